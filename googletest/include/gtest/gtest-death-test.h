@@ -44,11 +44,18 @@
 
 // This flag controls the style of death tests.  Valid values are "threadsafe",
 // meaning that the death test child process will re-execute the test binary
-// from the start, running only a single death test, or "fast",
+// from the start, running only a single death test, "zygote", meaning that
+// the child process will be forked from a copy of the test binary made by
+// InitGoogleTest() and run only a single death test, or "fast",
 // meaning that the child process will execute the test logic immediately
 // after forking.
 GTEST_DECLARE_string_(death_test_style);
 
+// This flag limits the size of the death test child process output kept for
+// matching and reporting.  Only its first and last half of this many bytes
+// are kept; 0 means no limit.
+GTEST_DECLARE_int32_(death_test_output_limit);
+
 namespace testing {
 
 #ifdef GTEST_HAS_DEATH_TEST
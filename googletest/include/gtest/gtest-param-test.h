@@ -176,6 +176,7 @@ TEST_P(DerivedTest, DoesBlah) {
 
 #include <functional>
 #include <iterator>
+#include <type_traits>
 #include <utility>
 
 #include "gtest/internal/gtest-internal.h"
@@ -247,13 +248,24 @@ internal::ParamGenerator<T> Range(T start, T end) {
 // ValuesIn(const Container& container)
 //   - returns a generator producing sequences with elements from
 //     an STL-style container.
+// ValuesIn(Container&& container)
+//   - same as above, but the container is moved into the generator instead
+//     of being copied.
+// ValuesIn(std::cref(range))
+//   - returns a generator producing sequences with elements from a random
+//     access container or C-style array without copying it. The range is
+//     read while tests are registered in RUN_ALL_TESTS(), so it must
+//     outlive that call and must not change size before it.
 // ValuesIn(Iterator begin, Iterator end)
 //   - returns a generator producing sequences with elements from
 //     a range [begin, end) defined by a pair of STL-style iterators. These
 //     iterators can also be plain C pointers.
 //
-// Please note that ValuesIn copies the values from the containers
-// passed in and keeps them to generate tests in RUN_ALL_TESTS().
+// Please note that, except for the std::cref() form, ValuesIn copies or
+// moves the values from the containers passed in and keeps them to generate
+// tests in RUN_ALL_TESTS(). Elements are not copied again while iterating,
+// and generators built from random access containers can be combined with
+// Combine() without materializing the product.
 //
 // Examples:
 //
@@ -312,6 +324,35 @@ internal::ParamGenerator<typename Container::value_type> ValuesIn(
   return ValuesIn(container.begin(), container.end());
 }
 
+template <class Container,
+          typename = std::enable_if_t<!std::is_lvalue_reference_v<Container>>>
+internal::ParamGenerator<typename Container::value_type> ValuesIn(
+    Container&& container) {
+  typedef typename Container::value_type ParamType;
+  typedef std::remove_cv_t<Container> StoredContainer;
+  if constexpr (internal::IsRandomAccessRange<StoredContainer>::value) {
+    return internal::ParamGenerator<ParamType>(
+        new internal::ValuesInContainerGenerator<ParamType, StoredContainer>(
+            std::move(container)));
+  } else {
+    return internal::ParamGenerator<ParamType>(
+        new internal::ValuesInIteratorRangeGenerator<ParamType>(
+            std::make_move_iterator(container.begin()),
+            std::make_move_iterator(container.end())));
+  }
+}
+
+template <class Range>
+internal::ParamGenerator<internal::RangeValueType<Range>> ValuesIn(
+    std::reference_wrapper<Range> range) {
+  static_assert(internal::IsRandomAccessRange<Range>::value,
+                "ValuesIn(std::cref(range)) requires a random access range.");
+  typedef internal::RangeValueType<Range> ParamType;
+  return internal::ParamGenerator<ParamType>(
+      new internal::ValuesInContainerGenerator<
+          ParamType, std::reference_wrapper<const Range>>(range.get()));
+}
+
 // Values() allows generating tests from explicitly specified list of
 // parameters.
 //
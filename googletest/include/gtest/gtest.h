@@ -51,7 +51,9 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <limits>
+#include <map>
 #include <memory>
 #include <ostream>
 #include <set>
@@ -82,13 +84,25 @@ GTEST_DISABLE_MSC_WARNINGS_PUSH_(4251 \
 // This flag temporary enables the disabled tests.
 GTEST_DECLARE_bool_(also_run_disabled_tests);
 
+// This flag makes the listeners that declare themselves async-safe receive
+// the events on a thread of their own.
+GTEST_DECLARE_bool_(async_listeners);
+
 // This flag brings the debugger on an assertion failure.
 GTEST_DECLARE_bool_(break_on_failure);
 
+// This flag sets the approximate number of milliseconds each benchmark test
+// spends timing its body.  0 runs the body once, without timing it.
+GTEST_DECLARE_int32_(benchmark_time_ms);
+
 // This flag controls whether Google Test catches all test-thrown exceptions
 // and logs them as failures.
 GTEST_DECLARE_bool_(catch_exceptions);
 
+// This flag sets the directory in which Google Test records the tests that
+// passed, so that later runs of the same binary can skip them.
+GTEST_DECLARE_string_(cache_dir);
+
 // This flag enables using colors in terminal output. Available values are
 // "yes" to enable colors, "no" (disable colors), or "auto" (the default)
 // to let Google Test decide.
@@ -106,6 +120,10 @@ GTEST_DECLARE_string_(filter);
 // debugging information when fatal signals are raised.
 GTEST_DECLARE_bool_(install_failure_signal_handler);
 
+// This flag sets the number of worker processes forked to run test suites
+// in parallel.  Values of 0 and 1 run all tests in the main process.
+GTEST_DECLARE_int32_(jobs);
+
 // This flag causes the Google Test to list tests. None of the tests listed
 // are actually run if the flag is provided.
 GTEST_DECLARE_bool_(list_tests);
@@ -114,6 +132,18 @@ GTEST_DECLARE_bool_(list_tests);
 // in addition to its normal textual output.
 GTEST_DECLARE_string_(output);
 
+// This flag sets the size in bytes of the buffer collecting the text output.
+// 0 writes the output after every event.
+GTEST_DECLARE_int32_(output_buffering);
+
+// This flag sets the number of worker threads used to run test suites in
+// parallel.  Values of 0 and 1 run all tests on the main thread.
+GTEST_DECLARE_int32_(parallel);
+
+// This flag selects, by name using a glob pattern, the test suites that must
+// run on the main thread when --gtest_parallel is in effect.
+GTEST_DECLARE_string_(parallel_exclude);
+
 // This flags control whether Google Test prints only test failures.
 GTEST_DECLARE_bool_(brief);
 
@@ -124,6 +154,15 @@ GTEST_DECLARE_bool_(print_time);
 // This flags control whether Google Test prints UTF8 characters as text.
 GTEST_DECLARE_bool_(print_utf8);
 
+// This flag controls whether Google Test measures the resources each test
+// uses, reports them, and prints the tests that use the most.
+GTEST_DECLARE_bool_(print_resources);
+
+// This flag controls whether Google Test measures the time spent in each
+// phase of the tests (fixture construction, SetUp(), the test body and so
+// on), reports it, and prints where the time went.
+GTEST_DECLARE_bool_(print_phase_times);
+
 // This flag specifies the random number seed.
 GTEST_DECLARE_int32_(random_seed);
 
@@ -137,10 +176,24 @@ GTEST_DECLARE_int32_(repeat);
 // only torn down once, for the last.
 GTEST_DECLARE_bool_(recreate_environments_when_repeating);
 
+// When this flag is set with "stdin" or a "unix:path" string, on supported
+// platforms the test program runs the tests requested on the standard input
+// or on the specified Unix domain socket instead of running them once.
+GTEST_DECLARE_string_(serve);
+
 // Together these flags determine which tests are run if the test is sharded.
 GTEST_DECLARE_int32_(shard_index);
 GTEST_DECLARE_int32_(total_shards);
 
+// This flag selects how the tests are assigned to the shards: by their order
+// ("index") or by a hash of their names ("hash", optionally followed by a
+// colon and the comma-separated weights of the shards).
+GTEST_DECLARE_string_(shard_by);
+
+// This flag names a JSON report of a previous run whose test durations are
+// used to balance the shards.
+GTEST_DECLARE_string_(shard_timing);
+
 // This flag controls whether Google Test includes Google Test internal
 // stack frames in failure stack traces.
 GTEST_DECLARE_bool_(show_internal_stack_frames);
@@ -152,6 +205,10 @@ GTEST_DECLARE_bool_(shuffle);
 // printed in a failure message.
 GTEST_DECLARE_int32_(stack_trace_depth);
 
+// This flag sets the number of seconds after which a test that is still
+// running is reported as timed out.  0 means no timeout.
+GTEST_DECLARE_int32_(test_timeout);
+
 // When this flag is specified, a failed assertion will throw an
 // exception if exceptions are enabled, or exit the program with a
 // non-zero code otherwise. For use with an external test framework.
@@ -159,7 +216,10 @@ GTEST_DECLARE_bool_(throw_on_failure);
 
 // When this flag is set with a "host:port" string, on supported
 // platforms test results are streamed to the specified port on
-// the specified host machine.
+// the specified host machine.  A "unix:path" string streams them to
+// the specified Unix domain socket instead, and a "shm:path" string
+// publishes them to a ring buffer in the specified memory-mapped file.
+// Any of these may be followed by '?' and '&'-separated options.
 GTEST_DECLARE_string_(stream_result_to);
 
 #if GTEST_USE_OWN_FLAGFILE_FLAG_
@@ -178,6 +238,7 @@ const int kMaxStackTraceDepth = 100;
 namespace internal {
 
 class AssertHelper;
+class BenchmarkRunner;
 class DefaultGlobalTestPartResultReporter;
 class ExecDeathTest;
 class NoExecDeathTest;
@@ -190,6 +251,7 @@ class TestEventRepeater;
 class UnitTestRecordPropertyTestHelper;
 class WindowsDeathTest;
 class FuchsiaDeathTest;
+class ZygoteDeathTest;
 class UnitTestImpl* GetUnitTestImpl();
 void ReportFailureInUnknownLocation(TestPartResult::Type result_type,
                                     const std::string& message);
@@ -309,6 +371,13 @@ class GTEST_API_ [[nodiscard]] Test {
     RecordProperty(key, (Message() << value).GetString());
   }
 
+  // Overrides --gtest_test_timeout for the currently running test: the test
+  // times out if it is still running timeout_in_seconds seconds from now.
+  // 0 means no timeout.  Can be called from the constructor or the SetUp()
+  // method of the test fixture, or from the test body.  Has no effect on
+  // platforms without threads.
+  static void SetTestTimeout(int timeout_in_seconds);
+
  protected:
   // Creates a Test object.
   Test();
@@ -366,6 +435,7 @@ class GTEST_API_ [[nodiscard]] Test {
 };
 
 typedef internal::TimeInMillis TimeInMillis;
+typedef internal::TimeInNanos TimeInNanos;
 
 // A copyable object representing a user specified test property which can be
 // output as a key/value string pair.
@@ -395,6 +465,92 @@ class [[nodiscard]] TestProperty {
   std::string value_;
 };
 
+// The timing of a benchmark test (see TEST_BENCHMARK): the statistics of the
+// time one run of its body took, over the samples it timed, each of the same
+// number of iterations.
+class GTEST_API_ BenchmarkResult {
+ public:
+  // Creates the result of a test that is not a benchmark.
+  BenchmarkResult() = default;
+
+  BenchmarkResult(int64_t iterations, int samples, double mean_ns,
+                  double median_ns, double stddev_ns)
+      : iterations_(iterations),
+        samples_(samples),
+        mean_ns_(mean_ns),
+        median_ns_(median_ns),
+        stddev_ns_(stddev_ns) {}
+
+  // Returns the number of iterations of the body in each sample.
+  int64_t iterations() const { return iterations_; }
+
+  // Returns the number of samples, or 0 if no timing was taken.
+  int samples() const { return samples_; }
+
+  // Returns the mean, median, and standard deviation of the time per
+  // iteration over the samples, in nanoseconds.
+  double mean_ns() const { return mean_ns_; }
+  double median_ns() const { return median_ns_; }
+  double stddev_ns() const { return stddev_ns_; }
+
+  // Returns the number of iterations per second at the mean time.
+  double iterations_per_second() const {
+    return mean_ns_ > 0 ? 1e9 / mean_ns_ : 0;
+  }
+
+ private:
+  int64_t iterations_ = 0;
+  int samples_ = 0;
+  double mean_ns_ = 0;
+  double median_ns_ = 0;
+  double stddev_ns_ = 0;
+};
+
+// The resources used by a test, as measured by --gtest_print_resources.  The
+// counters only cover the time the test ran, but they are those of the whole
+// process, other threads included.
+struct GTEST_API_ ResourceUsage {
+  // The CPU time spent in user code and in the kernel, in microseconds.
+  int64_t user_cpu_time_us = 0;
+  int64_t system_cpu_time_us = 0;
+  // The peak resident set size of the process when the test finished, and
+  // how much the test raised it, in kilobytes.
+  int64_t max_rss_kb = 0;
+  int64_t max_rss_growth_kb = 0;
+  // The page faults served without and with I/O.
+  int64_t minor_page_faults = 0;
+  int64_t major_page_faults = 0;
+  // The context switches in which the process gave up the CPU, waiting for
+  // something, and those in which it was preempted.
+  int64_t voluntary_context_switches = 0;
+  int64_t involuntary_context_switches = 0;
+};
+
+// The allocations made through the global operator new by the thread running
+// a test, as counted when the test program links the gtest_alloc library
+// (see EXPECT_ALLOCATIONS_LE).
+struct GTEST_API_ AllocationStats {
+  // The number of allocations, and the bytes they requested in total.
+  int64_t count = 0;
+  int64_t bytes = 0;
+  // The most bytes that were allocated at the same time, over those allocated
+  // when the counting started.
+  int64_t peak_bytes = 0;
+};
+
+// The time spent in each phase of a test, in nanoseconds, as measured with
+// --gtest_print_phase_times.
+struct GTEST_API_ TestPhaseTimes {
+  // Creating the test fixture object.
+  TimeInNanos constructor_nanos = 0;
+  // SetUp(), the test body and TearDown().
+  TimeInNanos set_up_nanos = 0;
+  TimeInNanos body_nanos = 0;
+  TimeInNanos tear_down_nanos = 0;
+  // Deleting the test fixture object.
+  TimeInNanos destructor_nanos = 0;
+};
+
 // The result of a single Test.  This includes a list of
 // TestPartResults, a list of TestProperties, a count of how many
 // death tests there are in the Test, and how much time it took to run
@@ -431,13 +587,47 @@ class GTEST_API_ [[nodiscard]] TestResult {
   // Returns true if and only if the test has a non-fatal failure.
   bool HasNonfatalFailure() const;
 
+  // Returns true if and only if the test was not run because it passed in a
+  // previous run recorded in --gtest_cache_dir.
+  bool Cached() const { return cached_; }
+
   // Returns the elapsed time, in milliseconds.
-  TimeInMillis elapsed_time() const { return elapsed_time_; }
+  TimeInMillis elapsed_time() const { return elapsed_time_nanos_ / 1000000; }
+
+  // Returns the elapsed time, in nanoseconds.
+  TimeInNanos elapsed_time_nanos() const { return elapsed_time_nanos_; }
 
   // Gets the time of the test case start, in ms from the start of the
   // UNIX epoch.
   TimeInMillis start_timestamp() const { return start_timestamp_; }
 
+  // Returns true if and only if the test is a benchmark that timed its body.
+  bool HasBenchmarkResult() const { return benchmark_result_.samples() > 0; }
+
+  // Returns the timing of the benchmark test, if HasBenchmarkResult().
+  const BenchmarkResult& benchmark_result() const { return benchmark_result_; }
+
+  // Returns true if and only if the resources the test used were measured
+  // (see --gtest_print_resources).
+  bool HasResourceUsage() const { return has_resource_usage_; }
+
+  // Returns the resources the test used, if HasResourceUsage().
+  const ResourceUsage& resource_usage() const { return resource_usage_; }
+
+  // Returns true if and only if the allocations of the test were counted,
+  // which requires linking the gtest_alloc library.
+  bool HasAllocationStats() const { return has_allocation_stats_; }
+
+  // Returns the allocations of the test, if HasAllocationStats().
+  const AllocationStats& allocation_stats() const { return allocation_stats_; }
+
+  // Returns true if and only if the time spent in each phase of the test was
+  // measured (see --gtest_print_phase_times).
+  bool HasPhaseTimes() const { return has_phase_times_; }
+
+  // Returns the time spent in each phase of the test, if HasPhaseTimes().
+  const TestPhaseTimes& phase_times() const { return phase_times_; }
+
   // Returns the i-th test part result among all the results. i can range from 0
   // to total_part_count() - 1. If i is not in that range, aborts the program.
   const TestPartResult& GetTestPartResult(int i) const;
@@ -448,15 +638,18 @@ class GTEST_API_ [[nodiscard]] TestResult {
   const TestProperty& GetTestProperty(int i) const;
 
  private:
+  friend class Test;
   friend class TestInfo;
   friend class TestSuite;
   friend class UnitTest;
+  friend class internal::BenchmarkRunner;
   friend class internal::DefaultGlobalTestPartResultReporter;
   friend class internal::ExecDeathTest;
   friend class internal::TestResultAccessor;
   friend class internal::UnitTestImpl;
   friend class internal::WindowsDeathTest;
   friend class internal::FuchsiaDeathTest;
+  friend class internal::ZygoteDeathTest;
 
   // Gets the vector of TestPartResults.
   const std::vector<TestPartResult>& test_part_results() const {
@@ -471,8 +664,33 @@ class GTEST_API_ [[nodiscard]] TestResult {
   // Sets the start time.
   void set_start_timestamp(TimeInMillis start) { start_timestamp_ = start; }
 
-  // Sets the elapsed time.
-  void set_elapsed_time(TimeInMillis elapsed) { elapsed_time_ = elapsed; }
+  // Sets the elapsed time, in milliseconds or in nanoseconds.
+  void set_elapsed_time(TimeInMillis elapsed) {
+    elapsed_time_nanos_ = elapsed * 1000000;
+  }
+  void set_elapsed_time_nanos(TimeInNanos elapsed) {
+    elapsed_time_nanos_ = elapsed;
+  }
+
+  // Sets whether the result of the test comes from the result cache.
+  void set_cached(bool cached) { cached_ = cached; }
+
+  // Sets the timing of the benchmark test.
+  void set_benchmark_result(const BenchmarkResult& benchmark_result) {
+    benchmark_result_ = benchmark_result;
+  }
+
+  // Sets the resources the test used.
+  void set_resource_usage(const ResourceUsage& resource_usage) {
+    resource_usage_ = resource_usage;
+    has_resource_usage_ = true;
+  }
+
+  // Sets the allocations of the test.
+  void set_allocation_stats(const AllocationStats& allocation_stats) {
+    allocation_stats_ = allocation_stats;
+    has_allocation_stats_ = true;
+  }
 
   // Adds a test property to the list. The property is validated and may add
   // a non-fatal failure if invalid (e.g., if it conflicts with reserved
@@ -516,8 +734,21 @@ class GTEST_API_ [[nodiscard]] TestResult {
   int death_test_count_;
   // The start time, in milliseconds since UNIX Epoch.
   TimeInMillis start_timestamp_;
-  // The elapsed time, in milliseconds.
-  TimeInMillis elapsed_time_;
+  // The elapsed time, in nanoseconds.
+  TimeInNanos elapsed_time_nanos_;
+  // Whether the test passed in a previous run and was not run again.
+  bool cached_;
+  // The timing of the test if it is a benchmark.
+  BenchmarkResult benchmark_result_;
+  // The resources the test used, if has_resource_usage_.
+  bool has_resource_usage_;
+  ResourceUsage resource_usage_;
+  // The allocations of the test, if has_allocation_stats_.
+  bool has_allocation_stats_;
+  AllocationStats allocation_stats_;
+  // The time spent in each phase of the test, if has_phase_times_.
+  bool has_phase_times_;
+  TestPhaseTimes phase_times_;
 
   // We disallow copying TestResult.
   TestResult(const TestResult&) = delete;
@@ -617,6 +848,10 @@ class GTEST_API_ [[nodiscard]] TestInfo {
       internal::TypeId fixture_class_id, internal::SetUpTestSuiteFunc set_up_tc,
       internal::TearDownTestSuiteFunc tear_down_tc,
       internal::TestFactoryBase* factory);
+  friend TestInfo* internal::MakeTestInfo(
+      std::string test_suite_name, const char* name, const char* type_param,
+      const char* value_param, internal::CodeLocation code_location,
+      internal::TypeId fixture_class_id, internal::TestFactoryBase* factory);
 
   // Constructs a TestInfo object. The newly constructed instance assumes
   // ownership of the factory object.
@@ -714,6 +949,10 @@ class GTEST_API_ [[nodiscard]] TestSuite {
   // Gets the number of skipped tests in this test suite.
   int skipped_test_count() const;
 
+  // Gets the number of tests in this test suite whose result was taken from
+  // the result cache.
+  int cached_test_count() const;
+
   // Gets the number of failed tests in this test suite.
   int failed_test_count() const;
 
@@ -729,7 +968,10 @@ class GTEST_API_ [[nodiscard]] TestSuite {
   // Get the number of tests in this test suite that should run.
   int test_to_run_count() const;
 
-  // Gets the number of all tests in this test suite.
+  // Gets the number of all tests in this test suite.  The instances of a
+  // parameterized test that RUN_ALL_TESTS() has not selected are only
+  // counted when their generator does not support random access (see
+  // docs/advanced.md).
   int total_test_count() const;
 
   // Returns true if and only if the test suite passed.
@@ -741,12 +983,29 @@ class GTEST_API_ [[nodiscard]] TestSuite {
   }
 
   // Returns the elapsed time, in milliseconds.
-  TimeInMillis elapsed_time() const { return elapsed_time_; }
+  TimeInMillis elapsed_time() const { return elapsed_time_nanos_ / 1000000; }
+
+  // Returns the elapsed time, in nanoseconds.
+  TimeInNanos elapsed_time_nanos() const { return elapsed_time_nanos_; }
 
   // Gets the time of the test suite start, in ms from the start of the
   // UNIX epoch.
   TimeInMillis start_timestamp() const { return start_timestamp_; }
 
+  // Returns true if and only if the time spent in SetUpTestSuite() and
+  // TearDownTestSuite() was measured (see --gtest_print_phase_times).
+  bool HasPhaseTimes() const { return has_phase_times_; }
+
+  // Returns the time spent in SetUpTestSuite(), in nanoseconds.
+  TimeInNanos set_up_test_suite_nanos() const {
+    return set_up_test_suite_nanos_;
+  }
+
+  // Returns the time spent in TearDownTestSuite(), in nanoseconds.
+  TimeInNanos tear_down_test_suite_nanos() const {
+    return tear_down_test_suite_nanos_;
+  }
+
   // Returns the i-th test among all the tests. i can range from 0 to
   // total_test_count() - 1. If i is not in that range, returns NULL.
   const TestInfo* GetTestInfo(int i) const;
@@ -778,6 +1037,33 @@ class GTEST_API_ [[nodiscard]] TestSuite {
   // destruction of the TestSuite object.
   void AddTestInfo(TestInfo* test_info);
 
+  // A group of tests whose TestInfo objects are created on demand.
+  struct DeferredTests {
+    // The number of tests added with AddTestInfo() before the group.
+    size_t position;
+    std::unique_ptr<internal::DeferredTestGroup> group;
+    // The TestInfo objects created so far, by index in the group.  They are
+    // also in test_info_list_, which owns them.
+    std::map<size_t, TestInfo*> test_infos;
+  };
+
+  // Adds a group of tests whose TestInfo objects are created on demand.
+  // Takes ownership of the group.
+  void AddDeferredTests(internal::DeferredTestGroup* group);
+
+  // Gets the number of deferred tests whose TestInfo objects have not been
+  // created.
+  int uncreated_test_count() const;
+
+  // Visits the tests of this test suite in registration order, calling
+  // on_test_info for each test added with AddTestInfo() and
+  // on_deferred_tests for each group of deferred tests.  The TestInfo
+  // objects created for a group are not passed to on_test_info; they are
+  // listed in the test_infos of the group.
+  void ForEachTest(
+      const std::function<void(TestInfo*)>& on_test_info,
+      const std::function<void(DeferredTests&)>& on_deferred_tests);
+
   // Clears the results of all tests in this test suite.
   void ClearResult();
 
@@ -818,6 +1104,11 @@ class GTEST_API_ [[nodiscard]] TestSuite {
     return test_info->should_run() && test_info->result()->Skipped();
   }
 
+  // Returns true if and only if the result of the test was cached.
+  static bool TestCached(const TestInfo* test_info) {
+    return test_info->should_run() && test_info->result()->Cached();
+  }
+
   // Returns true if and only if test failed.
   static bool TestFailed(const TestInfo* test_info) {
     return test_info->should_run() && test_info->result()->Failed();
@@ -858,6 +1149,8 @@ class GTEST_API_ [[nodiscard]] TestSuite {
   // The vector of TestInfos in their original order.  It owns the
   // elements in the vector.
   std::vector<TestInfo*> test_info_list_;
+  // The groups of tests whose TestInfo objects are created on demand.
+  std::vector<DeferredTests> deferred_tests_;
   // Provides a level of indirection for the test list to allow easy
   // shuffling and restoring the test order.  The i-th element in this
   // vector is the index of the i-th test in the shuffled test list.
@@ -870,8 +1163,13 @@ class GTEST_API_ [[nodiscard]] TestSuite {
   bool should_run_;
   // The start time, in milliseconds since UNIX Epoch.
   TimeInMillis start_timestamp_;
-  // Elapsed time, in milliseconds.
-  TimeInMillis elapsed_time_;
+  // Elapsed time, in nanoseconds.
+  TimeInNanos elapsed_time_nanos_;
+  // The time spent in SetUpTestSuite() and TearDownTestSuite(), in
+  // nanoseconds, if has_phase_times_.
+  bool has_phase_times_;
+  TimeInNanos set_up_test_suite_nanos_;
+  TimeInNanos tear_down_test_suite_nanos_;
   // Holds test properties recorded during execution of SetUpTestSuite and
   // TearDownTestSuite.
   TestResult ad_hoc_test_result_;
@@ -931,6 +1229,15 @@ class [[nodiscard]] TestEventListener {
  public:
   virtual ~TestEventListener() = default;
 
+  // Returns true if the listener can receive the events on a thread of its
+  // own, while the tests go on, when --gtest_async_listeners is specified.
+  // Such a listener receives the events in order, but must only read the
+  // result of a test in OnTestEnd(), the results of a test suite in
+  // OnTestSuiteEnd(), and the other results in OnTestIterationEnd() and
+  // OnTestProgramEnd(), as they keep changing otherwise, and must not
+  // generate failures.
+  virtual bool IsAsyncSafe() const { return false; }
+
   // Fired before any test activity starts.
   virtual void OnTestProgramStart(const UnitTest& unit_test) = 0;
 
@@ -1184,6 +1491,9 @@ class GTEST_API_ [[nodiscard]] UnitTest {
   // Gets the number of skipped tests.
   int skipped_test_count() const;
 
+  // Gets the number of tests whose result was taken from the result cache.
+  int cached_test_count() const;
+
   // Gets the number of failed tests.
   int failed_test_count() const;
 
@@ -1196,7 +1506,8 @@ class GTEST_API_ [[nodiscard]] UnitTest {
   // Gets the number of tests to be printed in the XML report.
   int reportable_test_count() const;
 
-  // Gets the number of all tests.
+  // Gets the number of all tests, counted as by
+  // TestSuite::total_test_count().
   int total_test_count() const;
 
   // Gets the number of tests that should run.
@@ -1209,6 +1520,19 @@ class GTEST_API_ [[nodiscard]] UnitTest {
   // Gets the elapsed time, in milliseconds.
   TimeInMillis elapsed_time() const;
 
+  // Gets the elapsed time, in nanoseconds.
+  TimeInNanos elapsed_time_nanos() const;
+
+  // Returns true if and only if the time spent setting up and tearing down
+  // the global test environments was measured (see
+  // --gtest_print_phase_times).
+  bool HasPhaseTimes() const;
+
+  // Gets the time spent setting up and tearing down the global test
+  // environments, in nanoseconds.
+  TimeInNanos environments_set_up_nanos() const;
+  TimeInNanos environments_tear_down_nanos() const;
+
   // Returns true if and only if the unit test passed (i.e. all test suites
   // passed).
   bool Passed() const;
@@ -2072,6 +2396,25 @@ GTEST_API_ AssertionResult DoubleLE(const char* expr1, const char* expr2,
 #define EXPECT_NO_FATAL_FAILURE(statement) \
   GTEST_TEST_NO_FATAL_FAILURE_(statement, GTEST_NONFATAL_FAILURE_)
 
+// Macros that execute statement and check how many times it allocates memory
+// through the global operator new in the current thread.  They require
+// linking the test program with the gtest_alloc library, and fail otherwise.
+//
+//   * {ASSERT|EXPECT}_ALLOCATIONS_LE(max_count, statement);
+//   * {ASSERT|EXPECT}_NO_ALLOCATIONS(statement);
+//
+// Examples:
+//
+//   EXPECT_NO_ALLOCATIONS(cache.Lookup(key));
+//   EXPECT_ALLOCATIONS_LE(1, queue.Push(item)) << "Push() should grow once";
+//
+#define ASSERT_ALLOCATIONS_LE(max_count, statement) \
+  GTEST_TEST_ALLOCATIONS_(max_count, statement, GTEST_FATAL_FAILURE_)
+#define EXPECT_ALLOCATIONS_LE(max_count, statement) \
+  GTEST_TEST_ALLOCATIONS_(max_count, statement, GTEST_NONFATAL_FAILURE_)
+#define ASSERT_NO_ALLOCATIONS(statement) ASSERT_ALLOCATIONS_LE(0, statement)
+#define EXPECT_NO_ALLOCATIONS(statement) EXPECT_ALLOCATIONS_LE(0, statement)
+
 // Causes a trace (including the given source file path and line number,
 // and the given message) to be included in every test failure message generated
 // by code in the scope of the lifetime of an instance of this class. The effect
@@ -2238,6 +2581,58 @@ constexpr bool StaticAssertTypeEq() noexcept {
 #define TEST_F(test_fixture, test_name) GTEST_TEST_F(test_fixture, test_name)
 #endif
 
+// Defines a benchmark test: a test whose body is run many times over and
+// timed.  Its mean, median, and standard deviation are reported along with
+// the other results of the test, which passes unless the body fails.
+//
+// Benchmark tests are registered, filtered, sharded, and run like the other
+// tests.  The body runs in batches timed as a whole, each about a tenth of
+// --gtest_benchmark_time_ms long.  A benchmark using a test fixture prepares
+// what the body needs in SetUp(), which runs once.  Example:
+//
+//   TEST_BENCHMARK(StringTest, Append) {
+//     std::string s;
+//     s.append("text");
+//     testing::DoNotOptimize(s);
+//   }
+//
+//   TEST_F_BENCHMARK(TableTest, Lookup) {
+//     testing::DoNotOptimize(table_.Find(key_));
+//   }
+#define GTEST_TEST_BENCHMARK(test_suite_name, test_name)             \
+  GTEST_TEST_BENCHMARK_(test_suite_name, test_name, ::testing::Test, \
+                        ::testing::internal::GetTestTypeId())
+#define GTEST_TEST_F_BENCHMARK(test_fixture, test_name)        \
+  GTEST_TEST_BENCHMARK_(test_fixture, test_name, test_fixture, \
+                        ::testing::internal::GetTypeId<test_fixture>())
+
+// Define this macro to 1 to omit the definition of TEST_BENCHMARK() and
+// TEST_F_BENCHMARK().
+#if !(defined(GTEST_DONT_DEFINE_TEST_BENCHMARK) && \
+      GTEST_DONT_DEFINE_TEST_BENCHMARK)
+#define TEST_BENCHMARK(test_suite_name, test_name) \
+  GTEST_TEST_BENCHMARK(test_suite_name, test_name)
+#define TEST_F_BENCHMARK(test_fixture, test_name) \
+  GTEST_TEST_F_BENCHMARK(test_fixture, test_name)
+#endif
+
+// Makes the compiler assume that value is used, so that a benchmark body
+// computing it is not optimized away.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+  // Values that fit in a register may stay in one; the others are forced to
+  // memory.
+  if (std::is_trivially_copyable<T>::value && sizeof(T) <= sizeof(void*)) {
+    asm volatile("" : : "r,m"(value) : "memory");
+  } else {
+    asm volatile("" : : "m"(value) : "memory");
+  }
+#else
+  internal::UseCharPointer(&reinterpret_cast<const volatile char&>(value));
+#endif
+}
+
 // Returns a path to a temporary directory, which should be writable. It is
 // implementation-dependent whether or not the path is terminated by the
 // directory-separator character.
@@ -304,6 +304,12 @@ class [[nodiscard]] InternalRunDeathTestFlag {
 // the flag is specified; otherwise returns NULL.
 InternalRunDeathTestFlag* ParseInternalRunDeathTestFlag();
 
+// Starts the fork server of "zygote"-style death tests if that style is
+// selected.  Must be called after the flags are parsed and before the flag
+// of the death test child process is.  In the child processes of zygote-style
+// death tests, returns with that flag set.
+void StartDeathTestZygoteIfRequested();
+
 #endif  // GTEST_HAS_DEATH_TEST
 
 }  // namespace internal
@@ -56,6 +56,7 @@
 #include <float.h>
 #include <string.h>
 
+#include <chrono>  // NOLINT
 #include <cstdint>
 #include <functional>
 #include <limits>
@@ -115,6 +116,8 @@ class TestInfo;         // Information about a test.
 class TestPartResult;   // Result of a test part.
 class UnitTest;         // A collection of test suites.
 
+struct AllocationStats;  // Allocations counted by gtest_alloc.
+
 template <typename T>
 ::std::string PrintToString(const T& value);
 
@@ -568,6 +571,53 @@ GTEST_API_ TestInfo* MakeAndRegisterTestInfo(
     TypeId fixture_class_id, SetUpTestSuiteFunc set_up_tc,
     TearDownTestSuiteFunc tear_down_tc, TestFactoryBase* factory);
 
+// Creates a new TestInfo object without registering it; the caller owns the
+// created object.  The arguments are the same as for
+// MakeAndRegisterTestInfo().
+GTEST_API_ TestInfo* MakeTestInfo(std::string test_suite_name, const char* name,
+                                  const char* type_param,
+                                  const char* value_param,
+                                  CodeLocation code_location,
+                                  TypeId fixture_class_id,
+                                  TestFactoryBase* factory);
+
+// A group of tests registered together, such as the instances of a TEST_P
+// created by an INSTANTIATE_TEST_SUITE_P, whose TestInfo objects are only
+// created for the tests that are selected to run.  The tests are identified
+// by their 0-based index in the group.
+class GTEST_API_ [[nodiscard]] DeferredTestGroup {
+ public:
+  virtual ~DeferredTestGroup() = default;
+
+  // Returns the number of tests in the group.
+  virtual size_t size() const = 0;
+
+  // Calls visit(index, name) for each test in the group, in order, until it
+  // returns false.  The names are computed on the fly and not kept.
+  virtual void ForEachTestName(
+      const std::function<bool(size_t, const std::string&)>& visit) const = 0;
+
+  // Returns the text representation of the value parameter of a test.
+  virtual std::string GetValueParam(size_t index) const = 0;
+
+  // Creates the TestInfo object of a test.  The caller owns the object.
+  virtual TestInfo* CreateTestInfo(size_t index) const = 0;
+};
+
+// Registers a group of tests whose TestInfo objects are created on demand.
+// Google Test takes ownership of the group.
+//
+// Arguments:
+//
+//   test_suite_name:  name of the test suite of the tests
+//   set_up_tc:        pointer to the function that sets up the test suite
+//   tear_down_tc:     pointer to the function that tears down the test suite
+//   group:            the tests
+GTEST_API_ void RegisterDeferredTests(std::string test_suite_name,
+                                      SetUpTestSuiteFunc set_up_tc,
+                                      TearDownTestSuiteFunc tear_down_tc,
+                                      DeferredTestGroup* group);
+
 // If *pstr starts with the given prefix, modifies *pstr to be right
 // past the prefix and returns true; otherwise leaves *pstr unchanged
 // and returns false.  None of pstr, *pstr, and prefix can be NULL.
@@ -1476,6 +1526,20 @@ class [[nodiscard]] NeverThrown {
                "failures in the current thread.\n"                  \
                "  Actual: it does.")
 
+#define GTEST_TEST_ALLOCATIONS_(max_count, statement, fail)                  \
+  GTEST_AMBIGUOUS_ELSE_BLOCKER_                                               \
+  if (::testing::internal::TrueWithString gtest_msg{}) {                     \
+    const ::testing::internal::AllocationScope gtest_allocation_scope;        \
+    GTEST_SUPPRESS_UNREACHABLE_CODE_WARNING_BELOW_(statement);                \
+    gtest_msg.value = ::testing::internal::CheckAllocations(                  \
+        gtest_allocation_scope, #statement, max_count);                       \
+    if (!gtest_msg.value.empty()) {                                           \
+      goto GTEST_CONCAT_TOKEN_(gtest_label_testallocations_, __LINE__);       \
+    }                                                                         \
+  } else /* NOLINT */                                                         \
+    GTEST_CONCAT_TOKEN_(gtest_label_testallocations_, __LINE__)               \
+        : fail(gtest_msg.value.c_str())
+
 // Expands to the name of the class that implements the given test.
 #define GTEST_TEST_CLASS_NAME_(test_suite_name, test_name) \
   test_suite_name##_##test_name##_Test
@@ -1521,4 +1585,125 @@ class [[nodiscard]] NeverThrown {
               .release());                                                     \
   void GTEST_TEST_CLASS_NAME_(test_suite_name, test_name)::TestBody()
 
+namespace testing {
+namespace internal {
+
+// Decides how many times the body of a benchmark test runs, and records its
+// timing in the result of the test.  The body first runs in batches of
+// growing size until a batch takes a tenth of --gtest_benchmark_time_ms;
+// then batches of that size are timed as the samples.
+class GTEST_API_ BenchmarkRunner {
+ public:
+  BenchmarkRunner();
+
+  // Returns the number of iterations of the body to time next, or 0 once the
+  // benchmark is done, which it also is as soon as the test fails.
+  int64_t NextIterations();
+
+  // Records that the given number of iterations took elapsed_nanos.
+  void Record(int64_t iterations, int64_t elapsed_nanos);
+
+ private:
+  // Records the statistics of the samples in the result of the test.
+  void Finish();
+
+  const int64_t budget_nanos_;
+  int64_t iterations_;
+  bool calibrated_;
+  bool done_;
+  // The time per iteration of each sample, in nanoseconds, and the total
+  // time of the samples.
+  std::vector<double> samples_;
+  int64_t sampled_nanos_;
+
+  BenchmarkRunner(const BenchmarkRunner&) = delete;
+  BenchmarkRunner& operator=(const BenchmarkRunner&) = delete;
+};
+
+// The allocation counters of a thread, kept by the global operator new and
+// operator delete of the gtest_alloc library.
+struct AllocationCounters {
+  int64_t count;
+  int64_t bytes;
+  // The bytes allocated and not yet deleted, and their highest value so far.
+  int64_t live_bytes;
+  int64_t peak_live_bytes;
+};
+
+// Installs the function that returns the allocation counters of the calling
+// thread.  gtest_alloc calls it when the program starts.
+GTEST_API_ void SetAllocationCountersGetter(AllocationCounters* (*getter)());
+
+// Returns the allocation counters of the calling thread, or nullptr if the
+// allocations are not counted.
+GTEST_API_ AllocationCounters* GetThreadAllocationCounters();
+
+// Counts the allocations the current thread makes while the scope lives.
+// Scopes nest.
+class GTEST_API_ AllocationScope {
+ public:
+  AllocationScope();
+  ~AllocationScope();
+
+  // Returns true if and only if the allocations are counted.
+  bool counting() const { return counters_ != nullptr; }
+
+  // Returns the allocations made since the scope started.
+  AllocationStats Stats() const;
+
+ private:
+  AllocationCounters* const counters_;
+  AllocationCounters start_;
+
+  AllocationScope(const AllocationScope&) = delete;
+  AllocationScope& operator=(const AllocationScope&) = delete;
+};
+
+// Returns an empty string if the allocations of scope, in which statement
+// ran, number at most max_count, and the failure message otherwise.
+GTEST_API_ std::string CheckAllocations(const AllocationScope& scope,
+                                        const char* statement,
+                                        int64_t max_count);
+
+// Does nothing, out of the compiler's sight, for DoNotOptimize().
+GTEST_API_ void UseCharPointer(const volatile char* pointer);
+
+// Times body as a benchmark test does.  Only the loop around it is timed.
+template <typename Body>
+void RunBenchmark(Body body) {
+  BenchmarkRunner runner;
+  for (int64_t iterations; (iterations = runner.NextIterations()) > 0;) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < iterations; ++i) body();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    runner.Record(
+        iterations,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  }
+}
+
+}  // namespace internal
+}  // namespace testing
+
+// Expands to the name of the class that holds the body of the given
+// benchmark test.
+#define GTEST_BENCHMARK_CLASS_NAME_(test_suite_name, test_name) \
+  test_suite_name##_##test_name##_Benchmark
+
+// Helper macro for defining benchmark tests.  The test is an ordinary one
+// whose body times the code that follows the macro.
+#define GTEST_TEST_BENCHMARK_(test_suite_name, test_name, parent_class,       \
+                              parent_id)                                      \
+  class GTEST_BENCHMARK_CLASS_NAME_(test_suite_name, test_name)               \
+      : public parent_class {                                                 \
+   protected:                                                                 \
+    void BenchmarkBody();                                                     \
+  };                                                                          \
+  GTEST_TEST_(test_suite_name, test_name,                                     \
+              GTEST_BENCHMARK_CLASS_NAME_(test_suite_name, test_name),        \
+              parent_id) {                                                    \
+    ::testing::internal::RunBenchmark([this] { BenchmarkBody(); });           \
+  }                                                                           \
+  void GTEST_BENCHMARK_CLASS_NAME_(test_suite_name, test_name)::BenchmarkBody()
+
 #endif  // GOOGLETEST_INCLUDE_GTEST_INTERNAL_GTEST_INTERNAL_H_
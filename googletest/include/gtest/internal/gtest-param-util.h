@@ -38,11 +38,14 @@
 
 #include <ctype.h>
 
+#include <algorithm>
 #include <cassert>
 #include <functional>
 #include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
+#include <optional>
 #include <ostream>
 #include <set>
 #include <string>
@@ -178,6 +181,65 @@ class [[nodiscard]] ParamGeneratorInterface {
   // Generator interface definition
   virtual ParamIteratorInterface<T>* Begin() const = 0;
   virtual ParamIteratorInterface<T>* End() const = 0;
+
+  // Optional random access interface. Generators that can compute an element
+  // from its position return true from IsRandomAccess() and implement Size()
+  // and At(). This lets Combine() and ConvertGenerator() address their
+  // components by index instead of walking and copying them.
+  virtual bool IsRandomAccess() const { return false; }
+  // Returns the number of elements in the sequence. Must only be called when
+  // IsRandomAccess() returns true.
+  virtual size_t Size() const { return 0; }
+  // Returns a pointer to the element at the given index, which must be less
+  // than Size(). Elements stored by the generator are returned in place;
+  // computed elements are constructed in *storage, which the caller owns.
+  virtual const T* At(size_t /* index */,
+                      std::optional<T>* /* storage */) const {
+    return nullptr;
+  }
+};
+
+// Iterates over a random access generator by index. Advancing the iterator
+// never allocates; the current element is computed lazily by the generator.
+template <typename T>
+class [[nodiscard]] IndexedParamIterator : public ParamIteratorInterface<T> {
+ public:
+  IndexedParamIterator(const ParamGeneratorInterface<T>* base, size_t index)
+      : base_(base), index_(index) {}
+  ~IndexedParamIterator() override = default;
+
+  const ParamGeneratorInterface<T>* BaseGenerator() const override {
+    return base_;
+  }
+  void Advance() override {
+    ++index_;
+    value_ = nullptr;
+  }
+  ParamIteratorInterface<T>* Clone() const override {
+    return new IndexedParamIterator(base_, index_);
+  }
+  const T* Current() const override {
+    if (value_ == nullptr) value_ = base_->At(index_, &storage_);
+    return value_;
+  }
+  bool Equals(const ParamIteratorInterface<T>& other) const override {
+    // Having the same base generator guarantees that the other
+    // iterator is of the same type and we can downcast.
+    GTEST_CHECK_(BaseGenerator() == other.BaseGenerator())
+        << "The program attempted to compare iterators "
+        << "from different generators." << std::endl;
+    return index_ ==
+           CheckedDowncastToActualType<const IndexedParamIterator>(&other)
+               ->index_;
+  }
+
+ private:
+  const ParamGeneratorInterface<T>* const base_;
+  size_t index_;
+  // Holds the current element when the generator computes it rather than
+  // storing it. Both members are caches and thus mutable.
+  mutable std::optional<T> storage_;
+  mutable const T* value_ = nullptr;
 };
 
 // Wraps ParamGeneratorInterface<T> and provides general generator syntax
@@ -201,6 +263,9 @@ class [[nodiscard]] ParamGenerator {
   iterator begin() const { return iterator(impl_->Begin()); }
   iterator end() const { return iterator(impl_->End()); }
 
+  // Gives generator adaptors access to the optional random access interface.
+  const ParamGeneratorInterface<T>* impl() const { return impl_.get(); }
+
  private:
   std::shared_ptr<const ParamGeneratorInterface<T>> impl_;
 };
@@ -226,6 +291,22 @@ class [[nodiscard]] RangeGenerator : public ParamGeneratorInterface<T> {
     return new Iterator(this, end_, end_index_, step_);
   }
 
+  // Integral ranges can compute their elements directly. Other types only
+  // promise operator+ and are iterated by repeated addition.
+  bool IsRandomAccess() const override { return kIsIntegral; }
+  size_t Size() const override { return static_cast<size_t>(end_index_); }
+  const T* At(size_t index, std::optional<T>* storage) const override {
+    if constexpr (kIsIntegral) {
+      storage->emplace(static_cast<T>(
+          begin_ + static_cast<IncrementT>(index) * step_));
+      return &**storage;
+    } else {
+      static_cast<void>(index);
+      static_cast<void>(storage);
+      return nullptr;
+    }
+  }
+
  private:
   class Iterator : public ParamIteratorInterface<T> {
    public:
@@ -283,6 +364,9 @@ class [[nodiscard]] RangeGenerator : public ParamGeneratorInterface<T> {
   // No implementation - assignment is unsupported.
   void operator=(const RangeGenerator& other);
 
+  static constexpr bool kIsIntegral =
+      std::is_integral<T>::value && std::is_integral<IncrementT>::value;
+
   const T begin_;
   const T end_;
   const IncrementT step_;
@@ -291,89 +375,87 @@ class [[nodiscard]] RangeGenerator : public ParamGeneratorInterface<T> {
   const int end_index_;
 };  // class RangeGenerator
 
-// Generates values from a pair of STL-style iterators. Used in the
-// ValuesIn() function. The elements are copied from the source range
-// since the source can be located on the stack, and the generator
-// is likely to persist beyond that stack frame.
 template <typename T>
-class [[nodiscard]] ValuesInIteratorRangeGenerator
+struct IsReferenceWrapper : std::false_type {};
+template <typename T>
+struct IsReferenceWrapper<std::reference_wrapper<T>> : std::true_type {};
+
+// The element type of a container, C-style array, or other range.
+template <typename Range>
+using RangeValueType = typename std::iterator_traits<decltype(std::begin(
+    std::declval<const Range&>()))>::value_type;
+
+// Whether the elements of a range can be addressed in constant time.
+template <typename Range>
+using IsRandomAccessRange = std::is_base_of<
+    std::random_access_iterator_tag,
+    typename std::iterator_traits<decltype(std::begin(
+        std::declval<const Range&>()))>::iterator_category>;
+
+// Generates values from a random access container. Used in the ValuesIn()
+// function. Container is either a container owned by the generator or a
+// std::reference_wrapper viewing a range that outlives the generator. The
+// elements are handed out in place, so iterating never copies them.
+template <typename T, typename Container>
+class [[nodiscard]] ValuesInContainerGenerator
     : public ParamGeneratorInterface<T> {
  public:
-  template <typename ForwardIterator>
-  ValuesInIteratorRangeGenerator(ForwardIterator begin, ForwardIterator end)
-      : container_(begin, end) {}
-  ~ValuesInIteratorRangeGenerator() override = default;
+  explicit ValuesInContainerGenerator(Container container)
+      : container_(std::move(container)) {}
+  ~ValuesInContainerGenerator() override = default;
 
   ParamIteratorInterface<T>* Begin() const override {
-    return new Iterator(this, container_.begin());
+    return new IndexedParamIterator<T>(this, 0);
   }
   ParamIteratorInterface<T>* End() const override {
-    return new Iterator(this, container_.end());
+    return new IndexedParamIterator<T>(this, Size());
   }
 
- private:
-  typedef typename ::std::vector<T> ContainerType;
-
-  class Iterator : public ParamIteratorInterface<T> {
-   public:
-    Iterator(const ParamGeneratorInterface<T>* base,
-             typename ContainerType::const_iterator iterator)
-        : base_(base), iterator_(iterator) {}
-    ~Iterator() override = default;
-
-    const ParamGeneratorInterface<T>* BaseGenerator() const override {
-      return base_;
-    }
-    void Advance() override {
-      ++iterator_;
-      value_.reset();
-    }
-    ParamIteratorInterface<T>* Clone() const override {
-      return new Iterator(*this);
-    }
-    // We need to use cached value referenced by iterator_ because *iterator_
-    // can return a temporary object (and of type other then T), so just
-    // having "return &*iterator_;" doesn't work.
-    // value_ is updated here and not in Advance() because Advance()
-    // can advance iterator_ beyond the end of the range, and we cannot
-    // detect that fact. The client code, on the other hand, is
-    // responsible for not calling Current() on an out-of-range iterator.
-    const T* Current() const override {
-      if (value_.get() == nullptr) value_.reset(new T(*iterator_));
-      return value_.get();
-    }
-    bool Equals(const ParamIteratorInterface<T>& other) const override {
-      // Having the same base generator guarantees that the other
-      // iterator is of the same type and we can downcast.
-      GTEST_CHECK_(BaseGenerator() == other.BaseGenerator())
-          << "The program attempted to compare iterators "
-          << "from different generators." << std::endl;
-      return iterator_ ==
-             CheckedDowncastToActualType<const Iterator>(&other)->iterator_;
+  bool IsRandomAccess() const override { return true; }
+  size_t Size() const override {
+    return static_cast<size_t>(std::end(range()) - std::begin(range()));
+  }
+  const T* At(size_t index, std::optional<T>* storage) const override {
+    auto it = std::begin(range());
+    std::advance(it, index);
+    // Containers such as std::vector<bool> return proxies rather than
+    // references, in which case the element has to be materialized.
+    if constexpr (std::is_same<decltype(*it), const T&>::value) {
+      static_cast<void>(storage);
+      return &*it;
+    } else {
+      storage->emplace(*it);
+      return &**storage;
     }
+  }
 
-   private:
-    Iterator(const Iterator& other)
-        // The explicit constructor call suppresses a false warning
-        // emitted by gcc when supplied with the -Wextra option.
-        : ParamIteratorInterface<T>(),
-          base_(other.base_),
-          iterator_(other.iterator_) {}
-
-    const ParamGeneratorInterface<T>* const base_;
-    typename ContainerType::const_iterator iterator_;
-    // A cached value of *iterator_. We keep it here to allow access by
-    // pointer in the wrapping iterator's operator->().
-    // value_ needs to be mutable to be accessed in Current().
-    // Use of std::unique_ptr helps manage cached value's lifetime,
-    // which is bound by the lifespan of the iterator itself.
-    mutable std::unique_ptr<const T> value_;
-  };  // class ValuesInIteratorRangeGenerator::Iterator
+ private:
+  const auto& range() const {
+    if constexpr (IsReferenceWrapper<Container>::value) {
+      return container_.get();
+    } else {
+      return container_;
+    }
+  }
 
   // No implementation - assignment is unsupported.
-  void operator=(const ValuesInIteratorRangeGenerator& other);
+  void operator=(const ValuesInContainerGenerator& other);
+
+  const Container container_;
+};  // class ValuesInContainerGenerator
 
-  const ContainerType container_;
+// Generates values from a pair of STL-style iterators. Used in the
+// ValuesIn() function. The elements are copied from the source range
+// since the source can be located on the stack, and the generator
+// is likely to persist beyond that stack frame.
+template <typename T>
+class [[nodiscard]] ValuesInIteratorRangeGenerator
+    : public ValuesInContainerGenerator<T, std::vector<T>> {
+ public:
+  template <typename ForwardIterator>
+  ValuesInIteratorRangeGenerator(ForwardIterator begin, ForwardIterator end)
+      : ValuesInContainerGenerator<T, std::vector<T>>(
+            std::vector<T>(begin, end)) {}
 };  // class ValuesInIteratorRangeGenerator
 
 // INTERNAL IMPLEMENTATION - DO NOT USE IN USER CODE.
@@ -572,6 +654,25 @@ class [[nodiscard]] ParameterizedTestSuiteInfo
           test_suite_name.clear();
         test_suite_name += test_suite_name_;
 
+        // The tests of a random access generator are registered as a group
+        // whose TestInfo objects are only created for the tests selected to
+        // run.  Their names are still checked here, once per instantiation
+        // as they do not depend on the test, whether or not they are
+        // selected.
+        if (generator.impl()->IsRandomAccess()) {
+          if (generator.impl()->Size() == 0) continue;
+          generated_instantiations = true;
+          auto* const deferred_tests = new DeferredTests(
+              test_suite_name, test_info, instantiation, generator);
+          if (test_info == tests_.front()) deferred_tests->CheckParamNames();
+          RegisterDeferredTests(
+              test_suite_name,
+              SuiteApiResolver<TestSuite>::GetSetUpCaseOrSuite(file, line),
+              SuiteApiResolver<TestSuite>::GetTearDownCaseOrSuite(file, line),
+              deferred_tests);
+          continue;
+        }
+
         size_t i = 0;
         std::set<std::string> test_param_names;
         for (const auto& param : generator) {
@@ -656,6 +757,93 @@ class [[nodiscard]] ParameterizedTestSuiteInfo
   };
   typedef ::std::vector<InstantiationInfo> InstantiationContainer;
 
+  // The tests created from a TEST_P by an INSTANTIATE_TEST_SUITE_P with a
+  // random access generator.  The parameter, name and TestInfo object of
+  // each test are computed from its index when needed.
+  class DeferredTests : public DeferredTestGroup {
+   public:
+    DeferredTests(std::string test_suite_name,
+                  std::shared_ptr<TestInfo> test_info,
+                  const InstantiationInfo& instantiation,
+                  ParamGenerator<ParamType> generator)
+        : test_suite_name_(std::move(test_suite_name)),
+          test_info_(std::move(test_info)),
+          instantiation_(instantiation),
+          generator_(std::move(generator)) {}
+
+    size_t size() const override { return generator_.impl()->Size(); }
+
+    void ForEachTestName(const std::function<bool(size_t, const std::string&)>&
+                             visit) const override {
+      for (size_t i = 0; i < size(); ++i) {
+        if (!visit(i, GetTestName(GetParamName(i)))) return;
+      }
+    }
+
+    // Checks that the parameter names are valid and distinct, as for the
+    // tests registered one by one.  Only the hashes of the names are kept;
+    // the names are compared when the hashes collide.
+    void CheckParamNames() const {
+      std::vector<std::pair<size_t, size_t>> hashes;
+      hashes.reserve(size());
+      for (size_t i = 0; i < size(); ++i) {
+        hashes.emplace_back(std::hash<std::string>()(GetParamName(i)), i);
+      }
+      std::sort(hashes.begin(), hashes.end());
+      for (size_t i = 1; i < hashes.size(); ++i) {
+        for (size_t j = i; j > 0 && hashes[j - 1].first == hashes[i].first;
+             --j) {
+          const std::string param_name = GetParamName(hashes[i].second);
+          GTEST_CHECK_(GetParamName(hashes[j - 1].second) != param_name)
+              << "Duplicate parameterized test name '" << param_name
+              << "', in " << instantiation_.file << " line "
+              << instantiation_.line << std::endl;
+        }
+      }
+    }
+
+    std::string GetValueParam(size_t index) const override {
+      std::optional<ParamType> storage;
+      return PrintToString(*generator_.impl()->At(index, &storage));
+    }
+
+    ::testing::TestInfo* CreateTestInfo(size_t index) const override {
+      std::optional<ParamType> storage;
+      const ParamType& param = *generator_.impl()->At(index, &storage);
+      return MakeTestInfo(
+          test_suite_name_, GetTestName(GetParamName(index)).c_str(),
+          nullptr,  // No type parameter.
+          PrintToString(param).c_str(), test_info_->code_location,
+          GetTypeId<TestSuite>(),
+          test_info_->test_meta_factory->CreateTestFactory(param));
+    }
+
+   private:
+    std::string GetParamName(size_t index) const {
+      std::optional<ParamType> storage;
+      std::string param_name =
+          instantiation_.name_func(TestParamInfo<ParamType>(
+              *generator_.impl()->At(index, &storage), index));
+      GTEST_CHECK_(IsValidParamName(param_name))
+          << "Parameterized test name '" << param_name
+          << "' is invalid (contains spaces, dashes, or any "
+             "non-alphanumeric characters other than underscores), in "
+          << instantiation_.file << " line " << instantiation_.line << ""
+          << std::endl;
+      return param_name;
+    }
+
+    std::string GetTestName(const std::string& param_name) const {
+      if (test_info_->test_base_name.empty()) return param_name;
+      return test_info_->test_base_name + "/" + param_name;
+    }
+
+    const std::string test_suite_name_;
+    const std::shared_ptr<TestInfo> test_info_;
+    const InstantiationInfo instantiation_;
+    const ParamGenerator<ParamType> generator_;
+  };
+
   static bool IsValidParamName(const std::string& name) {
     // Check for empty string
     if (name.empty()) return false;
@@ -789,15 +977,6 @@ class [[nodiscard]] TypeParameterizedTestSuiteRegistry {
   std::map<std::string, TypeParameterizedTestSuiteInfo> suites_;
 };
 
-}  // namespace internal
-
-// Forward declarations of ValuesIn(), which is implemented in
-// include/gtest/gtest-param-test.h.
-template <class Container>
-internal::ParamGenerator<typename Container::value_type> ValuesIn(
-    const Container& container);
-
-namespace internal {
 // Used in the Values() function to provide polymorphic capabilities.
 
 GTEST_DISABLE_MSC_WARNINGS_PUSH_(4100)
@@ -809,7 +988,9 @@ class [[nodiscard]] ValueArray {
 
   template <typename T>
   operator ParamGenerator<T>() const {  // NOLINT
-    return ValuesIn(MakeVector<T>(std::make_index_sequence<sizeof...(Ts)>()));
+    return ParamGenerator<T>(
+        new ValuesInContainerGenerator<T, std::vector<T>>(
+            MakeVector<T>(std::make_index_sequence<sizeof...(Ts)>())));
   }
 
  private:
@@ -830,17 +1011,69 @@ class [[nodiscard]] CartesianProductGenerator
   typedef ::std::tuple<T...> ParamType;
 
   CartesianProductGenerator(const std::tuple<ParamGenerator<T>...>& g)
-      : generators_(g) {}
+      : generators_(g),
+        is_random_access_(std::apply(
+            [](const ParamGenerator<T>&... gen) {
+              return (gen.impl()->IsRandomAccess() && ...);
+            },
+            generators_)) {
+    // A product too large to be indexed by size_t is iterated instead.
+    if (is_random_access_) {
+      is_random_access_ = ComputeStrides<sizeof...(T) - 1>(1);
+    }
+  }
   ~CartesianProductGenerator() override = default;
 
+  // When every component is random access the product is addressed by
+  // index: element i is decomposed into one index per component, with the
+  // last component varying fastest. Nothing is materialized up front and
+  // advancing an iterator does not allocate.
   ParamIteratorInterface<ParamType>* Begin() const override {
+    if (is_random_access_) return new IndexedParamIterator<ParamType>(this, 0);
     return new Iterator(this, generators_, false);
   }
   ParamIteratorInterface<ParamType>* End() const override {
+    if (is_random_access_) {
+      return new IndexedParamIterator<ParamType>(this, Size());
+    }
     return new Iterator(this, generators_, true);
   }
 
+  bool IsRandomAccess() const override { return is_random_access_; }
+  size_t Size() const override { return size_; }
+  const ParamType* At(size_t index,
+                      std::optional<ParamType>* storage) const override {
+    return ComputeAt(index, storage, std::index_sequence_for<T...>());
+  }
+
  private:
+  // Returns false if the size of the product overflows size_t.
+  template <size_t ThisI>
+  bool ComputeStrides(size_t stride) {
+    strides_[ThisI] = stride;
+    const size_t size = std::get<ThisI>(generators_).impl()->Size();
+    if (size != 0 && stride > std::numeric_limits<size_t>::max() / size) {
+      return false;
+    }
+    if constexpr (ThisI == 0) {
+      size_ = stride * size;
+      return true;
+    } else {
+      return ComputeStrides<ThisI - 1>(stride * size);
+    }
+  }
+
+  template <size_t... I>
+  const ParamType* ComputeAt(size_t index, std::optional<ParamType>* storage,
+                             std::index_sequence<I...>) const {
+    // Components that compute their elements construct them here.
+    std::tuple<std::optional<T>...> components;
+    storage->emplace(*std::get<I>(generators_).impl()->At(
+        index / strides_[I] % std::get<I>(generators_).impl()->Size(),
+        &std::get<I>(components))...);
+    return &**storage;
+  }
+
   template <class I>
   class IteratorImpl;
   template <size_t... I>
@@ -938,6 +1171,10 @@ class [[nodiscard]] CartesianProductGenerator
   using Iterator = IteratorImpl<std::make_index_sequence<sizeof...(T)>>;
 
   std::tuple<ParamGenerator<T>...> generators_;
+  bool is_random_access_;
+  // Only computed when is_random_access_ is true.
+  size_t strides_[sizeof...(T)] = {};
+  size_t size_ = 0;
 };
 
 template <class... Gen>
@@ -962,12 +1199,25 @@ class [[nodiscard]] ParamGeneratorConverter
       : generator_(std::move(gen)), converter_(std::move(converter)) {}
 
   ParamIteratorInterface<To>* Begin() const override {
+    if (IsRandomAccess()) return new IndexedParamIterator<To>(this, 0);
     return new Iterator(this, generator_.begin(), generator_.end());
   }
   ParamIteratorInterface<To>* End() const override {
+    if (IsRandomAccess()) return new IndexedParamIterator<To>(this, Size());
     return new Iterator(this, generator_.end(), generator_.end());
   }
 
+  bool IsRandomAccess() const override {
+    return generator_.impl()->IsRandomAccess();
+  }
+  size_t Size() const override { return generator_.impl()->Size(); }
+  const To* At(size_t index, std::optional<To>* storage) const override {
+    std::optional<From> from;
+    storage->emplace(static_cast<To>(
+        converter_(*generator_.impl()->At(index, &from))));
+    return &**storage;
+  }
+
   // Returns the std::function wrapping the user-supplied converter callable. It
   // is used by the iterator (see class Iterator below) to convert the object
   // (of type FROM) returned by the ParamGenerator to an object of a type that
@@ -203,6 +203,7 @@
 //   GTEST_USE_OWN_FLAGFILE_FLAG_ - Always defined to 0 or 1.
 //   GTEST_HAS_CXXABI_H_ - Always defined to 0 or 1.
 //   GTEST_CAN_STREAM_RESULTS_ - Always defined to 0 or 1.
+//   GTEST_CAN_RUN_TEST_JOBS_ - Always defined to 0 or 1.
 //   GTEST_HAS_ALT_PATH_SEP_ - Always defined to 0 or 1.
 //   GTEST_WIDE_STRING_USES_UTF16_ - Always defined to 0 or 1.
 //   GTEST_HAS_MUTEX_AND_THREAD_LOCAL_ - Always defined to 0 or 1.
@@ -235,7 +236,7 @@
 //
 // Integer types:
 //   TypeWithSize   - maps an integer to a int type.
-//   TimeInMillis   - integers of known sizes.
+//   TimeInMillis, TimeInNanos - integers of known sizes.
 //   BiggestInt     - the biggest signed integer type.
 //
 // Command-line utilities:
@@ -776,6 +777,28 @@ typedef struct _RTL_CRITICAL_SECTION GTEST_CRITICAL_SECTION;
 #define GTEST_CAN_STREAM_RESULTS_ 0
 #endif
 
+// Determines whether tests can be run in a pool of forked worker processes
+// (--gtest_jobs).
+#if defined(GTEST_OS_LINUX) || defined(GTEST_OS_GNU_KFREEBSD) || \
+    defined(GTEST_OS_DRAGONFLY) || defined(GTEST_OS_FREEBSD) ||  \
+    defined(GTEST_OS_NETBSD) || defined(GTEST_OS_OPENBSD) ||     \
+    defined(GTEST_OS_GNU_HURD) || defined(GTEST_OS_MAC)
+#define GTEST_CAN_RUN_TEST_JOBS_ 1
+#else
+#define GTEST_CAN_RUN_TEST_JOBS_ 0
+#endif
+
+// Determines whether the resources used by each test can be measured with
+// getrusage() (--gtest_print_resources).
+#if defined(GTEST_OS_LINUX) || defined(GTEST_OS_GNU_KFREEBSD) || \
+    defined(GTEST_OS_DRAGONFLY) || defined(GTEST_OS_FREEBSD) ||  \
+    defined(GTEST_OS_NETBSD) || defined(GTEST_OS_OPENBSD) ||     \
+    defined(GTEST_OS_GNU_HURD) || defined(GTEST_OS_MAC)
+#define GTEST_CAN_MEASURE_RESOURCES_ 1
+#else
+#define GTEST_CAN_MEASURE_RESOURCES_ 0
+#endif
+
 // Defines some utility macros.
 
 // The GNU compiler emits a warning if nested "if" statements are followed by
@@ -1239,9 +1262,16 @@ Derived* CheckedDowncastToActualType(Base* base) {
 //   CaptureStderr     - starts capturing stderr.
 //   GetCapturedStderr - stops capturing stderr and returns the captured string.
 //
+// Given a max_size, only the first max_size bytes of the output are
+// returned.  On Linux, the output is held in memory and never touches the
+// file system; with a max_size, the rest of it is dropped as it is written,
+// so a large output takes at most max_size bytes of memory.  Without one,
+// all of the output is held in memory until it is returned.
 GTEST_API_ void CaptureStdout();
+GTEST_API_ void CaptureStdout(size_t max_size);
 GTEST_API_ std::string GetCapturedStdout();
 GTEST_API_ void CaptureStderr();
+GTEST_API_ void CaptureStderr(size_t max_size);
 GTEST_API_ std::string GetCapturedStderr();
 
 #endif  // GTEST_HAS_STREAM_REDIRECTION
@@ -2329,6 +2359,7 @@ class [[nodiscard]] TypeWithSize<8> {
 
 // Integer types of known sizes.
 using TimeInMillis = int64_t;  // Represents time in milliseconds.
+using TimeInNanos = int64_t;   // Represents time in nanoseconds.
 
 // Utilities for command line flags and environment variables.
 
@@ -33,7 +33,9 @@
 #include "gtest/gtest-death-test.h"
 
 #include <stdlib.h>
+#include <string.h>
 
+#include <algorithm>
 #include <functional>
 #include <memory>
 #include <sstream>
@@ -53,17 +55,15 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
-
-#ifdef GTEST_OS_LINUX
-#include <signal.h>
-#endif  // GTEST_OS_LINUX
-
 #include <stdarg.h>
 
 #ifdef GTEST_OS_WINDOWS
 #include <windows.h>
 #else
+#include <poll.h>
+#include <signal.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/wait.h>
 #endif  // GTEST_OS_WINDOWS
 
@@ -110,10 +110,21 @@ GTEST_DEFINE_string_(
                                           testing::kDefaultDeathTestStyle),
     "Indicates how to run a death test in a forked child process: "
     "\"threadsafe\" (child process re-executes the test binary "
-    "from the beginning, running only the specific death test) or "
+    "from the beginning, running only the specific death test), "
+    "\"zygote\" (like \"threadsafe\", but the child process is forked "
+    "from a copy of the test program made by InitGoogleTest() instead "
+    "of re-executing it) or "
     "\"fast\" (child process runs the death test immediately "
     "after forking).");
 
+GTEST_DEFINE_int32_(
+    death_test_output_limit,
+    testing::internal::Int32FromGTestEnv("death_test_output_limit",
+                                         1024 * 1024),
+    "The maximum number of bytes of the stderr output of a death test "
+    "child process kept for matching and reporting. Only the first and the "
+    "last half of them are kept; 0 means no limit.");
+
 GTEST_DEFINE_bool_(
     death_test_use_fork,
     testing::internal::BoolFromGTestEnv("death_test_use_fork", false),
@@ -161,7 +172,8 @@ bool InDeathTestChild() {
 
 #else
 
-  if (GTEST_FLAG_GET(death_test_style) == "threadsafe")
+  if (GTEST_FLAG_GET(death_test_style) == "threadsafe" ||
+      GTEST_FLAG_GET(death_test_style) == "zygote")
     return !GTEST_FLAG_GET(internal_run_death_test).empty();
   else
     return g_in_fast_death_test_child;
@@ -402,6 +414,76 @@ void DeathTest::set_last_death_test_message(const std::string& message) {
 
 std::string DeathTest::last_death_test_message_;
 
+// Holds the stderr output of a death test child process.  With a limit, only
+// its first and last limit / 2 bytes are kept, the latter in a ring buffer,
+// so the memory used does not depend on how much the child process writes.
+class DeathTestOutput {
+ public:
+  // A limit of 0 means that all of the output is kept.
+  explicit DeathTestOutput(size_t limit)
+      : head_limit_(limit == 0 ? std::string::npos : limit - limit / 2),
+        tail_limit_(limit / 2),
+        tail_start_(0),
+        omitted_size_(0) {}
+
+  // Appends size bytes of output.
+  void Append(const char* data, size_t size) {
+    const size_t head_size = std::min(size, head_limit_ - head_.size());
+    head_.append(data, head_size);
+    data += head_size;
+    size -= head_size;
+    if (size == 0) return;
+
+    // Drops what does not fit into the tail, oldest first.
+    if (size >= tail_limit_) {
+      omitted_size_ += tail_.size() + size - tail_limit_;
+      tail_.assign(data + size - tail_limit_, tail_limit_);
+      tail_start_ = 0;
+      return;
+    }
+    const size_t appended_size = std::min(size, tail_limit_ - tail_.size());
+    tail_.append(data, appended_size);
+    data += appended_size;
+    size -= appended_size;
+    omitted_size_ += size;
+    while (size > 0) {
+      const size_t chunk_size = std::min(size, tail_limit_ - tail_start_);
+      tail_.replace(tail_start_, chunk_size, data, chunk_size);
+      tail_start_ = (tail_start_ + chunk_size) % tail_limit_;
+      data += chunk_size;
+      size -= chunk_size;
+    }
+  }
+  void Append(const std::string& data) { Append(data.data(), data.size()); }
+
+  // Returns the kept output.  If some was omitted, a line saying how much
+  // separates its first and last part.
+  std::string Contents() const {
+    std::string contents = head_;
+    if (omitted_size_ > 0) {
+      if (!contents.empty() && contents.back() != '\n') contents += '\n';
+      contents += "[... " + StreamableToString(omitted_size_) +
+                  " bytes omitted ...]\n";
+    }
+    contents.append(tail_, tail_start_, std::string::npos);
+    contents.append(tail_, 0, tail_start_);
+    return contents;
+  }
+
+  // Returns the number of bytes of output that were not kept.
+  size_t omitted_size() const { return omitted_size_; }
+
+ private:
+  const size_t head_limit_;
+  const size_t tail_limit_;
+  std::string head_;
+  // A ring buffer of the last tail_limit_ bytes of the output, which starts
+  // at tail_start_ once it is full.
+  std::string tail_;
+  size_t tail_start_;
+  size_t omitted_size_;
+};
+
 // Provides cross platform implementation for some death functionality.
 class DeathTestImpl : public DeathTest {
  protected:
@@ -412,7 +494,9 @@ class DeathTestImpl : public DeathTest {
         status_(-1),
         outcome_(IN_PROGRESS),
         read_fd_(-1),
-        write_fd_(-1) {}
+        write_fd_(-1),
+        output_(static_cast<size_t>(
+            (std::max)(GTEST_FLAG_GET(death_test_output_limit), 0))) {}
 
   // read_fd_ is expected to be closed and cleared by a derived class.
   ~DeathTestImpl() override { GTEST_DEATH_TEST_CHECK_(read_fd_ == -1); }
@@ -438,9 +522,13 @@ class DeathTestImpl : public DeathTest {
   // case of unexpected codes.
   void ReadAndInterpretStatusByte();
 
-  // Returns stderr output from the child process.
+  // Returns stderr output from the child process, as far as it is kept by
+  // output().
   virtual std::string GetErrorLogs();
 
+  // Returns the buffer that keeps the stderr output of the child process.
+  DeathTestOutput* output() { return &output_; }
+
  private:
   // The textual content of the code this object is testing.  This class
   // doesn't own this string and should not attempt to delete it.
@@ -461,6 +549,8 @@ class DeathTestImpl : public DeathTest {
   // It is always -1 in the parent process.  The parent keeps its end of the
   // pipe in read_fd_.
   int write_fd_;
+  // The stderr output of the child process.
+  DeathTestOutput output_;
 };
 
 // Called in the parent process only. Reads the result code of the death
@@ -508,7 +598,10 @@ void DeathTestImpl::ReadAndInterpretStatusByte() {
   set_read_fd(-1);
 }
 
-std::string DeathTestImpl::GetErrorLogs() { return GetCapturedStderr(); }
+std::string DeathTestImpl::GetErrorLogs() {
+  output_.Append(GetCapturedStderr());
+  return output_.Contents();
+}
 
 // Signals that the death test code which should have exited, didn't.
 // Should be called only in a death test child process.
@@ -623,7 +716,15 @@ bool DeathTestImpl::Passed(bool status_ok) {
           << "DeathTest::Passed somehow called before conclusion of test";
   }
 
-  DeathTest::set_last_death_test_message(buffer.GetString());
+  std::string message = buffer.GetString();
+  if (!success && output_.omitted_size() > 0) {
+    if (message.back() != '\n') message += '\n';
+    message += "      Note: " + StreamableToString(output_.omitted_size()) +
+               " bytes of the output were omitted; see --" GTEST_FLAG_PREFIX_
+               "death_test_output_limit.\n";
+  }
+
+  DeathTest::set_last_death_test_message(message);
   return success;
 }
 
@@ -848,8 +949,6 @@ class FuchsiaDeathTest : public DeathTestImpl {
   const char* const file_;
   // The line number on which the death test is located.
   const int line_;
-  // The stderr data captured by the child process.
-  std::string captured_stderr_;
 
   zx::process child_process_;
   zx::channel exception_channel_;
@@ -910,14 +1009,11 @@ int FuchsiaDeathTest::Wait() {
       if (packet.signal.observed & ZX_SOCKET_READABLE) {
         // Read data from the socket.
         constexpr size_t kBufferSize = 1024;
+        char buffer[kBufferSize];
         do {
-          size_t old_length = captured_stderr_.length();
           size_t bytes_read = 0;
-          captured_stderr_.resize(old_length + kBufferSize);
-          status_zx =
-              stderr_socket_.read(0, &captured_stderr_.front() + old_length,
-                                  kBufferSize, &bytes_read);
-          captured_stderr_.resize(old_length + bytes_read);
+          status_zx = stderr_socket_.read(0, buffer, kBufferSize, &bytes_read);
+          output()->Append(buffer, status_zx == ZX_OK ? bytes_read : 0);
         } while (status_zx == ZX_OK);
         if (status_zx == ZX_ERR_PEER_CLOSED) {
           socket_closed = true;
@@ -1046,7 +1142,7 @@ DeathTest::TestRole FuchsiaDeathTest::AssumeRole() {
   return OVERSEE_TEST;
 }
 
-std::string FuchsiaDeathTest::GetErrorLogs() { return captured_stderr_; }
+std::string FuchsiaDeathTest::GetErrorLogs() { return output()->Contents(); }
 
 #else  // We are neither on Windows, nor on Fuchsia.
 
@@ -1063,15 +1159,115 @@ class ForkingDeathTest : public DeathTestImpl {
  protected:
   void set_child_pid(pid_t child_pid) { child_pid_ = child_pid; }
 
+  // Makes stderr the write end of a new pipe, so that the child process
+  // spawned next inherits it, until RestoreStderr() is called.  The output
+  // is read into output() while waiting for the child process.
+  void RedirectStderrToPipe();
+  void RestoreStderr();
+  // Closes the descriptors the parent process keeps for reading the output.
+  // Called in a forked child process.
+  void CloseOutputPipeInChild();
+
+  // Reads the output of the child process until fd becomes readable, so
+  // that the child process cannot block writing to a full pipe while the
+  // parent waits for fd.
+  void ReadOutputUntilReadable(int fd);
+  // Reads the output that is left in the pipe once the child process has
+  // exited, and closes the pipe.
+  void ReadRemainingOutput();
+
+  std::string GetErrorLogs() override { return output()->Contents(); }
+
  private:
+  // Reads what is available from the pipe into output().  Returns false at
+  // the end of the output or on error, after closing the pipe.
+  bool ReadOutput();
+
   // PID of child process during death test; 0 in the child process itself.
   pid_t child_pid_;
+  // The read end of the pipe carrying the stderr output of the child
+  // process, or -1.
+  int output_fd_;
+  // A duplicate of the original stderr while it is redirected, or -1.
+  int saved_stderr_fd_;
 };
 
 // Constructs a ForkingDeathTest.
 ForkingDeathTest::ForkingDeathTest(const char* a_statement,
                                    Matcher<const std::string&> matcher)
-    : DeathTestImpl(a_statement, std::move(matcher)), child_pid_(-1) {}
+    : DeathTestImpl(a_statement, std::move(matcher)),
+      child_pid_(-1),
+      output_fd_(-1),
+      saved_stderr_fd_(-1) {}
+
+void ForkingDeathTest::RedirectStderrToPipe() {
+  int pipe_fd[2];
+  GTEST_DEATH_TEST_CHECK_(pipe(pipe_fd) != -1);
+  fflush(nullptr);
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(saved_stderr_fd_ =
+                                      fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 0));
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(dup2(pipe_fd[1], STDERR_FILENO));
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(close(pipe_fd[1]));
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(fcntl(pipe_fd[0], F_SETFD, FD_CLOEXEC));
+  output_fd_ = pipe_fd[0];
+}
+
+void ForkingDeathTest::RestoreStderr() {
+  fflush(stderr);
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(dup2(saved_stderr_fd_, STDERR_FILENO));
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(close(saved_stderr_fd_));
+  saved_stderr_fd_ = -1;
+}
+
+void ForkingDeathTest::CloseOutputPipeInChild() {
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(close(output_fd_));
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(close(saved_stderr_fd_));
+  output_fd_ = -1;
+  saved_stderr_fd_ = -1;
+}
+
+bool ForkingDeathTest::ReadOutput() {
+  char buffer[16 * 1024];
+  ssize_t num_read;
+  do {
+    num_read = read(output_fd_, buffer, sizeof(buffer));
+  } while (num_read == -1 && errno == EINTR);
+  if (num_read > 0) {
+    output()->Append(buffer, static_cast<size_t>(num_read));
+    return true;
+  }
+  if (num_read == -1 && errno == EAGAIN) return false;
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(close(output_fd_));
+  output_fd_ = -1;
+  return false;
+}
+
+void ForkingDeathTest::ReadOutputUntilReadable(int fd) {
+  for (;;) {
+    pollfd poll_fds[2] = {{fd, POLLIN, 0}, {output_fd_, POLLIN, 0}};
+    const nfds_t poll_fd_count = output_fd_ == -1 ? 1 : 2;
+    int poll_result;
+    GTEST_DEATH_TEST_CHECK_SYSCALL_(poll_result =
+                                        poll(poll_fds, poll_fd_count, -1));
+    if (poll_fd_count == 2 && poll_fds[1].revents != 0) ReadOutput();
+    if (poll_fds[0].revents != 0) return;
+  }
+}
+
+void ForkingDeathTest::ReadRemainingOutput() {
+  if (output_fd_ == -1) return;
+  // Descendants of the child process may keep the pipe open, so only the
+  // output that is already there is read.
+  const int flags = fcntl(output_fd_, F_GETFL);
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(
+      fcntl(output_fd_, F_SETFL, flags | O_NONBLOCK));
+  while (ReadOutput()) {
+  }
+  if (output_fd_ != -1) {
+    GTEST_DEATH_TEST_CHECK_SYSCALL_(close(output_fd_));
+    output_fd_ = -1;
+  }
+}
 
 // Waits for the child in a death test to exit, returning its exit
 // status, or 0 if no child process exists.  As a side effect, sets the
@@ -1079,10 +1275,12 @@ ForkingDeathTest::ForkingDeathTest(const char* a_statement,
 int ForkingDeathTest::Wait() {
   if (!spawned()) return 0;
 
+  ReadOutputUntilReadable(read_fd());
   ReadAndInterpretStatusByte();
 
   int status_value;
   GTEST_DEATH_TEST_CHECK_SYSCALL_(waitpid(child_pid_, &status_value, 0));
+  ReadRemainingOutput();
   set_status(status_value);
   return status_value;
 }
@@ -1108,7 +1306,7 @@ DeathTest::TestRole NoExecDeathTest::AssumeRole() {
   GTEST_DEATH_TEST_CHECK_(pipe(pipe_fd) != -1);
 
   DeathTest::set_last_death_test_message("");
-  CaptureStderr();
+  RedirectStderrToPipe();
   // When we fork the process below, the log file buffers are copied, but the
   // file descriptors are shared.  We flush all log files here so that closing
   // the file descriptors in the child process doesn't throw off the
@@ -1116,6 +1314,7 @@ DeathTest::TestRole NoExecDeathTest::AssumeRole() {
   // This is as close to the fork as possible to avoid a race condition in case
   // there are multiple threads running before the death test, and another
   // thread writes to the log file.
+  FlushAsyncTestEvents();
   FlushInfoLog();
 
   const pid_t child_pid = fork();
@@ -1123,6 +1322,7 @@ DeathTest::TestRole NoExecDeathTest::AssumeRole() {
   set_child_pid(child_pid);
   if (child_pid == 0) {
     GTEST_DEATH_TEST_CHECK_SYSCALL_(close(pipe_fd[0]));
+    CloseOutputPipeInChild();
     set_write_fd(pipe_fd[1]);
     // Redirects all logging to stderr in the child process to prevent
     // concurrent writes to the log files.  We capture stderr in the parent
@@ -1134,6 +1334,7 @@ DeathTest::TestRole NoExecDeathTest::AssumeRole() {
     g_in_fast_death_test_child = true;
     return EXECUTE_TEST;
   } else {
+    RestoreStderr();
     GTEST_DEATH_TEST_CHECK_SYSCALL_(close(pipe_fd[1]));
     set_read_fd(pipe_fd[0]);
     set_spawned(true);
@@ -1153,6 +1354,10 @@ class ExecDeathTest : public ForkingDeathTest {
         line_(line) {}
   TestRole AssumeRole() override;
 
+ protected:
+  const char* file() const { return file_; }
+  int line() const { return line_; }
+
  private:
   static ::std::vector<std::string> GetArgvsForDeathTestChildProcess() {
     ::std::vector<std::string> args = GetInjectableArgvs();
@@ -1383,13 +1588,15 @@ DeathTest::TestRole ExecDeathTest::AssumeRole() {
 
   DeathTest::set_last_death_test_message("");
 
-  CaptureStderr();
-  // See the comment in NoExecDeathTest::AssumeRole for why the next line
-  // is necessary.
+  RedirectStderrToPipe();
+  // See the comment in NoExecDeathTest::AssumeRole for why the next lines
+  // are necessary.
+  FlushAsyncTestEvents();
   FlushInfoLog();
 
   std::vector<char*> argv = CreateArgvFromArgs(args);
   const pid_t child_pid = ExecDeathTestSpawnChild(argv.data(), pipe_fd[0]);
+  RestoreStderr();
   GTEST_DEATH_TEST_CHECK_SYSCALL_(close(pipe_fd[1]));
   set_child_pid(child_pid);
   set_read_fd(pipe_fd[0]);
@@ -1397,8 +1604,382 @@ DeathTest::TestRole ExecDeathTest::AssumeRole() {
   return OVERSEE_TEST;
 }
 
+#ifndef GTEST_OS_QNX
+#ifndef GTEST_OS_MAC
+extern "C" char** environ;
+#endif  // GTEST_OS_MAC
+
+// Returns the environment of the current process.
+static char** GetEnvironment() {
+#ifdef GTEST_OS_MAC
+  return *_NSGetEnviron();
+#else
+  return environ;
+#endif  // GTEST_OS_MAC
+}
+
+// The sending end of the datagram socket on which the zygote of
+// zygote-style death tests receives its requests, or -1 if no zygote runs
+// for this process.
+static int g_zygote_request_fd = -1;
+
+// The number of file descriptors passed along with each request to the
+// zygote: a stream socket connected to the requester, the write end of the
+// status pipe of the death test, and the requester's stdout and stderr.
+static const int kZygoteRequestFdCount = 4;
+
+// Writes all of the given bytes to fd, retrying on short writes.  Returns
+// false on error.
+static bool WriteAllToFd(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    const ssize_t written = write(fd, data, size);
+    if (written == -1) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += written;
+    size -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+// Reads from fd until the end of file, appending the data to *out.
+// Returns false on error.
+static bool ReadAllFromFd(int fd, std::string* out) {
+  char buffer[4096];
+  for (;;) {
+    const ssize_t num_read = read(fd, buffer, sizeof(buffer));
+    if (num_read == 0) return true;
+    if (num_read == -1) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    out->append(buffer, static_cast<size_t>(num_read));
+  }
+}
+
+// Sends a request to the zygote, passing the given file descriptors.
+// Returns false if the zygote cannot be reached.
+static bool SendZygoteRequest(const int (&fds)[kZygoteRequestFdCount]) {
+  char byte = 0;
+  iovec iov = {&byte, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+  memset(control, 0, sizeof(control));
+  msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  cmsghdr* const header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(header), fds, sizeof(fds));
+  ssize_t sent;
+  do {
+    sent = sendmsg(g_zygote_request_fd, &message, 0);
+  } while (sent == -1 && errno == EINTR);
+  return sent == 1;
+}
+
+// Receives a request in the zygote, storing the passed file descriptors in
+// fds.  Returns false if no well-formed request could be read.
+static bool ReceiveZygoteRequest(int request_fd,
+                                 int (&fds)[kZygoteRequestFdCount]) {
+  char byte;
+  iovec iov = {&byte, 1};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+  msghdr message;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  if (recvmsg(request_fd, &message, 0) != 1) return false;
+  const cmsghdr* const header = CMSG_FIRSTHDR(&message);
+  if (header == nullptr || header->cmsg_level != SOL_SOCKET ||
+      header->cmsg_type != SCM_RIGHTS) {
+    return false;
+  }
+  // The control buffer has room for the expected descriptors only, so a
+  // request can only come with fewer, and is then dropped.
+  const size_t fd_count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+  memcpy(fds, CMSG_DATA(header), fd_count * sizeof(int));
+  if (fd_count != kZygoteRequestFdCount) {
+    for (size_t i = 0; i < fd_count; ++i) close(fds[i]);
+    return false;
+  }
+  return true;
+}
+
+// Handles one request in a process forked from the zygote.  The request,
+// sent by the main process on fds[0], consists of the file, line and index
+// of the death test, the full name of the test containing it and the
+// environment of the main process, all terminated by '\0'.  The function
+// forks the death test child process, in which it returns after setting up
+// the flags that make it run only the requested death test, just like the
+// command line of a threadsafe-style death test child process would.  In
+// the forking process, it sends the exit status of the child back to the
+// main process and exits.
+static void HandleZygoteRequest(const int (&fds)[kZygoteRequestFdCount]) {
+  std::string request;
+  std::vector<std::string> fields;
+  if (ReadAllFromFd(fds[0], &request)) {
+    for (size_t start = 0; start < request.size();) {
+      const size_t end = request.find('\0', start);
+      if (end == std::string::npos) break;
+      fields.push_back(request.substr(start, end - start));
+      start = end + 1;
+    }
+  }
+  // The main process reports a missing exit status as an error.
+  if (fields.size() < 4) _Exit(1);
+
+  const pid_t child_pid = fork();
+  if (child_pid == 0) {
+    close(fds[0]);
+    dup2(fds[2], 1);
+    dup2(fds[3], 2);
+    close(fds[2]);
+    close(fds[3]);
+
+    // Gives the child the working directory and the environment a
+    // threadsafe-style death test child process would have.
+    const char* const original_dir =
+        UnitTest::GetInstance()->original_working_dir();
+    if (chdir(original_dir) != 0) {
+      DeathTestAbort(std::string("chdir(\"") + original_dir +
+                     "\") failed: " + GetLastErrnoDescription());
+    }
+    std::vector<std::string> names;
+    for (char** env = GetEnvironment(); *env != nullptr; ++env) {
+      const char* const equals = strchr(*env, '=');
+      if (equals != nullptr) {
+        names.emplace_back(*env, static_cast<size_t>(equals - *env));
+      }
+    }
+    for (const std::string& name : names) unsetenv(name.c_str());
+    for (size_t i = 4; i < fields.size(); ++i) {
+      const size_t equals = fields[i].find('=');
+      if (equals == std::string::npos) continue;
+      setenv(fields[i].substr(0, equals).c_str(),
+             fields[i].c_str() + equals + 1, 1);
+    }
+
+    GTEST_FLAG_SET(filter, fields[3]);
+    GTEST_FLAG_SET(internal_run_death_test,
+                   fields[0] + "|" + fields[1] + "|" + fields[2] + "|" +
+                       StreamableToString(fds[1]));
+    return;
+  }
+  close(fds[1]);
+  close(fds[2]);
+  close(fds[3]);
+  if (child_pid == -1) _Exit(1);
+
+  int status_value;
+  pid_t waited;
+  do {
+    waited = waitpid(child_pid, &status_value, 0);
+  } while (waited == -1 && errno == EINTR);
+  if (waited == -1) _Exit(1);
+  WriteAllToFd(fds[0], reinterpret_cast<const char*>(&status_value),
+               sizeof(status_value));
+  _Exit(0);
+}
+
+// The main loop of the zygote: forks a process for each request received
+// on request_fd, until the main process exits and thereby closes the write
+// end of the lifeline pipe.  Returns only in a death test child process.
+static void RunDeathTestZygote(int request_fd, int lifeline_fd) {
+  // The zygote must not keep the output of the main process open, and the
+  // processes it forks for requests are reaped automatically.
+  const int null_fd = open("/dev/null", O_WRONLY);
+  if (null_fd != -1) {
+    dup2(null_fd, 1);
+    dup2(null_fd, 2);
+    close(null_fd);
+  }
+  signal(SIGCHLD, SIG_IGN);
+
+  for (;;) {
+    pollfd poll_fds[2] = {{request_fd, POLLIN, 0}, {lifeline_fd, POLLIN, 0}};
+    if (poll(poll_fds, 2, -1) == -1) {
+      if (errno == EINTR) continue;
+      _Exit(1);
+    }
+    if (poll_fds[1].revents != 0) _Exit(0);
+    if (poll_fds[0].revents == 0) continue;
+
+    int fds[kZygoteRequestFdCount];
+    if (!ReceiveZygoteRequest(request_fd, fds)) continue;
+    const pid_t pid = fork();
+    if (pid == 0) {
+      signal(SIGCHLD, SIG_DFL);
+      close(request_fd);
+      close(lifeline_fd);
+      HandleZygoteRequest(fds);
+      return;
+    }
+    for (int fd : fds) close(fd);
+  }
+}
+
+// A concrete death test class that runs the death test like ExecDeathTest
+// does, but has the child process forked from the zygote started by
+// StartDeathTestZygoteIfRequested() instead of re-executing the program.
+// The zygote is a copy of the program made in InitGoogleTest(), so the
+// child skips the static initialization and flag parsing of a re-executed
+// program.  Without a zygote, the death test runs in the threadsafe style.
+class ZygoteDeathTest : public ExecDeathTest {
+ public:
+  ZygoteDeathTest(const char* a_statement, Matcher<const std::string&> matcher,
+                  const char* file, int line)
+      : ExecDeathTest(a_statement, std::move(matcher), file, line),
+        zygote_fd_(-1) {}
+  TestRole AssumeRole() override;
+  int Wait() override;
+
+ private:
+  // The connection on which the zygote reports the exit status of the
+  // child process; -1 if the child process was not forked by the zygote.
+  int zygote_fd_;
+};
+
+// The AssumeRole process for a zygote-style death test.  It asks the zygote
+// for a child process running the current death test, passing it the
+// write end of the status pipe and the (captured) standard output streams.
+DeathTest::TestRole ZygoteDeathTest::AssumeRole() {
+  const UnitTestImpl* const impl = GetUnitTestImpl();
+  if (g_zygote_request_fd == -1 ||
+      impl->internal_run_death_test_flag() != nullptr) {
+    return ExecDeathTest::AssumeRole();
+  }
+  const TestInfo* const info = impl->current_test_info();
+  const int death_test_index = info->result()->death_test_count();
+
+  std::string request = std::string(file()) + '\0' +
+                        StreamableToString(line()) + '\0' +
+                        StreamableToString(death_test_index) + '\0' +
+                        info->test_suite_name() + "." + info->name() + '\0';
+  for (char** env = GetEnvironment(); *env != nullptr; ++env) {
+    request += *env;
+    request += '\0';
+  }
+
+  int pipe_fd[2];
+  GTEST_DEATH_TEST_CHECK_(pipe(pipe_fd) != -1);
+  int socket_fd[2];
+  GTEST_DEATH_TEST_CHECK_(socketpair(AF_UNIX, SOCK_STREAM, 0, socket_fd) !=
+                          -1);
+
+  DeathTest::set_last_death_test_message("");
+
+  RedirectStderrToPipe();
+  // See the comment in NoExecDeathTest::AssumeRole for why the next line
+  // is necessary.
+  FlushInfoLog();
+
+  const int fds[kZygoteRequestFdCount] = {socket_fd[1], pipe_fd[1], 1, 2};
+  const bool request_sent = SendZygoteRequest(fds);
+  RestoreStderr();
+  if (!request_sent) {
+    DeathTestAbort("Cannot send a request to the death test zygote: " +
+                   GetLastErrnoDescription());
+  }
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(close(socket_fd[1]));
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(close(pipe_fd[1]));
+  GTEST_DEATH_TEST_CHECK_(
+      WriteAllToFd(socket_fd[0], request.data(), request.size()));
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(shutdown(socket_fd[0], SHUT_WR));
+  zygote_fd_ = socket_fd[0];
+  set_read_fd(pipe_fd[0]);
+  set_spawned(true);
+  return OVERSEE_TEST;
+}
+
+// Waits for the child forked by the zygote to exit, returning the exit
+// status the zygote reports for it.
+int ZygoteDeathTest::Wait() {
+  if (zygote_fd_ == -1) return ExecDeathTest::Wait();
+
+  ReadOutputUntilReadable(read_fd());
+  ReadAndInterpretStatusByte();
+
+  std::string reply;
+  const bool read_ok = ReadAllFromFd(zygote_fd_, &reply);
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(close(zygote_fd_));
+  zygote_fd_ = -1;
+  int status_value;
+  if (!read_ok || reply.size() != sizeof(status_value)) {
+    DeathTestAbort(
+        "The death test zygote did not report the exit status of the death "
+        "test child process");
+  }
+  memcpy(&status_value, reply.data(), sizeof(status_value));
+  ReadRemainingOutput();
+  set_status(status_value);
+  return status_value;
+}
+
+#endif  // GTEST_OS_QNX
+
 #endif  // !GTEST_OS_WINDOWS
 
+// Starts the zygote of zygote-style death tests if the death test style is
+// "zygote" and this is not a death test child process.  The zygote is a
+// single-threaded copy of the current process that forks the child
+// processes of zygote-style death tests.  This function returns in those
+// child processes too, with the flags set that make them run only their
+// death test.
+void StartDeathTestZygoteIfRequested() {
+#if !defined(GTEST_OS_WINDOWS) && !defined(GTEST_OS_FUCHSIA) && \
+    !defined(GTEST_OS_QNX)
+  if (GTEST_FLAG_GET(death_test_style) != "zygote" ||
+      !GTEST_FLAG_GET(internal_run_death_test).empty() ||
+      g_zygote_request_fd != -1) {
+    return;
+  }
+
+  // Forking the zygote from a process running other threads would give
+  // death tests the problems the threadsafe style exists to avoid.
+  const size_t thread_count = GetThreadCount();
+  if (thread_count != 1) {
+    GTEST_LOG_(WARNING) << DeathTestThreadWarning(thread_count)
+                        << " Zygote-style death tests will re-execute the "
+                        << "test program instead.";
+    return;
+  }
+
+  int request_fd[2];
+  int lifeline_fd[2];
+  GTEST_DEATH_TEST_CHECK_(socketpair(AF_UNIX, SOCK_DGRAM, 0, request_fd) !=
+                          -1);
+  GTEST_DEATH_TEST_CHECK_(pipe(lifeline_fd) != -1);
+  // Output buffered so far must not be written again by death tests.
+  fflush(stdout);
+  fflush(stderr);
+  FlushAsyncTestEvents();
+  const pid_t pid = fork();
+  GTEST_DEATH_TEST_CHECK_(pid != -1);
+  if (pid == 0) {
+    close(request_fd[0]);
+    close(lifeline_fd[1]);
+    RunDeathTestZygote(request_fd[1], lifeline_fd[0]);
+    return;
+  }
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(close(request_fd[1]));
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(close(lifeline_fd[0]));
+  // Keeps the descriptors from leaking into the processes of
+  // threadsafe-style death tests.  The write end of the lifeline pipe stays
+  // open until this process exits.
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(fcntl(request_fd[0], F_SETFD, FD_CLOEXEC));
+  GTEST_DEATH_TEST_CHECK_SYSCALL_(fcntl(lifeline_fd[1], F_SETFD, FD_CLOEXEC));
+  g_zygote_request_fd = request_fd[0];
+#endif  // !GTEST_OS_WINDOWS && !GTEST_OS_FUCHSIA && !GTEST_OS_QNX
+}
+
 // Creates a concrete DeathTest-derived class that depends on the
 // --gtest_death_test_style flag, and sets the pointer pointed to
 // by the "test" argument to its address.  If the test should be
@@ -1433,6 +2014,7 @@ bool DefaultDeathTestFactory::Create(const char* statement,
 #ifdef GTEST_OS_WINDOWS
 
   if (GTEST_FLAG_GET(death_test_style) == "threadsafe" ||
+      GTEST_FLAG_GET(death_test_style) == "zygote" ||
       GTEST_FLAG_GET(death_test_style) == "fast") {
     *test = new WindowsDeathTest(statement, std::move(matcher), file, line);
   }
@@ -1440,6 +2022,7 @@ bool DefaultDeathTestFactory::Create(const char* statement,
 #elif defined(GTEST_OS_FUCHSIA)
 
   if (GTEST_FLAG_GET(death_test_style) == "threadsafe" ||
+      GTEST_FLAG_GET(death_test_style) == "zygote" ||
       GTEST_FLAG_GET(death_test_style) == "fast") {
     *test = new FuchsiaDeathTest(statement, std::move(matcher), file, line);
   }
@@ -1448,6 +2031,12 @@ bool DefaultDeathTestFactory::Create(const char* statement,
 
   if (GTEST_FLAG_GET(death_test_style) == "threadsafe") {
     *test = new ExecDeathTest(statement, std::move(matcher), file, line);
+  } else if (GTEST_FLAG_GET(death_test_style) == "zygote") {
+#ifdef GTEST_OS_QNX
+    *test = new ExecDeathTest(statement, std::move(matcher), file, line);
+#else
+    *test = new ZygoteDeathTest(statement, std::move(matcher), file, line);
+#endif  // GTEST_OS_QNX
   } else if (GTEST_FLAG_GET(death_test_style) == "fast") {
     *test = new NoExecDeathTest(statement, std::move(matcher));
   }
@@ -43,10 +43,13 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <deque>
+#include <initializer_list>
 #include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "gtest/internal/gtest-port.h"
@@ -56,6 +59,10 @@
 #include <netdb.h>      // NOLINT
 #endif
 
+#if GTEST_CAN_RUN_TEST_JOBS_
+#include <signal.h>  // NOLINT
+#endif
+
 #ifdef GTEST_OS_WINDOWS
 #include <windows.h>  // NOLINT
 #endif                // GTEST_OS_WINDOWS
@@ -90,6 +97,24 @@ GTEST_API_ extern bool g_help_flag;
 // Returns the current time in milliseconds.
 GTEST_API_ TimeInMillis GetTimeInMillis();
 
+// Measures the resources the process uses from the creation of the meter on,
+// if --gtest_print_resources is in effect and the platform allows it.  With
+// --gtest_parallel, only those of the creating thread are measured where the
+// platform allows it, and the meter must be used on that thread.
+class GTEST_API_ ResourceMeter {
+ public:
+  ResourceMeter();
+
+  // Stores the resources used since the meter was created in *usage and
+  // returns true, or returns false if they are not measured.
+  bool Measure(ResourceUsage* usage) const;
+
+ private:
+  bool this_thread_only_;
+  bool measuring_;
+  ResourceUsage start_;
+};
+
 // Returns true if and only if Google Test should use colors in the output.
 GTEST_API_ bool ShouldUseColor(bool stdout_is_tty);
 
@@ -97,12 +122,34 @@ GTEST_API_ bool ShouldUseColor(bool stdout_is_tty);
 // seconds, the output has a trailing decimal point (e.g., "N." instead of "N").
 GTEST_API_ std::string FormatTimeInMillisAsSeconds(TimeInMillis ms);
 
+// Formats the given time in nanoseconds as seconds, like
+// FormatTimeInMillisAsSeconds() but with up to 9 decimals.
+GTEST_API_ std::string FormatTimeInNanosAsSeconds(TimeInNanos ns);
+
 // Converts the given time in milliseconds to a date string in the ISO 8601
 // format, without the timezone information.  N.B.: due to the use the
 // non-reentrant localtime() function, this function is not thread safe.  Do
 // not use it in any code that can be called from multiple threads.
 GTEST_API_ std::string FormatEpochTimeInMillisAsIso8601(TimeInMillis ms);
 
+// Returns the first byte in [begin, end) that is a control character (below
+// 0x20) or one of the at most 8 characters in chars.  Returns end if there is
+// none.  The XML and JSON reports copy the bytes before it as they are and
+// escape it.
+GTEST_API_ const char* FindByteToEscape(const char* begin, const char* end,
+                                        const char* chars);
+
+// Returns a copy of str escaped for an XML attribute value if is_attribute is
+// true, for XML text otherwise.  Characters invalid in XML are dropped.
+GTEST_API_ std::string EscapeXml(const std::string& str, bool is_attribute);
+
+// Returns str with the characters invalid in XML removed.
+GTEST_API_ std::string RemoveInvalidXmlCharacters(const std::string& str);
+
+// Returns a copy of str escaped for a JSON string.  Bytes above 0x7f are not
+// escaped.
+GTEST_API_ std::string EscapeJson(const std::string& str);
+
 // Parses a string for an Int32 flag, in the form of "--flag=value".
 //
 // On success, stores the value of the flag in *value, and returns
@@ -143,77 +190,119 @@ class GTestFlagSaver {
   // The c'tor.
   GTestFlagSaver() {
     also_run_disabled_tests_ = GTEST_FLAG_GET(also_run_disabled_tests);
+    async_listeners_ = GTEST_FLAG_GET(async_listeners);
+    benchmark_time_ms_ = GTEST_FLAG_GET(benchmark_time_ms);
     break_on_failure_ = GTEST_FLAG_GET(break_on_failure);
+    cache_dir_ = GTEST_FLAG_GET(cache_dir);
     catch_exceptions_ = GTEST_FLAG_GET(catch_exceptions);
     color_ = GTEST_FLAG_GET(color);
+    death_test_output_limit_ = GTEST_FLAG_GET(death_test_output_limit);
     death_test_style_ = GTEST_FLAG_GET(death_test_style);
     death_test_use_fork_ = GTEST_FLAG_GET(death_test_use_fork);
     fail_fast_ = GTEST_FLAG_GET(fail_fast);
     filter_ = GTEST_FLAG_GET(filter);
     internal_run_death_test_ = GTEST_FLAG_GET(internal_run_death_test);
+    jobs_ = GTEST_FLAG_GET(jobs);
     list_tests_ = GTEST_FLAG_GET(list_tests);
     output_ = GTEST_FLAG_GET(output);
+    output_buffering_ = GTEST_FLAG_GET(output_buffering);
+    parallel_ = GTEST_FLAG_GET(parallel);
+    parallel_exclude_ = GTEST_FLAG_GET(parallel_exclude);
     brief_ = GTEST_FLAG_GET(brief);
     print_time_ = GTEST_FLAG_GET(print_time);
     print_utf8_ = GTEST_FLAG_GET(print_utf8);
+    print_resources_ = GTEST_FLAG_GET(print_resources);
+    print_phase_times_ = GTEST_FLAG_GET(print_phase_times);
     random_seed_ = GTEST_FLAG_GET(random_seed);
     repeat_ = GTEST_FLAG_GET(repeat);
+    serve_ = GTEST_FLAG_GET(serve);
+    shard_by_ = GTEST_FLAG_GET(shard_by);
+    shard_timing_ = GTEST_FLAG_GET(shard_timing);
     recreate_environments_when_repeating_ =
         GTEST_FLAG_GET(recreate_environments_when_repeating);
     shuffle_ = GTEST_FLAG_GET(shuffle);
     stack_trace_depth_ = GTEST_FLAG_GET(stack_trace_depth);
     stream_result_to_ = GTEST_FLAG_GET(stream_result_to);
+    test_timeout_ = GTEST_FLAG_GET(test_timeout);
     throw_on_failure_ = GTEST_FLAG_GET(throw_on_failure);
   }
 
   // The d'tor is not virtual.  DO NOT INHERIT FROM THIS CLASS.
   ~GTestFlagSaver() {
     GTEST_FLAG_SET(also_run_disabled_tests, also_run_disabled_tests_);
+    GTEST_FLAG_SET(async_listeners, async_listeners_);
+    GTEST_FLAG_SET(benchmark_time_ms, benchmark_time_ms_);
     GTEST_FLAG_SET(break_on_failure, break_on_failure_);
+    GTEST_FLAG_SET(cache_dir, cache_dir_);
     GTEST_FLAG_SET(catch_exceptions, catch_exceptions_);
     GTEST_FLAG_SET(color, color_);
+    GTEST_FLAG_SET(death_test_output_limit, death_test_output_limit_);
     GTEST_FLAG_SET(death_test_style, death_test_style_);
     GTEST_FLAG_SET(death_test_use_fork, death_test_use_fork_);
     GTEST_FLAG_SET(filter, filter_);
     GTEST_FLAG_SET(fail_fast, fail_fast_);
     GTEST_FLAG_SET(internal_run_death_test, internal_run_death_test_);
+    GTEST_FLAG_SET(jobs, jobs_);
     GTEST_FLAG_SET(list_tests, list_tests_);
     GTEST_FLAG_SET(output, output_);
+    GTEST_FLAG_SET(output_buffering, output_buffering_);
+    GTEST_FLAG_SET(parallel, parallel_);
+    GTEST_FLAG_SET(parallel_exclude, parallel_exclude_);
     GTEST_FLAG_SET(brief, brief_);
     GTEST_FLAG_SET(print_time, print_time_);
     GTEST_FLAG_SET(print_utf8, print_utf8_);
+    GTEST_FLAG_SET(print_resources, print_resources_);
+    GTEST_FLAG_SET(print_phase_times, print_phase_times_);
     GTEST_FLAG_SET(random_seed, random_seed_);
     GTEST_FLAG_SET(repeat, repeat_);
+    GTEST_FLAG_SET(serve, serve_);
+    GTEST_FLAG_SET(shard_by, shard_by_);
+    GTEST_FLAG_SET(shard_timing, shard_timing_);
     GTEST_FLAG_SET(recreate_environments_when_repeating,
                    recreate_environments_when_repeating_);
     GTEST_FLAG_SET(shuffle, shuffle_);
     GTEST_FLAG_SET(stack_trace_depth, stack_trace_depth_);
     GTEST_FLAG_SET(stream_result_to, stream_result_to_);
+    GTEST_FLAG_SET(test_timeout, test_timeout_);
     GTEST_FLAG_SET(throw_on_failure, throw_on_failure_);
   }
 
  private:
   // Fields for saving the original values of flags.
   bool also_run_disabled_tests_;
+  bool async_listeners_;
+  int32_t benchmark_time_ms_;
   bool break_on_failure_;
+  std::string cache_dir_;
   bool catch_exceptions_;
   std::string color_;
+  int32_t death_test_output_limit_;
   std::string death_test_style_;
   bool death_test_use_fork_;
   bool fail_fast_;
   std::string filter_;
   std::string internal_run_death_test_;
+  int32_t jobs_;
   bool list_tests_;
   std::string output_;
+  int32_t output_buffering_;
+  int32_t parallel_;
+  std::string parallel_exclude_;
   bool brief_;
   bool print_time_;
   bool print_utf8_;
+  bool print_resources_;
+  bool print_phase_times_;
   int32_t random_seed_;
   int32_t repeat_;
+  std::string serve_;
+  std::string shard_by_;
+  std::string shard_timing_;
   bool recreate_environments_when_repeating_;
   bool shuffle_;
   int32_t stack_trace_depth_;
   std::string stream_result_to_;
+  int32_t test_timeout_;
   bool throw_on_failure_;
 };
 
@@ -246,6 +335,11 @@ GTEST_API_ std::string WideStringToUtf8(const wchar_t* str, int num_chars);
 // be created, prints an error and exits.
 void WriteToShardStatusFileIfNeeded();
 
+// Waits until the events queued for the async-safe listeners have been
+// delivered, so that a process forked next does not inherit the delivering
+// thread in the middle of an event, holding locks no thread will release.
+void FlushAsyncTestEvents();
+
 // Checks whether sharding is enabled by examining the relevant flag values.
 // If the flags are set, but inconsistent (e.g., shard_index >= total_shards),
 // prints an error and exits. If in_subprocess_for_death_test, sharding is
@@ -265,6 +359,41 @@ GTEST_API_ int32_t Int32FromEnvOrDie(const char* env_var, int32_t default_val);
 GTEST_API_ bool ShouldRunTestOnShard(int total_shards, int shard_index,
                                      int test_id);
 
+// Returns a hash of the full name of a test ("TestSuite.Test") that does not
+// depend on the platform or on the other tests in the program.
+GTEST_API_ uint64_t HashTestName(const std::string& full_name);
+
+// Returns the shard of the test with the given full name when the tests are
+// sharded by hash (see --gtest_shard_by), given the weight of each shard.
+// The weights must be positive.
+GTEST_API_ int GetShardOfTestByHash(const std::string& full_name,
+                                    const std::vector<uint32_t>& shard_weights);
+
+// Reads the durations of the tests recorded in a report written by
+// --gtest_output=json into durations, keyed by the full name of each test
+// ("TestSuite.Test").  Only the tests whose result is "COMPLETED" are read.
+// Returns false if json is not such a report.
+GTEST_API_ bool ParseTestDurationsFromJsonReport(
+    const std::string& json,
+    std::unordered_map<std::string, TimeInNanos>* durations);
+
+#if GTEST_HAS_FILE_SYSTEM
+// Converts the given iteration (the last one if iteration is negative) of the
+// binary report (see --gtest_output=bin) in input_file to the XML or JSON
+// report described by output, "xml:PATH" or "json:PATH".  The tests of the
+// report are registered in the current process, which must have none of its
+// own.  Returns false and sets *error on failure.
+GTEST_API_ bool ConvertBinaryReport(const std::string& input_file,
+                                    const std::string& output, int iteration,
+                                    std::string* error);
+#endif  // GTEST_HAS_FILE_SYSTEM
+
+// Assigns tests with the given expected durations to total_shards shards so
+// that the shards take about as long, longest test first.  The assignment
+// only depends on the arguments.  Returns the shard of each test.
+GTEST_API_ std::vector<int> AssignTestsToShards(
+    const std::vector<TimeInNanos>& durations, int total_shards);
+
 // STL container utilities.
 
 // Returns the number of elements in the given container that satisfy
@@ -439,6 +568,15 @@ class OsStackTraceGetter : public OsStackTraceGetterInterface {
   std::string CurrentStackTrace(int max_depth, int skip_count) override;
   void UponLeavingGTest() override;
 
+  // Stores the addresses of at most max_depth frames of the current stack in
+  // frames, and returns their number, or 0 if stack traces are not supported.
+  // Once called outside of a signal handler, can be called from one.
+  static int CaptureRawStackTrace(void** frames, int max_depth);
+
+  // Formats the frames captured by CaptureRawStackTrace() like
+  // CurrentStackTrace() does.
+  static std::string FormatRawStackTrace(void* const* frames, int size);
+
  private:
 #ifdef GTEST_HAS_ABSL
   Mutex mutex_;  // Protects all internal state.
@@ -499,6 +637,125 @@ class DefaultPerThreadTestPartResultReporter
       const DefaultPerThreadTestPartResultReporter&) = delete;
 };
 
+// The state of a worker thread of the parallel test runner (see
+// --gtest_parallel).  While a worker runs a test suite, the test running on
+// that thread and the listener receiving its events are tracked here instead
+// of in the UnitTestImpl fields shared with the main thread.
+struct ParallelWorkerState {
+  TestSuite* current_test_suite = nullptr;
+  TestInfo* current_test_info = nullptr;
+  TestEventListener* repeater = nullptr;
+};
+
+#if GTEST_HAS_FILE_SYSTEM
+// The tests that passed in previous runs of a test program (see
+// --gtest_cache_dir).  A test is identified by a 64-bit key.  The keys are
+// kept sorted in a file of the cache directory whose name depends on the
+// program and on the flags that change how its tests run, so that a rebuilt
+// program or a different configuration starts with an empty cache.
+class GTEST_API_ TestResultCache {
+ public:
+  // Loads the cache of the program identified by program_id from the given
+  // directory.  A missing or malformed cache file is treated as empty.
+  TestResultCache(const FilePath& directory, const std::string& program_id);
+  ~TestResultCache();
+
+  // Returns the key of a test: a hash of its full name and of its type and
+  // value parameters.
+  static uint64_t KeyOf(const TestInfo& test_info);
+
+  // Returns true if and only if the test with the given key passed in a
+  // previous run.
+  bool Contains(uint64_t key) const;
+
+  // Records whether the test with the given key passed in this run.
+  void Record(uint64_t key, bool passed);
+
+  // Replaces the cache file with the tests that passed, merged with those
+  // recorded by other runs in the meantime.  Returns false on failure.
+  bool Save();
+
+  // Returns the path of the cache file.
+  const FilePath& path() const { return path_; }
+
+ private:
+  // Loads the keys stored in the cache file, if any.
+  void Load();
+
+  // Releases the keys loaded from the cache file.
+  void Unload();
+
+  FilePath path_;
+
+  // The sorted keys of the cache file.  They point either into a read-only
+  // mapping of the file, on Linux, or into key_storage_.
+  const uint64_t* keys_;
+  size_t key_count_;
+#ifdef GTEST_OS_LINUX
+  void* mapping_;
+  size_t mapping_size_;
+#endif  // GTEST_OS_LINUX
+  std::vector<uint64_t> key_storage_;
+
+  // The tests that passed and failed in this run.
+  std::set<uint64_t> passed_;
+  std::set<uint64_t> failed_;
+
+  TestResultCache(const TestResultCache&) = delete;
+  TestResultCache& operator=(const TestResultCache&) = delete;
+};
+#endif  // GTEST_HAS_FILE_SYSTEM
+
+#ifdef GTEST_IS_THREADSAFE
+// Reports the tests that run for longer than their timeout (see
+// --gtest_test_timeout).
+class TestWatchdog;
+#endif  // GTEST_IS_THREADSAFE
+
+// Leaves what Google Test allocates while it lives, such as the message of a
+// failure, out of the allocation counts of the current thread.
+class AllocationCountingPause {
+ public:
+  AllocationCountingPause()
+      : counters_(GetThreadAllocationCounters()), start_() {
+    if (counters_ != nullptr) start_ = *counters_;
+  }
+  ~AllocationCountingPause() {
+    if (counters_ != nullptr) *counters_ = start_;
+  }
+
+ private:
+  AllocationCounters* const counters_;
+  AllocationCounters start_;
+
+  AllocationCountingPause(const AllocationCountingPause&) = delete;
+  AllocationCountingPause& operator=(const AllocationCountingPause&) = delete;
+};
+
+// Records the test events of a test suite to replay them later.
+class TestEventRecorder;
+
+// Serializes the events sent to the listeners, and the changes to the results
+// of the running tests, with the report of a test that timed out, which the
+// watchdog thread makes while the test still runs.  A thread holding the lock
+// may take it again.
+class TestEventLock {
+ public:
+  TestEventLock();
+  ~TestEventLock();
+
+ private:
+  TestEventLock(const TestEventLock&) = delete;
+  TestEventLock& operator=(const TestEventLock&) = delete;
+};
+
+#if GTEST_CAN_RUN_TEST_JOBS_
+// Helpers of the fork-based test runner (see --gtest_jobs).
+class TestJobMessage;
+struct TestJobSuite;
+struct TestJobWorker;
+#endif  // GTEST_CAN_RUN_TEST_JOBS_
+
 // The private implementation of the UnitTest class.  We don't protect
 // the methods under a mutex, as this class is not accessible by a
 // user and the UnitTest class that delegates work to this class does
@@ -548,6 +805,9 @@ class GTEST_API_ UnitTestImpl {
   // Gets the number of skipped tests.
   int skipped_test_count() const;
 
+  // Gets the number of tests whose result was taken from the result cache.
+  int cached_test_count() const;
+
   // Gets the number of failed tests.
   int failed_test_count() const;
 
@@ -563,6 +823,10 @@ class GTEST_API_ UnitTestImpl {
   // Gets the number of all tests.
   int total_test_count() const;
 
+  // Gets the number of tests linked in, including the deferred tests whose
+  // TestInfo objects have not been created.
+  int linked_test_count() const;
+
   // Gets the number of tests that should run.
   int test_to_run_count() const;
 
@@ -571,7 +835,23 @@ class GTEST_API_ UnitTestImpl {
   TimeInMillis start_timestamp() const { return start_timestamp_; }
 
   // Gets the elapsed time, in milliseconds.
-  TimeInMillis elapsed_time() const { return elapsed_time_; }
+  TimeInMillis elapsed_time() const { return elapsed_time_nanos_ / 1000000; }
+
+  // Gets the elapsed time, in nanoseconds.
+  TimeInNanos elapsed_time_nanos() const { return elapsed_time_nanos_; }
+
+  // Returns true if and only if the time spent setting up and tearing down
+  // the environments was measured.
+  bool HasPhaseTimes() const { return has_phase_times_; }
+
+  // Gets the time spent setting up and tearing down the environments, in
+  // nanoseconds.
+  TimeInNanos environments_set_up_nanos() const {
+    return environments_set_up_nanos_;
+  }
+  TimeInNanos environments_tear_down_nanos() const {
+    return environments_tear_down_nanos_;
+  }
 
   // Returns true if and only if the unit test passed (i.e. all test suites
   // passed).
@@ -672,6 +952,32 @@ class GTEST_API_ UnitTestImpl {
   void AddTestInfo(internal::SetUpTestSuiteFunc set_up_tc,
                    internal::TearDownTestSuiteFunc tear_down_tc,
                    TestInfo* test_info) {
+    RecordOriginalWorkingDir();
+    GetTestSuite(test_info->test_suite_name_, test_info->type_param(),
+                 set_up_tc, tear_down_tc)
+        ->AddTestInfo(test_info);
+  }
+
+  // Adds a group of tests whose TestInfo objects are created on demand by
+  // FilterTests().
+  //
+  // Arguments:
+  //
+  //   test_suite_name: name of the test suite of the tests
+  //   set_up_tc:       pointer to the function that sets up the test suite
+  //   tear_down_tc:    pointer to the function that tears down the test suite
+  //   group:           the tests, which the test suite takes ownership of
+  void AddDeferredTests(const std::string& test_suite_name,
+                        internal::SetUpTestSuiteFunc set_up_tc,
+                        internal::TearDownTestSuiteFunc tear_down_tc,
+                        DeferredTestGroup* group) {
+    RecordOriginalWorkingDir();
+    GetTestSuite(test_suite_name, nullptr, set_up_tc, tear_down_tc)
+        ->AddDeferredTests(group);
+  }
+
+  // Remembers the working directory the first time a test is registered.
+  void RecordOriginalWorkingDir() {
 #if GTEST_HAS_FILE_SYSTEM
     // In order to support thread-safe death tests, we need to
     // remember the original working directory when the test program
@@ -686,10 +992,6 @@ class GTEST_API_ UnitTestImpl {
           << "Failed to get the current working directory.";
     }
 #endif  // GTEST_HAS_FILE_SYSTEM
-
-    GetTestSuite(test_info->test_suite_name_, test_info->type_param(),
-                 set_up_tc, tear_down_tc)
-        ->AddTestInfo(test_info);
   }
 
   // Returns ParameterizedTestSuiteRegistry object used to keep track of
@@ -723,6 +1025,33 @@ class GTEST_API_ UnitTestImpl {
   // the rest of the tests will still be run.
   bool RunAllTests();
 
+#if GTEST_CAN_STREAM_RESULTS_
+  // Runs the tests requested by the clients of --gtest_serve until the
+  // standard input ends or a client sends "quit".  Returns false if the
+  // requests cannot be served.
+  bool ServeTestRequests();
+#endif  // GTEST_CAN_STREAM_RESULTS_
+
+#ifdef GTEST_IS_THREADSAFE
+  // Runs the test suites of the current iteration on a pool of num_workers
+  // threads.  See --gtest_parallel.
+  void RunTestSuitesInParallel(int num_workers);
+#endif  // GTEST_IS_THREADSAFE
+
+#if GTEST_CAN_RUN_TEST_JOBS_
+  // Runs the test suites of the current iteration in a pool of num_jobs
+  // forked worker processes.  See --gtest_jobs.
+  void RunTestSuitesInJobs(int num_jobs);
+#endif  // GTEST_CAN_RUN_TEST_JOBS_
+
+  // Makes the given test, which runs on the current thread, time out
+  // timeout_in_seconds seconds from now, or never if timeout_in_seconds is
+  // 0.  See --gtest_test_timeout.
+  void SetTestTimeout(TestInfo* test_info, int timeout_in_seconds);
+
+  // Stops watching the given test for a timeout.
+  void ClearTestTimeout(TestInfo* test_info);
+
   // Clears the results of all tests, except the ad hoc tests.
   void ClearNonAdHocTestResult() {
     ForEach(test_suites_, TestSuite::ClearTestSuiteResult);
@@ -739,20 +1068,61 @@ class GTEST_API_ UnitTestImpl {
 
   enum ReactionToSharding { HONOR_SHARDING_PROTOCOL, IGNORE_SHARDING_PROTOCOL };
 
+  // Which TestInfo objects of the deferred tests FilterTests() creates.
+  enum ReactionToDeferredTests {
+    CREATE_REPORTABLE_TESTS,  // The tests that will be reported.
+    CREATE_ALL_TESTS,
+    CREATE_NO_TESTS
+  };
+
   // Matches the full name of each test against the user-specified
   // filter to decide whether the test should run, then records the
   // result in each TestSuite and TestInfo object.
   // If shard_tests == HONOR_SHARDING_PROTOCOL, further filters tests
   // based on sharding variables in the environment.
+  // The TestInfo objects of the deferred tests are created as specified by
+  // deferred_tests; the other deferred tests are only filtered by name.
   // Returns the number of tests that should run.
-  int FilterTests(ReactionToSharding shard_tests);
+  int FilterTests(ReactionToSharding shard_tests,
+                  ReactionToDeferredTests deferred_tests =
+                      CREATE_REPORTABLE_TESTS);
+
+  // Assigns the runnable tests to the shards by the durations recorded in the
+  // report named by --gtest_shard_timing, and leaves only those of this shard
+  // selected.  Returns the number of tests to run on this shard.
+  int BalanceShards(const std::vector<TestInfo*>& runnable_tests,
+                    int total_shards, int shard_index);
 
   // Prints the names of the tests matching the user-specified filter flag.
   void ListTestsMatchingFilter();
 
-  const TestSuite* current_test_suite() const { return current_test_suite_; }
-  TestInfo* current_test_info() { return current_test_info_; }
-  const TestInfo* current_test_info() const { return current_test_info_; }
+  // Returns the test suite or test running on the current thread.  Threads
+  // that are not parallel test workers see the main thread's values.
+  const TestSuite* current_test_suite() const {
+    const ParallelWorkerState* const state = parallel_worker_state_.get();
+    return state != nullptr ? state->current_test_suite : current_test_suite_;
+  }
+  TestInfo* current_test_info() {
+    const ParallelWorkerState* const state = parallel_worker_state_.get();
+    return state != nullptr ? state->current_test_info : current_test_info_;
+  }
+  const TestInfo* current_test_info() const {
+    const ParallelWorkerState* const state = parallel_worker_state_.get();
+    return state != nullptr ? state->current_test_info : current_test_info_;
+  }
+
+  // Returns the listener that receives the test events raised on the current
+  // thread: the event recorder of a parallel test worker, or the repeater.
+  TestEventListener* current_repeater() {
+    const ParallelWorkerState* const state = parallel_worker_state_.get();
+    return state != nullptr ? state->repeater : listeners_.repeater();
+  }
+
+  // Makes the current thread a parallel test worker using the given state,
+  // or turns it back into an ordinary thread if state is NULL.
+  void set_parallel_worker_state(ParallelWorkerState* state) {
+    parallel_worker_state_.set(state);
+  }
 
   // Returns the vector of environments that need to be set-up/torn-down
   // before/after the tests are run.
@@ -768,6 +1138,7 @@ class GTEST_API_ UnitTestImpl {
 
 #ifdef GTEST_HAS_DEATH_TEST
   void InitDeathTestSubprocessControlInfo() {
+    StartDeathTestZygoteIfRequested();
     internal_run_death_test_flag_.reset(ParseInternalRunDeathTestFlag());
   }
   // Returns a pointer to the parsed --gtest_internal_run_death_test
@@ -792,6 +1163,14 @@ class GTEST_API_ UnitTestImpl {
   // UnitTestOptions. Must not be called before InitGoogleTest.
   void ConfigureXmlOutput();
 
+#if GTEST_HAS_FILE_SYSTEM
+  // Registers the tests of the given iteration (the last one if iteration is
+  // negative) of a binary report (see --gtest_output=bin) read from file,
+  // along with their results.  Returns false and sets *error if file is not
+  // such a report.
+  bool LoadBinaryReport(FILE* file, int iteration, std::string* error);
+#endif  // GTEST_HAS_FILE_SYSTEM
+
 #if GTEST_CAN_STREAM_RESULTS_
   // Initializes the event listener for streaming test results to a socket.
   // Must not be called before InitGoogleTest.
@@ -834,21 +1213,74 @@ class GTEST_API_ UnitTestImpl {
   };
 
   friend class ::testing::UnitTest;
+  friend class TestEventRecorder;
+#ifdef GTEST_IS_THREADSAFE
+  friend class TestWatchdog;
+
+  // Reports that the given test, which was expected to finish within
+  // timeout_in_seconds seconds, timed out, and ends the test program, or the
+  // worker process running the test.  Called on the watchdog thread.
+  [[noreturn]] void ReportTestTimeout(TestInfo* test_info,
+                                      int timeout_in_seconds);
+#endif  // GTEST_IS_THREADSAFE
 
   // Used by UnitTest::Run() to capture the state of
   // GTEST_FLAG(catch_exceptions) at the moment it starts.
   void set_catch_exceptions(bool value) { catch_exceptions_ = value; }
 
+#if GTEST_CAN_RUN_TEST_JOBS_
+  // Helpers of RunTestSuitesInJobs().
+  void StartTestJobWorker(TestJobWorker* worker,
+                          const std::vector<TestJobWorker>& workers,
+                          const struct sigaction& child_sigpipe);
+  [[noreturn]] void RunTestJobWorker(int command_fd, int event_fd);
+  void HandleTestJobMessage(
+      TestJobWorker* worker, TestJobMessage* message,
+      const std::vector<std::unique_ptr<TestJobSuite>>& suites);
+  void HandleTestJobWorkerExit(
+      TestJobWorker* worker, std::deque<int>* pending,
+      const std::vector<std::unique_ptr<TestJobSuite>>& suites);
+  void FinishTestJobSuite(int i, TestJobSuite* suite);
+#endif  // GTEST_CAN_RUN_TEST_JOBS_
+
+#if GTEST_HAS_FILE_SYSTEM
+  // Loads the results of the previous runs from --gtest_cache_dir.
+  void LoadTestResultCache();
+
+  // Marks the tests that should run and passed in a previous run as cached.
+  // See --gtest_cache_dir.
+  void MarkCachedTests();
+
+  // Records the results of the tests that ran in the result cache.
+  void RecordTestResultsInCache();
+#endif  // GTEST_HAS_FILE_SYSTEM
+
+  // Returns the TestSuite object for the test running on the current thread.
+  TestSuite* mutable_current_test_suite() {
+    const ParallelWorkerState* const state = parallel_worker_state_.get();
+    return state != nullptr ? state->current_test_suite : current_test_suite_;
+  }
+
   // Sets the TestSuite object for the test that's currently running.
   void set_current_test_suite(TestSuite* a_current_test_suite) {
-    current_test_suite_ = a_current_test_suite;
+    ParallelWorkerState* const state = parallel_worker_state_.get();
+    if (state != nullptr) {
+      state->current_test_suite = a_current_test_suite;
+    } else {
+      current_test_suite_ = a_current_test_suite;
+    }
   }
 
   // Sets the TestInfo object for the test that's currently running.  If
   // current_test_info is NULL, the assertion results will be stored in
   // ad_hoc_test_result_.
   void set_current_test_info(TestInfo* a_current_test_info) {
-    current_test_info_ = a_current_test_info;
+    ParallelWorkerState* const state = parallel_worker_state_.get();
+    if (state != nullptr) {
+      state->current_test_info = a_current_test_info;
+    } else {
+      current_test_info_ = a_current_test_info;
+    }
   }
 
   // The UnitTest object that owns this implementation object.
@@ -858,6 +1290,9 @@ class GTEST_API_ UnitTestImpl {
   // The working directory when the first TEST() or TEST_F() was
   // executed.
   internal::FilePath original_working_dir_;
+
+  // The results of previous runs, if --gtest_cache_dir is specified.
+  std::unique_ptr<TestResultCache> test_result_cache_;
 #endif  // GTEST_HAS_FILE_SYSTEM
 
   // The default test part result reporters.
@@ -920,6 +1355,10 @@ class GTEST_API_ UnitTestImpl {
   // assertion results in ad_hoc_test_result_.  Initially NULL.
   TestInfo* current_test_info_;
 
+  // Points to (but doesn't own) the state of the parallel test worker
+  // running on the current thread, or NULL on any other thread.
+  internal::ThreadLocal<ParallelWorkerState*> parallel_worker_state_;
+
   // Normally, a user only writes assertions inside a TEST or TEST_F,
   // or inside a function called by a TEST or TEST_F.  Since Google
   // Test keeps track of which test is current running, it can
@@ -953,8 +1392,38 @@ class GTEST_API_ UnitTestImpl {
   // UNIX epoch.
   TimeInMillis start_timestamp_;
 
-  // How long the test took to run, in milliseconds.
-  TimeInMillis elapsed_time_;
+  // How long the test took to run, in nanoseconds.
+  TimeInNanos elapsed_time_nanos_;
+
+  // The time spent setting up and tearing down the environments, in
+  // nanoseconds, if has_phase_times_.
+  bool has_phase_times_;
+  TimeInNanos environments_set_up_nanos_;
+  TimeInNanos environments_tear_down_nanos_;
+
+  // The index of the current iteration of the tests (see --gtest_repeat).
+  int iteration_;
+
+  // True if and only if RunAllTests() is running the tests of a request
+  // received by ServeTestRequests().
+  bool serving_test_requests_;
+
+#ifdef GTEST_IS_THREADSAFE
+  // Watches the running tests for timeouts.  Created when the first timeout
+  // is set.
+  std::unique_ptr<TestWatchdog> test_watchdog_;
+
+  // The test suites run by the parallel test workers whose events have not
+  // been replayed yet, in order, with the recorders of their events.  Guarded
+  // by TestEventLock.
+  std::deque<std::pair<const TestSuite*, TestEventRecorder*>>
+      unreplayed_test_suites_;
+#endif  // GTEST_IS_THREADSAFE
+
+#if GTEST_CAN_RUN_TEST_JOBS_
+  // True if and only if this process is a worker of --gtest_jobs.
+  bool is_test_job_worker_;
+#endif  // GTEST_CAN_RUN_TEST_JOBS_
 
 #ifdef GTEST_HAS_DEATH_TEST
   // The decomposed components of the gtest_internal_run_death_test flag,
@@ -1071,9 +1540,31 @@ class TestResultAccessor {
 
 #if GTEST_CAN_STREAM_RESULTS_
 
-// Streams test results to the given port on the given host machine.
+// Streams test results to the given port on the given host machine, or to
+// the given Unix domain socket.
 class StreamingListener : public EmptyTestEventListener {
  public:
+  // How the events are framed and sent: the options that may follow the
+  // address in --gtest_stream_result_to.
+  struct Options {
+    // Frames each event as length-prefixed fields ("framing=compact")
+    // instead of a line of URL-encoded fields ("framing=text").
+    bool compact = false;
+    // The number of bytes of events collected before they are written out
+    // ("buffer=BYTES").  0 writes out each event at once.
+    size_t buffer_size = 0;
+    // Drops the events that do not fit into the buffer while the receiver
+    // falls behind ("overflow=drop") instead of waiting for it
+    // ("overflow=block").
+    bool drop_on_overflow = false;
+    // The number of bytes of records the ring buffer of a "shm:PATH" target
+    // holds ("size=BYTES").
+    size_t ring_size = 1 << 20;
+  };
+
+  // A field of an event: its name and its value.
+  using Field = std::pair<const char*, std::string>;
+
   // Abstract base class for writing strings to a socket.
   class AbstractSocketWriter {
    public:
@@ -1082,6 +1573,9 @@ class StreamingListener : public EmptyTestEventListener {
     // Sends a string to the socket.
     virtual void Send(const std::string& message) = 0;
 
+    // Writes out the strings sent so far, if they are buffered.
+    virtual void Flush() {}
+
     // Closes the socket.
     virtual void CloseConnection() {}
 
@@ -1093,68 +1587,140 @@ class StreamingListener : public EmptyTestEventListener {
   class SocketWriter : public AbstractSocketWriter {
    public:
     SocketWriter(const std::string& host, const std::string& port)
-        : sockfd_(-1), host_name_(host), port_num_(port) {
-      MakeConnection();
-    }
+        : SocketWriter(host + ":" + port, Options()) {}
+
+    // Connects to the given address, "HOST:PORT" or "unix:PATH".
+    SocketWriter(const std::string& address, const Options& options);
 
     ~SocketWriter() override {
       if (sockfd_ != -1) CloseConnection();
     }
 
-    // Sends a string to the socket.
-    void Send(const std::string& message) override {
-      GTEST_CHECK_(sockfd_ != -1)
-          << "Send() can be called only when there is a connection.";
-
-      const size_t len = message.length();
-      if (write(sockfd_, message.c_str(), len) != static_cast<ssize_t>(len)) {
-        GTEST_LOG_(WARNING) << "stream_result_to: failed to stream to "
-                            << host_name_ << ":" << port_num_;
-      }
-    }
+    // Sends a string to the socket, or buffers it, as the options say.
+    void Send(const std::string& message) override;
+
+    // Writes out the buffered strings, without waiting for the receiver if
+    // the options say to drop events.
+    void Flush() override;
 
    private:
     // Creates a client socket and connects to the server.
     void MakeConnection();
 
-    // Closes the socket.
-    void CloseConnection() override {
-      GTEST_CHECK_(sockfd_ != -1)
-          << "CloseConnection() can be called only when there is a connection.";
+    // Closes the socket, after writing out the buffered strings.
+    void CloseConnection() override;
 
-      close(sockfd_);
-      sockfd_ = -1;
-    }
+    // Writes out the buffered strings, waiting for the receiver to accept
+    // them for up to timeout_in_millis milliseconds, or for as long as it
+    // takes if timeout_in_millis is negative.
+    void Write(int timeout_in_millis);
 
     int sockfd_;  // socket file descriptor
-    const std::string host_name_;
-    const std::string port_num_;
+    const std::string address_;
+    const Options options_;
+    // The strings sent but not written out yet.
+    std::string pending_;
+    // The number of strings dropped since the last one buffered.
+    int64_t dropped_count_;
+    // When the buffered strings were last written out.
+    TimeInMillis last_write_time_;
+    // The process that made the connection.  The children forked from it,
+    // such as death tests, share the socket but leave writing to it.
+    const pid_t owner_pid_;
 
     SocketWriter(const SocketWriter&) = delete;
     SocketWriter& operator=(const SocketWriter&) = delete;
   };  // class SocketWriter
 
+  // Publishes the strings to a ring buffer in a memory-mapped file, such as
+  // one under /dev/shm, that other processes can follow as it fills.  Each
+  // string is a record; when the ring is full, the oldest records are
+  // overwritten.  The format is described in docs/advanced.md.
+  class RingBufferWriter : public AbstractSocketWriter {
+   public:
+    // Creates the file at path, with room for capacity bytes of records.
+    RingBufferWriter(const std::string& path, size_t capacity);
+
+    ~RingBufferWriter() override;
+
+    // Appends a record holding the string to the ring.
+    void Send(const std::string& message) override;
+
+    // Marks the ring as finished.
+    void CloseConnection() override;
+
+   private:
+    // The start of the file.
+    struct Header;
+
+    // Returns the number of bytes the record at position takes up.
+    uint64_t RecordSpan(uint64_t position) const;
+
+    Header* header_;  // nullptr if the file could not be mapped
+    char* data_;      // the records
+    const uint64_t capacity_;
+    // The positions, counted in bytes since the start of the stream, of the
+    // oldest record not overwritten yet and of the end of the last record.
+    uint64_t oldest_position_;
+    uint64_t write_position_;
+    // The sequence number of the next record.
+    uint32_t sequence_;
+    // The process that created the ring.  The children forked from it,
+    // such as death tests, share the mapping but leave writing to it.
+    const pid_t owner_pid_;
+
+    RingBufferWriter(const RingBufferWriter&) = delete;
+    RingBufferWriter& operator=(const RingBufferWriter&) = delete;
+  };  // class RingBufferWriter
+
   // Escapes '=', '&', '%', and '\n' characters in str as "%xx".
   static std::string UrlEncode(const char* str);
 
+  // Appends an event with the given name and fields to *out, as a line of
+  // URL-encoded fields, or as length-prefixed fields if compact is true.
+  static void AppendEvent(bool compact, const char* name,
+                          std::initializer_list<Field> fields,
+                          std::string* out);
+
+  // Parses the value of --gtest_stream_result_to: an address, "HOST:PORT",
+  // "unix:PATH" or "shm:PATH", optionally followed by '?' and options
+  // separated by '&', e.g.
+  // "unix:/tmp/results?framing=compact&buffer=65536&overflow=drop".
+  // The PATH of a Unix domain socket starts with '/', or with '@' for the
+  // abstract namespace; "unix:" followed by anything else is the HOST:PORT of
+  // a host named "unix".  Returns false and sets *error if the value is invalid.
+  static bool ParseTarget(const std::string& target, std::string* address,
+                          Options* options, std::string* error);
+
   StreamingListener(const std::string& host, const std::string& port)
-      : socket_writer_(new SocketWriter(host, port)) {
+      : socket_writer_(new SocketWriter(host, port)), compact_(false) {
     Start();
   }
 
-  explicit StreamingListener(AbstractSocketWriter* socket_writer)
-      : socket_writer_(socket_writer) {
+  StreamingListener(const std::string& address, const Options& options)
+      : socket_writer_(MakeWriter(address, options)),
+        compact_(options.compact) {
     Start();
   }
 
+  explicit StreamingListener(AbstractSocketWriter* socket_writer,
+                             bool compact = false)
+      : socket_writer_(socket_writer), compact_(compact) {
+    Start();
+  }
+
+  // The results are only read in the events after which they no longer
+  // change, so sending to the socket can wait for --gtest_async_listeners.
+  bool IsAsyncSafe() const override { return true; }
+
   void OnTestProgramStart(const UnitTest& /* unit_test */) override {
-    SendLn("event=TestProgramStart");
+    SendEvent("TestProgramStart", {});
   }
 
   void OnTestProgramEnd(const UnitTest& unit_test) override {
     // Note that Google Test current only report elapsed time for each
     // test iteration, not for the entire test program.
-    SendLn("event=TestProgramEnd&passed=" + FormatBool(unit_test.Passed()));
+    SendEvent("TestProgramEnd", {{"passed", FormatBool(unit_test.Passed())}});
 
     // Notify the streaming server to stop.
     socket_writer_->CloseConnection();
@@ -1162,65 +1728,137 @@ class StreamingListener : public EmptyTestEventListener {
 
   void OnTestIterationStart(const UnitTest& /* unit_test */,
                             int iteration) override {
-    SendLn("event=TestIterationStart&iteration=" +
-           StreamableToString(iteration));
+    SendEvent("TestIterationStart",
+              {{"iteration", StreamableToString(iteration)}});
   }
 
   void OnTestIterationEnd(const UnitTest& unit_test,
                           int /* iteration */) override {
-    SendLn("event=TestIterationEnd&passed=" + FormatBool(unit_test.Passed()) +
-           "&elapsed_time=" + StreamableToString(unit_test.elapsed_time()) +
-           "ms");
+    SendEvent("TestIterationEnd",
+              {{"passed", FormatBool(unit_test.Passed())},
+               {"elapsed_time",
+                StreamableToString(unit_test.elapsed_time()) + "ms"}});
+    socket_writer_->Flush();
   }
 
   // Note that "event=TestCaseStart" is a wire format and has to remain
   // "case" for compatibility
   void OnTestSuiteStart(const TestSuite& test_suite) override {
-    SendLn(std::string("event=TestCaseStart&name=") + test_suite.name());
+    SendEvent("TestCaseStart", {{"name", test_suite.name()}});
   }
 
   // Note that "event=TestCaseEnd" is a wire format and has to remain
   // "case" for compatibility
   void OnTestSuiteEnd(const TestSuite& test_suite) override {
-    SendLn("event=TestCaseEnd&passed=" + FormatBool(test_suite.Passed()) +
-           "&elapsed_time=" + StreamableToString(test_suite.elapsed_time()) +
-           "ms");
+    SendEvent("TestCaseEnd",
+              {{"passed", FormatBool(test_suite.Passed())},
+               {"elapsed_time",
+                StreamableToString(test_suite.elapsed_time()) + "ms"}});
   }
 
   void OnTestStart(const TestInfo& test_info) override {
-    SendLn(std::string("event=TestStart&name=") + test_info.name());
+    SendEvent("TestStart", {{"name", test_info.name()}});
   }
 
   void OnTestEnd(const TestInfo& test_info) override {
-    SendLn("event=TestEnd&passed=" +
-           FormatBool((test_info.result())->Passed()) + "&elapsed_time=" +
-           StreamableToString((test_info.result())->elapsed_time()) + "ms");
+    SendEvent("TestEnd",
+              {{"passed", FormatBool((test_info.result())->Passed())},
+               {"elapsed_time",
+                StreamableToString((test_info.result())->elapsed_time()) +
+                    "ms"}});
   }
 
   void OnTestPartResult(const TestPartResult& test_part_result) override {
     const char* file_name = test_part_result.file_name();
     if (file_name == nullptr) file_name = "";
-    SendLn("event=TestPartResult&file=" + UrlEncode(file_name) +
-           "&line=" + StreamableToString(test_part_result.line_number()) +
-           "&message=" + UrlEncode(test_part_result.message()));
+    SendEvent("TestPartResult",
+              {{"file", file_name},
+               {"line", StreamableToString(test_part_result.line_number())},
+               {"message", test_part_result.message()}});
   }
 
  private:
-  // Sends the given message and a newline to the socket.
-  void SendLn(const std::string& message) { socket_writer_->SendLn(message); }
+  // Sends the given event to the socket.
+  void SendEvent(const char* name, std::initializer_list<Field> fields) {
+    std::string event;
+    AppendEvent(compact_, name, fields, &event);
+    socket_writer_->Send(event);
+  }
+
+  // Returns a writer to the given address.
+  static AbstractSocketWriter* MakeWriter(const std::string& address,
+                                          const Options& options);
 
   // Called at the start of streaming to notify the receiver what
   // protocol we are using.
-  void Start() { SendLn("gtest_streaming_protocol_version=1.0"); }
+  void Start() {
+    socket_writer_->SendLn(compact_ ? "gtest_streaming_protocol_version=1.0"
+                                      "&framing=compact"
+                                    : "gtest_streaming_protocol_version=1.0");
+  }
 
   std::string FormatBool(bool value) { return value ? "1" : "0"; }
 
   const std::unique_ptr<AbstractSocketWriter> socket_writer_;
+  const bool compact_;
 
   StreamingListener(const StreamingListener&) = delete;
   StreamingListener& operator=(const StreamingListener&) = delete;
 };  // class StreamingListener
 
+// A request to run tests, as received by a test program started with
+// --gtest_serve.
+struct TestRunRequest {
+  std::string filter = "*";
+  int32_t repeat = 1;
+  std::string output = "stream";  // "stream", "xml" or "json"
+};
+
+// Receives requests to run tests on the standard input or on a Unix domain
+// socket, one line per request, and sends the responses back.  A request is
+// made of URL-encoded fields separated by '&', all of them optional:
+//
+//   filter=FooTest.*&repeat=2&output=json
+class GTEST_API_ TestRequestServer {
+ public:
+  // Parses a request line.  Returns false and sets *error if the request is
+  // malformed.
+  static bool ParseRequest(const std::string& line, TestRunRequest* request,
+                           std::string* error);
+
+  // The address is either "stdin" or "unix:" followed by the path of the
+  // socket.
+  explicit TestRequestServer(const std::string& address);
+  ~TestRequestServer();
+
+  // Starts listening to the address.  Returns false and sets *error if it
+  // cannot.  When serving the standard input, the standard output becomes
+  // the response stream and whatever the tests print goes to the standard
+  // error instead.
+  bool Start(std::string* error);
+
+  // Waits for the next request line, accepting a new connection when the
+  // previous client went away.  Returns false when the standard input ends.
+  bool NextRequest(std::string* line);
+
+  // Sends a string to the client of the current request.  A client that
+  // went away is ignored.
+  void Send(const std::string& message);
+
+ private:
+  // Closes the connection to the current client.
+  void CloseConnection();
+
+  const std::string address_;
+  int listen_fd_;  // The Unix domain socket, or -1 when serving stdin.
+  int input_fd_;   // -1 when there is no client.
+  int output_fd_;
+  std::string buffer_;  // The data received after the last request.
+
+  TestRequestServer(const TestRequestServer&) = delete;
+  TestRequestServer& operator=(const TestRequestServer&) = delete;
+};  // class TestRequestServer
+
 #endif  // GTEST_CAN_STREAM_RESULTS_
 
 }  // namespace internal
@@ -34,8 +34,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <fstream>
+#include <limits>
 #include <memory>
 #include <ostream>
 #include <string>
@@ -71,6 +73,11 @@
 #endif
 #endif
 
+#ifdef GTEST_OS_LINUX
+#include <fcntl.h>
+#include <sys/syscall.h>
+#endif  // GTEST_OS_LINUX
+
 #ifdef GTEST_OS_QNX
 #include <devctl.h>
 #include <fcntl.h>
@@ -1065,6 +1072,29 @@ GTestLog::~GTestLog() {
   }
 }
 
+// Reads at most max_size bytes from the beginning of a file as a string.
+static std::string ReadFileHead(FILE* file, size_t max_size) {
+  std::string content(std::min(GetFileSize(file), max_size), '\0');
+
+  size_t bytes_last_read = 0;  // # of bytes read in the last fread()
+  size_t bytes_read = 0;       // # of bytes read so far
+
+  fseek(file, 0, SEEK_SET);
+
+  // Keeps reading the file until we cannot read further or the
+  // pre-determined size is reached.  The data is read into the string
+  // directly, so that large files are not buffered twice.
+  while (bytes_read < content.size()) {
+    bytes_last_read =
+        fread(&content[bytes_read], 1, content.size() - bytes_read, file);
+    if (bytes_last_read == 0) break;
+    bytes_read += bytes_last_read;
+  }
+
+  content.resize(bytes_read);
+  return content;
+}
+
 #if GTEST_HAS_STREAM_REDIRECTION
 
 // Disable Microsoft deprecation warnings for POSIX functions called from
@@ -1079,13 +1109,63 @@ bool EndsWithPathSeparator(const std::string& path) {
 }
 #endif
 
+#ifdef GTEST_OS_LINUX
+// Creates an anonymous in-memory file for capturing a stream, which saves
+// the round trips to the file system a temporary file would take.  Returns
+// -1 if that is not supported, e.g. by kernels older than 3.17.
+//
+// Unless max_size is unlimited, the file is sized to max_size rounded up to
+// a whole page and sealed against growing, so that the kernel rejects the
+// writes past it instead of holding all of the output in memory.  Rounding
+// to a page keeps a write that straddles the end from losing the part of it
+// that fits, as the kernel checks the seal a page at a time.
+int CreateCaptureMemoryFile(size_t max_size) {
+#ifdef SYS_memfd_create
+  const unsigned int kMemfdCloexec = 1;        // MFD_CLOEXEC
+  const unsigned int kMemfdAllowSealing = 2;  // MFD_ALLOW_SEALING
+  const bool bounded = max_size != (std::numeric_limits<size_t>::max)();
+  const int fd = static_cast<int>(
+      syscall(SYS_memfd_create, "gtest_captured_stream",
+              kMemfdCloexec | (bounded ? kMemfdAllowSealing : 0u)));
+#ifdef F_ADD_SEALS
+  const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  if (fd != -1 && bounded && page_size > 0 &&
+      max_size <= static_cast<size_t>((std::numeric_limits<off_t>::max)()) -
+                      page_size) {
+    const size_t size = (max_size + page_size - 1) / page_size * page_size;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+      fcntl(fd, F_ADD_SEALS, F_SEAL_GROW | F_SEAL_SHRINK);
+    }
+  }
+#endif  // F_ADD_SEALS
+  return fd;
+#else
+  static_cast<void>(max_size);
+  return -1;
+#endif  // SYS_memfd_create
+}
+#endif  // GTEST_OS_LINUX
+
 }  // namespace
 
 // Object that captures an output stream (stdout/stderr).
 class CapturedStream {
  public:
-  // The ctor redirects the stream to a temporary file.
-  explicit CapturedStream(int fd) : fd_(fd), uncaptured_fd_(dup(fd)) {
+  // The ctor redirects the stream to an in-memory file on Linux, and to a
+  // temporary file elsewhere or if that fails.  At most max_size bytes of
+  // the output are returned.  The in-memory file also drops the output past
+  // them as it is written, so it takes at most max_size bytes (rounded up to
+  // a page) of memory; the temporary file holds all of the output.
+  CapturedStream(int fd, size_t max_size)
+      : fd_(fd), uncaptured_fd_(dup(fd)), memory_fd_(-1), max_size_(max_size) {
+#ifdef GTEST_OS_LINUX
+    memory_fd_ = CreateCaptureMemoryFile(max_size);
+    if (memory_fd_ != -1) {
+      fflush(nullptr);
+      dup2(memory_fd_, fd_);
+      return;
+    }
+#endif  // GTEST_OS_LINUX
 #ifdef GTEST_OS_WINDOWS
     char temp_dir_path[MAX_PATH + 1] = {'\0'};   // NOLINT
     char temp_file_path[MAX_PATH + 1] = {'\0'};  // NOLINT
@@ -1171,7 +1251,13 @@ class CapturedStream {
     close(captured_fd);
   }
 
-  ~CapturedStream() { remove(filename_.c_str()); }
+  ~CapturedStream() {
+    if (memory_fd_ != -1) {
+      close(memory_fd_);
+    } else {
+      remove(filename_.c_str());
+    }
+  }
 
   std::string GetCapturedString() {
     if (uncaptured_fd_ != -1) {
@@ -1182,12 +1268,33 @@ class CapturedStream {
       uncaptured_fd_ = -1;
     }
 
-    FILE* const file = posix::FOpen(filename_.c_str(), "r");
+    FILE* file = nullptr;
+    size_t max_size = max_size_;
+#ifdef GTEST_OS_LINUX
+    if (memory_fd_ != -1) {
+      // The in-memory file may be larger than the output written to it, which
+      // ends at the offset the stream shared with it.
+      const off_t written = lseek(memory_fd_, 0, SEEK_CUR);
+      if (written >= 0) {
+        max_size = (std::min)(max_size, static_cast<size_t>(written));
+      }
+      // The writes rejected past max_size leave the error flag of the stream
+      // set.
+      if (fd_ == fileno(stdout)) clearerr(stdout);
+      if (fd_ == fileno(stderr)) clearerr(stderr);
+      file = posix::FDOpen(dup(memory_fd_), "r");
+      GTEST_CHECK_(file != nullptr)
+          << "Failed to open in-memory file for capturing stream.";
+    }
+#endif  // GTEST_OS_LINUX
     if (file == nullptr) {
-      GTEST_LOG_(FATAL) << "Failed to open tmp file " << filename_
-                        << " for capturing stream.";
+      file = posix::FOpen(filename_.c_str(), "r");
+      if (file == nullptr) {
+        GTEST_LOG_(FATAL) << "Failed to open tmp file " << filename_
+                          << " for capturing stream.";
+      }
     }
-    const std::string content = ReadEntireFile(file);
+    const std::string content = ReadFileHead(file, max_size);
     posix::FClose(file);
     return content;
   }
@@ -1195,6 +1302,11 @@ class CapturedStream {
  private:
   const int fd_;  // A stream to capture.
   int uncaptured_fd_;
+  // The in-memory file holding the output, or -1 if it is held by the
+  // temporary file.
+  int memory_fd_;
+  // The maximum number of bytes of the output to return.
+  const size_t max_size_;
   // Name of the temporary file holding the stderr output.
   ::std::string filename_;
 
@@ -1208,13 +1320,13 @@ static CapturedStream* g_captured_stderr = nullptr;
 static CapturedStream* g_captured_stdout = nullptr;
 
 // Starts capturing an output stream (stdout/stderr).
-static void CaptureStream(int fd, const char* stream_name,
+static void CaptureStream(int fd, const char* stream_name, size_t max_size,
                           CapturedStream** stream) {
   if (*stream != nullptr) {
     GTEST_LOG_(FATAL) << "Only one " << stream_name
                       << " capturer can exist at a time.";
   }
-  *stream = new CapturedStream(fd);
+  *stream = new CapturedStream(fd, max_size);
 }
 
 // Stops capturing the output stream and returns the captured string.
@@ -1237,13 +1349,19 @@ const int kStdErrFileno = STDERR_FILENO;
 #endif  // defined(_MSC_VER) || defined(__BORLANDC__)
 
 // Starts capturing stdout.
-void CaptureStdout() {
-  CaptureStream(kStdOutFileno, "stdout", &g_captured_stdout);
+void CaptureStdout() { CaptureStdout((std::numeric_limits<size_t>::max)()); }
+
+// Starts capturing stdout, keeping at most max_size bytes of it.
+void CaptureStdout(size_t max_size) {
+  CaptureStream(kStdOutFileno, "stdout", max_size, &g_captured_stdout);
 }
 
 // Starts capturing stderr.
-void CaptureStderr() {
-  CaptureStream(kStdErrFileno, "stderr", &g_captured_stderr);
+void CaptureStderr() { CaptureStderr((std::numeric_limits<size_t>::max)()); }
+
+// Starts capturing stderr, keeping at most max_size bytes of it.
+void CaptureStderr(size_t max_size) {
+  CaptureStream(kStdErrFileno, "stderr", max_size, &g_captured_stderr);
 }
 
 // Stops capturing stdout and returns the captured string.
@@ -1264,26 +1382,7 @@ size_t GetFileSize(FILE* file) {
 }
 
 std::string ReadEntireFile(FILE* file) {
-  const size_t file_size = GetFileSize(file);
-  char* const buffer = new char[file_size];
-
-  size_t bytes_last_read = 0;  // # of bytes read in the last fread()
-  size_t bytes_read = 0;       // # of bytes read so far
-
-  fseek(file, 0, SEEK_SET);
-
-  // Keeps reading the file until we cannot read further or the
-  // pre-determined file size is reached.
-  do {
-    bytes_last_read =
-        fread(buffer + bytes_read, 1, file_size - bytes_read, file);
-    bytes_read += bytes_last_read;
-  } while (bytes_last_read > 0 && bytes_read < file_size);
-
-  const std::string content(buffer, bytes_read);
-  delete[] buffer;
-
-  return content;
+  return ReadFileHead(file, std::numeric_limits<size_t>::max());
 }
 
 #ifdef GTEST_HAS_DEATH_TEST
@@ -41,12 +41,16 @@
 #include <wctype.h>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>  // NOLINT
 #include <cmath>
 #include <csignal>  // NOLINT: raise(3) is used on some platforms
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <functional>
 #include <initializer_list>
 #include <iomanip>
 #include <ios>
@@ -58,7 +62,9 @@
 #include <ostream>  // NOLINT
 #include <set>
 #include <sstream>
+#include <streambuf>
 #include <string_view>
+#include <type_traits>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -68,16 +74,29 @@
 #include "gtest/internal/custom/gtest.h"
 #include "gtest/internal/gtest-port.h"
 
+#ifdef GTEST_IS_THREADSAFE
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <thread>              // NOLINT
+#endif  // GTEST_IS_THREADSAFE
+
 #ifdef GTEST_OS_LINUX
 
+#include <dirent.h>  // NOLINT
 #include <fcntl.h>   // NOLINT
 #include <limits.h>  // NOLINT
+#include <link.h>    // NOLINT
 #include <sched.h>   // NOLINT
 // Declares vsnprintf().  This header is not available on Windows.
-#include <strings.h>   // NOLINT
-#include <sys/mman.h>  // NOLINT
-#include <sys/time.h>  // NOLINT
-#include <unistd.h>    // NOLINT
+#include <strings.h>      // NOLINT
+#include <sys/mman.h>     // NOLINT
+#include <sys/syscall.h>  // NOLINT
+#include <sys/time.h>     // NOLINT
+#include <unistd.h>       // NOLINT
+
+#ifdef __GLIBC__
+#include <execinfo.h>  // NOLINT
+#endif  // __GLIBC__
 
 #include <string>
 
@@ -125,9 +144,37 @@
 
 #if GTEST_CAN_STREAM_RESULTS_
 #include <arpa/inet.h>   // NOLINT
+#include <fcntl.h>       // NOLINT
 #include <netdb.h>       // NOLINT
+#include <poll.h>        // NOLINT
+#include <sys/mman.h>    // NOLINT
 #include <sys/socket.h>  // NOLINT
 #include <sys/types.h>   // NOLINT
+#include <sys/un.h>      // NOLINT
+#include <unistd.h>      // NOLINT
+#endif
+
+#if GTEST_CAN_MEASURE_RESOURCES_
+#include <sys/resource.h>  // NOLINT
+#include <sys/time.h>      // NOLINT
+#endif
+
+#if GTEST_CAN_RUN_TEST_JOBS_
+#include <fcntl.h>     // NOLINT
+#include <poll.h>      // NOLINT
+#include <signal.h>    // NOLINT
+#include <sys/wait.h>  // NOLINT
+#include <unistd.h>    // NOLINT
+#endif
+
+// The strings written to reports are scanned 16 bytes at a time for
+// characters to escape where SSE2 is available.
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GTEST_CAN_SCAN_WITH_SSE2_ 1
+#include <emmintrin.h>  // NOLINT
+#else
+#define GTEST_CAN_SCAN_WITH_SSE2_ 0
 #endif
 
 #include "src/gtest-internal-inl.h"
@@ -216,20 +263,168 @@ const char kStackTraceMarker[] = "\nStack trace:\n";
 bool g_help_flag = false;
 
 #if GTEST_HAS_FILE_SYSTEM
-// Utility function to Open File for Writing
-static FILE* OpenFileForWriting(const std::string& output_file) {
+// Utility function to Open File for Writing, in binary mode if binary is
+// true, so that no byte is translated on Windows.
+static FILE* OpenFileForWriting(const std::string& output_file,
+                                bool binary = false) {
   FILE* fileout = nullptr;
   FilePath output_file_path(output_file);
   FilePath output_dir(output_file_path.RemoveFileName());
 
   if (output_dir.CreateDirectoriesRecursively()) {
-    fileout = posix::FOpen(output_file.c_str(), "w");
+    fileout = posix::FOpen(output_file.c_str(), binary ? "wb" : "w");
   }
   if (fileout == nullptr) {
     GTEST_LOG_(FATAL) << "Unable to open file \"" << output_file << "\"";
   }
   return fileout;
 }
+
+// A stream buffer writing straight into a FILE, so that a report can be
+// written without first building it in memory.
+class FileStreamBuf : public std::streambuf {
+ public:
+  explicit FileStreamBuf(FILE* file) : file_(file) {}
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::not_eof(c);
+    }
+    return fputc(c, file_) == EOF ? traits_type::eof() : c;
+  }
+
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    return static_cast<std::streamsize>(
+        fwrite(s, 1, static_cast<size_t>(n), file_));
+  }
+
+ private:
+  FILE* const file_;
+};
+
+// Returns true if path names a regular file, or nothing yet, in which case
+// the report creates a regular file there.  Other files, such as pipes and
+// devices like /dev/stdout, can only be written once, from start to end.
+static bool IsRegularFileOrMissing(const std::string& path) {
+#ifdef GTEST_OS_WINDOWS_MOBILE
+  static_cast<void>(path);
+  return true;
+#else
+  posix::StatStruct file_stat{};
+  if (posix::Stat(path.c_str(), &file_stat) != 0) return errno == ENOENT;
+#ifdef GTEST_OS_WINDOWS
+  return (file_stat.st_mode & _S_IFMT) == _S_IFREG;
+#else
+  return S_ISREG(file_stat.st_mode);
+#endif  // GTEST_OS_WINDOWS
+#endif  // GTEST_OS_WINDOWS_MOBILE
+}
+
+// Returns true if path names a symbolic link, which replacing the file would
+// turn into a regular file.
+static bool IsSymbolicLink(const std::string& path) {
+#if defined(GTEST_OS_WINDOWS) || defined(GTEST_OS_ESP8266) || \
+    defined(GTEST_OS_ESP32) || defined(GTEST_OS_QURT)
+  static_cast<void>(path);
+  return false;
+#else
+  struct stat link_stat;
+  return lstat(path.c_str(), &link_stat) == 0 && S_ISLNK(link_stat.st_mode);
+#endif
+}
+
+// Writes a report to output_file with print, by way of a temporary file in
+// the same directory that then replaces output_file in one step.  A test
+// program killed while the report is written thus leaves the previous
+// contents of output_file, such as a partial report, in place.  A file that
+// cannot be replaced, such as a pipe, a symbolic link or a file in a
+// directory where the temporary file cannot be created, is written directly.
+template <typename Print>
+static void WriteReportFile(const std::string& output_file, Print print) {
+  const auto write = [&print](FILE* fileout) {
+    {
+      FileStreamBuf buffer(fileout);
+      std::ostream stream(&buffer);
+      print(&stream);
+    }
+    fclose(fileout);
+  };
+  const std::string temp_file = output_file + ".tmp";
+  FILE* fileout = nullptr;
+  if (IsRegularFileOrMissing(output_file) && !IsSymbolicLink(output_file)) {
+    fileout = posix::FOpen(temp_file.c_str(), "w");
+  }
+  if (fileout == nullptr) {
+    write(OpenFileForWriting(output_file));
+    return;
+  }
+  write(fileout);
+#ifdef GTEST_OS_WINDOWS
+  const bool replaced =
+      ::MoveFileExA(temp_file.c_str(), output_file.c_str(),
+                    MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  const bool replaced = rename(temp_file.c_str(), output_file.c_str()) == 0;
+#endif  // GTEST_OS_WINDOWS
+  if (!replaced) {
+    remove(temp_file.c_str());
+    GTEST_LOG_(FATAL) << "Unable to replace file \"" << output_file << "\"";
+  }
+}
+
+// Keeps the report file of a running test program well-formed while the
+// tests run.  The report of each test is appended to the file as soon as the
+// test finishes, followed by a trailer closing the elements still open, which
+// the next append overwrites.  A test program killed in the middle of a run
+// thus leaves a valid report of the tests that finished.  Only a regular file
+// can be rewritten this way; the report is not written to other files until
+// it is complete.
+class PartialReportFile {
+ public:
+  PartialReportFile() = default;
+  ~PartialReportFile() { Close(); }
+
+  // Starts a new report in output_file.
+  void Open(const std::string& output_file, const std::string& header,
+            const std::string& trailer) {
+    Close();
+    if (!IsRegularFileOrMissing(output_file)) return;
+    file_ = OpenFileForWriting(output_file);
+    trailer_offset_ = 0;
+    Append(header, trailer);
+  }
+
+  // Replaces the current trailer with text followed by trailer.  The file is
+  // cut after the new trailer, in case it ends before the old one did.
+  void Append(const std::string& text, const std::string& trailer) {
+    if (file_ == nullptr) return;
+    fseek(file_, trailer_offset_, SEEK_SET);
+    fwrite(text.data(), 1, text.size(), file_);
+    trailer_offset_ = ftell(file_);
+    fwrite(trailer.data(), 1, trailer.size(), file_);
+    fflush(file_);
+    const long end = ftell(file_);
+#if defined(GTEST_OS_WINDOWS) && !defined(GTEST_OS_WINDOWS_MOBILE)
+    _chsize_s(posix::FileNo(file_), end);
+#elif !defined(GTEST_OS_WINDOWS)
+    static_cast<void>(ftruncate(posix::FileNo(file_), end));
+#endif
+  }
+
+  void Close() {
+    if (file_ != nullptr) fclose(file_);
+    file_ = nullptr;
+  }
+
+ private:
+  FILE* file_ = nullptr;
+  // Where the trailer starts in the file.
+  long trailer_offset_ = 0;
+
+  PartialReportFile(const PartialReportFile&) = delete;
+  PartialReportFile& operator=(const PartialReportFile&) = delete;
+};
 #endif  // GTEST_HAS_FILE_SYSTEM
 
 }  // namespace internal
@@ -282,12 +477,31 @@ GTEST_DEFINE_bool_(
     testing::internal::BoolFromGTestEnv("also_run_disabled_tests", false),
     "Run disabled tests too, in addition to the tests normally being run.");
 
+GTEST_DEFINE_bool_(
+    async_listeners,
+    testing::internal::BoolFromGTestEnv("async_listeners", false),
+    "True if and only if the event listeners that declare themselves "
+    "async-safe should receive the events on a thread of their own, so that "
+    "they do not slow down the tests.");
+
+GTEST_DEFINE_int32_(
+    benchmark_time_ms,
+    testing::internal::Int32FromGTestEnv("benchmark_time_ms", 500),
+    "The approximate number of milliseconds each benchmark test spends "
+    "timing its body.  0 runs the body once, without timing it.");
+
 GTEST_DEFINE_bool_(
     break_on_failure,
     testing::internal::BoolFromGTestEnv("break_on_failure", false),
     "True if and only if a failed assertion should be a debugger "
     "break-point.");
 
+GTEST_DEFINE_string_(
+    cache_dir, testing::internal::StringFromGTestEnv("cache_dir", ""),
+    "If non-empty, the directory in which the tests that passed are "
+    "recorded.  Later runs of the same test binary with the same flags "
+    "report those tests as cached instead of running them again.");
+
 GTEST_DEFINE_bool_(catch_exceptions,
                    testing::internal::BoolFromGTestEnv("catch_exceptions",
                                                        true),
@@ -331,7 +545,8 @@ GTEST_DEFINE_string_(
     output,
     testing::internal::StringFromGTestEnv(
         "output", testing::internal::OutputFlagAlsoCheckEnvVar().c_str()),
-    "A format (defaults to \"xml\" but can be specified to be \"json\"), "
+    "A format (defaults to \"xml\" but can be specified to be \"json\" "
+    "or \"bin\"), "
     "optionally followed by a colon and an output file name or directory. "
     "A directory is indicated by a trailing pathname separator. "
     "Examples: \"xml:filename.xml\", \"xml::directoryname/\". "
@@ -340,6 +555,37 @@ GTEST_DEFINE_string_(
     "executable's name and, if necessary, made unique by adding "
     "digits.");
 
+GTEST_DEFINE_int32_(
+    output_buffering,
+    testing::internal::Int32FromGTestEnv("output_buffering", 0),
+    "The size in bytes of a buffer that collects the text output, which is "
+    "then written out when the buffer fills, before test code runs, when a "
+    "test fails, at the end of each iteration, at the first event a second "
+    "after it was last written out, and when the program is killed by a "
+    "signal.  0 (the default) writes the output after every event.");
+
+GTEST_DEFINE_int32_(
+    jobs, testing::internal::Int32FromGTestEnv("jobs", 0),
+    "The number of worker processes forked to run test suites concurrently. "
+    "The workers report back to the main process, which produces the "
+    "output and reports of a single run.  0 or 1 runs all tests in the main "
+    "process.");
+
+GTEST_DEFINE_int32_(
+    parallel, testing::internal::Int32FromGTestEnv("parallel", 0),
+    "The number of worker threads used to run test suites concurrently. "
+    "Each test suite runs entirely on one worker; idle workers steal "
+    "suites queued for busy ones.  0 or 1 runs all tests on the main "
+    "thread.");
+
+GTEST_DEFINE_string_(
+    parallel_exclude,
+    testing::internal::StringFromGTestEnv("parallel_exclude", ""),
+    "A colon-separated list of glob (not regex) patterns selecting the test "
+    "suites that must run on the main thread, after the parallel workers "
+    "have finished, when --gtest_parallel is in effect.  Death test suites "
+    "always run on the main thread.");
+
 GTEST_DEFINE_bool_(
     brief, testing::internal::BoolFromGTestEnv("brief", false),
     "True if only test failures should be displayed in text output.");
@@ -354,6 +600,24 @@ GTEST_DEFINE_bool_(print_utf8,
                    "True if and only if " GTEST_NAME_
                    " prints UTF8 characters as text.");
 
+GTEST_DEFINE_bool_(
+    print_resources,
+    testing::internal::BoolFromGTestEnv("print_resources", false),
+    "True if and only if " GTEST_NAME_
+    " should measure the CPU time, memory, page faults and context switches "
+    "of each test, report them in the XML and JSON output, and print the "
+    "tests that use the most at the end of each iteration.");
+
+GTEST_DEFINE_bool_(
+    print_phase_times,
+    testing::internal::BoolFromGTestEnv("print_phase_times", false),
+    "True if and only if " GTEST_NAME_
+    " should measure the time spent constructing, setting up, running, "
+    "tearing down and destroying each test, in SetUpTestSuite() and "
+    "TearDownTestSuite(), and in the global environments, report it in the "
+    "XML and JSON output, and print where the time went at the end of each "
+    "iteration.");
+
 GTEST_DEFINE_int32_(
     random_seed, testing::internal::Int32FromGTestEnv("random_seed", 0),
     "Random number seed to use when shuffling test orders.  Must be in range "
@@ -376,6 +640,13 @@ GTEST_DEFINE_bool_(
     "there is no last run, the environments will always be recreated to avoid "
     "leaks.");
 
+GTEST_DEFINE_string_(
+    serve, testing::internal::StringFromGTestEnv("serve", ""),
+    "This flag makes the test program stay alive and run the tests requested "
+    "on the standard input (\"stdin\") or on a Unix domain socket "
+    "(\"unix:PATH\"), one request per line, streaming the results back.  The "
+    "flag is effective only on Linux and macOS.");
+
 GTEST_DEFINE_bool_(show_internal_stack_frames, false,
                    "True if and only if " GTEST_NAME_
                    " should include internal stack frames when "
@@ -397,9 +668,20 @@ GTEST_DEFINE_string_(
     stream_result_to,
     testing::internal::StringFromGTestEnv("stream_result_to", ""),
     "This flag specifies the host name and the port number on which to stream "
-    "test results. Example: \"localhost:555\". The flag is effective only on "
+    "test results, the Unix domain socket to stream them to, or the file to "
+    "map a ring buffer of them into, optionally followed by '?' and "
+    "'&'-separated options. Examples: \"localhost:555\", "
+    "\"unix:/tmp/results?framing=compact&buffer=65536&overflow=drop\", "
+    "\"shm:/dev/shm/results?size=1048576\". The flag is effective only on "
     "Linux and macOS.");
 
+GTEST_DEFINE_int32_(
+    test_timeout, testing::internal::Int32FromGTestEnv("test_timeout", 0),
+    "The number of seconds after which a test that is still running is "
+    "reported as timed out, with the stack traces of all the threads.  The "
+    "test program then ends, unless --gtest_jobs runs the tests in worker "
+    "processes.  0 (the default) means no timeout.");
+
 GTEST_DEFINE_bool_(
     throw_on_failure,
     testing::internal::BoolFromGTestEnv("throw_on_failure", false),
@@ -413,6 +695,21 @@ GTEST_DEFINE_int32_(
     "The zero-based index of the shard to run. A value of -1 "
     "(the default) indicates that sharding is disabled.");
 
+GTEST_DEFINE_string_(
+    shard_by, testing::internal::StringFromGTestEnv("shard_by", "index"),
+    "How the tests are assigned to the shards: \"index\" (the default) "
+    "deals them out in order; \"hash\" picks the shard of each test from "
+    "a hash of its full name, so that tests keep their shard when others are "
+    "added or removed.  \"hash:W0,W1,...\" gives each shard a weight, "
+    "making the share of the tests it gets proportional to it.");
+
+GTEST_DEFINE_string_(
+    shard_timing, testing::internal::StringFromGTestEnv("shard_timing", ""),
+    "The path of a JSON report written by a previous run of the test "
+    "program.  When the tests are sharded, the test durations recorded in "
+    "it are used to give every shard about the same amount of work, instead "
+    "of the same number of tests.");
+
 GTEST_DEFINE_int32_(
     total_shards,
     testing::internal::Int32FromEnvOrDie(testing::kTestTotalShards, -1),
@@ -507,12 +804,16 @@ AssertHelper::AssertHelper(TestPartResult::Type type, const char* file,
 AssertHelper::AssertHelper(TestPartResult::Type type,
                            const std::string_view file, int line,
                            const std::string_view message)
-    : data_(new AssertHelperData(type, file, line, message)) {}
+    : data_([&] {
+        const AllocationCountingPause allocation_counting_pause;
+        return new AssertHelperData(type, file, line, message);
+      }()) {}
 
 AssertHelper::~AssertHelper() { delete data_; }
 
 // Message assignment, for assertion streaming support.
 void AssertHelper::operator=(const Message& message) const {
+  const AllocationCountingPause allocation_counting_pause;
   UnitTest::GetInstance()->AddTestPartResult(
       data_->type, data_->file, data_->line,
       AppendUserMessage(data_->message, message),
@@ -760,106 +1061,228 @@ std::string UnitTestOptions::GetAbsolutePathToOutputFile() {
 }
 #endif  // GTEST_HAS_FILE_SYSTEM
 
-// Returns true if and only if the wildcard pattern matches the string. Each
-// pattern consists of regular characters, single-character wildcards (?), and
-// multi-character wildcards (*).
-//
-// This function implements a linear-time string globbing algorithm based on
-// https://research.swtch.com/glob.
-static bool PatternMatchesString(const std::string& name_str,
-                                 const char* pattern, const char* pattern_end) {
-  const char* name = name_str.c_str();
-  const char* const name_begin = name;
-  const char* const name_end = name + name_str.size();
-
-  const char* pattern_next = pattern;
-  const char* name_next = name;
-
-  while (pattern < pattern_end || name < name_end) {
-    if (pattern < pattern_end) {
-      switch (*pattern) {
-        default:  // Match an ordinary character.
-          if (name < name_end && *name == *pattern) {
-            ++pattern;
-            ++name;
-            continue;
-          }
-          break;
-        case '?':  // Match any single character.
-          if (name < name_end) {
-            ++pattern;
-            ++name;
-            continue;
-          }
-          break;
-        case '*':
-          // Match zero or more characters. Start by skipping over the wildcard
-          // and matching zero characters from name. If that fails, restart and
-          // match one more character than the last attempt.
-          pattern_next = pattern;
-          name_next = name + 1;
-          ++pattern;
-          continue;
-      }
-    }
-    // Failed to match a character. Restart if possible.
-    if (name_begin < name_next && name_next <= name_end) {
-      pattern = pattern_next;
-      name = name_next;
-      continue;
-    }
-    return false;
-  }
-  return true;
-}
-
 namespace {
 
-bool IsGlobPattern(const std::string& pattern) {
-  return std::any_of(pattern.begin(), pattern.end(),
-                     [](const char c) { return c == '?' || c == '*'; });
-}
-
+// A set of wildcard patterns compiled into a trie.  Each pattern consists of
+// regular characters, single-character wildcards (?), and multi-character
+// wildcards (*), and each of them labels an edge of the trie.
+//
+// A name is matched against all the patterns at once by walking the trie and
+// keeping the set of nodes that the characters read so far can reach, as in
+// https://swtch.com/~rsc/regexp/regexp1.html.  Patterns that share a prefix
+// are matched together, and patterns whose prefix does not match are dropped
+// as soon as it fails, so a match costs time linear in the length of the name
+// rather than in the number of patterns.  The characters of a name can also be
+// fed in pieces, which lets a test suite name be matched once for all the
+// tests of the suite.
 class UnitTestFilter {
  public:
-  UnitTestFilter() = default;
+  // The nodes of the trie reached by the characters matched so far.
+  struct MatchState {
+    std::vector<size_t> nodes;
+    std::vector<size_t> next_nodes;  // Scratch space for Advance().
+  };
+
+  UnitTestFilter() : nodes_(1) {}
 
   // Constructs a filter from a string of patterns separated by `:`.
-  explicit UnitTestFilter(const std::string& filter) {
+  explicit UnitTestFilter(const std::string& filter) : nodes_(1) {
     // By design "" filter matches "" string.
-    std::vector<std::string> all_patterns;
-    SplitString(filter, ':', &all_patterns);
-    const auto exact_match_patterns_begin = std::partition(
-        all_patterns.begin(), all_patterns.end(), &IsGlobPattern);
-
-    glob_patterns_.reserve(static_cast<size_t>(
-        std::distance(all_patterns.begin(), exact_match_patterns_begin)));
-    std::move(all_patterns.begin(), exact_match_patterns_begin,
-              std::inserter(glob_patterns_, glob_patterns_.begin()));
-    std::move(
-        exact_match_patterns_begin, all_patterns.end(),
-        std::inserter(exact_match_patterns_, exact_match_patterns_.begin()));
+    std::vector<std::string> patterns;
+    SplitString(filter, ':', &patterns);
+    for (const std::string& pattern : patterns) AddPattern(pattern);
   }
 
   // Returns true if and only if name matches at least one of the patterns in
   // the filter.
   bool MatchesName(const std::string& name) const {
-    return exact_match_patterns_.find(name) != exact_match_patterns_.end() ||
-           std::any_of(glob_patterns_.begin(), glob_patterns_.end(),
-                       [&name](const std::string& pattern) {
-                         return PatternMatchesString(
-                             name, pattern.c_str(),
-                             pattern.c_str() + pattern.size());
+    MatchState state;
+    Start(&state);
+    Advance(name, &state);
+    return Matches(state);
+  }
+
+  // Starts matching a new name.
+  void Start(MatchState* state) const {
+    state->nodes.clear();
+    Reach(kRoot, &state->nodes);
+  }
+
+  // Matches the next characters of the name.
+  void Advance(const std::string& chars, MatchState* state) const {
+    for (const char c : chars) {
+      if (CannotMatch(*state)) return;
+      Advance(c, state);
+    }
+  }
+
+  void Advance(char c, MatchState* state) const {
+    std::vector<size_t>& next_nodes = state->next_nodes;
+    next_nodes.clear();
+    for (const size_t node_index : state->nodes) {
+      const Node& node = nodes_[node_index];
+      // A '*' matches one more character.
+      if (node.is_any_string) AddOnce(node_index, &next_nodes);
+      for (const auto& child : node.children) {
+        if (child.first == c) {
+          Reach(child.second, &next_nodes);
+          break;
+        }
+      }
+      if (node.any_char != kNone) Reach(node.any_char, &next_nodes);
+    }
+    state->nodes.swap(next_nodes);
+  }
+
+  // Returns true if and only if no pattern matches a name that starts with
+  // the characters matched so far.
+  static bool CannotMatch(const MatchState& state) {
+    return state.nodes.empty();
+  }
+
+  // Returns true if and only if a pattern matches the characters matched so
+  // far.
+  bool Matches(const MatchState& state) const {
+    return std::any_of(
+        state.nodes.begin(), state.nodes.end(),
+        [this](size_t node) { return nodes_[node].ends_pattern; });
+  }
+
+  // Returns true if and only if a pattern matches every name that starts with
+  // the characters matched so far, as "Foo.*" does after "Foo.".
+  bool MatchesAnyContinuation(const MatchState& state) const {
+    return std::any_of(state.nodes.begin(), state.nodes.end(),
+                       [this](size_t node) {
+                         return nodes_[node].is_any_string &&
+                                nodes_[node].ends_pattern;
                        });
   }
 
  private:
-  std::vector<std::string> glob_patterns_;
-  std::unordered_set<std::string> exact_match_patterns_;
+  static constexpr size_t kRoot = 0;
+  static constexpr size_t kNone = 0;  // The root is nobody's child.
+
+  struct Node {
+    std::vector<std::pair<char, size_t>> children;  // For regular characters.
+    size_t any_char = kNone;                        // For '?'.
+    size_t any_string = kNone;                      // For '*'.
+    bool is_any_string = false;  // True if the node follows a '*'.
+    bool ends_pattern = false;
+  };
+
+  void AddPattern(const std::string& pattern) {
+    size_t node = kRoot;
+    for (const char c : pattern) {
+      // "**" matches the same names as "*".
+      if (c == '*' && nodes_[node].is_any_string) continue;
+
+      size_t child = FindChild(node, c);
+      if (child == kNone) {
+        child = nodes_.size();
+        nodes_.emplace_back();
+        if (c == '*') {
+          nodes_[child].is_any_string = true;
+          nodes_[node].any_string = child;
+        } else if (c == '?') {
+          nodes_[node].any_char = child;
+        } else {
+          nodes_[node].children.emplace_back(c, child);
+        }
+      }
+      node = child;
+    }
+    nodes_[node].ends_pattern = true;
+  }
+
+  size_t FindChild(size_t node, char c) const {
+    if (c == '*') return nodes_[node].any_string;
+    if (c == '?') return nodes_[node].any_char;
+    for (const auto& child : nodes_[node].children) {
+      if (child.first == c) return child.second;
+    }
+    return kNone;
+  }
+
+  // Adds the node to the set of nodes reached, and the '*' that follows it,
+  // which can match zero characters.  Only the nodes after a '*' can be
+  // reached twice, as they are also reached by matching one more character.
+  void Reach(size_t node, std::vector<size_t>* nodes) const {
+    nodes->push_back(node);
+    if (nodes_[node].any_string != kNone) {
+      AddOnce(nodes_[node].any_string, nodes);
+    }
+  }
+
+  static void AddOnce(size_t node, std::vector<size_t>* nodes) {
+    if (std::find(nodes->begin(), nodes->end(), node) == nodes->end()) {
+      nodes->push_back(node);
+    }
+  }
+
+  std::vector<Node> nodes_;
 };
 
 class PositiveAndNegativeUnitTestFilter {
  public:
+  // Matches the tests of one test suite at a time against a filter.  The name
+  // of the test suite is matched once for all of its tests, and the tests of
+  // a test suite that the filter rules out are not matched at all.
+  class TestSuiteMatcher {
+   public:
+    explicit TestSuiteMatcher(const PositiveAndNegativeUnitTestFilter& filter)
+        : filter_(filter) {}
+
+    // Starts matching the tests of the given test suite.  Returns false if
+    // none of them can match the filter, in which case MatchesTest() must not
+    // be called.
+    bool StartTestSuite(const std::string& test_suite_name) {
+      StartName(filter_.positive_filter_, test_suite_name, &positive_);
+      StartName(filter_.negative_filter_, test_suite_name, &negative_);
+      if (UnitTestFilter::CannotMatch(positive_) ||
+          filter_.negative_filter_.MatchesAnyContinuation(negative_)) {
+        return false;
+      }
+      all_match_positive_ =
+          filter_.positive_filter_.MatchesAnyContinuation(positive_);
+      none_match_negative_ = UnitTestFilter::CannotMatch(negative_);
+      return true;
+    }
+
+    // Returns true if and only if the test of the current test suite matches
+    // the positive filter and does not match the negative filter.
+    bool MatchesTest(const std::string& test_name) {
+      return (all_match_positive_ ||
+              MatchesRest(filter_.positive_filter_, positive_, test_name)) &&
+             (none_match_negative_ ||
+              !MatchesRest(filter_.negative_filter_, negative_, test_name));
+    }
+
+   private:
+    static void StartName(const UnitTestFilter& filter,
+                          const std::string& test_suite_name,
+                          UnitTestFilter::MatchState* state) {
+      filter.Start(state);
+      filter.Advance(test_suite_name, state);
+      if (!UnitTestFilter::CannotMatch(*state)) filter.Advance('.', state);
+    }
+
+    bool MatchesRest(const UnitTestFilter& filter,
+                     const UnitTestFilter::MatchState& test_suite_state,
+                     const std::string& test_name) {
+      test_.nodes.assign(test_suite_state.nodes.begin(),
+                         test_suite_state.nodes.end());
+      filter.Advance(test_name, &test_);
+      return filter.Matches(test_);
+    }
+
+    const PositiveAndNegativeUnitTestFilter& filter_;
+    UnitTestFilter::MatchState positive_;
+    UnitTestFilter::MatchState negative_;
+    UnitTestFilter::MatchState test_;
+    bool all_match_positive_ = false;
+    bool none_match_negative_ = false;
+  };
+
   // Constructs a positive and a negative filter from a string. The string
   // contains a positive filter optionally followed by a '-' character and a
   // negative filter. In case only a negative filter is provided the positive
@@ -897,11 +1320,9 @@ class PositiveAndNegativeUnitTestFilter {
   // and does not match the negative filter.
   bool MatchesTest(const std::string& test_suite_name,
                    const std::string& test_name) const {
-#ifdef GTEST_HAS_ABSL
-    return MatchesName(absl::StrCat(test_suite_name, ".", test_name));
-#else
-    return MatchesName(test_suite_name + "." + test_name);
-#endif
+    TestSuiteMatcher matcher(*this);
+    return matcher.StartTestSuite(test_suite_name) &&
+           matcher.MatchesTest(test_name);
   }
 
   // Returns true if and only if name matches the positive filter and does not
@@ -1096,8 +1517,9 @@ DefaultGlobalTestPartResultReporter::DefaultGlobalTestPartResultReporter(
 
 void DefaultGlobalTestPartResultReporter::ReportTestPartResult(
     const TestPartResult& result) {
+  const TestEventLock lock;
   unit_test_->current_test_result()->AddTestPartResult(result);
-  unit_test_->listeners()->repeater()->OnTestPartResult(result);
+  unit_test_->current_repeater()->OnTestPartResult(result);
 }
 
 DefaultPerThreadTestPartResultReporter::DefaultPerThreadTestPartResultReporter(
@@ -1166,6 +1588,11 @@ int UnitTestImpl::skipped_test_count() const {
   return SumOverTestSuiteList(test_suites_, &TestSuite::skipped_test_count);
 }
 
+// Gets the number of tests whose result was taken from the result cache.
+int UnitTestImpl::cached_test_count() const {
+  return SumOverTestSuiteList(test_suites_, &TestSuite::cached_test_count);
+}
+
 // Gets the number of failed tests.
 int UnitTestImpl::failed_test_count() const {
   return SumOverTestSuiteList(test_suites_, &TestSuite::failed_test_count);
@@ -1192,6 +1619,13 @@ int UnitTestImpl::total_test_count() const {
   return SumOverTestSuiteList(test_suites_, &TestSuite::total_test_count);
 }
 
+// Gets the number of tests linked in, including the deferred tests whose
+// TestInfo objects have not been created.
+int UnitTestImpl::linked_test_count() const {
+  return total_test_count() +
+         SumOverTestSuiteList(test_suites_, &TestSuite::uncreated_test_count);
+}
+
 // Gets the number of tests that should run.
 int UnitTestImpl::test_to_run_count() const {
   return SumOverTestSuiteList(test_suites_, &TestSuite::test_to_run_count);
@@ -1221,9 +1655,12 @@ class Timer {
   Timer() : start_(clock::now()) {}
 
   // Return time elapsed in milliseconds since the timer was created.
-  TimeInMillis Elapsed() {
-    return std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() -
-                                                                 start_)
+  TimeInMillis Elapsed() { return ElapsedNanos() / 1000000; }
+
+  // Return time elapsed in nanoseconds since the timer was created.
+  TimeInNanos ElapsedNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() -
+                                                                start_)
         .count();
   }
 
@@ -1238,6 +1675,66 @@ class Timer {
   clock::time_point start_;
 };
 
+// Reads the resources the process has used so far into *usage, returning
+// false if they cannot be measured.  If this_thread_only is true, the counters
+// other than the peak resident set size, which is only kept for the whole
+// process, are those of the calling thread where the platform allows it.
+static bool ReadResourceUsage(bool this_thread_only, ResourceUsage* usage) {
+#if GTEST_CAN_MEASURE_RESOURCES_
+  struct rusage rusage;
+  if (getrusage(RUSAGE_SELF, &rusage) != 0) return false;
+#ifdef GTEST_OS_MAC
+  usage->max_rss_kb = rusage.ru_maxrss / 1024;  // In bytes on macOS.
+#else
+  usage->max_rss_kb = rusage.ru_maxrss;
+#endif  // GTEST_OS_MAC
+  usage->max_rss_growth_kb = 0;
+#if defined(GTEST_OS_LINUX) && defined(RUSAGE_THREAD)
+  if (this_thread_only && getrusage(RUSAGE_THREAD, &rusage) != 0) return false;
+#else
+  static_cast<void>(this_thread_only);
+#endif  // defined(GTEST_OS_LINUX) && defined(RUSAGE_THREAD)
+  usage->user_cpu_time_us =
+      int64_t{rusage.ru_utime.tv_sec} * 1000000 + rusage.ru_utime.tv_usec;
+  usage->system_cpu_time_us =
+      int64_t{rusage.ru_stime.tv_sec} * 1000000 + rusage.ru_stime.tv_usec;
+  usage->minor_page_faults = rusage.ru_minflt;
+  usage->major_page_faults = rusage.ru_majflt;
+  usage->voluntary_context_switches = rusage.ru_nvcsw;
+  usage->involuntary_context_switches = rusage.ru_nivcsw;
+  return true;
+#else
+  static_cast<void>(this_thread_only);
+  static_cast<void>(usage);
+  return false;
+#endif  // GTEST_CAN_MEASURE_RESOURCES_
+}
+
+// With --gtest_parallel, the other tests running at the same time must not
+// be charged to the one measured.
+ResourceMeter::ResourceMeter()
+    : this_thread_only_(GTEST_FLAG_GET(parallel) > 1) {
+  measuring_ = GTEST_FLAG_GET(print_resources) &&
+               ReadResourceUsage(this_thread_only_, &start_);
+}
+
+bool ResourceMeter::Measure(ResourceUsage* usage) const {
+  ResourceUsage end;
+  if (!measuring_ || !ReadResourceUsage(this_thread_only_, &end)) return false;
+  usage->user_cpu_time_us = end.user_cpu_time_us - start_.user_cpu_time_us;
+  usage->system_cpu_time_us =
+      end.system_cpu_time_us - start_.system_cpu_time_us;
+  usage->max_rss_kb = end.max_rss_kb;
+  usage->max_rss_growth_kb = end.max_rss_kb - start_.max_rss_kb;
+  usage->minor_page_faults = end.minor_page_faults - start_.minor_page_faults;
+  usage->major_page_faults = end.major_page_faults - start_.major_page_faults;
+  usage->voluntary_context_switches =
+      end.voluntary_context_switches - start_.voluntary_context_switches;
+  usage->involuntary_context_switches =
+      end.involuntary_context_switches - start_.involuntary_context_switches;
+  return true;
+}
+
 // Returns a timestamp as milliseconds since the epoch. Note this time may jump
 // around subject to adjustments by the system, to measure elapsed time use
 // Timer instead.
@@ -2340,7 +2837,13 @@ std::string AppendUserMessage(const std::string& gtest_msg,
 
 // Creates an empty TestResult.
 TestResult::TestResult()
-    : death_test_count_(0), start_timestamp_(0), elapsed_time_(0) {}
+    : death_test_count_(0),
+      start_timestamp_(0),
+      elapsed_time_nanos_(0),
+      cached_(false),
+      has_resource_usage_(false),
+      has_allocation_stats_(false),
+      has_phase_times_(false) {}
 
 // D'tor.
 TestResult::~TestResult() = default;
@@ -2411,6 +2914,31 @@ static const char* const kReservedOutputTestCaseAttributes[] = {
     "classname",   "name", "status", "time",   "type_param",
     "value_param", "file", "line",   "result", "timestamp"};
 
+// The list of attributes of the <benchmark> element of XML output.
+static const char* const kReservedOutputBenchmarkAttributes[] = {
+    "iterations", "samples",   "mean_ns",
+    "median_ns",  "stddev_ns", "iterations_per_second"};
+
+// The list of attributes of the <resources> element of XML output.
+static const char* const kReservedOutputResourcesAttributes[] = {
+    "user_cpu_time_us",           "system_cpu_time_us",
+    "max_rss_kb",                 "max_rss_growth_kb",
+    "minor_page_faults",          "major_page_faults",
+    "voluntary_context_switches", "involuntary_context_switches"};
+
+// The list of attributes of the <allocations> element of XML output.
+static const char* const kReservedOutputAllocationsAttributes[] = {
+    "count", "bytes", "peak_bytes"};
+
+// The list of attributes of the <phases> elements of XML output, which
+// belong to <testcase>, <testsuite> and <testsuites> elements.
+static const char* const kReservedOutputPhasesAttributes[] = {
+    "constructor",          "set_up",
+    "body",                 "tear_down",
+    "destructor",           "set_up_test_suite",
+    "tear_down_test_suite", "environments_set_up",
+    "environments_tear_down"};
+
 template <size_t kSize>
 std::vector<std::string> ArrayAsVector(const char* const (&array)[kSize]) {
   return std::vector<std::string>(array, array + kSize);
@@ -2442,6 +2970,14 @@ static std::vector<std::string> GetReservedOutputAttributesForElement(
     return ArrayAsVector(kReservedTestSuiteAttributes);
   } else if (xml_element == "testcase") {
     return ArrayAsVector(kReservedOutputTestCaseAttributes);
+  } else if (xml_element == "benchmark") {
+    return ArrayAsVector(kReservedOutputBenchmarkAttributes);
+  } else if (xml_element == "resources") {
+    return ArrayAsVector(kReservedOutputResourcesAttributes);
+  } else if (xml_element == "allocations") {
+    return ArrayAsVector(kReservedOutputAllocationsAttributes);
+  } else if (xml_element == "phases") {
+    return ArrayAsVector(kReservedOutputPhasesAttributes);
   } else {
     GTEST_CHECK_(false) << "Unrecognized xml_element provided: " << xml_element;
   }
@@ -2490,7 +3026,15 @@ void TestResult::Clear() {
   test_part_results_.clear();
   test_properties_.clear();
   death_test_count_ = 0;
-  elapsed_time_ = 0;
+  elapsed_time_nanos_ = 0;
+  cached_ = false;
+  benchmark_result_ = BenchmarkResult();
+  has_resource_usage_ = false;
+  resource_usage_ = ResourceUsage();
+  has_allocation_stats_ = false;
+  allocation_stats_ = AllocationStats();
+  has_phase_times_ = false;
+  phase_times_ = TestPhaseTimes();
 }
 
 // Returns true off the test part was skipped.
@@ -2569,6 +3113,12 @@ void Test::RecordProperty(const std::string& key, const std::string& value) {
   UnitTest::GetInstance()->RecordProperty(key, value);
 }
 
+void Test::SetTestTimeout(int timeout_in_seconds) {
+  internal::UnitTestImpl* const impl = internal::GetUnitTestImpl();
+  TestInfo* const test_info = impl->current_test_info();
+  if (test_info != nullptr) impl->SetTestTimeout(test_info, timeout_in_seconds);
+}
+
 namespace internal {
 
 void ReportFailureInUnknownLocation(TestPartResult::Type result_type,
@@ -2761,6 +3311,34 @@ Result HandleExceptionsInMethodIfSupported(T* object, Result (T::*method)(),
   }
 }
 
+#ifdef GTEST_IS_THREADSAFE
+// The mutex of TestEventLock, never destroyed as events may be sent while the
+// program exits.
+static std::recursive_mutex& TestEventMutex() {
+  static std::recursive_mutex* const mutex = new std::recursive_mutex;
+  return *mutex;
+}
+#endif  // GTEST_IS_THREADSAFE
+
+TestEventLock::TestEventLock() {
+#ifdef GTEST_IS_THREADSAFE
+  TestEventMutex().lock();
+#endif  // GTEST_IS_THREADSAFE
+}
+
+TestEventLock::~TestEventLock() {
+#ifdef GTEST_IS_THREADSAFE
+  TestEventMutex().unlock();
+#endif  // GTEST_IS_THREADSAFE
+}
+
+// Sets the time a phase of the running test took, which the report of a
+// timeout may read.
+static void SetPhaseNanos(int64_t* phase_nanos, int64_t nanos) {
+  const TestEventLock lock;
+  *phase_nanos = nanos;
+}
+
 }  // namespace internal
 
 // Runs the test and updates the test result.
@@ -2768,22 +3346,41 @@ void Test::Run() {
   if (!HasSameFixtureClass()) return;
 
   internal::UnitTestImpl* const impl = internal::GetUnitTestImpl();
+  TestPhaseTimes& phase_times = impl->current_test_result()->phase_times_;
+  // Counts the allocations of SetUp(), the test body and TearDown(), leaving
+  // out those Google Test makes to create the fixture and record the result.
+  const internal::AllocationScope allocation_scope;
   impl->os_stack_trace_getter()->UponLeavingGTest();
+  internal::Timer set_up_timer;
   internal::HandleExceptionsInMethodIfSupported(this, &Test::SetUp, "SetUp()");
+  internal::SetPhaseNanos(&phase_times.set_up_nanos,
+                          set_up_timer.ElapsedNanos());
   // We will run the test only if SetUp() was successful and didn't call
   // GTEST_SKIP().
   if (!HasFatalFailure() && !IsSkipped()) {
     impl->os_stack_trace_getter()->UponLeavingGTest();
+    internal::Timer body_timer;
     internal::HandleExceptionsInMethodIfSupported(this, &Test::TestBody,
                                                   "the test body");
+    internal::SetPhaseNanos(&phase_times.body_nanos,
+                            body_timer.ElapsedNanos());
   }
 
   // However, we want to clean up as much as possible.  Hence we will
   // always call TearDown(), even if SetUp() or the test body has
   // failed.
   impl->os_stack_trace_getter()->UponLeavingGTest();
+  internal::Timer tear_down_timer;
   internal::HandleExceptionsInMethodIfSupported(this, &Test::TearDown,
                                                 "TearDown()");
+  internal::SetPhaseNanos(&phase_times.tear_down_nanos,
+                          tear_down_timer.ElapsedNanos());
+
+  if (allocation_scope.counting()) {
+    const AllocationStats stats = allocation_scope.Stats();
+    const internal::TestEventLock lock;
+    impl->current_test_result()->set_allocation_stats(stats);
+  }
 }
 
 // Returns true if and only if the current test has a fatal failure.
@@ -2803,6 +3400,152 @@ bool Test::IsSkipped() {
   return internal::GetUnitTestImpl()->current_test_result()->Skipped();
 }
 
+namespace internal {
+
+// class BenchmarkRunner
+
+// A benchmark test times at most kBenchmarkMaxSamples samples, and stops
+// earlier, after at least kBenchmarkMinSamples, once the samples have used up
+// --gtest_benchmark_time_ms.
+constexpr size_t kBenchmarkMaxSamples = 10;
+constexpr size_t kBenchmarkMinSamples = 3;
+
+// The most iterations a batch runs, reached when the optimizer has removed
+// the body or it is too fast to time.
+constexpr int64_t kBenchmarkMaxIterations = 1000000000;
+
+BenchmarkRunner::BenchmarkRunner()
+    : budget_nanos_(int64_t{GTEST_FLAG_GET(benchmark_time_ms)} * 1000000),
+      iterations_(1),
+      calibrated_(false),
+      done_(false),
+      sampled_nanos_(0) {}
+
+int64_t BenchmarkRunner::NextIterations() {
+  if (done_ || Test::HasFailure() || Test::IsSkipped()) return 0;
+  return iterations_;
+}
+
+void BenchmarkRunner::Record(int64_t iterations, int64_t elapsed_nanos) {
+  if (budget_nanos_ <= 0) {
+    done_ = true;
+    return;
+  }
+
+  const int64_t sample_nanos =
+      budget_nanos_ / static_cast<int64_t>(kBenchmarkMaxSamples);
+  if (!calibrated_) {
+    // The batches before the samples warm up the code under test, and grow
+    // until one takes as long as a sample should, or reaches the most
+    // iterations a batch runs.
+    if (elapsed_nanos >= sample_nanos ||
+        iterations >= kBenchmarkMaxIterations) {
+      calibrated_ = true;
+      return;
+    }
+    const double scale =
+        elapsed_nanos > 0
+            ? 1.2 * static_cast<double>(sample_nanos) /
+                  static_cast<double>(elapsed_nanos)
+            : 100.0;
+    const double next = std::min(
+        std::ceil(static_cast<double>(iterations) * std::min(scale, 100.0)),
+        static_cast<double>(kBenchmarkMaxIterations));
+    iterations_ = std::max(iterations + 1, static_cast<int64_t>(next));
+    return;
+  }
+
+  samples_.push_back(static_cast<double>(elapsed_nanos) /
+                     static_cast<double>(iterations));
+  sampled_nanos_ += elapsed_nanos;
+  if (samples_.size() >= kBenchmarkMaxSamples ||
+      (samples_.size() >= kBenchmarkMinSamples &&
+       sampled_nanos_ >= budget_nanos_)) {
+    Finish();
+  }
+}
+
+void BenchmarkRunner::Finish() {
+  done_ = true;
+  const size_t n = samples_.size();
+  double sum = 0;
+  for (double sample : samples_) sum += sample;
+  const double mean = sum / static_cast<double>(n);
+  double squares = 0;
+  for (double sample : samples_) squares += (sample - mean) * (sample - mean);
+  const double stddev = std::sqrt(squares / static_cast<double>(n - 1));
+
+  std::sort(samples_.begin(), samples_.end());
+  const double median = n % 2 == 1
+                            ? samples_[n / 2]
+                            : (samples_[n / 2 - 1] + samples_[n / 2]) / 2;
+
+  GetUnitTestImpl()->current_test_result()->set_benchmark_result(
+      BenchmarkResult(iterations_, static_cast<int>(n), mean, median, stddev));
+}
+
+void UseCharPointer(const volatile char* /* pointer */) {}
+
+// class AllocationScope
+
+// The function that returns the allocation counters of the calling thread,
+// which gtest_alloc installs.
+static AllocationCounters* (*g_allocation_counters_getter)() = nullptr;
+
+void SetAllocationCountersGetter(AllocationCounters* (*getter)()) {
+  g_allocation_counters_getter = getter;
+}
+
+AllocationCounters* GetThreadAllocationCounters() {
+  return g_allocation_counters_getter != nullptr
+             ? g_allocation_counters_getter()
+             : nullptr;
+}
+
+AllocationScope::AllocationScope()
+    : counters_(GetThreadAllocationCounters()), start_() {
+  if (counters_ == nullptr) return;
+  start_ = *counters_;
+  // The peak of the scope starts from what is allocated now.  The enclosing
+  // scopes get their peak back when this one ends.
+  counters_->peak_live_bytes = counters_->live_bytes;
+}
+
+AllocationScope::~AllocationScope() {
+  if (counters_ == nullptr) return;
+  counters_->peak_live_bytes =
+      (std::max)(counters_->peak_live_bytes, start_.peak_live_bytes);
+}
+
+AllocationStats AllocationScope::Stats() const {
+  AllocationStats stats;
+  if (counters_ != nullptr) {
+    stats.count = counters_->count - start_.count;
+    stats.bytes = counters_->bytes - start_.bytes;
+    stats.peak_bytes = counters_->peak_live_bytes - start_.live_bytes;
+  }
+  return stats;
+}
+
+std::string CheckAllocations(const AllocationScope& scope,
+                             const char* statement, int64_t max_count) {
+  // Reads the counts before making the message allocates.
+  const AllocationStats stats = scope.Stats();
+  if (!scope.counting()) {
+    return std::string("Expected: ") + statement + " allocates at most " +
+           StreamableToString(max_count) +
+           " times.\n  Actual: the allocations are not counted; link the "
+           "test program with gtest_alloc.";
+  }
+  if (stats.count <= max_count) return std::string();
+  return std::string("Expected: ") + statement + " allocates at most " +
+         StreamableToString(max_count) + " times.\n  Actual: it allocates " +
+         StreamableToString(stats.count) + " times, " +
+         StreamableToString(stats.bytes) + " bytes in total.";
+}
+
+}  // namespace internal
+
 // class TestInfo
 
 // Constructs a TestInfo object. It assumes ownership of the test factory
@@ -2854,12 +3597,31 @@ TestInfo* MakeAndRegisterTestInfo(
     TypeId fixture_class_id, SetUpTestSuiteFunc set_up_tc,
     TearDownTestSuiteFunc tear_down_tc, TestFactoryBase* factory) {
   TestInfo* const test_info =
-      new TestInfo(std::move(test_suite_name), name, type_param, value_param,
+      MakeTestInfo(std::move(test_suite_name), name, type_param, value_param,
                    std::move(code_location), fixture_class_id, factory);
   GetUnitTestImpl()->AddTestInfo(set_up_tc, tear_down_tc, test_info);
   return test_info;
 }
 
+// Creates a new TestInfo object without registering it.
+TestInfo* MakeTestInfo(std::string test_suite_name, const char* name,
+                       const char* type_param, const char* value_param,
+                       CodeLocation code_location, TypeId fixture_class_id,
+                       TestFactoryBase* factory) {
+  return new TestInfo(std::move(test_suite_name), name, type_param,
+                      value_param, std::move(code_location), fixture_class_id,
+                      factory);
+}
+
+// Registers a group of tests whose TestInfo objects are created on demand.
+void RegisterDeferredTests(std::string test_suite_name,
+                           SetUpTestSuiteFunc set_up_tc,
+                           TearDownTestSuiteFunc tear_down_tc,
+                           DeferredTestGroup* group) {
+  GetUnitTestImpl()->AddDeferredTests(test_suite_name, set_up_tc,
+                                      tear_down_tc, group);
+}
+
 void ReportInvalidTestSuiteType(const char* test_suite_name,
                                 const CodeLocation& code_location) {
   Message errors;
@@ -2894,7 +3656,7 @@ void UnitTestImpl::RegisterParameterizedTests() {
 // Creates the test object, runs it, records its result, and then
 // deletes it.
 void TestInfo::Run() {
-  TestEventListener* repeater = UnitTest::GetInstance()->listeners().repeater();
+  TestEventListener* repeater = internal::GetUnitTestImpl()->current_repeater();
   if (!should_run_) {
     if (is_disabled_ && matches_filter_) repeater->OnTestDisabled(*this);
     return;
@@ -2904,15 +3666,35 @@ void TestInfo::Run() {
   UnitTest::GetInstance()->set_current_test_info(this);
 
   // Notifies the unit test event listeners that a test is about to start.
-  repeater->OnTestStart(*this);
-  result_.set_start_timestamp(internal::GetTimeInMillis());
+  {
+    const internal::TestEventLock lock;
+    repeater->OnTestStart(*this);
+    result_.set_start_timestamp(internal::GetTimeInMillis());
+  }
+
+  // A test that passed in a previous run (see --gtest_cache_dir) is only
+  // reported.
+  if (result_.Cached()) {
+    repeater->OnTestEnd(*this);
+    UnitTest::GetInstance()->set_current_test_info(nullptr);
+    return;
+  }
+
+  internal::UnitTestImpl* const impl = internal::GetUnitTestImpl();
+  if (GTEST_FLAG_GET(test_timeout) > 0) {
+    impl->SetTestTimeout(this, GTEST_FLAG_GET(test_timeout));
+  }
   internal::Timer timer;
+  const internal::ResourceMeter resource_meter;
   UnitTest::GetInstance()->UponLeavingGTest();
 
   // Creates the test object.
+  internal::Timer constructor_timer;
   Test* const test = internal::HandleExceptionsInMethodIfSupported(
       factory_, &internal::TestFactoryBase::CreateTest,
       "the test fixture's constructor");
+  internal::SetPhaseNanos(&result_.phase_times_.constructor_nanos,
+                          constructor_timer.ElapsedNanos());
 
   // Runs the test if the constructor didn't generate a fatal failure or invoke
   // GTEST_SKIP().
@@ -2926,11 +3708,25 @@ void TestInfo::Run() {
   if (test != nullptr) {
     // Deletes the test object.
     UnitTest::GetInstance()->UponLeavingGTest();
+    internal::Timer destructor_timer;
     internal::HandleExceptionsInMethodIfSupported(
         test, &Test::DeleteSelf_, "the test fixture's destructor");
+    internal::SetPhaseNanos(&result_.phase_times_.destructor_nanos,
+                            destructor_timer.ElapsedNanos());
   }
+  const int64_t elapsed_nanos = timer.ElapsedNanos();
+  ResourceUsage resource_usage;
+  const bool measured = resource_meter.Measure(&resource_usage);
+  // Stops the watchdog before taking the lock it takes to report a timeout.
+  impl->ClearTestTimeout(this);
+
+  const internal::TestEventLock lock;
+  // The phases are always timed, which costs little, but only reported when
+  // asked for.
+  result_.has_phase_times_ = GTEST_FLAG_GET(print_phase_times);
 
-  result_.set_elapsed_time(timer.Elapsed());
+  result_.set_elapsed_time_nanos(elapsed_nanos);
+  if (measured) result_.set_resource_usage(resource_usage);
 
   // Notifies the unit test event listener that a test has just finished.
   repeater->OnTestEnd(*this);
@@ -2946,7 +3742,7 @@ void TestInfo::Skip() {
 
   UnitTest::GetInstance()->set_current_test_info(this);
 
-  TestEventListener* repeater = UnitTest::GetInstance()->listeners().repeater();
+  TestEventListener* repeater = internal::GetUnitTestImpl()->current_repeater();
 
   // Notifies the unit test event listeners that a test is about to start.
   repeater->OnTestStart(*this);
@@ -2974,6 +3770,11 @@ int TestSuite::skipped_test_count() const {
   return CountIf(test_info_list_, TestSkipped);
 }
 
+// Gets the number of tests in this test suite whose result was cached.
+int TestSuite::cached_test_count() const {
+  return CountIf(test_info_list_, TestCached);
+}
+
 // Gets the number of failed tests in this test suite.
 int TestSuite::failed_test_count() const {
   return CountIf(test_info_list_, TestFailed);
@@ -3022,7 +3823,10 @@ TestSuite::TestSuite(const std::string& a_name, const char* a_type_param,
       tear_down_tc_(tear_down_tc),
       should_run_(false),
       start_timestamp_(0),
-      elapsed_time_(0) {}
+      elapsed_time_nanos_(0),
+      has_phase_times_(false),
+      set_up_test_suite_nanos_(0),
+      tear_down_test_suite_nanos_(0) {}
 
 // Destructor of TestSuite.
 TestSuite::~TestSuite() {
@@ -3051,13 +3855,53 @@ void TestSuite::AddTestInfo(TestInfo* test_info) {
   test_indices_.push_back(static_cast<int>(test_indices_.size()));
 }
 
+// Adds a group of tests whose TestInfo objects are created on demand.
+void TestSuite::AddDeferredTests(internal::DeferredTestGroup* group) {
+  size_t position = test_info_list_.size();
+  for (const DeferredTests& deferred : deferred_tests_) {
+    position -= deferred.test_infos.size();
+  }
+  deferred_tests_.push_back(
+      {position, std::unique_ptr<internal::DeferredTestGroup>(group), {}});
+}
+
+// Gets the number of deferred tests whose TestInfo objects have not been
+// created.
+int TestSuite::uncreated_test_count() const {
+  size_t count = 0;
+  for (const DeferredTests& deferred : deferred_tests_) {
+    count += deferred.group->size() - deferred.test_infos.size();
+  }
+  return static_cast<int>(count);
+}
+
+// Visits the tests of this test suite in registration order.  The created
+// TestInfo objects of each group directly follow the tests added with
+// AddTestInfo() before the group in test_info_list_.
+void TestSuite::ForEachTest(
+    const std::function<void(TestInfo*)>& on_test_info,
+    const std::function<void(DeferredTests&)>& on_deferred_tests) {
+  size_t list_index = 0;
+  size_t added_count = 0;
+  for (DeferredTests& deferred : deferred_tests_) {
+    for (; added_count < deferred.position; ++added_count) {
+      on_test_info(test_info_list_[list_index++]);
+    }
+    list_index += deferred.test_infos.size();
+    on_deferred_tests(deferred);
+  }
+  for (; list_index < test_info_list_.size(); ++list_index) {
+    on_test_info(test_info_list_[list_index]);
+  }
+}
+
 // Runs every test in this TestSuite.
 void TestSuite::Run() {
   if (!should_run_) return;
 
   UnitTest::GetInstance()->set_current_test_suite(this);
 
-  TestEventListener* repeater = UnitTest::GetInstance()->listeners().repeater();
+  TestEventListener* repeater = internal::GetUnitTestImpl()->current_repeater();
 
   // Ensure our tests are in a deterministic order.
   //
@@ -3085,9 +3929,18 @@ void TestSuite::Run() {
   repeater->OnTestCaseStart(*this);
 #endif  //  GTEST_REMOVE_LEGACY_TEST_CASEAPI_
 
-  UnitTest::GetInstance()->UponLeavingGTest();
-  internal::HandleExceptionsInMethodIfSupported(
-      this, &TestSuite::RunSetUpTestSuite, "SetUpTestSuite()");
+  // There is no need to set up the test suite if the results of all its
+  // tests are cached.
+  const bool all_cached = cached_test_count() == test_to_run_count();
+
+  has_phase_times_ = GTEST_FLAG_GET(print_phase_times);
+  if (!all_cached) {
+    UnitTest::GetInstance()->UponLeavingGTest();
+    internal::Timer set_up_timer;
+    internal::HandleExceptionsInMethodIfSupported(
+        this, &TestSuite::RunSetUpTestSuite, "SetUpTestSuite()");
+    set_up_test_suite_nanos_ = set_up_timer.ElapsedNanos();
+  }
 
   const bool skip_all =
       ad_hoc_test_result().Failed() || ad_hoc_test_result().Skipped();
@@ -3108,11 +3961,15 @@ void TestSuite::Run() {
       break;
     }
   }
-  elapsed_time_ = timer.Elapsed();
+  elapsed_time_nanos_ = timer.ElapsedNanos();
 
-  UnitTest::GetInstance()->UponLeavingGTest();
-  internal::HandleExceptionsInMethodIfSupported(
-      this, &TestSuite::RunTearDownTestSuite, "TearDownTestSuite()");
+  if (!all_cached) {
+    UnitTest::GetInstance()->UponLeavingGTest();
+    internal::Timer tear_down_timer;
+    internal::HandleExceptionsInMethodIfSupported(
+        this, &TestSuite::RunTearDownTestSuite, "TearDownTestSuite()");
+    tear_down_test_suite_nanos_ = tear_down_timer.ElapsedNanos();
+  }
 
   // Call both legacy and the new API
   repeater->OnTestSuiteEnd(*this);
@@ -3130,7 +3987,7 @@ void TestSuite::Skip() {
 
   UnitTest::GetInstance()->set_current_test_suite(this);
 
-  TestEventListener* repeater = UnitTest::GetInstance()->listeners().repeater();
+  TestEventListener* repeater = internal::GetUnitTestImpl()->current_repeater();
 
   // Call both legacy and the new API
   repeater->OnTestSuiteStart(*this);
@@ -3156,6 +4013,9 @@ void TestSuite::Skip() {
 // Clears the results of all tests in this test suite.
 void TestSuite::ClearResult() {
   ad_hoc_test_result_.Clear();
+  has_phase_times_ = false;
+  set_up_test_suite_nanos_ = 0;
+  tear_down_test_suite_nanos_ = 0;
   ForEach(test_info_list_, TestInfo::ClearTestResult);
 }
 
@@ -3220,6 +4080,220 @@ namespace {
 enum class GTestColor { kDefault, kRed, kGreen, kYellow };
 }  // namespace
 
+// When --gtest_output_buffering is in effect, the text printers keep their
+// output in a buffer of their own instead of flushing stdout after every
+// event.  They write it out before test code runs, which may print to stdout
+// itself, when a test fails, at the end of each iteration, at most once every
+// kConsoleOutputFlushIntervalMillis milliseconds, and when the program is
+// killed by a signal.
+
+// How often buffered text output is written out while tests pass.
+constexpr TimeInMillis kConsoleOutputFlushIntervalMillis = 1000;
+
+// The time at which buffered text output was last written out, or -1 when
+// the output is not buffered.
+static std::atomic<TimeInMillis> g_last_console_output_flush(-1);
+
+// The buffer of the text output, its size, and the length of the text it
+// holds.  The buffer is null when the output is not buffered.
+static char* g_console_output_buffer = nullptr;
+static size_t g_console_output_buffer_size = 0;
+static std::atomic<size_t> g_console_output_length(0);
+
+// The file descriptor of stdout, to which the signal handler writes.
+static int g_console_output_fd = -1;
+
+// Writes out the text output.
+static void FlushConsoleOutput() {
+  const TestEventLock lock;
+  const size_t length = g_console_output_length.load();
+  if (length > 0) {
+    fwrite(g_console_output_buffer, 1, length, stdout);
+    g_console_output_length.store(0);
+  }
+  fflush(stdout);
+  if (g_last_console_output_flush.load() >= 0) {
+    g_last_console_output_flush.store(GetTimeInMillis());
+  }
+}
+
+// Prints text output, into the buffer when it is buffered.  Text that does
+// not fit in the buffer is printed to stdout once the buffer is written out.
+static void ConsoleVPrintf(const char* fmt, va_list args) {
+  if (g_console_output_buffer == nullptr) {
+    vprintf(fmt, args);
+    return;
+  }
+
+  const TestEventLock lock;
+  const size_t length = g_console_output_length.load();
+  va_list args_copy;
+  va_copy(args_copy, args);
+  const int size = vsnprintf(g_console_output_buffer + length,
+                             g_console_output_buffer_size - length, fmt,
+                             args_copy);
+  va_end(args_copy);
+  if (size < 0) return;
+  // vsnprintf() needs room for the terminating NUL.
+  if (static_cast<size_t>(size) < g_console_output_buffer_size - length) {
+    g_console_output_length.store(length + static_cast<size_t>(size));
+    return;
+  }
+
+  FlushConsoleOutput();
+  if (static_cast<size_t>(size) < g_console_output_buffer_size) {
+    vsnprintf(g_console_output_buffer, g_console_output_buffer_size, fmt,
+              args);
+    g_console_output_length.store(static_cast<size_t>(size));
+  } else {
+    vprintf(fmt, args);
+  }
+}
+
+GTEST_ATTRIBUTE_PRINTF_(1, 2)
+static void ConsolePrintf(const char* fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  ConsoleVPrintf(fmt, args);
+  va_end(args);
+}
+
+// Writes out the text output after an event, unless it is buffered and was
+// written out recently.
+static void MaybeFlushConsoleOutput() {
+  const TimeInMillis last_flush = g_last_console_output_flush.load();
+  if (last_flush < 0 ||
+      GetTimeInMillis() - last_flush >= kConsoleOutputFlushIntervalMillis) {
+    FlushConsoleOutput();
+  }
+}
+
+// Delivers the events queued for the async-safe listeners from the handler
+// of the given signal.  Defined with TestEventRepeater.
+static void FlushAsyncTestEventsOnSignal(int signal_number);
+
+// The signals ending the program on which the queued events are still
+// delivered and the buffered text output written out, with the dispositions
+// they had before.
+static struct {
+  int number;
+#ifdef GTEST_OS_WINDOWS
+  void (*previous_handler)(int);
+#else
+  struct sigaction previous_action;
+#endif  // GTEST_OS_WINDOWS
+} g_fatal_signals[] = {
+    {SIGABRT, {}}, {SIGFPE, {}},  {SIGILL, {}},
+    {SIGINT, {}},  {SIGSEGV, {}}, {SIGTERM, {}},
+#ifdef SIGBUS
+    {SIGBUS, {}},
+#endif
+#ifdef SIGHUP
+    {SIGHUP, {}},
+#endif
+};
+
+// Writes out the buffered text output from a signal handler.  It cannot use
+// stdio, which is not async-signal-safe and would deadlock if the signal
+// interrupted it, so it writes the buffer with write(), and empties it.
+static void WriteConsoleOutputOnSignal() {
+#if !defined(GTEST_OS_WINDOWS_MOBILE) && !defined(GTEST_OS_QURT)
+  const size_t length = g_console_output_length.load();
+  for (size_t written = 0; written < length;) {
+    const int result =
+        posix::Write(g_console_output_fd, g_console_output_buffer + written,
+                     static_cast<unsigned int>(length - written));
+    if (result <= 0) break;
+    written += static_cast<size_t>(result);
+  }
+  g_console_output_length.store(0);
+#endif  // !GTEST_OS_WINDOWS_MOBILE && !GTEST_OS_QURT
+}
+
+// Delivers the queued events and writes out the buffered text output, then
+// raises the signal again with the disposition it had before, which ends the
+// program.  Delivering the events is not async-signal-safe, but the program
+// is about to end, and losing the results of the test that crashed is worse
+// than the small risk of garbling them.
+static void HandleFatalSignal(int signal_number) {
+  FlushAsyncTestEventsOnSignal(signal_number);
+  WriteConsoleOutputOnSignal();
+  for (const auto& entry : g_fatal_signals) {
+    if (entry.number == signal_number) {
+#ifdef GTEST_OS_WINDOWS
+      std::signal(signal_number, entry.previous_handler);
+#else
+      sigaction(signal_number, &entry.previous_action, nullptr);
+#endif  // GTEST_OS_WINDOWS
+    }
+  }
+  std::raise(signal_number);
+}
+
+// Installs HandleFatalSignal() for the fatal signals, unless already done.
+// The signals the program ignores or handles itself, for instance with the
+// handler of a crash reporter or a sanitizer, are left alone.
+static void InstallFatalSignalHandlers() {
+  static bool installed = false;
+  if (installed) return;
+  installed = true;
+
+  for (auto& entry : g_fatal_signals) {
+#ifdef GTEST_OS_WINDOWS
+    const auto previous_handler =
+        std::signal(entry.number, &HandleFatalSignal);
+    if (previous_handler != SIG_DFL && previous_handler != SIG_ERR) {
+      std::signal(entry.number, previous_handler);
+    }
+    entry.previous_handler = SIG_DFL;
+#else
+    if (sigaction(entry.number, nullptr, &entry.previous_action) != 0 ||
+        (entry.previous_action.sa_flags & SA_SIGINFO) != 0 ||
+        entry.previous_action.sa_handler != SIG_DFL) {
+      continue;
+    }
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = &HandleFatalSignal;
+    sigaction(entry.number, &action, nullptr);
+#endif  // GTEST_OS_WINDOWS
+  }
+}
+
+#ifndef GTEST_OS_WINDOWS
+// The process that buffers the text output.  The children it forks for death
+// tests share the buffer, which they must not write out again.
+static pid_t g_console_output_pid = -1;
+#endif  // GTEST_OS_WINDOWS
+
+// Writes out the buffered text output when the program exits, for instance
+// because a test called exit().
+static void FlushConsoleOutputAtExit() {
+#ifndef GTEST_OS_WINDOWS
+  if (getpid() != g_console_output_pid) return;
+#endif  // GTEST_OS_WINDOWS
+  FlushConsoleOutput();
+}
+
+// Makes the text printers buffer up to size bytes of text output, per
+// --gtest_output_buffering.  Does nothing if the output is already buffered.
+static void BufferConsoleOutput(int32_t size) {
+  if (size <= 0 || g_console_output_buffer != nullptr) return;
+
+  fflush(stdout);
+  // Intentionally leaked: the text output is buffered until the program exits.
+  g_console_output_buffer = new char[static_cast<size_t>(size)];
+  g_console_output_buffer_size = static_cast<size_t>(size);
+  g_console_output_fd = posix::FileNo(stdout);
+#ifndef GTEST_OS_WINDOWS
+  g_console_output_pid = getpid();
+#endif  // GTEST_OS_WINDOWS
+  g_last_console_output_flush.store(GetTimeInMillis());
+  atexit(&FlushConsoleOutputAtExit);
+  InstallFatalSignalHandlers();
+}
+
 // Prints a TestPartResult to an std::string.
 static std::string PrintTestPartResultToString(
     const TestPartResult& test_part_result) {
@@ -3235,8 +4309,8 @@ static std::string PrintTestPartResultToString(
 // Prints a TestPartResult.
 static void PrintTestPartResult(const TestPartResult& test_part_result) {
   const std::string& result = PrintTestPartResultToString(test_part_result);
-  printf("%s\n", result.c_str());
-  fflush(stdout);
+  ConsolePrintf("%s\n", result.c_str());
+  FlushConsoleOutput();
   // If the test program runs in Visual Studio or a debugger, the
   // following statements add the test part result message to the Output
   // window such that the user can double-click on it to jump to the
@@ -3376,7 +4450,7 @@ static void ColoredPrintf(GTestColor color, const char* fmt, ...) {
   const bool use_color = in_color_mode && (color != GTestColor::kDefault);
 
   if (!use_color) {
-    vprintf(fmt, args);
+    ConsoleVPrintf(fmt, args);
     va_end(args);
     return;
   }
@@ -3395,7 +4469,7 @@ static void ColoredPrintf(GTestColor color, const char* fmt, ...) {
   // We need to flush the stream buffers into the console before each
   // SetConsoleTextAttribute call lest it affect the text that is already
   // printed but has not yet reached the console.
-  fflush(stdout);
+  FlushConsoleOutput();
   SetConsoleTextAttribute(stdout_handle, new_color);
 
   vprintf(fmt, args);
@@ -3404,9 +4478,9 @@ static void ColoredPrintf(GTestColor color, const char* fmt, ...) {
   // Restores the text color.
   SetConsoleTextAttribute(stdout_handle, old_color_attrs);
 #else
-  printf("\033[0;3%sm", GetAnsiColorCode(color));
-  vprintf(fmt, args);
-  printf("\033[m");  // Resets the terminal to default.
+  ConsolePrintf("\033[0;3%sm", GetAnsiColorCode(color));
+  ConsoleVPrintf(fmt, args);
+  ConsolePrintf("\033[m");  // Resets the terminal to default.
 #endif  // GTEST_OS_WINDOWS && !GTEST_OS_WINDOWS_MOBILE
   va_end(args);
 }
@@ -3421,13 +4495,13 @@ static void PrintFullTestCommentIfPresent(const TestInfo& test_info) {
   const char* const value_param = test_info.value_param();
 
   if (type_param != nullptr || value_param != nullptr) {
-    printf(", where ");
+    ConsolePrintf(", where ");
     if (type_param != nullptr) {
-      printf("%s = %s", kTypeParamLabel, type_param);
-      if (value_param != nullptr) printf(" and ");
+      ConsolePrintf("%s = %s", kTypeParamLabel, type_param);
+      if (value_param != nullptr) ConsolePrintf(" and ");
     }
     if (value_param != nullptr) {
-      printf("%s = %s", kValueParamLabel, value_param);
+      ConsolePrintf("%s = %s", kValueParamLabel, value_param);
     }
   }
 }
@@ -3439,7 +4513,7 @@ class PrettyUnitTestResultPrinter : public TestEventListener {
  public:
   PrettyUnitTestResultPrinter() = default;
   static void PrintTestName(const char* test_suite, const char* test) {
-    printf("%s.%s", test_suite, test);
+    ConsolePrintf("%s.%s", test_suite, test);
   }
 
   // The following methods override what's in the TestEventListener class.
@@ -3470,16 +4544,32 @@ class PrettyUnitTestResultPrinter : public TestEventListener {
   void OnTestProgramEnd(const UnitTest& /*unit_test*/) override {}
 
  private:
+  static const TestInfo* FindLastTestToRun(const TestSuite& test_suite);
   static void PrintFailedTests(const UnitTest& unit_test);
   static void PrintFailedTestSuites(const UnitTest& unit_test);
   static void PrintSkippedTests(const UnitTest& unit_test);
+
+  // The last test to run in the current test suite, after which
+  // TearDownTestSuite() runs.
+  const TestInfo* last_test_to_run_ = nullptr;
 };
 
+// Returns the last test to run in the given test suite, or nullptr if none.
+const TestInfo* PrettyUnitTestResultPrinter::FindLastTestToRun(
+    const TestSuite& test_suite) {
+  for (int i = test_suite.total_test_count() - 1; i >= 0; --i) {
+    const TestInfo* const test_info = test_suite.GetTestInfo(i);
+    if (test_info->should_run()) return test_info;
+  }
+  return nullptr;
+}
+
 // Fired before each iteration of tests starts.
 void PrettyUnitTestResultPrinter::OnTestIterationStart(
     const UnitTest& unit_test, int iteration) {
   if (GTEST_FLAG_GET(repeat) != 1)
-    printf("\nRepeating all tests (iteration %d) . . .\n\n", iteration + 1);
+    ConsolePrintf("\nRepeating all tests (iteration %d) . . .\n\n",
+                  iteration + 1);
 
   std::string f = GTEST_FLAG_GET(filter);
   const char* const filter = f.c_str();
@@ -3505,17 +4595,18 @@ void PrettyUnitTestResultPrinter::OnTestIterationStart(
   }
 
   ColoredPrintf(GTestColor::kGreen, "[==========] ");
-  printf("Running %s from %s.\n",
-         FormatTestCount(unit_test.test_to_run_count()).c_str(),
-         FormatTestSuiteCount(unit_test.test_suite_to_run_count()).c_str());
-  fflush(stdout);
+  ConsolePrintf(
+      "Running %s from %s.\n",
+      FormatTestCount(unit_test.test_to_run_count()).c_str(),
+      FormatTestSuiteCount(unit_test.test_suite_to_run_count()).c_str());
+  MaybeFlushConsoleOutput();
 }
 
 void PrettyUnitTestResultPrinter::OnEnvironmentsSetUpStart(
     const UnitTest& /*unit_test*/) {
   ColoredPrintf(GTestColor::kGreen, "[----------] ");
-  printf("Global test environment set-up.\n");
-  fflush(stdout);
+  ConsolePrintf("Global test environment set-up.\n");
+  FlushConsoleOutput();
 }
 
 #ifndef GTEST_REMOVE_LEGACY_TEST_CASEAPI_
@@ -3523,13 +4614,14 @@ void PrettyUnitTestResultPrinter::OnTestCaseStart(const TestCase& test_case) {
   const std::string counts =
       FormatCountableNoun(test_case.test_to_run_count(), "test", "tests");
   ColoredPrintf(GTestColor::kGreen, "[----------] ");
-  printf("%s from %s", counts.c_str(), test_case.name());
+  ConsolePrintf("%s from %s", counts.c_str(), test_case.name());
   if (test_case.type_param() == nullptr) {
-    printf("\n");
+    ConsolePrintf("\n");
   } else {
-    printf(", where %s = %s\n", kTypeParamLabel, test_case.type_param());
+    ConsolePrintf(", where %s = %s\n", kTypeParamLabel, test_case.type_param());
   }
-  fflush(stdout);
+  last_test_to_run_ = FindLastTestToRun(test_case);
+  FlushConsoleOutput();
 }
 #else
 void PrettyUnitTestResultPrinter::OnTestSuiteStart(
@@ -3537,28 +4629,33 @@ void PrettyUnitTestResultPrinter::OnTestSuiteStart(
   const std::string counts =
       FormatCountableNoun(test_suite.test_to_run_count(), "test", "tests");
   ColoredPrintf(GTestColor::kGreen, "[----------] ");
-  printf("%s from %s", counts.c_str(), test_suite.name());
+  ConsolePrintf("%s from %s", counts.c_str(), test_suite.name());
   if (test_suite.type_param() == nullptr) {
-    printf("\n");
+    ConsolePrintf("\n");
   } else {
-    printf(", where %s = %s\n", kTypeParamLabel, test_suite.type_param());
+    ConsolePrintf(", where %s = %s\n", kTypeParamLabel,
+                  test_suite.type_param());
   }
-  fflush(stdout);
+  last_test_to_run_ = FindLastTestToRun(test_suite);
+  FlushConsoleOutput();
 }
 #endif  // GTEST_REMOVE_LEGACY_TEST_CASEAPI_
 
 void PrettyUnitTestResultPrinter::OnTestStart(const TestInfo& test_info) {
+  // Cached tests do not run; OnTestEnd() reports them.
+  if (test_info.result()->Cached()) return;
+
   ColoredPrintf(GTestColor::kGreen, "[ RUN      ] ");
   PrintTestName(test_info.test_suite_name(), test_info.name());
-  printf("\n");
-  fflush(stdout);
+  ConsolePrintf("\n");
+  FlushConsoleOutput();
 }
 
 void PrettyUnitTestResultPrinter::OnTestDisabled(const TestInfo& test_info) {
   ColoredPrintf(GTestColor::kYellow, "[ DISABLED ] ");
   PrintTestName(test_info.test_suite_name(), test_info.name());
-  printf("\n");
-  fflush(stdout);
+  ConsolePrintf("\n");
+  MaybeFlushConsoleOutput();
 }
 
 // Called after an assertion failure.
@@ -3572,12 +4669,61 @@ void PrettyUnitTestResultPrinter::OnTestPartResult(
       // Print failure message from the assertion
       // (e.g. expected this and got that).
       PrintTestPartResult(result);
-      fflush(stdout);
   }
 }
 
+// Formats a duration given in nanoseconds with the unit that best fits it,
+// e.g. "12.3 ns", "4.56 us", or "789 ms".
+static std::string FormatNanoseconds(double nanos) {
+  static const char* const kUnits[] = {"ns", "us", "ms", "s"};
+  size_t unit = 0;
+  while (unit + 1 < sizeof(kUnits) / sizeof(kUnits[0]) && nanos >= 1000) {
+    nanos /= 1000;
+    ++unit;
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.3g %s", nanos, kUnits[unit]);
+  return buffer;
+}
+
+// Prints the timing of a benchmark test, e.g. "mean 12.3 ns, median 12.2 ns,
+// stddev 0.4 ns (81300813 iterations/s, 10 samples of 4096)".
+static void PrintBenchmarkResult(const BenchmarkResult& result) {
+  char rate[32];
+  snprintf(rate, sizeof(rate),
+           result.iterations_per_second() >= 1000 ? "%.0f" : "%.3g",
+           result.iterations_per_second());
+  ColoredPrintf(GTestColor::kGreen, "[ BENCHMARK] ");
+  ConsolePrintf(
+      "mean %s, median %s, stddev %s (%s iterations/s, %s of %s)\n",
+      FormatNanoseconds(result.mean_ns()).c_str(),
+      FormatNanoseconds(result.median_ns()).c_str(),
+      FormatNanoseconds(result.stddev_ns()).c_str(), rate,
+      FormatCountableNoun(result.samples(), "sample", "samples").c_str(),
+      internal::StreamableToString(result.iterations()).c_str());
+}
+
+// Prints the allocations a test made, if it made any.
+static void PrintAllocationStats(const AllocationStats& stats) {
+  if (stats.count == 0) return;
+  ColoredPrintf(GTestColor::kGreen, "[ ALLOCATED] ");
+  ConsolePrintf("%s %s, %s bytes, peak %s bytes\n",
+                internal::StreamableToString(stats.count).c_str(),
+                stats.count == 1 ? "allocation" : "allocations",
+                internal::StreamableToString(stats.bytes).c_str(),
+                internal::StreamableToString(stats.peak_bytes).c_str());
+}
+
 void PrettyUnitTestResultPrinter::OnTestEnd(const TestInfo& test_info) {
-  if (test_info.result()->Passed()) {
+  if (test_info.result()->HasBenchmarkResult()) {
+    PrintBenchmarkResult(test_info.result()->benchmark_result());
+  }
+  if (test_info.result()->HasAllocationStats()) {
+    PrintAllocationStats(test_info.result()->allocation_stats());
+  }
+  if (test_info.result()->Cached()) {
+    ColoredPrintf(GTestColor::kGreen, "[  CACHED  ] ");
+  } else if (test_info.result()->Passed()) {
     ColoredPrintf(GTestColor::kGreen, "[       OK ] ");
   } else if (test_info.result()->Skipped()) {
     ColoredPrintf(GTestColor::kGreen, "[  SKIPPED ] ");
@@ -3588,13 +4734,18 @@ void PrettyUnitTestResultPrinter::OnTestEnd(const TestInfo& test_info) {
   if (test_info.result()->Failed()) PrintFullTestCommentIfPresent(test_info);
 
   if (GTEST_FLAG_GET(print_time)) {
-    printf(" (%s ms)\n",
-           internal::StreamableToString(test_info.result()->elapsed_time())
-               .c_str());
+    ConsolePrintf(
+        " (%s ms)\n",
+        internal::StreamableToString(test_info.result()->elapsed_time())
+            .c_str());
   } else {
-    printf("\n");
+    ConsolePrintf("\n");
+  }
+  if (test_info.result()->Failed() || &test_info == last_test_to_run_) {
+    FlushConsoleOutput();
+  } else {
+    MaybeFlushConsoleOutput();
   }
-  fflush(stdout);
 }
 
 #ifndef GTEST_REMOVE_LEGACY_TEST_CASEAPI_
@@ -3604,9 +4755,10 @@ void PrettyUnitTestResultPrinter::OnTestCaseEnd(const TestCase& test_case) {
   const std::string counts =
       FormatCountableNoun(test_case.test_to_run_count(), "test", "tests");
   ColoredPrintf(GTestColor::kGreen, "[----------] ");
-  printf("%s from %s (%s ms total)\n\n", counts.c_str(), test_case.name(),
-         internal::StreamableToString(test_case.elapsed_time()).c_str());
-  fflush(stdout);
+  ConsolePrintf("%s from %s (%s ms total)\n\n", counts.c_str(),
+                test_case.name(),
+                internal::StreamableToString(test_case.elapsed_time()).c_str());
+  MaybeFlushConsoleOutput();
 }
 #else
 void PrettyUnitTestResultPrinter::OnTestSuiteEnd(const TestSuite& test_suite) {
@@ -3615,24 +4767,26 @@ void PrettyUnitTestResultPrinter::OnTestSuiteEnd(const TestSuite& test_suite) {
   const std::string counts =
       FormatCountableNoun(test_suite.test_to_run_count(), "test", "tests");
   ColoredPrintf(GTestColor::kGreen, "[----------] ");
-  printf("%s from %s (%s ms total)\n\n", counts.c_str(), test_suite.name(),
-         internal::StreamableToString(test_suite.elapsed_time()).c_str());
-  fflush(stdout);
+  ConsolePrintf(
+      "%s from %s (%s ms total)\n\n", counts.c_str(), test_suite.name(),
+      internal::StreamableToString(test_suite.elapsed_time()).c_str());
+  MaybeFlushConsoleOutput();
 }
 #endif  // GTEST_REMOVE_LEGACY_TEST_CASEAPI_
 
 void PrettyUnitTestResultPrinter::OnEnvironmentsTearDownStart(
     const UnitTest& /*unit_test*/) {
   ColoredPrintf(GTestColor::kGreen, "[----------] ");
-  printf("Global test environment tear-down\n");
-  fflush(stdout);
+  ConsolePrintf("Global test environment tear-down\n");
+  FlushConsoleOutput();
 }
 
 // Internal helper for printing the list of failed tests.
 void PrettyUnitTestResultPrinter::PrintFailedTests(const UnitTest& unit_test) {
   const int failed_test_count = unit_test.failed_test_count();
   ColoredPrintf(GTestColor::kRed, "[  FAILED  ] ");
-  printf("%s, listed below:\n", FormatTestCount(failed_test_count).c_str());
+  ConsolePrintf("%s, listed below:\n",
+                FormatTestCount(failed_test_count).c_str());
 
   for (int i = 0; i < unit_test.total_test_suite_count(); ++i) {
     const TestSuite& test_suite = *unit_test.GetTestSuite(i);
@@ -3645,13 +4799,13 @@ void PrettyUnitTestResultPrinter::PrintFailedTests(const UnitTest& unit_test) {
         continue;
       }
       ColoredPrintf(GTestColor::kRed, "[  FAILED  ] ");
-      printf("%s.%s", test_suite.name(), test_info.name());
+      ConsolePrintf("%s.%s", test_suite.name(), test_info.name());
       PrintFullTestCommentIfPresent(test_info);
-      printf("\n");
+      ConsolePrintf("\n");
     }
   }
-  printf("\n%2d FAILED %s\n", failed_test_count,
-         failed_test_count == 1 ? "TEST" : "TESTS");
+  ConsolePrintf("\n%2d FAILED %s\n", failed_test_count,
+                failed_test_count == 1 ? "TEST" : "TESTS");
 }
 
 // Internal helper for printing the list of test suite failures not covered by
@@ -3666,13 +4820,14 @@ void PrettyUnitTestResultPrinter::PrintFailedTestSuites(
     }
     if (test_suite.ad_hoc_test_result().Failed()) {
       ColoredPrintf(GTestColor::kRed, "[  FAILED  ] ");
-      printf("%s: SetUpTestSuite or TearDownTestSuite\n", test_suite.name());
+      ConsolePrintf("%s: SetUpTestSuite or TearDownTestSuite\n",
+                    test_suite.name());
       ++suite_failure_count;
     }
   }
   if (suite_failure_count > 0) {
-    printf("\n%2d FAILED TEST %s\n", suite_failure_count,
-           suite_failure_count == 1 ? "SUITE" : "SUITES");
+    ConsolePrintf("\n%2d FAILED TEST %s\n", suite_failure_count,
+                  suite_failure_count == 1 ? "SUITE" : "SUITES");
   }
 }
 
@@ -3694,30 +4849,174 @@ void PrettyUnitTestResultPrinter::PrintSkippedTests(const UnitTest& unit_test) {
         continue;
       }
       ColoredPrintf(GTestColor::kGreen, "[  SKIPPED ] ");
-      printf("%s.%s", test_suite.name(), test_info.name());
-      printf("\n");
+      ConsolePrintf("%s.%s", test_suite.name(), test_info.name());
+      ConsolePrintf("\n");
+    }
+  }
+}
+
+// The number of tests listed in each summary printed by
+// --gtest_print_resources and --gtest_print_phase_times.
+static const size_t kSummaryTestCount = 5;
+
+// Prints the tests that used the most CPU time and those that raised the peak
+// memory of the process the most (see --gtest_print_resources).
+static void PrintResourceSummary(const UnitTest& unit_test) {
+  using NamedUsage = std::pair<std::string, ResourceUsage>;
+  std::vector<NamedUsage> tests;
+  for (int i = 0; i < unit_test.total_test_suite_count(); ++i) {
+    const TestSuite& test_suite = *unit_test.GetTestSuite(i);
+    for (int j = 0; j < test_suite.total_test_count(); ++j) {
+      const TestInfo& test_info = *test_suite.GetTestInfo(j);
+      if (!test_info.should_run() || !test_info.result()->HasResourceUsage()) {
+        continue;
+      }
+      tests.emplace_back(
+          std::string(test_suite.name()) + "." + test_info.name(),
+          test_info.result()->resource_usage());
+    }
+  }
+  if (tests.empty()) return;
+
+  const auto cpu_time_us = [](const ResourceUsage& usage) {
+    return usage.user_cpu_time_us + usage.system_cpu_time_us;
+  };
+  const size_t count = std::min(tests.size(), kSummaryTestCount);
+  const auto end_of_list =
+      tests.begin() + static_cast<std::ptrdiff_t>(count);
+  std::partial_sort(tests.begin(), end_of_list, tests.end(),
+                    [&cpu_time_us](const NamedUsage& a, const NamedUsage& b) {
+                      return cpu_time_us(a.second) > cpu_time_us(b.second);
+                    });
+  ColoredPrintf(GTestColor::kGreen, "[ RESOURCES] ");
+  ConsolePrintf("The tests that used the most CPU time:\n");
+  for (size_t i = 0; i < count; ++i) {
+    const ResourceUsage& usage = tests[i].second;
+    ColoredPrintf(GTestColor::kGreen, "[ RESOURCES] ");
+    ConsolePrintf("  %s: %.1f ms (%.1f ms user, %.1f ms system)\n",
+                  tests[i].first.c_str(),
+                  static_cast<double>(cpu_time_us(usage)) / 1000,
+                  static_cast<double>(usage.user_cpu_time_us) / 1000,
+                  static_cast<double>(usage.system_cpu_time_us) / 1000);
+  }
+
+  std::partial_sort(tests.begin(), end_of_list, tests.end(),
+                    [](const NamedUsage& a, const NamedUsage& b) {
+                      return a.second.max_rss_growth_kb >
+                             b.second.max_rss_growth_kb;
+                    });
+  if (tests[0].second.max_rss_growth_kb <= 0) return;
+  ColoredPrintf(GTestColor::kGreen, "[ RESOURCES] ");
+  ConsolePrintf("The tests that raised the peak memory the most:\n");
+  for (size_t i = 0; i < count && tests[i].second.max_rss_growth_kb > 0; ++i) {
+    const ResourceUsage& usage = tests[i].second;
+    ColoredPrintf(GTestColor::kGreen, "[ RESOURCES] ");
+    ConsolePrintf("  %s: +%s KB, to %s KB\n", tests[i].first.c_str(),
+                  internal::StreamableToString(usage.max_rss_growth_kb).c_str(),
+                  internal::StreamableToString(usage.max_rss_kb).c_str());
+  }
+}
+
+// Prints the time spent in each phase of the tests over the iteration, and
+// the tests whose fixtures took the most time outside of the test body (see
+// --gtest_print_phase_times).
+static void PrintPhaseTimeSummary(const UnitTest& unit_test) {
+  if (!unit_test.HasPhaseTimes()) return;
+  TimeInNanos set_up_test_suite = 0;
+  TimeInNanos tear_down_test_suite = 0;
+  TestPhaseTimes totals;
+  using NamedTime = std::pair<std::string, TimeInNanos>;
+  std::vector<NamedTime> tests;
+  for (int i = 0; i < unit_test.total_test_suite_count(); ++i) {
+    const TestSuite& test_suite = *unit_test.GetTestSuite(i);
+    if (test_suite.HasPhaseTimes()) {
+      set_up_test_suite += test_suite.set_up_test_suite_nanos();
+      tear_down_test_suite += test_suite.tear_down_test_suite_nanos();
+    }
+    for (int j = 0; j < test_suite.total_test_count(); ++j) {
+      const TestInfo& test_info = *test_suite.GetTestInfo(j);
+      if (!test_info.should_run() || !test_info.result()->HasPhaseTimes()) {
+        continue;
+      }
+      const TestPhaseTimes& times = test_info.result()->phase_times();
+      totals.constructor_nanos += times.constructor_nanos;
+      totals.set_up_nanos += times.set_up_nanos;
+      totals.body_nanos += times.body_nanos;
+      totals.tear_down_nanos += times.tear_down_nanos;
+      totals.destructor_nanos += times.destructor_nanos;
+      tests.emplace_back(
+          std::string(test_suite.name()) + "." + test_info.name(),
+          times.constructor_nanos + times.set_up_nanos +
+              times.tear_down_nanos + times.destructor_nanos);
     }
   }
+
+  const std::pair<const char*, TimeInNanos> phases[] = {
+      {"environment set-up", unit_test.environments_set_up_nanos()},
+      {"SetUpTestSuite()", set_up_test_suite},
+      {"fixture constructors", totals.constructor_nanos},
+      {"SetUp()", totals.set_up_nanos},
+      {"test bodies", totals.body_nanos},
+      {"TearDown()", totals.tear_down_nanos},
+      {"fixture destructors", totals.destructor_nanos},
+      {"TearDownTestSuite()", tear_down_test_suite},
+      {"environment tear-down", unit_test.environments_tear_down_nanos()},
+  };
+  ColoredPrintf(GTestColor::kGreen, "[  PHASES  ] ");
+  ConsolePrintf("The time spent in each phase:\n");
+  for (const auto& phase : phases) {
+    ColoredPrintf(GTestColor::kGreen, "[  PHASES  ] ");
+    ConsolePrintf("  %s: %s\n", phase.first,
+                  FormatNanoseconds(static_cast<double>(phase.second)).c_str());
+  }
+
+  const size_t count = std::min(tests.size(), kSummaryTestCount);
+  const auto end_of_list = tests.begin() + static_cast<std::ptrdiff_t>(count);
+  std::partial_sort(tests.begin(), end_of_list, tests.end(),
+                    [](const NamedTime& a, const NamedTime& b) {
+                      return a.second > b.second;
+                    });
+  if (count == 0 || tests[0].second <= 0) return;
+  ColoredPrintf(GTestColor::kGreen, "[  PHASES  ] ");
+  ConsolePrintf("The tests whose fixtures took the most time:\n");
+  for (size_t i = 0; i < count && tests[i].second > 0; ++i) {
+    ColoredPrintf(GTestColor::kGreen, "[  PHASES  ] ");
+    ConsolePrintf(
+        "  %s: %s\n", tests[i].first.c_str(),
+        FormatNanoseconds(static_cast<double>(tests[i].second)).c_str());
+  }
 }
 
 void PrettyUnitTestResultPrinter::OnTestIterationEnd(const UnitTest& unit_test,
                                                      int /*iteration*/) {
+  if (GTEST_FLAG_GET(print_resources)) PrintResourceSummary(unit_test);
+  if (GTEST_FLAG_GET(print_phase_times)) PrintPhaseTimeSummary(unit_test);
   ColoredPrintf(GTestColor::kGreen, "[==========] ");
-  printf("%s from %s ran.",
-         FormatTestCount(unit_test.test_to_run_count()).c_str(),
-         FormatTestSuiteCount(unit_test.test_suite_to_run_count()).c_str());
+  ConsolePrintf(
+      "%s from %s ran.", FormatTestCount(unit_test.test_to_run_count()).c_str(),
+      FormatTestSuiteCount(unit_test.test_suite_to_run_count()).c_str());
   if (GTEST_FLAG_GET(print_time)) {
-    printf(" (%s ms total)",
-           internal::StreamableToString(unit_test.elapsed_time()).c_str());
+    ConsolePrintf(
+        " (%s ms total)",
+        internal::StreamableToString(unit_test.elapsed_time()).c_str());
   }
-  printf("\n");
+  ConsolePrintf("\n");
   ColoredPrintf(GTestColor::kGreen, "[  PASSED  ] ");
-  printf("%s.\n", FormatTestCount(unit_test.successful_test_count()).c_str());
+  ConsolePrintf("%s.\n",
+                FormatTestCount(unit_test.successful_test_count()).c_str());
+
+  const int cached_test_count = unit_test.cached_test_count();
+  if (cached_test_count > 0) {
+    ColoredPrintf(GTestColor::kGreen, "[  CACHED  ] ");
+    ConsolePrintf("%s passed in a previous run.\n",
+                  FormatTestCount(cached_test_count).c_str());
+  }
 
   const int skipped_test_count = unit_test.skipped_test_count();
   if (skipped_test_count > 0) {
     ColoredPrintf(GTestColor::kGreen, "[  SKIPPED ] ");
-    printf("%s, listed below:\n", FormatTestCount(skipped_test_count).c_str());
+    ConsolePrintf("%s, listed below:\n",
+                  FormatTestCount(skipped_test_count).c_str());
     PrintSkippedTests(unit_test);
   }
 
@@ -3729,13 +5028,13 @@ void PrettyUnitTestResultPrinter::OnTestIterationEnd(const UnitTest& unit_test,
   int num_disabled = unit_test.reportable_disabled_test_count();
   if (num_disabled && !GTEST_FLAG_GET(also_run_disabled_tests)) {
     if (unit_test.Passed()) {
-      printf("\n");  // Add a spacer if no FAILURE banner is displayed.
+      ConsolePrintf("\n");  // Add a spacer if no FAILURE banner is displayed.
     }
     ColoredPrintf(GTestColor::kYellow, "  YOU HAVE %d DISABLED %s\n\n",
                   num_disabled, num_disabled == 1 ? "TEST" : "TESTS");
   }
   // Ensure that Google Test output is printed before, e.g., heapchecker output.
-  fflush(stdout);
+  FlushConsoleOutput();
 }
 
 // End PrettyUnitTestResultPrinter
@@ -3747,7 +5046,7 @@ class BriefUnitTestResultPrinter : public TestEventListener {
  public:
   BriefUnitTestResultPrinter() = default;
   static void PrintTestName(const char* test_suite, const char* test) {
-    printf("%s.%s", test_suite, test);
+    ConsolePrintf("%s.%s", test_suite, test);
   }
 
   // The following methods override what's in the TestEventListener class.
@@ -3790,7 +5089,6 @@ void BriefUnitTestResultPrinter::OnTestPartResult(
       // Print failure message from the assertion
       // (e.g. expected this and got that).
       PrintTestPartResult(result);
-      fflush(stdout);
   }
 }
 
@@ -3801,50 +5099,177 @@ void BriefUnitTestResultPrinter::OnTestEnd(const TestInfo& test_info) {
     PrintFullTestCommentIfPresent(test_info);
 
     if (GTEST_FLAG_GET(print_time)) {
-      printf(" (%s ms)\n",
-             internal::StreamableToString(test_info.result()->elapsed_time())
-                 .c_str());
+      ConsolePrintf(
+          " (%s ms)\n",
+          internal::StreamableToString(test_info.result()->elapsed_time())
+              .c_str());
     } else {
-      printf("\n");
+      ConsolePrintf("\n");
     }
-    fflush(stdout);
+    FlushConsoleOutput();
   }
 }
 
 void BriefUnitTestResultPrinter::OnTestIterationEnd(const UnitTest& unit_test,
                                                     int /*iteration*/) {
+  if (GTEST_FLAG_GET(print_resources)) PrintResourceSummary(unit_test);
+  if (GTEST_FLAG_GET(print_phase_times)) PrintPhaseTimeSummary(unit_test);
   ColoredPrintf(GTestColor::kGreen, "[==========] ");
-  printf("%s from %s ran.",
-         FormatTestCount(unit_test.test_to_run_count()).c_str(),
-         FormatTestSuiteCount(unit_test.test_suite_to_run_count()).c_str());
+  ConsolePrintf(
+      "%s from %s ran.", FormatTestCount(unit_test.test_to_run_count()).c_str(),
+      FormatTestSuiteCount(unit_test.test_suite_to_run_count()).c_str());
   if (GTEST_FLAG_GET(print_time)) {
-    printf(" (%s ms total)",
-           internal::StreamableToString(unit_test.elapsed_time()).c_str());
+    ConsolePrintf(
+        " (%s ms total)",
+        internal::StreamableToString(unit_test.elapsed_time()).c_str());
   }
-  printf("\n");
+  ConsolePrintf("\n");
   ColoredPrintf(GTestColor::kGreen, "[  PASSED  ] ");
-  printf("%s.\n", FormatTestCount(unit_test.successful_test_count()).c_str());
+  ConsolePrintf("%s.\n",
+                FormatTestCount(unit_test.successful_test_count()).c_str());
+
+  const int cached_test_count = unit_test.cached_test_count();
+  if (cached_test_count > 0) {
+    ColoredPrintf(GTestColor::kGreen, "[  CACHED  ] ");
+    ConsolePrintf("%s passed in a previous run.\n",
+                  FormatTestCount(cached_test_count).c_str());
+  }
 
   const int skipped_test_count = unit_test.skipped_test_count();
   if (skipped_test_count > 0) {
     ColoredPrintf(GTestColor::kGreen, "[  SKIPPED ] ");
-    printf("%s.\n", FormatTestCount(skipped_test_count).c_str());
+    ConsolePrintf("%s.\n", FormatTestCount(skipped_test_count).c_str());
   }
 
   int num_disabled = unit_test.reportable_disabled_test_count();
   if (num_disabled && !GTEST_FLAG_GET(also_run_disabled_tests)) {
     if (unit_test.Passed()) {
-      printf("\n");  // Add a spacer if no FAILURE banner is displayed.
+      ConsolePrintf("\n");  // Add a spacer if no FAILURE banner is displayed.
     }
     ColoredPrintf(GTestColor::kYellow, "  YOU HAVE %d DISABLED %s\n\n",
                   num_disabled, num_disabled == 1 ? "TEST" : "TESTS");
   }
   // Ensure that Google Test output is printed before, e.g., heapchecker output.
-  fflush(stdout);
+  FlushConsoleOutput();
 }
 
 // End BriefUnitTestResultPrinter
 
+#ifdef GTEST_IS_THREADSAFE
+// How long a signal asking the program to end waits for the queued events to
+// be delivered.
+constexpr int kAsyncTestEventFlushTimeoutMillis = 5000;
+
+// Delivers events to listeners on a thread of its own, in the order in which
+// they are posted (--gtest_async_listeners).
+class AsyncTestEventQueue {
+ public:
+  AsyncTestEventQueue() : thread_(&AsyncTestEventQueue::DeliverEvents, this) {}
+
+  ~AsyncTestEventQueue() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    changed_.notify_all();
+    thread_.join();
+  }
+
+  // Queues an event, which calls the listener it is meant for.
+  void Post(std::function<void()> event) {
+    bool was_empty;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      was_empty = events_.empty();
+      events_.push_back(std::move(event));
+      posted_count_.fetch_add(1);
+    }
+    if (was_empty) changed_.notify_all();
+  }
+
+  // Waits until all the events posted so far have been delivered.
+  void Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const uint64_t posted_count = posted_count_.load();
+    changed_.wait(lock, [this, posted_count] {
+      return delivered_count_.load() >= posted_count;
+    });
+  }
+
+  // Like Flush(), but without locking, for signal handlers, and giving up
+  // after kAsyncTestEventFlushTimeoutMillis.  Returns at once when the signal
+  // is raised by a listener, whose events will then never be delivered.
+  void FlushOnSignal() {
+    if (std::this_thread::get_id() == thread_.get_id()) return;
+    const uint64_t posted_count = posted_count_.load();
+    for (int i = 0; i < kAsyncTestEventFlushTimeoutMillis &&
+                    delivered_count_.load() < posted_count;
+         i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+ private:
+  void DeliverEvents() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      changed_.wait(lock, [this] { return stopping_ || !events_.empty(); });
+      if (events_.empty()) return;
+      const std::function<void()> event = std::move(events_.front());
+      events_.pop_front();
+      lock.unlock();
+      event();
+      lock.lock();
+      delivered_count_.fetch_add(1);
+      changed_.notify_all();
+    }
+  }
+
+  std::mutex mutex_;
+  // Signaled when an event is posted or delivered, and when stopping.
+  std::condition_variable changed_;
+  std::deque<std::function<void()>> events_;
+  bool stopping_ = false;
+  // Read without locking by FlushOnSignal().
+  std::atomic<uint64_t> posted_count_{0};
+  std::atomic<uint64_t> delivered_count_{0};
+  // Last, so that it starts after the other members are initialized.
+  std::thread thread_;
+};
+
+// The queue of the events for the async-safe listeners of the process, or
+// null when they are called synchronously.
+static std::atomic<AsyncTestEventQueue*> g_async_test_event_queue(nullptr);
+
+// Only waits for the signals sent to end the program.  A fault is raised on
+// the thread that caused it, which may hold the locks the delivering thread
+// needs, or be the delivering thread itself, and waiting would only delay a
+// crash that the events cannot outlive anyway.
+static void FlushAsyncTestEventsOnSignal(int signal_number) {
+  switch (signal_number) {
+    case SIGINT:
+    case SIGTERM:
+#ifdef SIGHUP
+    case SIGHUP:
+#endif
+      break;
+    default:
+      return;
+  }
+  AsyncTestEventQueue* const queue = g_async_test_event_queue.load();
+  if (queue != nullptr) queue->FlushOnSignal();
+}
+#else
+static void FlushAsyncTestEventsOnSignal(int /* signal_number */) {}
+#endif  // GTEST_IS_THREADSAFE
+
+void FlushAsyncTestEvents() {
+#ifdef GTEST_IS_THREADSAFE
+  AsyncTestEventQueue* const queue = g_async_test_event_queue.load();
+  if (queue != nullptr) queue->Flush();
+#endif  // GTEST_IS_THREADSAFE
+}
+
 // class TestEventRepeater
 //
 // This class forwards events to other event listeners.
@@ -3858,7 +5283,16 @@ class TestEventRepeater : public TestEventListener {
   // Controls whether events will be forwarded to listeners_. Set to false
   // in death test child processes.
   bool forwarding_enabled() const { return forwarding_enabled_; }
-  void set_forwarding_enabled(bool enable) { forwarding_enabled_ = enable; }
+  void set_forwarding_enabled(bool enable);
+
+  // Starts delivering the events to the listeners that declare themselves
+  // async-safe on a thread of their own, per --gtest_async_listeners, or
+  // stops doing so once the pending events have been delivered.
+  void SetAsyncDelivery(bool enable);
+
+  // Waits until the events pending for the async-safe listeners have been
+  // delivered.
+  void FlushAsyncEvents();
 
   void OnTestProgramStart(const UnitTest& parameter) override;
   void OnTestIterationStart(const UnitTest& unit_test, int iteration) override;
@@ -3889,12 +5323,23 @@ class TestEventRepeater : public TestEventListener {
   bool forwarding_enabled_;
   // The list of listeners that receive events.
   std::vector<TestEventListener*> listeners_;
+#ifdef GTEST_IS_THREADSAFE
+  // The queue of the events for the async-safe listeners, or null when they
+  // are called synchronously.
+  std::unique_ptr<AsyncTestEventQueue> async_events_;
+#endif  // GTEST_IS_THREADSAFE
+
+  // Calls deliver(listener) for each listener, in reverse order if reverse
+  // is true, posting the calls to the async-safe listeners to async_events_.
+  template <typename Deliver>
+  void Forward(bool reverse, const Deliver& deliver);
 
   TestEventRepeater(const TestEventRepeater&) = delete;
   TestEventRepeater& operator=(const TestEventRepeater&) = delete;
 };
 
 TestEventRepeater::~TestEventRepeater() {
+  SetAsyncDelivery(false);
   ForEach(listeners_, Delete<TestEventListener>);
 }
 
@@ -3905,6 +5350,8 @@ void TestEventRepeater::Append(TestEventListener* listener) {
 TestEventListener* TestEventRepeater::Release(TestEventListener* listener) {
   for (size_t i = 0; i < listeners_.size(); ++i) {
     if (listeners_[i] == listener) {
+      // The listener must not be called once released.
+      if (listener->IsAsyncSafe()) FlushAsyncEvents();
       listeners_.erase(listeners_.begin() + static_cast<int>(i));
       return listener;
     }
@@ -3913,25 +5360,79 @@ TestEventListener* TestEventRepeater::Release(TestEventListener* listener) {
   return nullptr;
 }
 
+void TestEventRepeater::set_forwarding_enabled(bool enable) {
+  forwarding_enabled_ = enable;
+#ifdef GTEST_IS_THREADSAFE
+  // Forwarding is disabled in processes forked by the one delivering the
+  // events, in which the delivering thread does not exist.
+  if (!enable && async_events_ != nullptr) {
+    AsyncTestEventQueue* queue = async_events_.get();
+    g_async_test_event_queue.compare_exchange_strong(queue, nullptr);
+  }
+#endif  // GTEST_IS_THREADSAFE
+}
+
+void TestEventRepeater::SetAsyncDelivery(bool enable) {
+#ifdef GTEST_IS_THREADSAFE
+  if (enable == (async_events_ != nullptr)) return;
+  if (enable) {
+    async_events_ = std::make_unique<AsyncTestEventQueue>();
+    g_async_test_event_queue.store(async_events_.get());
+    InstallFatalSignalHandlers();
+  } else {
+    AsyncTestEventQueue* queue = async_events_.get();
+    g_async_test_event_queue.compare_exchange_strong(queue, nullptr);
+    // Delivers the pending events before stopping.
+    async_events_.reset();
+  }
+#else
+  static_cast<void>(enable);
+#endif  // GTEST_IS_THREADSAFE
+}
+
+void TestEventRepeater::FlushAsyncEvents() {
+#ifdef GTEST_IS_THREADSAFE
+  if (async_events_ != nullptr) async_events_->Flush();
+#endif  // GTEST_IS_THREADSAFE
+}
+
+template <typename Deliver>
+void TestEventRepeater::Forward(bool reverse, const Deliver& deliver) {
+  if (!forwarding_enabled_) return;
+  const TestEventLock lock;
+  for (size_t n = 0; n < listeners_.size(); n++) {
+    TestEventListener* const listener =
+        listeners_[reverse ? listeners_.size() - 1 - n : n];
+#ifdef GTEST_IS_THREADSAFE
+    if (async_events_ != nullptr && listener->IsAsyncSafe()) {
+      async_events_->Post([deliver, listener] { deliver(listener); });
+      continue;
+    }
+#endif  // GTEST_IS_THREADSAFE
+    deliver(listener);
+  }
+}
+
 // Since most methods are very similar, use macros to reduce boilerplate.
-// This defines a member that forwards the call to all listeners.
-#define GTEST_REPEATER_METHOD_(Name, Type)              \
-  void TestEventRepeater::Name(const Type& parameter) { \
-    if (forwarding_enabled_) {                          \
-      for (size_t i = 0; i < listeners_.size(); i++) {  \
-        listeners_[i]->Name(parameter);                 \
-      }                                                 \
-    }                                                   \
+// This defines a member that forwards the call to all listeners.  The events
+// posted for the async-safe listeners refer to the objects passed rather than
+// to copies: these are not copyable, listeners reach the other results
+// through them, and they outlive the events.  The results a listener may read
+// in an event are final by then, and the iteration does not end before the
+// events are delivered.
+#define GTEST_REPEATER_METHOD_(Name, Type)                            \
+  void TestEventRepeater::Name(const Type& parameter) {               \
+    Forward(false, [&parameter](TestEventListener* listener) {        \
+      listener->Name(parameter);                                      \
+    });                                                               \
   }
 // This defines a member that forwards the call to all listeners in reverse
 // order.
-#define GTEST_REVERSE_REPEATER_METHOD_(Name, Type)      \
-  void TestEventRepeater::Name(const Type& parameter) { \
-    if (forwarding_enabled_) {                          \
-      for (size_t i = listeners_.size(); i != 0; i--) { \
-        listeners_[i - 1]->Name(parameter);             \
-      }                                                 \
-    }                                                   \
+#define GTEST_REVERSE_REPEATER_METHOD_(Name, Type)                    \
+  void TestEventRepeater::Name(const Type& parameter) {               \
+    Forward(true, [&parameter](TestEventListener* listener) {         \
+      listener->Name(parameter);                                      \
+    });                                                               \
   }
 
 GTEST_REPEATER_METHOD_(OnTestProgramStart, UnitTest)
@@ -3943,7 +5444,6 @@ GTEST_REPEATER_METHOD_(OnTestCaseStart, TestSuite)
 GTEST_REPEATER_METHOD_(OnTestSuiteStart, TestSuite)
 GTEST_REPEATER_METHOD_(OnTestStart, TestInfo)
 GTEST_REPEATER_METHOD_(OnTestDisabled, TestInfo)
-GTEST_REPEATER_METHOD_(OnTestPartResult, TestPartResult)
 GTEST_REPEATER_METHOD_(OnEnvironmentsTearDownStart, UnitTest)
 GTEST_REVERSE_REPEATER_METHOD_(OnEnvironmentsSetUpEnd, UnitTest)
 GTEST_REVERSE_REPEATER_METHOD_(OnEnvironmentsTearDownEnd, UnitTest)
@@ -3953,27 +5453,39 @@ GTEST_REVERSE_REPEATER_METHOD_(OnTestEnd, TestInfo)
 GTEST_REVERSE_REPEATER_METHOD_(OnTestCaseEnd, TestSuite)
 #endif  //  GTEST_REMOVE_LEGACY_TEST_CASEAPI_
 GTEST_REVERSE_REPEATER_METHOD_(OnTestSuiteEnd, TestSuite)
-GTEST_REVERSE_REPEATER_METHOD_(OnTestProgramEnd, UnitTest)
 
 #undef GTEST_REPEATER_METHOD_
 #undef GTEST_REVERSE_REPEATER_METHOD_
 
+void TestEventRepeater::OnTestPartResult(const TestPartResult& result) {
+  // The result may not outlive the event, so the event holds a copy.
+  Forward(false, [result](TestEventListener* listener) {
+    listener->OnTestPartResult(result);
+  });
+}
+
 void TestEventRepeater::OnTestIterationStart(const UnitTest& unit_test,
                                              int iteration) {
-  if (forwarding_enabled_) {
-    for (size_t i = 0; i < listeners_.size(); i++) {
-      listeners_[i]->OnTestIterationStart(unit_test, iteration);
-    }
-  }
+  Forward(false, [&unit_test, iteration](TestEventListener* listener) {
+    listener->OnTestIterationStart(unit_test, iteration);
+  });
 }
 
+// The results of the tests change again after the iteration, so the
+// async-safe listeners must be done with them before it ends.
 void TestEventRepeater::OnTestIterationEnd(const UnitTest& unit_test,
                                            int iteration) {
-  if (forwarding_enabled_) {
-    for (size_t i = listeners_.size(); i > 0; i--) {
-      listeners_[i - 1]->OnTestIterationEnd(unit_test, iteration);
-    }
-  }
+  Forward(true, [&unit_test, iteration](TestEventListener* listener) {
+    listener->OnTestIterationEnd(unit_test, iteration);
+  });
+  FlushAsyncEvents();
+}
+
+void TestEventRepeater::OnTestProgramEnd(const UnitTest& unit_test) {
+  Forward(true, [&unit_test](TestEventListener* listener) {
+    listener->OnTestProgramEnd(unit_test);
+  });
+  FlushAsyncEvents();
 }
 
 // End TestEventRepeater
@@ -3984,6 +5496,10 @@ class XmlUnitTestResultPrinter : public EmptyTestEventListener {
  public:
   explicit XmlUnitTestResultPrinter(const char* output_file);
 
+  void OnTestIterationStart(const UnitTest& unit_test, int iteration) override;
+  void OnTestSuiteStart(const TestSuite& test_suite) override;
+  void OnTestEnd(const TestInfo& test_info) override;
+  void OnTestSuiteEnd(const TestSuite& test_suite) override;
   void OnTestIterationEnd(const UnitTest& unit_test, int iteration) override;
   void ListTestsMatchingFilter(const std::vector<TestSuite*>& test_suites);
 
@@ -3991,28 +5507,11 @@ class XmlUnitTestResultPrinter : public EmptyTestEventListener {
   static void PrintXmlTestsList(std::ostream* stream,
                                 const std::vector<TestSuite*>& test_suites);
 
- private:
-  // Is c a whitespace character that is normalized to a space character
-  // when it appears in an XML attribute value?
-  static bool IsNormalizableWhitespace(unsigned char c) {
-    return c == '\t' || c == '\n' || c == '\r';
-  }
-
-  // May c appear in a well-formed XML document?
-  // https://www.w3.org/TR/REC-xml/#charsets
-  static bool IsValidXmlCharacter(unsigned char c) {
-    return IsNormalizableWhitespace(c) || c >= 0x20;
-  }
-
-  // Returns an XML-escaped copy of the input string str.  If
-  // is_attribute is true, the text is meant to appear as an attribute
-  // value, and normalizable whitespace is preserved by replacing it
-  // with character references.
-  static std::string EscapeXml(const std::string& str, bool is_attribute);
-
-  // Returns the given string with all characters invalid in XML removed.
-  static std::string RemoveInvalidXmlCharacters(const std::string& str);
+  // Prints an XML summary of unit_test to output stream out.
+  static void PrintXmlUnitTest(::std::ostream* stream,
+                               const UnitTest& unit_test);
 
+ private:
   // Convenience wrapper around EscapeXml when str is an attribute value.
   static std::string EscapeXmlAttribute(const std::string& str) {
     return EscapeXml(str, true);
@@ -4049,6 +5548,22 @@ class XmlUnitTestResultPrinter : public EmptyTestEventListener {
   static void OutputXmlTestResult(::std::ostream* stream,
                                   const TestResult& result);
 
+  // Streams a <benchmark> element with the timing of a benchmark test.
+  static void OutputXmlBenchmarkResult(::std::ostream* stream,
+                                       const BenchmarkResult& result);
+
+  // Streams a <resources> element with the resources a test used.
+  static void OutputXmlResourceUsage(::std::ostream* stream,
+                                     const ResourceUsage& usage);
+
+  // Streams an <allocations> element with the allocations a test made.
+  static void OutputXmlAllocationStats(::std::ostream* stream,
+                                       const AllocationStats& stats);
+
+  // Streams a <phases> element with the time spent in each phase of a test.
+  static void OutputXmlTestPhaseTimes(::std::ostream* stream,
+                                      const TestPhaseTimes& times);
+
   // Streams an XML representation of a TestInfo object.
   static void OutputXmlTestInfo(::std::ostream* stream,
                                 const char* test_suite_name,
@@ -4058,10 +5573,6 @@ class XmlUnitTestResultPrinter : public EmptyTestEventListener {
   static void PrintXmlTestSuite(::std::ostream* stream,
                                 const TestSuite& test_suite);
 
-  // Prints an XML summary of unit_test to output stream out.
-  static void PrintXmlUnitTest(::std::ostream* stream,
-                               const UnitTest& unit_test);
-
   // Streams an XML representation of the test properties of a TestResult
   // object.
   static void OutputXmlTestProperties(std::ostream* stream,
@@ -4071,6 +5582,9 @@ class XmlUnitTestResultPrinter : public EmptyTestEventListener {
   // The output file.
   const std::string output_file_;
 
+  // The report of the tests run so far in the current iteration.
+  PartialReportFile partial_report_;
+
   XmlUnitTestResultPrinter(const XmlUnitTestResultPrinter&) = delete;
   XmlUnitTestResultPrinter& operator=(const XmlUnitTestResultPrinter&) = delete;
 };
@@ -4083,25 +5597,125 @@ XmlUnitTestResultPrinter::XmlUnitTestResultPrinter(const char* output_file)
   }
 }
 
-// Called after the unit test ends.
+// The partial report only carries the names of the test suites; their totals
+// are written with the complete report at the end of the iteration.
+static const char kXmlPartialReportTrailer[] = "</testsuites>\n";
+static const char kXmlPartialTestSuiteTrailer[] =
+    "  </testsuite>\n</testsuites>\n";
+
+void XmlUnitTestResultPrinter::OnTestIterationStart(
+    const UnitTest& /*unit_test*/, int /*iteration*/) {
+  std::stringstream stream;
+  stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites";
+  OutputXmlAttribute(&stream, "testsuites", "name", "AllTests");
+  stream << ">\n";
+  partial_report_.Open(output_file_, StringStreamToString(&stream),
+                       kXmlPartialReportTrailer);
+}
+
+void XmlUnitTestResultPrinter::OnTestSuiteStart(const TestSuite& test_suite) {
+  std::stringstream stream;
+  stream << "  <testsuite";
+  OutputXmlAttribute(&stream, "testsuite", "name", test_suite.name());
+  stream << ">\n";
+  partial_report_.Append(StringStreamToString(&stream),
+                         kXmlPartialTestSuiteTrailer);
+}
+
+void XmlUnitTestResultPrinter::OnTestEnd(const TestInfo& test_info) {
+  std::stringstream stream;
+  OutputXmlTestInfo(&stream, test_info.test_suite_name(), test_info);
+  partial_report_.Append(StringStreamToString(&stream),
+                         kXmlPartialTestSuiteTrailer);
+}
+
+void XmlUnitTestResultPrinter::OnTestSuiteEnd(const TestSuite& test_suite) {
+  std::stringstream stream;
+  if (test_suite.ad_hoc_test_result().Failed()) {
+    OutputXmlTestCaseForTestResult(&stream, test_suite.ad_hoc_test_result());
+  }
+  stream << "  </testsuite>\n";
+  partial_report_.Append(StringStreamToString(&stream),
+                         kXmlPartialReportTrailer);
+}
+
+// Called after the unit test ends.  Replaces the partial report with the
+// complete one, which is streamed to a temporary file as it is generated.
 void XmlUnitTestResultPrinter::OnTestIterationEnd(const UnitTest& unit_test,
                                                   int /*iteration*/) {
-  FILE* xmlout = OpenFileForWriting(output_file_);
-  std::stringstream stream;
-  PrintXmlUnitTest(&stream, unit_test);
-  fprintf(xmlout, "%s", StringStreamToString(&stream).c_str());
-  fclose(xmlout);
+  partial_report_.Close();
+  WriteReportFile(output_file_, [&unit_test](std::ostream* stream) {
+    PrintXmlUnitTest(stream, unit_test);
+  });
 }
 
 void XmlUnitTestResultPrinter::ListTestsMatchingFilter(
     const std::vector<TestSuite*>& test_suites) {
   FILE* xmlout = OpenFileForWriting(output_file_);
-  std::stringstream stream;
+  FileStreamBuf buffer(xmlout);
+  std::ostream stream(&buffer);
   PrintXmlTestsList(&stream, test_suites);
-  fprintf(xmlout, "%s", StringStreamToString(&stream).c_str());
   fclose(xmlout);
 }
 
+// Is c a whitespace character that is normalized to a space character
+// when it appears in an XML attribute value?
+static bool IsNormalizableWhitespace(unsigned char c) {
+  return c == '\t' || c == '\n' || c == '\r';
+}
+
+// May c appear in a well-formed XML document?
+// https://www.w3.org/TR/REC-xml/#charsets
+static bool IsValidXmlCharacter(unsigned char c) {
+  return IsNormalizableWhitespace(c) || c >= 0x20;
+}
+
+// Appends the two upper-case hex digits of c to output, like
+// String::FormatByte() without the cost of a stringstream.
+static void AppendHexByte(unsigned char c, std::string* output) {
+  static const char kHexDigits[] = "0123456789ABCDEF";
+  *output += kHexDigits[c >> 4];
+  *output += kHexDigits[c & 0xf];
+}
+
+const char* FindByteToEscape(const char* begin, const char* end,
+                             const char* chars) {
+  const char* p = begin;
+#if GTEST_CAN_SCAN_WITH_SSE2_
+  const size_t num_chars = strlen(chars);
+  __m128i char_vectors[8];
+  GTEST_CHECK_(num_chars <= 8) << "Too many characters to escape.";
+  for (size_t i = 0; i < num_chars; i++) {
+    char_vectors[i] = _mm_set1_epi8(chars[i]);
+  }
+  const __m128i max_control = _mm_set1_epi8(0x1f);
+  for (; end - p >= 16; p += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    // The bytes that are at most 0x1f, compared as unsigned.
+    __m128i found = _mm_cmpeq_epi8(_mm_min_epu8(bytes, max_control), bytes);
+    for (size_t i = 0; i < num_chars; i++) {
+      found = _mm_or_si128(found, _mm_cmpeq_epi8(bytes, char_vectors[i]));
+    }
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(found));
+    if (mask != 0) {
+      while ((mask & 1) == 0) {
+        mask >>= 1;
+        p++;
+      }
+      return p;
+    }
+  }
+#endif  // GTEST_CAN_SCAN_WITH_SSE2_
+  for (; p != end; p++) {
+    const unsigned char c = static_cast<unsigned char>(*p);
+    if (c < 0x20 || (c != 0 && strchr(chars, c) != nullptr)) {
+      break;
+    }
+  }
+  return p;
+}
+
 // Returns an XML-escaped copy of the input string str.  If is_attribute
 // is true, the text is meant to appear as an attribute value, and
 // normalizable whitespace is preserved by replacing it with character
@@ -4112,61 +5726,70 @@ void XmlUnitTestResultPrinter::ListTestsMatchingFilter(
 // module will consist of ordinary English text.
 // If this module is ever modified to produce version 1.1 XML output,
 // most invalid characters can be retained using character references.
-std::string XmlUnitTestResultPrinter::EscapeXml(const std::string& str,
-                                                bool is_attribute) {
-  Message m;
-
-  for (size_t i = 0; i < str.size(); ++i) {
-    const char ch = str[i];
+std::string EscapeXml(const std::string& str, bool is_attribute) {
+  std::string output;
+  output.reserve(str.size());
+  const char* const end = str.data() + str.size();
+  for (const char* p = str.data();; p++) {
+    // Copies the run of characters that need no escaping at once.
+    const char* const next = FindByteToEscape(p, end, "<>&'\"");
+    output.append(p, next);
+    if (next == end) break;
+    p = next;
+    const char ch = *p;
     switch (ch) {
       case '<':
-        m << "&lt;";
+        output += "&lt;";
         break;
       case '>':
-        m << "&gt;";
+        output += "&gt;";
         break;
       case '&':
-        m << "&amp;";
+        output += "&amp;";
         break;
       case '\'':
         if (is_attribute)
-          m << "&apos;";
+          output += "&apos;";
         else
-          m << '\'';
+          output += '\'';
         break;
       case '"':
         if (is_attribute)
-          m << "&quot;";
+          output += "&quot;";
         else
-          m << '"';
+          output += '"';
         break;
       default:
         if (IsValidXmlCharacter(static_cast<unsigned char>(ch))) {
           if (is_attribute &&
-              IsNormalizableWhitespace(static_cast<unsigned char>(ch)))
-            m << "&#x" << String::FormatByte(static_cast<unsigned char>(ch))
-              << ";";
-          else
-            m << ch;
+              IsNormalizableWhitespace(static_cast<unsigned char>(ch))) {
+            output += "&#x";
+            AppendHexByte(static_cast<unsigned char>(ch), &output);
+            output += ';';
+          } else {
+            output += ch;
+          }
         }
         break;
     }
   }
-
-  return m.GetString();
+  return output;
 }
 
 // Returns the given string with all characters invalid in XML removed.
 // Currently invalid characters are dropped from the string. An
 // alternative is to replace them with certain characters such as . or ?.
-std::string XmlUnitTestResultPrinter::RemoveInvalidXmlCharacters(
-    const std::string& str) {
+std::string RemoveInvalidXmlCharacters(const std::string& str) {
   std::string output;
   output.reserve(str.size());
-  for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
-    if (IsValidXmlCharacter(static_cast<unsigned char>(*it)))
-      output.push_back(*it);
-
+  const char* const end = str.data() + str.size();
+  for (const char* p = str.data();; p++) {
+    const char* const next = FindByteToEscape(p, end, "");
+    output.append(p, next);
+    if (next == end) break;
+    p = next;
+    if (IsValidXmlCharacter(static_cast<unsigned char>(*p))) output += *p;
+  }
   return output;
 }
 
@@ -4188,16 +5811,21 @@ std::string XmlUnitTestResultPrinter::RemoveInvalidXmlCharacters(
 
 // Formats the given time in milliseconds as seconds.
 std::string FormatTimeInMillisAsSeconds(TimeInMillis ms) {
-  ::std::stringstream ss;
+  return FormatTimeInNanosAsSeconds(ms * 1000000);
+}
+
+// Formats the given time in nanoseconds as seconds.
+std::string FormatTimeInNanosAsSeconds(TimeInNanos ns) {
+  const uint64_t magnitude =
+      ns < 0 ? 0 - static_cast<uint64_t>(ns) : static_cast<uint64_t>(ns);
   // For the exact N seconds, makes sure output has a trailing decimal point.
-  // Sets precision so that we won't have many trailing zeros (e.g., 300 ms
-  // will be just 0.3, 410 ms 0.41, and so on)
-  ss << std::fixed
-     << std::setprecision(
-            ms % 1000 == 0 ? 0 : (ms % 100 == 0 ? 1 : (ms % 10 == 0 ? 2 : 3)))
-     << std::showpoint;
-  ss << (static_cast<double>(ms) * 1e-3);
-  return ss.str();
+  // Drops the trailing zeros of the fraction (e.g., 300 ms will be just 0.3,
+  // 410 ms 0.41, and so on).
+  std::string fraction =
+      StreamableToString(magnitude % 1000000000 + 1000000000).substr(1);
+  fraction.erase(fraction.find_last_not_of('0') + 1);
+  return (ns < 0 ? "-" : "") + StreamableToString(magnitude / 1000000000) +
+         "." + fraction;
 }
 
 static bool PortableLocaltime(time_t seconds, struct tm* out) {
@@ -4280,7 +5908,7 @@ void XmlUnitTestResultPrinter::OutputXmlTestSuiteForTestResult(
   OutputXmlAttribute(stream, "testsuite", "skipped", "0");
   OutputXmlAttribute(stream, "testsuite", "errors", "0");
   OutputXmlAttribute(stream, "testsuite", "time",
-                     FormatTimeInMillisAsSeconds(result.elapsed_time()));
+                     FormatTimeInNanosAsSeconds(result.elapsed_time_nanos()));
   OutputXmlAttribute(
       stream, "testsuite", "timestamp",
       FormatEpochTimeInMillisAsIso8601(result.start_timestamp()));
@@ -4302,7 +5930,7 @@ void XmlUnitTestResultPrinter::OutputXmlTestCaseForTestResult(
   OutputXmlAttribute(stream, "testcase", "result", "completed");
   OutputXmlAttribute(stream, "testcase", "classname", "");
   OutputXmlAttribute(stream, "testcase", "time",
-                     FormatTimeInMillisAsSeconds(result.elapsed_time()));
+                     FormatTimeInNanosAsSeconds(result.elapsed_time_nanos()));
   OutputXmlAttribute(
       stream, "testcase", "timestamp",
       FormatEpochTimeInMillisAsIso8601(result.start_timestamp()));
@@ -4345,11 +5973,12 @@ void XmlUnitTestResultPrinter::OutputXmlTestInfo(::std::ostream* stream,
   OutputXmlAttribute(stream, kTestsuite, "status",
                      test_info.should_run() ? "run" : "notrun");
   OutputXmlAttribute(stream, kTestsuite, "result",
-                     test_info.should_run()
-                         ? (result.Skipped() ? "skipped" : "completed")
-                         : "suppressed");
+                     !test_info.should_run() ? "suppressed"
+                     : result.Cached()       ? "cached"
+                     : result.Skipped()      ? "skipped"
+                                             : "completed");
   OutputXmlAttribute(stream, kTestsuite, "time",
-                     FormatTimeInMillisAsSeconds(result.elapsed_time()));
+                     FormatTimeInNanosAsSeconds(result.elapsed_time_nanos()));
   OutputXmlAttribute(
       stream, kTestsuite, "timestamp",
       FormatEpochTimeInMillisAsIso8601(result.start_timestamp()));
@@ -4393,17 +6022,107 @@ void XmlUnitTestResultPrinter::OutputXmlTestResult(::std::ostream* stream,
     }
   }
 
-  if (failures == 0 && skips == 0 && result.test_property_count() == 0) {
+  if (failures == 0 && skips == 0 && result.test_property_count() == 0 &&
+      !result.HasBenchmarkResult() && !result.HasResourceUsage() &&
+      !result.HasAllocationStats() && !result.HasPhaseTimes()) {
     *stream << " />\n";
   } else {
     if (failures == 0 && skips == 0) {
       *stream << ">\n";
     }
+    if (result.HasBenchmarkResult()) {
+      OutputXmlBenchmarkResult(stream, result.benchmark_result());
+    }
+    if (result.HasResourceUsage()) {
+      OutputXmlResourceUsage(stream, result.resource_usage());
+    }
+    if (result.HasAllocationStats()) {
+      OutputXmlAllocationStats(stream, result.allocation_stats());
+    }
+    if (result.HasPhaseTimes()) {
+      OutputXmlTestPhaseTimes(stream, result.phase_times());
+    }
     OutputXmlTestProperties(stream, result, /*indent=*/"      ");
     *stream << "    </testcase>\n";
   }
 }
 
+// Streams a <benchmark> element with the timing of a benchmark test.
+void XmlUnitTestResultPrinter::OutputXmlBenchmarkResult(
+    ::std::ostream* stream, const BenchmarkResult& result) {
+  const std::string kBenchmark = "benchmark";
+  *stream << "      <" << kBenchmark;
+  OutputXmlAttribute(stream, kBenchmark, "iterations",
+                     StreamableToString(result.iterations()));
+  OutputXmlAttribute(stream, kBenchmark, "samples",
+                     StreamableToString(result.samples()));
+  OutputXmlAttribute(stream, kBenchmark, "mean_ns",
+                     StreamableToString(result.mean_ns()));
+  OutputXmlAttribute(stream, kBenchmark, "median_ns",
+                     StreamableToString(result.median_ns()));
+  OutputXmlAttribute(stream, kBenchmark, "stddev_ns",
+                     StreamableToString(result.stddev_ns()));
+  OutputXmlAttribute(stream, kBenchmark, "iterations_per_second",
+                     StreamableToString(result.iterations_per_second()));
+  *stream << " />\n";
+}
+
+// Streams a <resources> element with the resources a test used.
+void XmlUnitTestResultPrinter::OutputXmlResourceUsage(
+    ::std::ostream* stream, const ResourceUsage& usage) {
+  const std::string kResources = "resources";
+  *stream << "      <" << kResources;
+  OutputXmlAttribute(stream, kResources, "user_cpu_time_us",
+                     StreamableToString(usage.user_cpu_time_us));
+  OutputXmlAttribute(stream, kResources, "system_cpu_time_us",
+                     StreamableToString(usage.system_cpu_time_us));
+  OutputXmlAttribute(stream, kResources, "max_rss_kb",
+                     StreamableToString(usage.max_rss_kb));
+  OutputXmlAttribute(stream, kResources, "max_rss_growth_kb",
+                     StreamableToString(usage.max_rss_growth_kb));
+  OutputXmlAttribute(stream, kResources, "minor_page_faults",
+                     StreamableToString(usage.minor_page_faults));
+  OutputXmlAttribute(stream, kResources, "major_page_faults",
+                     StreamableToString(usage.major_page_faults));
+  OutputXmlAttribute(stream, kResources, "voluntary_context_switches",
+                     StreamableToString(usage.voluntary_context_switches));
+  OutputXmlAttribute(stream, kResources, "involuntary_context_switches",
+                     StreamableToString(usage.involuntary_context_switches));
+  *stream << " />\n";
+}
+
+// Streams an <allocations> element with the allocations a test made.
+void XmlUnitTestResultPrinter::OutputXmlAllocationStats(
+    ::std::ostream* stream, const AllocationStats& stats) {
+  const std::string kAllocations = "allocations";
+  *stream << "      <" << kAllocations;
+  OutputXmlAttribute(stream, kAllocations, "count",
+                     StreamableToString(stats.count));
+  OutputXmlAttribute(stream, kAllocations, "bytes",
+                     StreamableToString(stats.bytes));
+  OutputXmlAttribute(stream, kAllocations, "peak_bytes",
+                     StreamableToString(stats.peak_bytes));
+  *stream << " />\n";
+}
+
+// Streams a <phases> element with the time spent in each phase of a test.
+void XmlUnitTestResultPrinter::OutputXmlTestPhaseTimes(
+    ::std::ostream* stream, const TestPhaseTimes& times) {
+  const std::string kPhases = "phases";
+  *stream << "      <" << kPhases;
+  OutputXmlAttribute(stream, kPhases, "constructor",
+                     FormatTimeInNanosAsSeconds(times.constructor_nanos));
+  OutputXmlAttribute(stream, kPhases, "set_up",
+                     FormatTimeInNanosAsSeconds(times.set_up_nanos));
+  OutputXmlAttribute(stream, kPhases, "body",
+                     FormatTimeInNanosAsSeconds(times.body_nanos));
+  OutputXmlAttribute(stream, kPhases, "tear_down",
+                     FormatTimeInNanosAsSeconds(times.tear_down_nanos));
+  OutputXmlAttribute(stream, kPhases, "destructor",
+                     FormatTimeInNanosAsSeconds(times.destructor_nanos));
+  *stream << " />\n";
+}
+
 // Prints an XML representation of a TestSuite object
 void XmlUnitTestResultPrinter::PrintXmlTestSuite(std::ostream* stream,
                                                  const TestSuite& test_suite) {
@@ -4423,8 +6142,9 @@ void XmlUnitTestResultPrinter::PrintXmlTestSuite(std::ostream* stream,
 
     OutputXmlAttribute(stream, kTestsuite, "errors", "0");
 
-    OutputXmlAttribute(stream, kTestsuite, "time",
-                       FormatTimeInMillisAsSeconds(test_suite.elapsed_time()));
+    OutputXmlAttribute(
+        stream, kTestsuite, "time",
+        FormatTimeInNanosAsSeconds(test_suite.elapsed_time_nanos()));
     OutputXmlAttribute(
         stream, kTestsuite, "timestamp",
         FormatEpochTimeInMillisAsIso8601(test_suite.start_timestamp()));
@@ -4432,6 +6152,17 @@ void XmlUnitTestResultPrinter::PrintXmlTestSuite(std::ostream* stream,
   *stream << ">\n";
   OutputXmlTestProperties(stream, test_suite.ad_hoc_test_result(),
                           /*indent=*/"    ");
+  if (test_suite.HasPhaseTimes()) {
+    const std::string kPhases = "phases";
+    *stream << "    <" << kPhases;
+    OutputXmlAttribute(
+        stream, kPhases, "set_up_test_suite",
+        FormatTimeInNanosAsSeconds(test_suite.set_up_test_suite_nanos()));
+    OutputXmlAttribute(
+        stream, kPhases, "tear_down_test_suite",
+        FormatTimeInNanosAsSeconds(test_suite.tear_down_test_suite_nanos()));
+    *stream << " />\n";
+  }
   for (int i = 0; i < test_suite.total_test_count(); ++i) {
     if (test_suite.GetTestInfo(i)->is_reportable())
       OutputXmlTestInfo(stream, test_suite.name(), *test_suite.GetTestInfo(i));
@@ -4459,8 +6190,9 @@ void XmlUnitTestResultPrinter::PrintXmlUnitTest(std::ostream* stream,
       stream, kTestsuites, "disabled",
       StreamableToString(unit_test.reportable_disabled_test_count()));
   OutputXmlAttribute(stream, kTestsuites, "errors", "0");
-  OutputXmlAttribute(stream, kTestsuites, "time",
-                     FormatTimeInMillisAsSeconds(unit_test.elapsed_time()));
+  OutputXmlAttribute(
+      stream, kTestsuites, "time",
+      FormatTimeInNanosAsSeconds(unit_test.elapsed_time_nanos()));
   OutputXmlAttribute(
       stream, kTestsuites, "timestamp",
       FormatEpochTimeInMillisAsIso8601(unit_test.start_timestamp()));
@@ -4475,6 +6207,17 @@ void XmlUnitTestResultPrinter::PrintXmlUnitTest(std::ostream* stream,
 
   OutputXmlTestProperties(stream, unit_test.ad_hoc_test_result(),
                           /*indent=*/"  ");
+  if (unit_test.HasPhaseTimes()) {
+    const std::string kPhases = "phases";
+    *stream << "  <" << kPhases;
+    OutputXmlAttribute(
+        stream, kPhases, "environments_set_up",
+        FormatTimeInNanosAsSeconds(unit_test.environments_set_up_nanos()));
+    OutputXmlAttribute(
+        stream, kPhases, "environments_tear_down",
+        FormatTimeInNanosAsSeconds(unit_test.environments_tear_down_nanos()));
+    *stream << " />\n";
+  }
   for (int i = 0; i < unit_test.total_test_suite_count(); ++i) {
     if (unit_test.GetTestSuite(i)->reportable_test_count() > 0)
       PrintXmlTestSuite(stream, *unit_test.GetTestSuite(i));
@@ -4534,21 +6277,46 @@ void XmlUnitTestResultPrinter::OutputXmlTestProperties(
 // End XmlUnitTestResultPrinter
 #endif  // GTEST_HAS_FILE_SYSTEM
 
+// Returns the bits of a double, for the binary report and the test
+// job messages, which only store integers.
+static int64_t DoubleToBits(double value) {
+  int64_t bits;
+  static_assert(sizeof(bits) == sizeof(value), "");
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// Returns the double whose bits DoubleToBits() returned.
+static double BitsToDouble(int64_t bits) {
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
 #if GTEST_HAS_FILE_SYSTEM
 // This class generates an JSON output file.
 class JsonUnitTestResultPrinter : public EmptyTestEventListener {
  public:
   explicit JsonUnitTestResultPrinter(const char* output_file);
 
-  void OnTestIterationEnd(const UnitTest& unit_test, int iteration) override;
-
-  // Prints an JSON summary of all unit tests.
+  void OnTestIterationStart(const UnitTest& unit_test, int iteration) override;
+  void OnTestSuiteStart(const TestSuite& test_suite) override;
+  void OnTestEnd(const TestInfo& test_info) override;
+  void OnTestSuiteEnd(const TestSuite& test_suite) override;
+  void OnTestIterationEnd(const UnitTest& unit_test, int iteration) override;
+
+  // Prints an JSON summary of all unit tests.
   static void PrintJsonTestList(::std::ostream* stream,
                                 const std::vector<TestSuite*>& test_suites);
 
+  // Prints a JSON summary of unit_test to output stream out.
+  static void PrintJsonUnitTest(::std::ostream* stream,
+                                const UnitTest& unit_test);
+
  private:
-  // Returns an JSON-escaped copy of the input string str.
-  static std::string EscapeJson(const std::string& str);
+  // Verifies that the given attribute belongs to the given element.
+  static void CheckJsonKey(const std::string& element_name,
+                           const std::string& name);
 
   //// Verifies that the given attribute belongs to the given element and
   //// streams the attribute as JSON.
@@ -4556,10 +6324,16 @@ class JsonUnitTestResultPrinter : public EmptyTestEventListener {
                             const std::string& element_name,
                             const std::string& name, const std::string& value,
                             const std::string& indent, bool comma = true);
+  template <typename Number, typename = typename std::enable_if<
+                                 std::is_arithmetic<Number>::value>::type>
   static void OutputJsonKey(std::ostream* stream,
                             const std::string& element_name,
-                            const std::string& name, int value,
-                            const std::string& indent, bool comma = true);
+                            const std::string& name, Number value,
+                            const std::string& indent, bool comma = true) {
+    CheckJsonKey(element_name, name);
+    *stream << indent << "\"" << name << "\": " << StreamableToString(value);
+    if (comma) *stream << ",\n";
+  }
 
   // Streams a test suite JSON stanza containing the given test result.
   //
@@ -4586,10 +6360,6 @@ class JsonUnitTestResultPrinter : public EmptyTestEventListener {
   static void PrintJsonTestSuite(::std::ostream* stream,
                                  const TestSuite& test_suite);
 
-  // Prints a JSON summary of unit_test to output stream out.
-  static void PrintJsonUnitTest(::std::ostream* stream,
-                                const UnitTest& unit_test);
-
   // Produces a string representing the test properties in a result as
   // a JSON dictionary.
   static std::string TestPropertiesAsJson(const TestResult& result,
@@ -4598,6 +6368,12 @@ class JsonUnitTestResultPrinter : public EmptyTestEventListener {
   // The output file.
   const std::string output_file_;
 
+  // The report of the tests run so far in the current iteration, and whether
+  // it holds a test suite or a test of the current test suite yet.
+  PartialReportFile partial_report_;
+  bool has_test_suites_ = false;
+  bool has_tests_ = false;
+
   JsonUnitTestResultPrinter(const JsonUnitTestResultPrinter&) = delete;
   JsonUnitTestResultPrinter& operator=(const JsonUnitTestResultPrinter&) =
       delete;
@@ -4611,63 +6387,58 @@ JsonUnitTestResultPrinter::JsonUnitTestResultPrinter(const char* output_file)
   }
 }
 
-void JsonUnitTestResultPrinter::OnTestIterationEnd(const UnitTest& unit_test,
-                                                   int /*iteration*/) {
-  FILE* jsonout = OpenFileForWriting(output_file_);
-  std::stringstream stream;
-  PrintJsonUnitTest(&stream, unit_test);
-  fprintf(jsonout, "%s", StringStreamToString(&stream).c_str());
-  fclose(jsonout);
-}
-
-// Returns an JSON-escaped copy of the input string str.
-std::string JsonUnitTestResultPrinter::EscapeJson(const std::string& str) {
-  Message m;
-
-  for (size_t i = 0; i < str.size(); ++i) {
-    const char ch = str[i];
+// Returns an JSON-escaped copy of the input string str.  The bytes of
+// non-ASCII characters are copied as they are, so UTF-8 text stays UTF-8.
+std::string EscapeJson(const std::string& str) {
+  std::string output;
+  output.reserve(str.size());
+  const char* const end = str.data() + str.size();
+  for (const char* p = str.data();; p++) {
+    // Copies the run of characters that need no escaping at once.
+    const char* const next = FindByteToEscape(p, end, "\\\"/");
+    output.append(p, next);
+    if (next == end) break;
+    p = next;
+    const char ch = *p;
     switch (ch) {
       case '\\':
       case '"':
       case '/':
-        m << '\\' << ch;
+        output += '\\';
+        output += ch;
         break;
       case '\b':
-        m << "\\b";
+        output += "\\b";
         break;
       case '\t':
-        m << "\\t";
+        output += "\\t";
         break;
       case '\n':
-        m << "\\n";
+        output += "\\n";
         break;
       case '\f':
-        m << "\\f";
+        output += "\\f";
         break;
       case '\r':
-        m << "\\r";
+        output += "\\r";
         break;
       default:
-        if (ch < ' ') {
-          m << "\\u00" << String::FormatByte(static_cast<unsigned char>(ch));
-        } else {
-          m << ch;
-        }
+        output += "\\u00";
+        AppendHexByte(static_cast<unsigned char>(ch), &output);
         break;
     }
   }
-
-  return m.GetString();
+  return output;
 }
 
 // The following routines generate an JSON representation of a UnitTest
 // object.
 
-// Formats the given time in milliseconds as seconds.
-static std::string FormatTimeInMillisAsDuration(TimeInMillis ms) {
-  ::std::stringstream ss;
-  ss << (static_cast<double>(ms) * 1e-3) << "s";
-  return ss.str();
+// Formats the given time in nanoseconds as seconds, for a Duration field.
+static std::string FormatTimeInNanosAsDuration(TimeInNanos ns) {
+  std::string seconds = FormatTimeInNanosAsSeconds(ns);
+  if (seconds.back() == '.') seconds.pop_back();
+  return seconds + "s";
 }
 
 // Converts the given epoch time in milliseconds to a date string in the
@@ -4689,27 +6460,67 @@ static inline std::string Indent(size_t width) {
   return std::string(width, ' ');
 }
 
-void JsonUnitTestResultPrinter::OutputJsonKey(std::ostream* stream,
-                                              const std::string& element_name,
-                                              const std::string& name,
-                                              const std::string& value,
-                                              const std::string& indent,
-                                              bool comma) {
-  const std::vector<std::string>& allowed_names =
-      GetReservedOutputAttributesForElement(element_name);
+// The partial report only carries the names of the test suites; their totals
+// are written with the complete report at the end of the iteration.
+static const char kJsonPartialReportTrailer[] = "\n  ]\n}\n";
+static const char kJsonPartialTestSuiteTrailer[] =
+    "\n      ]\n    }\n  ]\n}\n";
 
-  GTEST_CHECK_(std::find(allowed_names.begin(), allowed_names.end(), name) !=
-               allowed_names.end())
-      << "Key \"" << name << "\" is not allowed for value \"" << element_name
-      << "\".";
+void JsonUnitTestResultPrinter::OnTestIterationStart(
+    const UnitTest& /*unit_test*/, int /*iteration*/) {
+  std::stringstream stream;
+  stream << "{\n";
+  OutputJsonKey(&stream, "testsuites", "name", "AllTests", Indent(2));
+  stream << Indent(2) << "\"testsuites\": [\n";
+  partial_report_.Open(output_file_, StringStreamToString(&stream),
+                       kJsonPartialReportTrailer);
+  has_test_suites_ = false;
+}
 
-  *stream << indent << "\"" << name << "\": \"" << EscapeJson(value) << "\"";
-  if (comma) *stream << ",\n";
+void JsonUnitTestResultPrinter::OnTestSuiteStart(const TestSuite& test_suite) {
+  std::stringstream stream;
+  if (has_test_suites_) stream << ",\n";
+  stream << Indent(4) << "{\n";
+  OutputJsonKey(&stream, "testsuite", "name", test_suite.name(), Indent(6));
+  stream << Indent(6) << "\"testsuite\": [\n";
+  partial_report_.Append(StringStreamToString(&stream),
+                         kJsonPartialTestSuiteTrailer);
+  has_test_suites_ = true;
+  has_tests_ = false;
 }
 
-void JsonUnitTestResultPrinter::OutputJsonKey(
-    std::ostream* stream, const std::string& element_name,
-    const std::string& name, int value, const std::string& indent, bool comma) {
+void JsonUnitTestResultPrinter::OnTestEnd(const TestInfo& test_info) {
+  std::stringstream stream;
+  if (has_tests_) stream << ",\n";
+  OutputJsonTestInfo(&stream, test_info.test_suite_name(), test_info);
+  partial_report_.Append(StringStreamToString(&stream),
+                         kJsonPartialTestSuiteTrailer);
+  has_tests_ = true;
+}
+
+void JsonUnitTestResultPrinter::OnTestSuiteEnd(const TestSuite& test_suite) {
+  std::stringstream stream;
+  if (test_suite.ad_hoc_test_result().Failed()) {
+    if (has_tests_) stream << ",\n";
+    OutputJsonTestCaseForTestResult(&stream, test_suite.ad_hoc_test_result());
+  }
+  stream << "\n" << Indent(6) << "]\n" << Indent(4) << "}";
+  partial_report_.Append(StringStreamToString(&stream),
+                         kJsonPartialReportTrailer);
+}
+
+// Replaces the partial report with the complete one, which is streamed to a
+// temporary file as it is generated.
+void JsonUnitTestResultPrinter::OnTestIterationEnd(const UnitTest& unit_test,
+                                                   int /*iteration*/) {
+  partial_report_.Close();
+  WriteReportFile(output_file_, [&unit_test](std::ostream* stream) {
+    PrintJsonUnitTest(stream, unit_test);
+  });
+}
+
+void JsonUnitTestResultPrinter::CheckJsonKey(const std::string& element_name,
+                                             const std::string& name) {
   const std::vector<std::string>& allowed_names =
       GetReservedOutputAttributesForElement(element_name);
 
@@ -4717,8 +6528,16 @@ void JsonUnitTestResultPrinter::OutputJsonKey(
                allowed_names.end())
       << "Key \"" << name << "\" is not allowed for value \"" << element_name
       << "\".";
+}
 
-  *stream << indent << "\"" << name << "\": " << StreamableToString(value);
+void JsonUnitTestResultPrinter::OutputJsonKey(std::ostream* stream,
+                                              const std::string& element_name,
+                                              const std::string& name,
+                                              const std::string& value,
+                                              const std::string& indent,
+                                              bool comma) {
+  CheckJsonKey(element_name, name);
+  *stream << indent << "\"" << name << "\": \"" << EscapeJson(value) << "\"";
   if (comma) *stream << ",\n";
 }
 
@@ -4735,7 +6554,7 @@ void JsonUnitTestResultPrinter::OutputJsonTestSuiteForTestResult(
     OutputJsonKey(stream, "testsuite", "skipped", 0, Indent(6));
     OutputJsonKey(stream, "testsuite", "errors", 0, Indent(6));
     OutputJsonKey(stream, "testsuite", "time",
-                  FormatTimeInMillisAsDuration(result.elapsed_time()),
+                  FormatTimeInNanosAsDuration(result.elapsed_time_nanos()),
                   Indent(6));
     OutputJsonKey(stream, "testsuite", "timestamp",
                   FormatEpochTimeInMillisAsRFC3339(result.start_timestamp()),
@@ -4761,7 +6580,7 @@ void JsonUnitTestResultPrinter::OutputJsonTestCaseForTestResult(
                 FormatEpochTimeInMillisAsRFC3339(result.start_timestamp()),
                 Indent(10));
   OutputJsonKey(stream, "testcase", "time",
-                FormatTimeInMillisAsDuration(result.elapsed_time()),
+                FormatTimeInNanosAsDuration(result.elapsed_time_nanos()),
                 Indent(10));
   OutputJsonKey(stream, "testcase", "classname", "", Indent(10), false);
   *stream << TestPropertiesAsJson(result, Indent(10));
@@ -4802,15 +6621,17 @@ void JsonUnitTestResultPrinter::OutputJsonTestInfo(::std::ostream* stream,
   OutputJsonKey(stream, kTestsuite, "status",
                 test_info.should_run() ? "RUN" : "NOTRUN", kIndent);
   OutputJsonKey(stream, kTestsuite, "result",
-                test_info.should_run()
-                    ? (result.Skipped() ? "SKIPPED" : "COMPLETED")
-                    : "SUPPRESSED",
+                !test_info.should_run() ? "SUPPRESSED"
+                : result.Cached()       ? "CACHED"
+                : result.Skipped()      ? "SKIPPED"
+                                        : "COMPLETED",
                 kIndent);
   OutputJsonKey(stream, kTestsuite, "timestamp",
                 FormatEpochTimeInMillisAsRFC3339(result.start_timestamp()),
                 kIndent);
   OutputJsonKey(stream, kTestsuite, "time",
-                FormatTimeInMillisAsDuration(result.elapsed_time()), kIndent);
+                FormatTimeInNanosAsDuration(result.elapsed_time_nanos()),
+                kIndent);
   OutputJsonKey(stream, kTestsuite, "classname", test_suite_name, kIndent,
                 false);
   *stream << TestPropertiesAsJson(result, kIndent);
@@ -4869,6 +6690,86 @@ void JsonUnitTestResultPrinter::OutputJsonTestResult(::std::ostream* stream,
     if (skipped > 0) *stream << "\n" << kIndent << "]";
   }
 
+  if (result.HasBenchmarkResult()) {
+    const BenchmarkResult& benchmark = result.benchmark_result();
+    const std::string kBenchmark = "benchmark";
+    const std::string kBenchmarkIndent = Indent(12);
+    *stream << ",\n" << kIndent << "\"" << kBenchmark << "\": {\n";
+    OutputJsonKey(stream, kBenchmark, "iterations", benchmark.iterations(),
+                  kBenchmarkIndent);
+    OutputJsonKey(stream, kBenchmark, "samples", benchmark.samples(),
+                  kBenchmarkIndent);
+    OutputJsonKey(stream, kBenchmark, "mean_ns", benchmark.mean_ns(),
+                  kBenchmarkIndent);
+    OutputJsonKey(stream, kBenchmark, "median_ns", benchmark.median_ns(),
+                  kBenchmarkIndent);
+    OutputJsonKey(stream, kBenchmark, "stddev_ns", benchmark.stddev_ns(),
+                  kBenchmarkIndent);
+    OutputJsonKey(stream, kBenchmark, "iterations_per_second",
+                  benchmark.iterations_per_second(), kBenchmarkIndent, false);
+    *stream << "\n" << kIndent << "}";
+  }
+
+  if (result.HasResourceUsage()) {
+    const ResourceUsage& usage = result.resource_usage();
+    const std::string kResources = "resources";
+    const std::string kResourcesIndent = Indent(12);
+    *stream << ",\n" << kIndent << "\"" << kResources << "\": {\n";
+    OutputJsonKey(stream, kResources, "user_cpu_time_us",
+                  usage.user_cpu_time_us, kResourcesIndent);
+    OutputJsonKey(stream, kResources, "system_cpu_time_us",
+                  usage.system_cpu_time_us, kResourcesIndent);
+    OutputJsonKey(stream, kResources, "max_rss_kb", usage.max_rss_kb,
+                  kResourcesIndent);
+    OutputJsonKey(stream, kResources, "max_rss_growth_kb",
+                  usage.max_rss_growth_kb, kResourcesIndent);
+    OutputJsonKey(stream, kResources, "minor_page_faults",
+                  usage.minor_page_faults, kResourcesIndent);
+    OutputJsonKey(stream, kResources, "major_page_faults",
+                  usage.major_page_faults, kResourcesIndent);
+    OutputJsonKey(stream, kResources, "voluntary_context_switches",
+                  usage.voluntary_context_switches, kResourcesIndent);
+    OutputJsonKey(stream, kResources, "involuntary_context_switches",
+                  usage.involuntary_context_switches, kResourcesIndent, false);
+    *stream << "\n" << kIndent << "}";
+  }
+
+  if (result.HasAllocationStats()) {
+    const AllocationStats& stats = result.allocation_stats();
+    const std::string kAllocations = "allocations";
+    const std::string kAllocationsIndent = Indent(12);
+    *stream << ",\n" << kIndent << "\"" << kAllocations << "\": {\n";
+    OutputJsonKey(stream, kAllocations, "count", stats.count,
+                  kAllocationsIndent);
+    OutputJsonKey(stream, kAllocations, "bytes", stats.bytes,
+                  kAllocationsIndent);
+    OutputJsonKey(stream, kAllocations, "peak_bytes", stats.peak_bytes,
+                  kAllocationsIndent, false);
+    *stream << "\n" << kIndent << "}";
+  }
+
+  if (result.HasPhaseTimes()) {
+    const TestPhaseTimes& times = result.phase_times();
+    const std::string kPhases = "phases";
+    const std::string kPhasesIndent = Indent(12);
+    *stream << ",\n" << kIndent << "\"" << kPhases << "\": {\n";
+    OutputJsonKey(stream, kPhases, "constructor",
+                  FormatTimeInNanosAsDuration(times.constructor_nanos),
+                  kPhasesIndent);
+    OutputJsonKey(stream, kPhases, "set_up",
+                  FormatTimeInNanosAsDuration(times.set_up_nanos),
+                  kPhasesIndent);
+    OutputJsonKey(stream, kPhases, "body",
+                  FormatTimeInNanosAsDuration(times.body_nanos), kPhasesIndent);
+    OutputJsonKey(stream, kPhases, "tear_down",
+                  FormatTimeInNanosAsDuration(times.tear_down_nanos),
+                  kPhasesIndent);
+    OutputJsonKey(stream, kPhases, "destructor",
+                  FormatTimeInNanosAsDuration(times.destructor_nanos),
+                  kPhasesIndent, false);
+    *stream << "\n" << kIndent << "}";
+  }
+
   *stream << "\n" << Indent(8) << "}";
 }
 
@@ -4893,8 +6794,21 @@ void JsonUnitTestResultPrinter::PrintJsonTestSuite(
         FormatEpochTimeInMillisAsRFC3339(test_suite.start_timestamp()),
         kIndent);
     OutputJsonKey(stream, kTestsuite, "time",
-                  FormatTimeInMillisAsDuration(test_suite.elapsed_time()),
+                  FormatTimeInNanosAsDuration(test_suite.elapsed_time_nanos()),
                   kIndent, false);
+    if (test_suite.HasPhaseTimes()) {
+      const std::string kPhases = "phases";
+      *stream << ",\n" << kIndent << "\"" << kPhases << "\": {\n";
+      OutputJsonKey(
+          stream, kPhases, "set_up_test_suite",
+          FormatTimeInNanosAsDuration(test_suite.set_up_test_suite_nanos()),
+          Indent(8));
+      OutputJsonKey(
+          stream, kPhases, "tear_down_test_suite",
+          FormatTimeInNanosAsDuration(test_suite.tear_down_test_suite_nanos()),
+          Indent(8), false);
+      *stream << "\n" << kIndent << "}";
+    }
     *stream << TestPropertiesAsJson(test_suite.ad_hoc_test_result(), kIndent)
             << ",\n";
   }
@@ -4947,8 +6861,21 @@ void JsonUnitTestResultPrinter::PrintJsonUnitTest(std::ostream* stream,
                 FormatEpochTimeInMillisAsRFC3339(unit_test.start_timestamp()),
                 kIndent);
   OutputJsonKey(stream, kTestsuites, "time",
-                FormatTimeInMillisAsDuration(unit_test.elapsed_time()), kIndent,
-                false);
+                FormatTimeInNanosAsDuration(unit_test.elapsed_time_nanos()),
+                kIndent, false);
+  if (unit_test.HasPhaseTimes()) {
+    const std::string kPhases = "phases";
+    *stream << ",\n" << kIndent << "\"" << kPhases << "\": {\n";
+    OutputJsonKey(
+        stream, kPhases, "environments_set_up",
+        FormatTimeInNanosAsDuration(unit_test.environments_set_up_nanos()),
+        Indent(4));
+    OutputJsonKey(
+        stream, kPhases, "environments_tear_down",
+        FormatTimeInNanosAsDuration(unit_test.environments_tear_down_nanos()),
+        Indent(4), false);
+    *stream << "\n" << kIndent << "}";
+  }
 
   *stream << TestPropertiesAsJson(unit_test.ad_hoc_test_result(), kIndent)
           << ",\n";
@@ -5022,201 +6949,1715 @@ std::string JsonUnitTestResultPrinter::TestPropertiesAsJson(
 }
 
 // End JsonUnitTestResultPrinter
-#endif  // GTEST_HAS_FILE_SYSTEM
 
-#if GTEST_CAN_STREAM_RESULTS_
+// Binary reports (see --gtest_output=bin) start with the "GTESTBIN" magic
+// and the version of the format, followed by a stream of records.  A record
+// is its size, then its type and fields.  Integers (sizes included) are
+// zigzag-encoded LEB128 varints.  Strings are stored either inline, as their
+// size followed by their bytes, or interned: a kString record carrying the
+// bytes of a string gives it the next id, starting from 1, and the fields
+// after it refer to the string by that id, 0 standing for a null string.
+// Names, file names and property keys are interned; messages, value
+// parameters and property values, which seldom repeat, are stored inline.
+// Timestamps are in milliseconds since the epoch, and elapsed times in
+// nanoseconds.
+static const char kBinaryReportMagic[] = "GTESTBIN";
+static const int64_t kBinaryReportVersion = 2;
+
+enum class BinaryReportRecordType : int64_t {
+  kString = 1,  // The bytes of the interned string.
+  // The iteration, whether the tests are shuffled and the random seed.
+  kIterationStart,
+  // The positions of the test suite in the unit test and of the test in the
+  // test suite, the name, type parameter (interned) and value parameter
+  // (whether the test has one, then inline) of the test, its file name and
+  // line number, whether it runs, and its result, optionally followed by its
+  // benchmark result: the number of samples, then, if there are any, the
+  // iterations per sample and the mean, median and standard deviation of the
+  // time per iteration (as the bits of doubles); then optionally by whether
+  // its resource usage was measured, and if so the fields of ResourceUsage
+  // in the order they are declared; then optionally by whether its
+  // allocations were counted, and if so the fields of AllocationStats; then
+  // optionally by whether its phases were timed, and if so the fields of
+  // TestPhaseTimes.
+  kTest,
+  // The position of the test suite in the unit test, its name and type
+  // parameter (interned), start timestamp and elapsed time, and the result
+  // of its set-up and tear-down, optionally followed by whether its phases
+  // were timed, and if so the time of its set-up and tear-down.
+  kTestSuite,
+  // The start timestamp and elapsed time of the iteration and the result of
+  // the global environments, optionally followed by whether the phases were
+  // timed, and if so the time of the environments' set-up and tear-down.
+  kIterationEnd,
+};
 
-// Checks if str contains '=', '&', '%' or '\n' characters. If yes,
-// replaces them by "%xx" where xx is their hexadecimal value. For
-// example, replaces "=" with "%3D".  This algorithm is O(strlen(str))
-// in both time and space -- important as the input str may contain an
-// arbitrarily long test failure message and stack trace.
-std::string StreamingListener::UrlEncode(const char* str) {
-  std::string result;
-  result.reserve(strlen(str) + 1);
-  for (char ch = *str; ch != '\0'; ch = *++str) {
-    switch (ch) {
-      case '%':
-      case '=':
-      case '&':
-      case '\n':
-        result.push_back('%');
-        result.append(String::FormatByte(static_cast<unsigned char>(ch)));
-        break;
-      default:
-        result.push_back(ch);
-        break;
-    }
-  }
-  return result;
-}
+// A result is stored as its start timestamp and elapsed time, then its test
+// part results, each as its type, file name (interned), line number and
+// message (inline), then its properties, each as its key (interned) and value
+// (inline), both lists prefixed by their size.
 
-void StreamingListener::SocketWriter::MakeConnection() {
-  GTEST_CHECK_(sockfd_ == -1)
-      << "MakeConnection() can't be called when there is already a connection.";
+// This class writes a binary report of the test events as they happen, so
+// that it takes little memory and little time however many tests run.  The
+// iterations of --gtest_repeat all go to the same file.
+class BinaryUnitTestResultPrinter : public EmptyTestEventListener {
+ public:
+  explicit BinaryUnitTestResultPrinter(const char* output_file);
+  ~BinaryUnitTestResultPrinter() override;
 
-  addrinfo hints;
-  memset(&hints, 0, sizeof(hints));
-  hints.ai_family = AF_UNSPEC;  // To allow both IPv4 and IPv6 addresses.
-  hints.ai_socktype = SOCK_STREAM;
-  addrinfo* servinfo = nullptr;
-
-  // Use the getaddrinfo() to get a linked list of IP addresses for
-  // the given host name.
-  const int error_num =
-      getaddrinfo(host_name_.c_str(), port_num_.c_str(), &hints, &servinfo);
-  if (error_num != 0) {
-    GTEST_LOG_(WARNING) << "stream_result_to: getaddrinfo() failed: "
-                        << gai_strerror(error_num);
-  }
-
-  // Loop through all the results and connect to the first we can.
-  for (addrinfo* cur_addr = servinfo; sockfd_ == -1 && cur_addr != nullptr;
-       cur_addr = cur_addr->ai_next) {
-    sockfd_ = socket(cur_addr->ai_family, cur_addr->ai_socktype,
-                     cur_addr->ai_protocol);
-    if (sockfd_ != -1) {
-      // Connect the client socket to the server socket.
-      if (connect(sockfd_, cur_addr->ai_addr, cur_addr->ai_addrlen) == -1) {
-        close(sockfd_);
-        sockfd_ = -1;
-      }
-    }
-  }
+  void OnTestIterationStart(const UnitTest& unit_test, int iteration) override;
+  void OnTestSuiteStart(const TestSuite& test_suite) override;
+  void OnTestEnd(const TestInfo& test_info) override;
+  void OnTestSuiteEnd(const TestSuite& test_suite) override;
+  void OnTestIterationEnd(const UnitTest& unit_test, int iteration) override;
 
-  freeaddrinfo(servinfo);  // all done with this structure
+ private:
+  void AddInt(int64_t value);
+  void AddInlineString(const std::string& value);
+  void AddInternedString(const char* value);
+  void AddResult(const TestResult& result);
+  void AddTest(int test_suite_position, int test_position,
+               const TestInfo& test_info);
+  void AddTestSuite(int position, const TestSuite& test_suite);
 
-  if (sockfd_ == -1) {
-    GTEST_LOG_(WARNING) << "stream_result_to: failed to connect to "
-                        << host_name_ << ":" << port_num_;
-  }
-}
+  // Writes the record made of the fields added since the last one.
+  void WriteRecord(BinaryReportRecordType type);
 
-// End of class Streaming Listener
-#endif  // GTEST_CAN_STREAM_RESULTS__
+  // The output file.
+  const std::string output_file_;
+  FILE* file_ = nullptr;
 
-// class OsStackTraceGetter
+  // The ids of the interned strings.
+  std::unordered_map<std::string, int64_t> string_ids_;
+  // The fields of the record being built.
+  std::string record_;
 
-const char* const OsStackTraceGetterInterface::kElidedFramesMarker =
-    "... " GTEST_NAME_ " internal frames ...";
+  // The unit test of the current iteration, the position of the test suite
+  // last started, and the position of the test last finished in it.
+  const UnitTest* unit_test_ = nullptr;
+  int test_suite_position_ = 0;
+  int test_position_ = 0;
 
-std::string OsStackTraceGetter::CurrentStackTrace(int max_depth, int skip_count)
-    GTEST_LOCK_EXCLUDED_(mutex_) {
-#ifdef GTEST_HAS_ABSL
-  std::string result;
+  BinaryUnitTestResultPrinter(const BinaryUnitTestResultPrinter&) = delete;
+  BinaryUnitTestResultPrinter& operator=(const BinaryUnitTestResultPrinter&) =
+      delete;
+};
 
-  if (max_depth <= 0) {
-    return result;
+// Appends value to out as a zigzag-encoded LEB128 varint.
+static void AppendVarint(int64_t value, std::string* out) {
+  uint64_t bits = (static_cast<uint64_t>(value) << 1) ^
+                  static_cast<uint64_t>(value < 0 ? -1 : 0);
+  while (bits >= 0x80) {
+    out->push_back(static_cast<char>((bits & 0x7f) | 0x80));
+    bits >>= 7;
   }
+  out->push_back(static_cast<char>(bits));
+}
 
-  max_depth = std::min(max_depth, kMaxStackTraceDepth);
+BinaryUnitTestResultPrinter::BinaryUnitTestResultPrinter(
+    const char* output_file)
+    : output_file_(output_file) {
+  if (output_file_.empty()) {
+    GTEST_LOG_(FATAL) << "Binary output file may not be null";
+  }
+}
 
-  std::vector<void*> raw_stack(max_depth);
-  // Skips the frames requested by the caller, plus this function.
-  const int raw_stack_size =
-      absl::GetStackTrace(&raw_stack[0], max_depth, skip_count + 1);
+BinaryUnitTestResultPrinter::~BinaryUnitTestResultPrinter() {
+  if (file_ != nullptr) fclose(file_);
+}
 
-  void* caller_frame = nullptr;
-  {
-    MutexLock lock(mutex_);
-    caller_frame = caller_frame_;
+void BinaryUnitTestResultPrinter::OnTestIterationStart(
+    const UnitTest& unit_test, int iteration) {
+  if (file_ == nullptr) {
+    file_ = OpenFileForWriting(output_file_, /*binary=*/true);
+    std::string header(kBinaryReportMagic);
+    AppendVarint(kBinaryReportVersion, &header);
+    fwrite(header.data(), 1, header.size(), file_);
   }
+  unit_test_ = &unit_test;
+  test_suite_position_ = 0;
+  AddInt(iteration);
+  AddInt(GTEST_FLAG_GET(shuffle));
+  AddInt(unit_test.random_seed());
+  WriteRecord(BinaryReportRecordType::kIterationStart);
+}
 
-  for (int i = 0; i < raw_stack_size; ++i) {
-    if (raw_stack[i] == caller_frame &&
-        !GTEST_FLAG_GET(show_internal_stack_frames)) {
-      // Add a marker to the trace and stop adding frames.
-      absl::StrAppend(&result, kElidedFramesMarker, "\n");
+void BinaryUnitTestResultPrinter::OnTestSuiteStart(
+    const TestSuite& test_suite) {
+  // The test suites start in the order of their positions.
+  const int count = unit_test_->total_test_suite_count();
+  for (int i = 0; i < count; i++) {
+    const int position = (test_suite_position_ + i) % count;
+    if (unit_test_->GetTestSuite(position) == &test_suite) {
+      test_suite_position_ = position;
       break;
     }
+  }
+  test_position_ = 0;
+}
 
-    char tmp[1024];
-    const char* symbol = "(unknown)";
-    if (absl::Symbolize(raw_stack[i], tmp, sizeof(tmp))) {
-      symbol = tmp;
+void BinaryUnitTestResultPrinter::OnTestEnd(const TestInfo& test_info) {
+  // The tests of a test suite run in the order of their positions.
+  const TestSuite* const test_suite =
+      unit_test_->GetTestSuite(test_suite_position_);
+  const int count = test_suite->total_test_count();
+  for (int i = 0; i < count; i++) {
+    const int position = (test_position_ + i) % count;
+    if (test_suite->GetTestInfo(position) == &test_info) {
+      test_position_ = position;
+      break;
     }
+  }
+  AddTest(test_suite_position_, test_position_, test_info);
+}
 
-    char line[1024];
-    snprintf(line, sizeof(line), "  %p: %s\n", raw_stack[i], symbol);
-    result += line;
+void BinaryUnitTestResultPrinter::OnTestSuiteEnd(const TestSuite& test_suite) {
+  // The tests that did not run, which have no events, are reported too.
+  for (int i = 0; i < test_suite.total_test_count(); i++) {
+    const TestInfo& test_info = *test_suite.GetTestInfo(i);
+    if (test_info.is_reportable() && !test_info.should_run()) {
+      AddTest(test_suite_position_, i, test_info);
+    }
   }
+  AddTestSuite(test_suite_position_, test_suite);
+  fflush(file_);
+}
 
-  return result;
+void BinaryUnitTestResultPrinter::OnTestIterationEnd(const UnitTest& unit_test,
+                                                     int /*iteration*/) {
+  // So are the test suites that did not run.
+  for (int i = 0; i < unit_test.total_test_suite_count(); i++) {
+    const TestSuite& test_suite = *unit_test.GetTestSuite(i);
+    if (test_suite.should_run() || test_suite.reportable_test_count() == 0) {
+      continue;
+    }
+    for (int j = 0; j < test_suite.total_test_count(); j++) {
+      if (test_suite.GetTestInfo(j)->is_reportable()) {
+        AddTest(i, j, *test_suite.GetTestInfo(j));
+      }
+    }
+    AddTestSuite(i, test_suite);
+  }
+  AddInt(unit_test.start_timestamp());
+  AddInt(unit_test.elapsed_time_nanos());
+  AddResult(unit_test.ad_hoc_test_result());
+  AddInt(unit_test.HasPhaseTimes());
+  if (unit_test.HasPhaseTimes()) {
+    AddInt(unit_test.environments_set_up_nanos());
+    AddInt(unit_test.environments_tear_down_nanos());
+  }
+  WriteRecord(BinaryReportRecordType::kIterationEnd);
+  fflush(file_);
+}
 
-#else   // !GTEST_HAS_ABSL
-  static_cast<void>(max_depth);
-  static_cast<void>(skip_count);
-  return "";
-#endif  // GTEST_HAS_ABSL
+void BinaryUnitTestResultPrinter::AddInt(int64_t value) {
+  AppendVarint(value, &record_);
 }
 
-void OsStackTraceGetter::UponLeavingGTest() GTEST_LOCK_EXCLUDED_(mutex_) {
-#ifdef GTEST_HAS_ABSL
-  void* caller_frame = nullptr;
-  if (absl::GetStackTrace(&caller_frame, 1, 3) <= 0) {
-    caller_frame = nullptr;
-  }
+void BinaryUnitTestResultPrinter::AddInlineString(const std::string& value) {
+  AddInt(static_cast<int64_t>(value.size()));
+  record_ += value;
+}
 
-  MutexLock lock(mutex_);
-  caller_frame_ = caller_frame;
-#endif  // GTEST_HAS_ABSL
+void BinaryUnitTestResultPrinter::AddInternedString(const char* value) {
+  if (value == nullptr) {
+    AddInt(0);
+    return;
+  }
+  const auto inserted = string_ids_.insert(
+      {value, static_cast<int64_t>(string_ids_.size()) + 1});
+  if (inserted.second) {
+    // The string goes in a record of its own, ahead of the one being built.
+    std::string record;
+    record.swap(record_);
+    record_ = value;
+    WriteRecord(BinaryReportRecordType::kString);
+    record_.swap(record);
+  }
+  AddInt(inserted.first->second);
 }
 
-#ifdef GTEST_INTERNAL_HAS_PREMATURE_EXIT_FILE
-// A helper class that creates the premature-exit file in its
-// constructor and deletes the file in its destructor.
-class ScopedPrematureExitFile {
+void BinaryUnitTestResultPrinter::AddResult(const TestResult& result) {
+  AddInt(result.start_timestamp());
+  AddInt(result.elapsed_time_nanos());
+  AddInt(result.total_part_count());
+  for (int i = 0; i < result.total_part_count(); i++) {
+    const TestPartResult& part = result.GetTestPartResult(i);
+    AddInt(part.type());
+    AddInternedString(part.file_name());
+    AddInt(part.line_number());
+    AddInlineString(part.message());
+  }
+  AddInt(result.test_property_count());
+  for (int i = 0; i < result.test_property_count(); i++) {
+    AddInternedString(result.GetTestProperty(i).key());
+    AddInlineString(result.GetTestProperty(i).value());
+  }
+}
+
+void BinaryUnitTestResultPrinter::AddTest(int test_suite_position,
+                                          int test_position,
+                                          const TestInfo& test_info) {
+  AddInt(test_suite_position);
+  AddInt(test_position);
+  AddInternedString(test_info.name());
+  AddInternedString(test_info.type_param());
+  AddInt(test_info.value_param() != nullptr);
+  AddInlineString(test_info.value_param() != nullptr ? test_info.value_param()
+                                                     : "");
+  AddInternedString(test_info.file());
+  AddInt(test_info.line());
+  AddInt(test_info.should_run());
+  AddResult(*test_info.result());
+  const BenchmarkResult& benchmark = test_info.result()->benchmark_result();
+  AddInt(benchmark.samples());
+  if (benchmark.samples() > 0) {
+    AddInt(benchmark.iterations());
+    AddInt(DoubleToBits(benchmark.mean_ns()));
+    AddInt(DoubleToBits(benchmark.median_ns()));
+    AddInt(DoubleToBits(benchmark.stddev_ns()));
+  }
+  AddInt(test_info.result()->HasResourceUsage());
+  if (test_info.result()->HasResourceUsage()) {
+    const ResourceUsage& usage = test_info.result()->resource_usage();
+    AddInt(usage.user_cpu_time_us);
+    AddInt(usage.system_cpu_time_us);
+    AddInt(usage.max_rss_kb);
+    AddInt(usage.max_rss_growth_kb);
+    AddInt(usage.minor_page_faults);
+    AddInt(usage.major_page_faults);
+    AddInt(usage.voluntary_context_switches);
+    AddInt(usage.involuntary_context_switches);
+  }
+  AddInt(test_info.result()->HasAllocationStats());
+  if (test_info.result()->HasAllocationStats()) {
+    const AllocationStats& stats = test_info.result()->allocation_stats();
+    AddInt(stats.count);
+    AddInt(stats.bytes);
+    AddInt(stats.peak_bytes);
+  }
+  AddInt(test_info.result()->HasPhaseTimes());
+  if (test_info.result()->HasPhaseTimes()) {
+    const TestPhaseTimes& times = test_info.result()->phase_times();
+    AddInt(times.constructor_nanos);
+    AddInt(times.set_up_nanos);
+    AddInt(times.body_nanos);
+    AddInt(times.tear_down_nanos);
+    AddInt(times.destructor_nanos);
+  }
+  WriteRecord(BinaryReportRecordType::kTest);
+}
+
+void BinaryUnitTestResultPrinter::AddTestSuite(int position,
+                                               const TestSuite& test_suite) {
+  AddInt(position);
+  AddInternedString(test_suite.name());
+  AddInternedString(test_suite.type_param());
+  AddInt(test_suite.start_timestamp());
+  AddInt(test_suite.elapsed_time_nanos());
+  AddResult(test_suite.ad_hoc_test_result());
+  AddInt(test_suite.HasPhaseTimes());
+  if (test_suite.HasPhaseTimes()) {
+    AddInt(test_suite.set_up_test_suite_nanos());
+    AddInt(test_suite.tear_down_test_suite_nanos());
+  }
+  WriteRecord(BinaryReportRecordType::kTestSuite);
+}
+
+void BinaryUnitTestResultPrinter::WriteRecord(BinaryReportRecordType type) {
+  std::string type_field;
+  AppendVarint(static_cast<int64_t>(type), &type_field);
+  std::string header;
+  AppendVarint(static_cast<int64_t>(type_field.size() + record_.size()),
+               &header);
+  header += type_field;
+  fwrite(header.data(), 1, header.size(), file_);
+  fwrite(record_.data(), 1, record_.size(), file_);
+  record_.clear();
+}
+
+// End BinaryUnitTestResultPrinter
+
+namespace {
+
+// Reads the records of a binary report.  A field read past the end of its
+// record makes the record invalid rather than failing right away.
+class BinaryReportReader {
  public:
-  explicit ScopedPrematureExitFile(const char* premature_exit_filepath)
-      : premature_exit_filepath_(
-            premature_exit_filepath ? premature_exit_filepath : "") {
-    // If a path to the premature-exit file is specified...
-    if (!premature_exit_filepath_.empty()) {
-      // create the file with a single "0" character in it.  I/O
-      // errors are ignored as there's nothing better we can do and we
-      // don't want to fail the test because of this.
-      if (FILE* pfile = posix::FOpen(premature_exit_filepath_.c_str(), "w")) {
-        fwrite("0", 1, 1, pfile);
-        fclose(pfile);
-      } else {
-        premature_exit_filepath_.clear();
+  explicit BinaryReportReader(FILE* file) : file_(file) {}
+
+  // Checks that the report starts with a header of a known version.
+  bool ReadHeader() {
+    char magic[sizeof(kBinaryReportMagic) - 1];
+    uint64_t version;
+    return fread(magic, 1, sizeof(magic), file_) == sizeof(magic) &&
+           memcmp(magic, kBinaryReportMagic, sizeof(magic)) == 0 &&
+           ReadFileVarint(&version) &&
+           DecodeZigzag(version) == kBinaryReportVersion;
+  }
+
+  // Reads the next record other than an interned string, returning its
+  // type.  Returns false at the end of the report, which a record cut short
+  // also marks: a test program killed in the middle of writing one leaves the
+  // records before it readable.
+  bool NextRecord(BinaryReportRecordType* type) {
+    for (;;) {
+      uint64_t bits;
+      if (!ReadFileVarint(&bits)) return false;
+      const int64_t size = DecodeZigzag(bits);
+      if (size <= 0) return false;
+      record_.resize(static_cast<size_t>(size));
+      position_ = 0;
+      valid_ = true;
+      if (fread(&record_[0], 1, record_.size(), file_) != record_.size()) {
+        return false;
       }
+      *type = static_cast<BinaryReportRecordType>(ReadInt());
+      if (*type != BinaryReportRecordType::kString) return true;
+      strings_.push_back(record_.substr(position_));
     }
   }
 
-  ~ScopedPrematureExitFile() {
-#ifndef GTEST_OS_ESP8266
-    if (!premature_exit_filepath_.empty()) {
-      int retval = remove(premature_exit_filepath_.c_str());
-      if (retval) {
-        GTEST_LOG_(ERROR) << "Failed to remove premature exit filepath \""
-                          << premature_exit_filepath_ << "\" with error "
-                          << retval;
-      }
+  // Whether the fields read so far belong to the current record.
+  bool valid() const { return valid_; }
+
+  // Whether all the fields of the current record have been read, which
+  // tells the fields that older versions of a record lack.
+  bool AtEndOfRecord() const { return position_ == record_.size(); }
+
+  int64_t ReadInt() {
+    uint64_t bits = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (position_ == record_.size()) break;
+      const unsigned char byte =
+          static_cast<unsigned char>(record_[position_++]);
+      bits |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) return DecodeZigzag(bits);
     }
-#endif
+    valid_ = false;
+    return 0;
+  }
+
+  std::string ReadInlineString() {
+    const int64_t size = ReadInt();
+    if (size < 0 || static_cast<uint64_t>(size) > record_.size() - position_) {
+      valid_ = false;
+      return std::string();
+    }
+    std::string value = record_.substr(position_, static_cast<size_t>(size));
+    position_ += static_cast<size_t>(size);
+    return value;
+  }
+
+  // Returns the interned string the next field refers to, or nullptr for a
+  // null string.
+  const char* ReadInternedString() {
+    const int64_t id = ReadInt();
+    if (id == 0) return nullptr;
+    if (id < 0 || static_cast<uint64_t>(id) > strings_.size()) {
+      valid_ = false;
+      return nullptr;
+    }
+    return strings_[static_cast<size_t>(id - 1)].c_str();
   }
 
  private:
-  std::string premature_exit_filepath_;
+  static int64_t DecodeZigzag(uint64_t bits) {
+    return static_cast<int64_t>(bits >> 1) ^ -static_cast<int64_t>(bits & 1);
+  }
 
-  ScopedPrematureExitFile(const ScopedPrematureExitFile&) = delete;
-  ScopedPrematureExitFile& operator=(const ScopedPrematureExitFile&) = delete;
-};
-#endif  // GTEST_INTERNAL_HAS_PREMATURE_EXIT_FILE
+  bool ReadFileVarint(uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      const int byte = fgetc(file_);
+      if (byte == EOF) return false;
+      *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+  }
 
-}  // namespace internal
+  FILE* const file_;
+  // The interned strings, by id - 1.  A deque keeps them in place.
+  std::deque<std::string> strings_;
+  std::string record_;
+  size_t position_ = 0;
+  bool valid_ = true;
+};
 
-// class TestEventListeners
+// A test of a binary report, which only serves to be reported.
+class BinaryReportTestFactory : public TestFactoryBase {
+ public:
+  Test* CreateTest() override { return nullptr; }
+};
 
-TestEventListeners::TestEventListeners()
-    : repeater_(new internal::TestEventRepeater()),
-      default_result_printer_(nullptr),
-      default_xml_generator_(nullptr) {}
+}  // namespace
 
-TestEventListeners::~TestEventListeners() { delete repeater_; }
+bool UnitTestImpl::LoadBinaryReport(FILE* file, int iteration,
+                                    std::string* error) {
+  BinaryReportReader reader(file);
+  if (!reader.ReadHeader()) {
+    *error = "Not a binary report of a supported version.";
+    return false;
+  }
 
-// Returns the standard listener responsible for the default console
+  struct LoadedTest {
+    const char* name;
+    const char* type_param;
+    bool has_value_param;
+    std::string value_param;
+    const char* file;
+    int line;
+    bool should_run;
+    TestResult result;
+  };
+  struct LoadedTestSuite {
+    const char* name = nullptr;
+    const char* type_param = nullptr;
+    TimeInMillis start_timestamp = 0;
+    TimeInNanos elapsed_time = 0;
+    TestResult ad_hoc_test_result;
+    bool has_phase_times = false;
+    TimeInNanos set_up_test_suite_nanos = 0;
+    TimeInNanos tear_down_test_suite_nanos = 0;
+    // The tests by position.
+    std::map<int64_t, LoadedTest> tests;
+  };
+  // The test suites of the iteration being loaded by position.  A test suite
+  // without a name has not been finished.
+  std::map<int64_t, LoadedTestSuite> test_suites;
+  bool found = false;
+  bool loading = false;
+  bool shuffle = false;
+
+  const auto read_result = [&reader](TestResult* result) {
+    result->start_timestamp_ = reader.ReadInt();
+    result->elapsed_time_nanos_ = reader.ReadInt();
+    for (int64_t n = reader.ReadInt(); n > 0 && reader.valid(); n--) {
+      const auto type = static_cast<TestPartResult::Type>(reader.ReadInt());
+      const char* const file_name = reader.ReadInternedString();
+      const int line_number = static_cast<int>(reader.ReadInt());
+      result->test_part_results_.push_back(TestPartResult(
+          type, file_name, line_number, reader.ReadInlineString().c_str()));
+    }
+    for (int64_t n = reader.ReadInt(); n > 0 && reader.valid(); n--) {
+      const char* const key = reader.ReadInternedString();
+      result->test_properties_.push_back(
+          TestProperty(key == nullptr ? "" : key, reader.ReadInlineString()));
+    }
+  };
+
+  BinaryReportRecordType type;
+  while (reader.NextRecord(&type)) {
+    if (type == BinaryReportRecordType::kIterationStart) {
+      const int64_t record_iteration = reader.ReadInt();
+      if (found && iteration >= 0) break;
+      loading = iteration < 0 || record_iteration == iteration;
+      if (!loading) continue;
+      found = true;
+      test_suites.clear();
+      shuffle = reader.ReadInt() != 0;
+      random_seed_ = static_cast<int>(reader.ReadInt());
+      start_timestamp_ = 0;
+      elapsed_time_nanos_ = 0;
+      ad_hoc_test_result_.Clear();
+      has_phase_times_ = false;
+      environments_set_up_nanos_ = 0;
+      environments_tear_down_nanos_ = 0;
+    } else if (!loading) {
+      continue;
+    } else if (type == BinaryReportRecordType::kTest) {
+      LoadedTestSuite& test_suite = test_suites[reader.ReadInt()];
+      LoadedTest& test = test_suite.tests[reader.ReadInt()];
+      test.name = reader.ReadInternedString();
+      test.type_param = reader.ReadInternedString();
+      test.has_value_param = reader.ReadInt() != 0;
+      test.value_param = reader.ReadInlineString();
+      test.file = reader.ReadInternedString();
+      test.line = static_cast<int>(reader.ReadInt());
+      test.should_run = reader.ReadInt() != 0;
+      read_result(&test.result);
+      const int samples =
+          reader.AtEndOfRecord() ? 0 : static_cast<int>(reader.ReadInt());
+      if (samples > 0) {
+        const int64_t iterations = reader.ReadInt();
+        const double mean_ns = BitsToDouble(reader.ReadInt());
+        const double median_ns = BitsToDouble(reader.ReadInt());
+        const double stddev_ns = BitsToDouble(reader.ReadInt());
+        test.result.set_benchmark_result(BenchmarkResult(
+            iterations, samples, mean_ns, median_ns, stddev_ns));
+      }
+      if (!reader.AtEndOfRecord() && reader.ReadInt() != 0) {
+        ResourceUsage usage;
+        usage.user_cpu_time_us = reader.ReadInt();
+        usage.system_cpu_time_us = reader.ReadInt();
+        usage.max_rss_kb = reader.ReadInt();
+        usage.max_rss_growth_kb = reader.ReadInt();
+        usage.minor_page_faults = reader.ReadInt();
+        usage.major_page_faults = reader.ReadInt();
+        usage.voluntary_context_switches = reader.ReadInt();
+        usage.involuntary_context_switches = reader.ReadInt();
+        test.result.set_resource_usage(usage);
+      }
+      if (!reader.AtEndOfRecord() && reader.ReadInt() != 0) {
+        AllocationStats stats;
+        stats.count = reader.ReadInt();
+        stats.bytes = reader.ReadInt();
+        stats.peak_bytes = reader.ReadInt();
+        test.result.set_allocation_stats(stats);
+      }
+      if (!reader.AtEndOfRecord() && reader.ReadInt() != 0) {
+        TestPhaseTimes& times = test.result.phase_times_;
+        test.result.has_phase_times_ = true;
+        times.constructor_nanos = reader.ReadInt();
+        times.set_up_nanos = reader.ReadInt();
+        times.body_nanos = reader.ReadInt();
+        times.tear_down_nanos = reader.ReadInt();
+        times.destructor_nanos = reader.ReadInt();
+      }
+    } else if (type == BinaryReportRecordType::kTestSuite) {
+      LoadedTestSuite& test_suite = test_suites[reader.ReadInt()];
+      test_suite.name = reader.ReadInternedString();
+      test_suite.type_param = reader.ReadInternedString();
+      test_suite.start_timestamp = reader.ReadInt();
+      test_suite.elapsed_time = reader.ReadInt();
+      read_result(&test_suite.ad_hoc_test_result);
+      if (!reader.AtEndOfRecord() && reader.ReadInt() != 0) {
+        test_suite.has_phase_times = true;
+        test_suite.set_up_test_suite_nanos = reader.ReadInt();
+        test_suite.tear_down_test_suite_nanos = reader.ReadInt();
+      }
+    } else if (type == BinaryReportRecordType::kIterationEnd) {
+      start_timestamp_ = reader.ReadInt();
+      elapsed_time_nanos_ = reader.ReadInt();
+      read_result(&ad_hoc_test_result_);
+      if (!reader.AtEndOfRecord() && reader.ReadInt() != 0) {
+        has_phase_times_ = true;
+        environments_set_up_nanos_ = reader.ReadInt();
+        environments_tear_down_nanos_ = reader.ReadInt();
+      }
+      loading = false;
+    }
+    if (!reader.valid()) {
+      *error = "Malformed record in the binary report.";
+      return false;
+    }
+  }
+  if (!found) {
+    *error = "The binary report does not hold the requested iteration.";
+    return false;
+  }
+
+  GTEST_FLAG_SET(shuffle, shuffle);
+  const UnitTestFilter disable_test_filter(kDisableTestFilter);
+  for (auto& loaded_test_suite : test_suites) {
+    LoadedTestSuite& loaded = loaded_test_suite.second;
+    if (loaded.name == nullptr || loaded.tests.empty()) continue;
+    TestSuite* const test_suite =
+        GetTestSuite(loaded.name, loaded.type_param, nullptr, nullptr);
+    test_suite->start_timestamp_ = loaded.start_timestamp;
+    test_suite->elapsed_time_nanos_ = loaded.elapsed_time;
+    test_suite->has_phase_times_ = loaded.has_phase_times;
+    test_suite->set_up_test_suite_nanos_ = loaded.set_up_test_suite_nanos;
+    test_suite->tear_down_test_suite_nanos_ = loaded.tear_down_test_suite_nanos;
+    test_suite->ad_hoc_test_result_.test_part_results_.swap(
+        loaded.ad_hoc_test_result.test_part_results_);
+    test_suite->ad_hoc_test_result_.test_properties_.swap(
+        loaded.ad_hoc_test_result.test_properties_);
+    const bool test_suite_is_disabled =
+        disable_test_filter.MatchesName(loaded.name);
+    for (auto& loaded_test : loaded.tests) {
+      LoadedTest& test = loaded_test.second;
+      TestInfo* const test_info = MakeTestInfo(
+          loaded.name, test.name == nullptr ? "" : test.name, test.type_param,
+          test.has_value_param ? test.value_param.c_str() : nullptr,
+          CodeLocation(test.file == nullptr ? "" : test.file, test.line),
+          GetTestTypeId(), new BinaryReportTestFactory);
+      test_info->is_disabled_ =
+          test_suite_is_disabled ||
+          disable_test_filter.MatchesName(test_info->name());
+      test_info->matches_filter_ = true;
+      test_info->is_in_another_shard_ = false;
+      test_info->should_run_ = test.should_run;
+      test_info->result_.start_timestamp_ = test.result.start_timestamp_;
+      test_info->result_.elapsed_time_nanos_ = test.result.elapsed_time_nanos_;
+      test_info->result_.test_part_results_.swap(
+          test.result.test_part_results_);
+      test_info->result_.test_properties_.swap(test.result.test_properties_);
+      test_info->result_.benchmark_result_ = test.result.benchmark_result_;
+      test_info->result_.has_resource_usage_ = test.result.has_resource_usage_;
+      test_info->result_.resource_usage_ = test.result.resource_usage_;
+      test_info->result_.has_allocation_stats_ =
+          test.result.has_allocation_stats_;
+      test_info->result_.allocation_stats_ = test.result.allocation_stats_;
+      test_info->result_.has_phase_times_ = test.result.has_phase_times_;
+      test_info->result_.phase_times_ = test.result.phase_times_;
+      test_suite->AddTestInfo(test_info);
+      test_suite->set_should_run(test_suite->should_run() || test.should_run);
+    }
+  }
+  return true;
+}
+
+bool ConvertBinaryReport(const std::string& input_file,
+                         const std::string& output, int iteration,
+                         std::string* error) {
+  const size_t colon = output.find(':');
+  const std::string format = output.substr(0, colon);
+  if (colon == std::string::npos || (format != "xml" && format != "json")) {
+    *error = "The output must be \"xml:PATH\" or \"json:PATH\".";
+    return false;
+  }
+  FILE* const input = posix::FOpen(input_file.c_str(), "rb");
+  if (input == nullptr) {
+    *error = "Unable to open file \"" + input_file + "\".";
+    return false;
+  }
+  const bool loaded =
+      GetUnitTestImpl()->LoadBinaryReport(input, iteration, error);
+  fclose(input);
+  if (!loaded) return false;
+
+  FILE* const fileout = OpenFileForWriting(output.substr(colon + 1));
+  FileStreamBuf buffer(fileout);
+  std::ostream stream(&buffer);
+  if (format == "xml") {
+    XmlUnitTestResultPrinter::PrintXmlUnitTest(&stream,
+                                               *UnitTest::GetInstance());
+  } else {
+    JsonUnitTestResultPrinter::PrintJsonUnitTest(&stream,
+                                                 *UnitTest::GetInstance());
+  }
+  fclose(fileout);
+  return true;
+}
+#endif  // GTEST_HAS_FILE_SYSTEM
+
+#if GTEST_CAN_STREAM_RESULTS_
+
+// Writes out the buffered events of --gtest_stream_result_to at the first
+// event this many milliseconds after they were last written out, so that a
+// slow test does not hold back the events before it.
+constexpr TimeInMillis kStreamResultsWriteIntervalMillis = 1000;
+
+// How long closing the connection waits for the receiver to accept the
+// buffered events when the events that do not fit are dropped.
+constexpr int kStreamResultsCloseTimeoutMillis = 1000;
+
+// Appends [begin, end) to *out, replacing '=', '&', '%' and '\n' characters
+// by "%xx" where xx is their hexadecimal value.  The runs of bytes in between
+// are copied as they are.
+static void AppendUrlEncoded(const char* begin, const char* end,
+                             std::string* out) {
+  for (const char* p = begin; p != end;) {
+    const char* const next = FindByteToEscape(p, end, "%=&");
+    out->append(p, next);
+    if (next == end) break;
+    if (*next == '\n' || *next == '%' || *next == '=' || *next == '&') {
+      out->push_back('%');
+      AppendHexByte(static_cast<unsigned char>(*next), out);
+    } else {
+      out->push_back(*next);
+    }
+    p = next + 1;
+  }
+}
+
+// Appends the size of the bytes that follow it in a compact frame: an
+// unsigned LEB128 varint.
+static void AppendFrameSize(size_t size, std::string* out) {
+  while (size >= 0x80) {
+    out->push_back(static_cast<char>((size & 0x7f) | 0x80));
+    size >>= 7;
+  }
+  out->push_back(static_cast<char>(size));
+}
+
+// Checks if str contains '=', '&', '%' or '\n' characters. If yes,
+// replaces them by "%xx" where xx is their hexadecimal value. For
+// example, replaces "=" with "%3D".  This algorithm is O(strlen(str))
+// in both time and space -- important as the input str may contain an
+// arbitrarily long test failure message and stack trace.
+std::string StreamingListener::UrlEncode(const char* str) {
+  std::string result;
+  const size_t length = strlen(str);
+  result.reserve(length + 1);
+  AppendUrlEncoded(str, str + length, &result);
+  return result;
+}
+
+// A text event is a line "event=NAME&KEY=VALUE&...", with the values
+// URL-encoded.  A compact event is the size of the rest of the frame, then
+// the name, each key, and each value as its size followed by its bytes,
+// the sizes being unsigned LEB128 varints.
+void StreamingListener::AppendEvent(bool compact, const char* name,
+                                    std::initializer_list<Field> fields,
+                                    std::string* out) {
+  if (!compact) {
+    *out += "event=";
+    *out += name;
+    for (const Field& field : fields) {
+      *out += '&';
+      *out += field.first;
+      *out += '=';
+      AppendUrlEncoded(field.second.data(),
+                       field.second.data() + field.second.size(), out);
+    }
+    *out += '\n';
+    return;
+  }
+
+  std::string frame;
+  const size_t name_size = strlen(name);
+  AppendFrameSize(name_size, &frame);
+  frame.append(name, name_size);
+  for (const Field& field : fields) {
+    const size_t key_size = strlen(field.first);
+    AppendFrameSize(key_size, &frame);
+    frame.append(field.first, key_size);
+    AppendFrameSize(field.second.size(), &frame);
+    frame += field.second;
+  }
+  AppendFrameSize(frame.size(), out);
+  *out += frame;
+}
+
+// Returns true if address names a Unix domain socket: "unix:" followed by an
+// absolute path, or on Linux by '@' and a name in the abstract namespace.
+// Other addresses starting with "unix:" are HOST:PORT, for a host named
+// "unix".
+static bool IsUnixSocketAddress(const std::string& address) {
+  return address.size() > 5 && address.compare(0, 5, "unix:") == 0 &&
+         (address[5] == '/' || address[5] == '@');
+}
+
+bool StreamingListener::ParseTarget(const std::string& target,
+                                    std::string* address, Options* options,
+                                    std::string* error) {
+  *options = Options();
+  const size_t question = target.find('?');
+  *address = target.substr(0, question);
+  const bool is_ring = address->compare(0, 4, "shm:") == 0;
+  if (is_ring || IsUnixSocketAddress(*address) || *address == "unix:") {
+    const size_t colon = address->find(':');
+    if (colon + 1 == address->size()) {
+      *error = "missing path after \"" + address->substr(0, colon + 1) + "\"";
+      return false;
+    }
+    // The ring holds the events as they are framed by framing=compact.
+    options->compact = is_ring;
+  } else {
+    const size_t colon = address->rfind(':');
+    if (colon == std::string::npos || colon == 0 ||
+        colon + 1 == address->size()) {
+      *error = "expected HOST:PORT, unix:PATH or shm:PATH";
+      return false;
+    }
+  }
+  if (question == std::string::npos) return true;
+
+  const auto is_size = [](const std::string& value) {
+    return !value.empty() &&
+           value.find_first_not_of("0123456789") == std::string::npos;
+  };
+  std::vector<std::string> fields;
+  SplitString(target.substr(question + 1), '&', &fields);
+  for (const std::string& field : fields) {
+    const size_t equal = field.find('=');
+    if (equal == std::string::npos) {
+      *error = "missing '=' in option \"" + field + "\"";
+      return false;
+    }
+    const std::string name = field.substr(0, equal);
+    const std::string value = field.substr(equal + 1);
+    if (is_ring) {
+      if (name == "size" && is_size(value) &&
+          value.find_first_not_of('0') != std::string::npos) {
+        options->ring_size =
+            static_cast<size_t>(strtoull(value.c_str(), nullptr, 10));
+      } else {
+        *error = "invalid option \"" + field + "\" for shm:PATH";
+        return false;
+      }
+    } else if (name == "framing" && (value == "text" || value == "compact")) {
+      options->compact = value == "compact";
+    } else if (name == "buffer" && is_size(value)) {
+      options->buffer_size =
+          static_cast<size_t>(strtoull(value.c_str(), nullptr, 10));
+    } else if (name == "overflow" && (value == "block" || value == "drop")) {
+      options->drop_on_overflow = value == "drop";
+    } else {
+      *error = "invalid option \"" + field + "\"";
+      return false;
+    }
+  }
+  return true;
+}
+
+StreamingListener::AbstractSocketWriter* StreamingListener::MakeWriter(
+    const std::string& address, const Options& options) {
+  if (address.compare(0, 4, "shm:") == 0) {
+    return new RingBufferWriter(address.substr(4), options.ring_size);
+  }
+  return new SocketWriter(address, options);
+}
+
+StreamingListener::SocketWriter::SocketWriter(const std::string& address,
+                                              const Options& options)
+    : sockfd_(-1),
+      address_(address),
+      options_(options),
+      dropped_count_(0),
+      last_write_time_(GetTimeInMillis()),
+      owner_pid_(getpid()) {
+  MakeConnection();
+}
+
+void StreamingListener::SocketWriter::Send(const std::string& message) {
+  GTEST_CHECK_(sockfd_ != -1)
+      << "Send() can be called only when there is a connection.";
+
+  if (options_.drop_on_overflow && !pending_.empty() &&
+      pending_.size() + message.size() > options_.buffer_size) {
+    // Makes room for the message if the receiver has caught up, and drops
+    // it otherwise.
+    Write(0);
+    if (!pending_.empty() &&
+        pending_.size() + message.size() > options_.buffer_size) {
+      ++dropped_count_;
+      return;
+    }
+  }
+  if (dropped_count_ > 0) {
+    AppendEvent(options_.compact, "EventsDropped",
+                {{"count", StreamableToString(dropped_count_)}}, &pending_);
+    dropped_count_ = 0;
+  }
+  pending_ += message;
+
+  if (pending_.size() >= options_.buffer_size ||
+      GetTimeInMillis() - last_write_time_ >=
+          kStreamResultsWriteIntervalMillis) {
+    Write(options_.drop_on_overflow ? 0 : -1);
+  }
+}
+
+void StreamingListener::SocketWriter::Flush() {
+  GTEST_CHECK_(sockfd_ != -1)
+      << "Flush() can be called only when there is a connection.";
+
+  Write(options_.drop_on_overflow ? 0 : -1);
+}
+
+void StreamingListener::SocketWriter::Write(int timeout_in_millis) {
+  if (getpid() != owner_pid_) {
+    // The parent writes out the strings this child inherited.
+    pending_.clear();
+    return;
+  }
+#ifdef MSG_NOSIGNAL
+  // A receiver that went away is reported below rather than by SIGPIPE.
+  const int flags = MSG_NOSIGNAL;
+#else
+  const int flags = 0;
+#endif
+  const TimeInMillis deadline = GetTimeInMillis() + timeout_in_millis;
+  size_t written = 0;
+  while (written < pending_.size()) {
+    const ssize_t result = send(sockfd_, pending_.data() + written,
+                                pending_.size() - written, flags);
+    if (result >= 0) {
+      written += static_cast<size_t>(result);
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      // Only the non-blocking socket of "overflow=drop" gets here.
+      int wait_millis = -1;
+      if (timeout_in_millis >= 0) {
+        wait_millis = static_cast<int>(deadline - GetTimeInMillis());
+        if (wait_millis <= 0) break;
+      }
+      pollfd socket_poll = {sockfd_, POLLOUT, 0};
+      poll(&socket_poll, 1, wait_millis);
+    } else if (errno != EINTR) {
+      GTEST_LOG_(WARNING) << "stream_result_to: failed to stream to "
+                          << address_;
+      written = pending_.size();
+    }
+  }
+  pending_.erase(0, written);
+  last_write_time_ = GetTimeInMillis();
+}
+
+void StreamingListener::SocketWriter::CloseConnection() {
+  GTEST_CHECK_(sockfd_ != -1)
+      << "CloseConnection() can be called only when there is a connection.";
+
+  if (dropped_count_ > 0) {
+    AppendEvent(options_.compact, "EventsDropped",
+                {{"count", StreamableToString(dropped_count_)}}, &pending_);
+    dropped_count_ = 0;
+  }
+  Write(options_.drop_on_overflow ? kStreamResultsCloseTimeoutMillis : -1);
+  pending_.clear();
+  close(sockfd_);
+  sockfd_ = -1;
+}
+
+void StreamingListener::SocketWriter::MakeConnection() {
+  GTEST_CHECK_(sockfd_ == -1)
+      << "MakeConnection() can't be called when there is already a connection.";
+
+  if (IsUnixSocketAddress(address_)) {
+    const std::string path = address_.substr(5);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() < sizeof(addr.sun_path)) {
+      memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+      socklen_t addr_size = sizeof(addr);
+#ifdef GTEST_OS_LINUX
+      // The name of a socket in the abstract namespace starts with a NUL
+      // byte, and its length is that of the address.
+      if (path[0] == '@') {
+        addr.sun_path[0] = '\0';
+        addr_size = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) +
+                                           path.size());
+      }
+#endif  // GTEST_OS_LINUX
+      sockfd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (sockfd_ != -1 &&
+          connect(sockfd_, reinterpret_cast<const sockaddr*>(&addr),
+                  addr_size) == -1) {
+        close(sockfd_);
+        sockfd_ = -1;
+      }
+    } else {
+      GTEST_LOG_(WARNING) << "stream_result_to: socket path too long: "
+                          << path;
+    }
+  } else {
+    const size_t colon = address_.rfind(':');
+    const std::string host_name = address_.substr(0, colon);
+    const std::string port_num =
+        colon == std::string::npos ? "" : address_.substr(colon + 1);
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;  // To allow both IPv4 and IPv6 addresses.
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* servinfo = nullptr;
+
+    // Use the getaddrinfo() to get a linked list of IP addresses for
+    // the given host name.
+    const int error_num =
+        getaddrinfo(host_name.c_str(), port_num.c_str(), &hints, &servinfo);
+    if (error_num != 0) {
+      GTEST_LOG_(WARNING) << "stream_result_to: getaddrinfo() failed: "
+                          << gai_strerror(error_num);
+    }
+
+    // Loop through all the results and connect to the first we can.
+    for (addrinfo* cur_addr = servinfo; sockfd_ == -1 && cur_addr != nullptr;
+         cur_addr = cur_addr->ai_next) {
+      sockfd_ = socket(cur_addr->ai_family, cur_addr->ai_socktype,
+                       cur_addr->ai_protocol);
+      if (sockfd_ != -1) {
+        // Connect the client socket to the server socket.
+        if (connect(sockfd_, cur_addr->ai_addr, cur_addr->ai_addrlen) == -1) {
+          close(sockfd_);
+          sockfd_ = -1;
+        }
+      }
+    }
+
+    freeaddrinfo(servinfo);  // all done with this structure
+  }
+
+  if (sockfd_ == -1) {
+    GTEST_LOG_(WARNING) << "stream_result_to: failed to connect to "
+                        << address_;
+  } else if (options_.drop_on_overflow) {
+    // Sending never waits for the receiver; Write() polls when it may.
+    fcntl(sockfd_, F_SETFL, fcntl(sockfd_, F_GETFL) | O_NONBLOCK);
+  }
+}
+
+// The records of a ring buffer start at multiples of 8 bytes, with a size
+// and a sequence number.  The size kRingWrapSize marks the rest of the ring,
+// which is too short for the next record, as unused.
+constexpr uint64_t kRingRecordAlignment = 8;
+constexpr uint32_t kRingWrapSize = 0xffffffff;
+
+// The format version of the ring buffer file.
+constexpr uint32_t kRingVersion = 1;
+
+static uint64_t RingRecordSpan(uint64_t payload_size) {
+  return (8 + payload_size + kRingRecordAlignment - 1) &
+         ~(kRingRecordAlignment - 1);
+}
+
+// The layout is part of the format documented in docs/advanced.md, and read
+// by other processes as the test program writes it.
+struct StreamingListener::RingBufferWriter::Header {
+  char magic[8];  // "gtestrng"
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t capacity;
+  std::atomic<uint64_t> oldest_position;
+  std::atomic<uint64_t> write_position;
+  std::atomic<uint32_t> finished;
+  uint32_t pid;
+  char reserved[16];
+};
+
+StreamingListener::RingBufferWriter::RingBufferWriter(const std::string& path,
+                                                      size_t capacity)
+    : header_(nullptr),
+      data_(nullptr),
+      capacity_((capacity + kRingRecordAlignment - 1) &
+                ~(kRingRecordAlignment - 1)),
+      oldest_position_(0),
+      write_position_(0),
+      sequence_(0),
+      owner_pid_(getpid()) {
+  static_assert(sizeof(Header) == 64, "The ring buffer header is 64 bytes.");
+  static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                "Readers in other processes need lock-free atomics.");
+
+  // Replaces any earlier file rather than truncating it, as another process
+  // may still have that one mapped.
+  const size_t file_size = sizeof(Header) + capacity_;
+  if (unlink(path.c_str()) == -1 && errno != ENOENT) {
+    GTEST_LOG_(WARNING) << "stream_result_to: cannot replace " << path << ": "
+                        << strerror(errno);
+    return;
+  }
+  const int fd =
+      open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd == -1 || ftruncate(fd, static_cast<off_t>(file_size)) == -1) {
+    GTEST_LOG_(WARNING) << "stream_result_to: cannot create " << path << ": "
+                        << strerror(errno);
+    if (fd != -1) close(fd);
+    return;
+  }
+  void* const mapping =
+      mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    GTEST_LOG_(WARNING) << "stream_result_to: cannot map " << path << ": "
+                        << strerror(errno);
+    return;
+  }
+
+  // The file is all zeros; the magic number is set last so that a reader
+  // seeing it sees the rest of the header too.
+  header_ = new (mapping) Header();
+  header_->version = kRingVersion;
+  header_->header_size = sizeof(Header);
+  header_->capacity = capacity_;
+  header_->pid = static_cast<uint32_t>(owner_pid_);
+  data_ = static_cast<char*>(mapping) + sizeof(Header);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(header_->magic, "gtestrng", sizeof(header_->magic));
+}
+
+StreamingListener::RingBufferWriter::~RingBufferWriter() {
+  if (header_ != nullptr) munmap(header_, sizeof(Header) + capacity_);
+}
+
+uint64_t StreamingListener::RingBufferWriter::RecordSpan(
+    uint64_t position) const {
+  const uint64_t offset = position % capacity_;
+  uint32_t size;
+  memcpy(&size, data_ + offset, sizeof(size));
+  return size == kRingWrapSize ? capacity_ - offset : RingRecordSpan(size);
+}
+
+void StreamingListener::RingBufferWriter::Send(const std::string& message) {
+  if (header_ == nullptr || getpid() != owner_pid_) return;
+
+  // A record that cannot fit is skipped, leaving a gap in the sequence.
+  const uint32_t sequence = sequence_++;
+  const uint64_t span = RingRecordSpan(message.size());
+  if (span > capacity_) return;
+
+  uint64_t start = write_position_;
+  const uint64_t offset = start % capacity_;
+  const uint64_t wrap = offset + span > capacity_ ? capacity_ - offset : 0;
+  const uint64_t end = start + wrap + span;
+
+  // Moves the oldest position past the records about to be overwritten,
+  // before overwriting them, so that a reader can tell if a record changed
+  // under it.
+  while (oldest_position_ < write_position_ &&
+         oldest_position_ + capacity_ < end) {
+    oldest_position_ += RecordSpan(oldest_position_);
+  }
+  if (oldest_position_ + capacity_ < end) oldest_position_ = start + wrap;
+  header_->oldest_position.store(oldest_position_, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  if (wrap != 0) {
+    memcpy(data_ + offset, &kRingWrapSize, sizeof(kRingWrapSize));
+    start += wrap;
+  }
+  char* const record = data_ + start % capacity_;
+  const uint32_t size = static_cast<uint32_t>(message.size());
+  memcpy(record, &size, sizeof(size));
+  memcpy(record + 4, &sequence, sizeof(sequence));
+  memcpy(record + 8, message.data(), message.size());
+
+  write_position_ = end;
+  header_->write_position.store(end, std::memory_order_release);
+}
+
+void StreamingListener::RingBufferWriter::CloseConnection() {
+  if (header_ == nullptr || getpid() != owner_pid_) return;
+
+  header_->finished.store(1, std::memory_order_release);
+}
+
+// End of class Streaming Listener
+
+// class TestRequestServer
+
+bool TestRequestServer::ParseRequest(const std::string& line,
+                                     TestRunRequest* request,
+                                     std::string* error) {
+  *request = TestRunRequest();
+  if (line.empty()) return true;
+  std::vector<std::string> fields;
+  SplitString(line, '&', &fields);
+  for (const std::string& field : fields) {
+    const size_t equal = field.find('=');
+    if (equal == std::string::npos) {
+      *error = "missing '=' in field \"" + field + "\"";
+      return false;
+    }
+    const std::string name = field.substr(0, equal);
+    // Decodes the "%xx" escapes of StreamingListener::UrlEncode().
+    std::string value;
+    for (size_t i = equal + 1; i < field.size(); ++i) {
+      if (field[i] == '%' && i + 2 < field.size() &&
+          IsXDigit(field[i + 1]) && IsXDigit(field[i + 2])) {
+        value.push_back(static_cast<char>(
+            std::stoi(field.substr(i + 1, 2), nullptr, 16)));
+        i += 2;
+      } else {
+        value.push_back(field[i]);
+      }
+    }
+
+    if (name == "filter") {
+      request->filter = value;
+    } else if (name == "repeat") {
+      char* end = nullptr;
+      const long repeat = strtol(value.c_str(), &end, 10);  // NOLINT
+      if (value.empty() || *end != '\0' || repeat < 1 ||
+          repeat > std::numeric_limits<int32_t>::max()) {
+        *error = "repeat must be a positive number, not \"" + value + "\"";
+        return false;
+      }
+      request->repeat = static_cast<int32_t>(repeat);
+#if GTEST_HAS_FILE_SYSTEM
+    } else if (name == "output" &&
+               (value == "stream" || value == "xml" || value == "json")) {
+#else
+    } else if (name == "output" && value == "stream") {
+#endif  // GTEST_HAS_FILE_SYSTEM
+      request->output = value;
+    } else if (name == "output") {
+      *error = "unsupported output format \"" + value + "\"";
+      return false;
+    } else {
+      *error = "unknown field \"" + name + "\"";
+      return false;
+    }
+  }
+  return true;
+}
+
+TestRequestServer::TestRequestServer(const std::string& address)
+    : address_(address), listen_fd_(-1), input_fd_(-1), output_fd_(-1) {}
+
+TestRequestServer::~TestRequestServer() {
+  if (listen_fd_ != -1) {
+    CloseConnection();
+    close(listen_fd_);
+    unlink(address_.c_str() + strlen("unix:"));
+  } else if (output_fd_ != -1) {
+    // Gives the standard output back.
+    FlushConsoleOutput();
+    dup2(output_fd_, STDOUT_FILENO);
+    close(output_fd_);
+  }
+}
+
+bool TestRequestServer::Start(std::string* error) {
+  if (address_ == "stdin") {
+    FlushConsoleOutput();
+    input_fd_ = STDIN_FILENO;
+    output_fd_ = dup(STDOUT_FILENO);
+    if (output_fd_ == -1 || dup2(STDERR_FILENO, STDOUT_FILENO) == -1) {
+      *error = "cannot redirect the standard output";
+      return false;
+    }
+    return true;
+  }
+
+  if (address_.compare(0, strlen("unix:"), "unix:") != 0) {
+    *error = "the address must be \"stdin\" or \"unix:PATH\"";
+    return false;
+  }
+  const std::string path = address_.substr(strlen("unix:"));
+  sockaddr_un socket_address;
+  memset(&socket_address, 0, sizeof(socket_address));
+  if (path.empty() || path.size() >= sizeof(socket_address.sun_path)) {
+    *error = "invalid socket path";
+    return false;
+  }
+  socket_address.sun_family = AF_UNIX;
+  memcpy(socket_address.sun_path, path.c_str(), path.size());
+
+  // Replaces the socket of a previous server.
+  unlink(path.c_str());
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd_ == -1 ||
+      bind(listen_fd_, reinterpret_cast<const sockaddr*>(&socket_address),
+           sizeof(socket_address)) == -1 ||
+      listen(listen_fd_, 1) == -1) {
+    *error = std::string("cannot listen: ") + strerror(errno);
+    if (listen_fd_ != -1) close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+  return true;
+}
+
+bool TestRequestServer::NextRequest(std::string* line) {
+  for (;;) {
+    const size_t end = buffer_.find('\n');
+    if (end != std::string::npos) {
+      *line = buffer_.substr(0, end);
+      buffer_.erase(0, end + 1);
+      if (!line->empty() && line->back() == '\r') line->pop_back();
+      return true;
+    }
+
+    if (input_fd_ == -1) {
+      // The standard input has ended.
+      if (listen_fd_ == -1) return false;
+
+      const int connection_fd = accept(listen_fd_, nullptr, nullptr);
+      if (connection_fd == -1) {
+        if (errno == EINTR) continue;
+        GTEST_LOG_(WARNING) << "serve: accept() failed: " << strerror(errno);
+        return false;
+      }
+#ifdef SO_NOSIGPIPE
+      const int no_sigpipe = 1;
+      setsockopt(connection_fd, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe,
+                 sizeof(no_sigpipe));
+#endif  // SO_NOSIGPIPE
+      input_fd_ = output_fd_ = connection_fd;
+    }
+
+    char chunk[4096];
+    const ssize_t size = read(input_fd_, chunk, sizeof(chunk));
+    if (size > 0) {
+      buffer_.append(chunk, static_cast<size_t>(size));
+    } else if (size == -1 && errno == EINTR) {
+      continue;
+    } else {
+      // The client went away; an incomplete last line is dropped.
+      buffer_.clear();
+      CloseConnection();
+    }
+  }
+}
+
+void TestRequestServer::Send(const std::string& message) {
+  const char* data = message.data();
+  size_t remaining = message.size();
+  while (remaining > 0 && output_fd_ != -1) {
+#ifdef MSG_NOSIGNAL
+    const ssize_t written =
+        listen_fd_ != -1 ? send(output_fd_, data, remaining, MSG_NOSIGNAL)
+                         : write(output_fd_, data, remaining);
+#else
+    const ssize_t written = write(output_fd_, data, remaining);
+#endif  // MSG_NOSIGNAL
+    if (written > 0) {
+      data += written;
+      remaining -= static_cast<size_t>(written);
+    } else if (written == -1 && errno != EINTR) {
+      // Keeps running the tests of the request, but the results are lost.
+      if (listen_fd_ != -1) {
+        shutdown(output_fd_, SHUT_WR);
+      }
+      return;
+    }
+  }
+}
+
+void TestRequestServer::CloseConnection() {
+  if (listen_fd_ != -1 && input_fd_ != -1) close(input_fd_);
+  input_fd_ = -1;
+  if (listen_fd_ != -1) output_fd_ = -1;
+}
+
+// End of class TestRequestServer
+#endif  // GTEST_CAN_STREAM_RESULTS__
+
+// class OsStackTraceGetter
+
+const char* const OsStackTraceGetterInterface::kElidedFramesMarker =
+    "... " GTEST_NAME_ " internal frames ...";
+
+std::string OsStackTraceGetter::CurrentStackTrace(int max_depth, int skip_count)
+    GTEST_LOCK_EXCLUDED_(mutex_) {
+#ifdef GTEST_HAS_ABSL
+  std::string result;
+
+  if (max_depth <= 0) {
+    return result;
+  }
+
+  max_depth = std::min(max_depth, kMaxStackTraceDepth);
+
+  std::vector<void*> raw_stack(max_depth);
+  // Skips the frames requested by the caller, plus this function.
+  const int raw_stack_size =
+      absl::GetStackTrace(&raw_stack[0], max_depth, skip_count + 1);
+
+  void* caller_frame = nullptr;
+  {
+    MutexLock lock(mutex_);
+    caller_frame = caller_frame_;
+  }
+
+  for (int i = 0; i < raw_stack_size; ++i) {
+    if (raw_stack[i] == caller_frame &&
+        !GTEST_FLAG_GET(show_internal_stack_frames)) {
+      // Add a marker to the trace and stop adding frames.
+      absl::StrAppend(&result, kElidedFramesMarker, "\n");
+      break;
+    }
+
+    result += FormatRawStackTrace(&raw_stack[i], 1);
+  }
+
+  return result;
+
+#else   // !GTEST_HAS_ABSL
+  static_cast<void>(max_depth);
+  static_cast<void>(skip_count);
+  return "";
+#endif  // GTEST_HAS_ABSL
+}
+
+void OsStackTraceGetter::UponLeavingGTest() GTEST_LOCK_EXCLUDED_(mutex_) {
+#ifdef GTEST_HAS_ABSL
+  void* caller_frame = nullptr;
+  if (absl::GetStackTrace(&caller_frame, 1, 3) <= 0) {
+    caller_frame = nullptr;
+  }
+
+  MutexLock lock(mutex_);
+  caller_frame_ = caller_frame;
+#endif  // GTEST_HAS_ABSL
+}
+
+int OsStackTraceGetter::CaptureRawStackTrace(void** frames, int max_depth) {
+#ifdef GTEST_HAS_ABSL
+  // Skips this function.
+  return absl::GetStackTrace(frames, max_depth, 1);
+#elif defined(GTEST_OS_LINUX) && defined(__GLIBC__)
+  return backtrace(frames, max_depth);
+#else
+  static_cast<void>(frames);
+  static_cast<void>(max_depth);
+  return 0;
+#endif  // GTEST_HAS_ABSL
+}
+
+std::string OsStackTraceGetter::FormatRawStackTrace(void* const* frames,
+                                                    int size) {
+  std::string result;
+#ifdef GTEST_HAS_ABSL
+  for (int i = 0; i < size; ++i) {
+    char tmp[1024];
+    const char* symbol = "(unknown)";
+    if (absl::Symbolize(frames[i], tmp, sizeof(tmp))) {
+      symbol = tmp;
+    }
+
+    char line[1024];
+    snprintf(line, sizeof(line), "  %p: %s\n", frames[i], symbol);
+    result += line;
+  }
+#elif defined(GTEST_OS_LINUX) && defined(__GLIBC__)
+  char** const symbols = backtrace_symbols(frames, size);
+  for (int i = 0; i < size; ++i) {
+    char line[1024];
+    snprintf(line, sizeof(line), "  %p: %s\n", frames[i],
+             symbols != nullptr ? symbols[i] : "(unknown)");
+    result += line;
+  }
+  free(symbols);
+#else
+  static_cast<void>(frames);
+  static_cast<void>(size);
+#endif  // GTEST_HAS_ABSL
+  return result;
+}
+
+// The exit code of a test program, or of a worker process of --gtest_jobs,
+// ended by a test timeout.  timeout(1) exits with the same code.
+constexpr int kTestTimeoutExitCode = 124;
+
+#ifdef GTEST_IS_THREADSAFE
+namespace {
+
+#ifdef GTEST_OS_LINUX
+// The stack trace of a thread, which the thread captures itself in a signal
+// handler when GetStackTracesOfAllThreads() asks it to.
+struct ThreadStackTrace {
+  std::atomic<pid_t> thread_id{0};
+  std::atomic<int> size{-1};
+  void* frames[kMaxStackTraceDepth];
+};
+
+ThreadStackTrace g_thread_stack_trace;
+
+void CaptureThreadStackTrace(int /* signal_number */) {
+  const int saved_errno = errno;
+  if (static_cast<pid_t>(syscall(SYS_gettid)) ==
+      g_thread_stack_trace.thread_id.load()) {
+    g_thread_stack_trace.size.store(OsStackTraceGetter::CaptureRawStackTrace(
+        g_thread_stack_trace.frames, kMaxStackTraceDepth));
+  }
+  errno = saved_errno;
+}
+
+// Returns the name of the given thread of this process.
+std::string GetThreadName(pid_t thread_id) {
+  const std::string path =
+      "/proc/self/task/" + StreamableToString(thread_id) + "/comm";
+  FILE* const file = posix::FOpen(path.c_str(), "r");
+  if (file == nullptr) return "";
+  // procfs reports a size of zero, so ReadEntireFile() cannot be used here.
+  char buffer[64] = "";
+  const bool read = fgets(buffer, sizeof(buffer), file) != nullptr;
+  posix::FClose(file);
+  std::string name = read ? buffer : "";
+  if (!name.empty() && name.back() == '\n') name.pop_back();
+  return name;
+}
+#endif  // GTEST_OS_LINUX
+
+// Returns the stack traces of all the threads of the process but the calling
+// one, or an empty string if they cannot be captured.
+std::string GetStackTracesOfAllThreads() {
+  std::string result;
+#ifdef GTEST_OS_LINUX
+  // The first call may allocate memory, which signal handlers cannot do.
+  void* frame;
+  if (OsStackTraceGetter::CaptureRawStackTrace(&frame, 1) == 0) return result;
+
+  std::vector<pid_t> thread_ids;
+  DIR* const dir = opendir("/proc/self/task");
+  if (dir == nullptr) return result;
+  while (const dirent* const entry = readdir(dir)) {
+    if (IsDigit(entry->d_name[0])) {
+      thread_ids.push_back(static_cast<pid_t>(atoi(entry->d_name)));
+    }
+  }
+  closedir(dir);
+  std::sort(thread_ids.begin(), thread_ids.end());
+
+  // Signals one thread at a time, which stores its stack trace in
+  // g_thread_stack_trace.
+  const int signal_number = SIGRTMIN;
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = &CaptureThreadStackTrace;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  struct sigaction old_action;
+  sigaction(signal_number, &action, &old_action);
+  const pid_t self = static_cast<pid_t>(syscall(SYS_gettid));
+  for (const pid_t thread_id : thread_ids) {
+    if (thread_id == self) continue;
+    g_thread_stack_trace.size.store(-1);
+    g_thread_stack_trace.thread_id.store(thread_id);
+    if (syscall(SYS_tgkill, getpid(), thread_id, signal_number) == 0) {
+      // Gives the thread a second to handle the signal.
+      for (int i = 0; i < 1000 && g_thread_stack_trace.size.load() < 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+    g_thread_stack_trace.thread_id.store(0);
+
+    result += "Thread " + StreamableToString(thread_id) + " (" +
+              GetThreadName(thread_id) + "):\n";
+    const int size = g_thread_stack_trace.size.load();
+    result += size > 0 ? OsStackTraceGetter::FormatRawStackTrace(
+                             g_thread_stack_trace.frames, size)
+                       : "  (unavailable)\n";
+  }
+  sigaction(signal_number, &old_action, nullptr);
+#endif  // GTEST_OS_LINUX
+  return result;
+}
+
+}  // namespace
+
+// Watches the running tests on a thread of its own, started when the first
+// timeout is set.
+class TestWatchdog {
+ public:
+  TestWatchdog() = default;
+
+  ~TestWatchdog() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    changed_.notify_all();
+    if (thread_.joinable()) thread_.join();
+  }
+
+  // Makes the given test time out timeout_in_seconds seconds from now, or
+  // never if timeout_in_seconds is 0.
+  void Arm(TestInfo* test_info, int timeout_in_seconds) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    WaitUnlessTimingOut(test_info, &lock);
+    if (timeout_in_seconds <= 0) {
+      deadlines_.erase(test_info);
+      return;
+    }
+    deadlines_[test_info] = {
+        std::chrono::steady_clock::now() +
+            std::chrono::seconds(timeout_in_seconds),
+        timeout_in_seconds};
+    if (!thread_.joinable()) {
+      thread_ = std::thread(&TestWatchdog::Watch, this);
+    }
+    changed_.notify_all();
+  }
+
+  // Stops watching the given test.
+  void Disarm(TestInfo* test_info) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    WaitUnlessTimingOut(test_info, &lock);
+    deadlines_.erase(test_info);
+  }
+
+ private:
+  struct Deadline {
+    std::chrono::steady_clock::time_point time;
+    int timeout_in_seconds;
+  };
+
+  // Never returns if the given test is being reported as timed out, as the
+  // process is about to end.
+  void WaitUnlessTimingOut(TestInfo* test_info,
+                           std::unique_lock<std::mutex>* lock) {
+    changed_.wait(*lock, [this, test_info] {
+      return timed_out_test_ != test_info;
+    });
+  }
+
+  void Watch() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+      if (deadlines_.empty()) {
+        changed_.wait(lock);
+        continue;
+      }
+      const auto first = std::min_element(
+          deadlines_.begin(), deadlines_.end(),
+          [](const std::pair<TestInfo* const, Deadline>& a,
+             const std::pair<TestInfo* const, Deadline>& b) {
+            return a.second.time < b.second.time;
+          });
+      if (first->second.time > std::chrono::steady_clock::now()) {
+        changed_.wait_until(lock, first->second.time);
+        continue;
+      }
+      TestInfo* const test_info = first->first;
+      const int timeout_in_seconds = first->second.timeout_in_seconds;
+      deadlines_.erase(first);
+      timed_out_test_ = test_info;
+      lock.unlock();
+      GetUnitTestImpl()->ReportTestTimeout(test_info, timeout_in_seconds);
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::map<TestInfo*, Deadline> deadlines_;
+  TestInfo* timed_out_test_ = nullptr;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+#endif  // GTEST_IS_THREADSAFE
+
+#ifdef GTEST_INTERNAL_HAS_PREMATURE_EXIT_FILE
+// A helper class that creates the premature-exit file in its
+// constructor and deletes the file in its destructor.
+class ScopedPrematureExitFile {
+ public:
+  explicit ScopedPrematureExitFile(const char* premature_exit_filepath)
+      : premature_exit_filepath_(
+            premature_exit_filepath ? premature_exit_filepath : "") {
+    // If a path to the premature-exit file is specified...
+    if (!premature_exit_filepath_.empty()) {
+      // create the file with a single "0" character in it.  I/O
+      // errors are ignored as there's nothing better we can do and we
+      // don't want to fail the test because of this.
+      if (FILE* pfile = posix::FOpen(premature_exit_filepath_.c_str(), "w")) {
+        fwrite("0", 1, 1, pfile);
+        fclose(pfile);
+      } else {
+        premature_exit_filepath_.clear();
+      }
+    }
+  }
+
+  ~ScopedPrematureExitFile() {
+#ifndef GTEST_OS_ESP8266
+    if (!premature_exit_filepath_.empty()) {
+      int retval = remove(premature_exit_filepath_.c_str());
+      if (retval) {
+        GTEST_LOG_(ERROR) << "Failed to remove premature exit filepath \""
+                          << premature_exit_filepath_ << "\" with error "
+                          << retval;
+      }
+    }
+#endif
+  }
+
+ private:
+  std::string premature_exit_filepath_;
+
+  ScopedPrematureExitFile(const ScopedPrematureExitFile&) = delete;
+  ScopedPrematureExitFile& operator=(const ScopedPrematureExitFile&) = delete;
+};
+#endif  // GTEST_INTERNAL_HAS_PREMATURE_EXIT_FILE
+
+}  // namespace internal
+
+// class TestEventListeners
+
+TestEventListeners::TestEventListeners()
+    : repeater_(new internal::TestEventRepeater()),
+      default_result_printer_(nullptr),
+      default_xml_generator_(nullptr) {}
+
+TestEventListeners::~TestEventListeners() { delete repeater_; }
+
+// Returns the standard listener responsible for the default console
 // output.  Can be removed from the listeners list to shut down default
 // console output.  Note that removing this object from the listener list
 // with Release transfers its ownership to the user.
@@ -5349,6 +8790,11 @@ int UnitTest::skipped_test_count() const {
   return impl()->skipped_test_count();
 }
 
+// Gets the number of tests whose result was taken from the result cache.
+int UnitTest::cached_test_count() const {
+  return impl()->cached_test_count();
+}
+
 // Gets the number of failed tests.
 int UnitTest::failed_test_count() const { return impl()->failed_test_count(); }
 
@@ -5384,6 +8830,27 @@ internal::TimeInMillis UnitTest::elapsed_time() const {
   return impl()->elapsed_time();
 }
 
+// Gets the elapsed time, in nanoseconds.
+internal::TimeInNanos UnitTest::elapsed_time_nanos() const {
+  return impl()->elapsed_time_nanos();
+}
+
+// Returns true if and only if the time spent setting up and tearing down the
+// global test environments was measured.
+bool UnitTest::HasPhaseTimes() const { return impl()->HasPhaseTimes(); }
+
+// Gets the time spent setting up the global test environments, in
+// nanoseconds.
+internal::TimeInNanos UnitTest::environments_set_up_nanos() const {
+  return impl()->environments_set_up_nanos();
+}
+
+// Gets the time spent tearing down the global test environments, in
+// nanoseconds.
+internal::TimeInNanos UnitTest::environments_tear_down_nanos() const {
+  return impl()->environments_tear_down_nanos();
+}
+
 // Returns true if and only if the unit test passed (i.e. all test suites
 // passed).
 bool UnitTest::Passed() const { return impl()->Passed(); }
@@ -5465,6 +8932,7 @@ void UnitTest::AddTestPartResult(TestPartResult::Type result_type,
                                  int line_number, const std::string& message,
                                  const std::string& os_stack_trace)
     GTEST_LOCK_EXCLUDED_(mutex_) {
+  const internal::AllocationCountingPause allocation_counting_pause;
   Message msg;
   msg << message;
 
@@ -5539,6 +9007,7 @@ void UnitTest::AddTestPartResult(TestPartResult::Type result_type,
 // the same key, the value will be updated.
 void UnitTest::RecordProperty(const std::string& key,
                               const std::string& value) {
+  const internal::AllocationCountingPause allocation_counting_pause;
   impl_->RecordProperty(TestProperty(key, value));
 }
 
@@ -5724,7 +9193,15 @@ UnitTestImpl::UnitTestImpl(UnitTest* parent)
       random_seed_(0),  // Will be overridden by the flag before first use.
       random_(0),       // Will be reseeded before first use.
       start_timestamp_(0),
-      elapsed_time_(0),
+      elapsed_time_nanos_(0),
+      has_phase_times_(false),
+      environments_set_up_nanos_(0),
+      environments_tear_down_nanos_(0),
+      iteration_(0),
+      serving_test_requests_(false),
+#if GTEST_CAN_RUN_TEST_JOBS_
+      is_test_job_worker_(false),
+#endif  // GTEST_CAN_RUN_TEST_JOBS_
 #ifdef GTEST_HAS_DEATH_TEST
       death_test_factory_(new DefaultDeathTestFactory),
 #endif
@@ -5752,12 +9229,14 @@ void UnitTestImpl::RecordProperty(const TestProperty& test_property) {
   std::string xml_element;
   TestResult* test_result;  // TestResult appropriate for property recording.
 
-  if (current_test_info_ != nullptr) {
+  TestInfo* const test_info = current_test_info();
+  TestSuite* const test_suite = mutable_current_test_suite();
+  if (test_info != nullptr) {
     xml_element = "testcase";
-    test_result = &(current_test_info_->result_);
-  } else if (current_test_suite_ != nullptr) {
+    test_result = &(test_info->result_);
+  } else if (test_suite != nullptr) {
     xml_element = "testsuite";
-    test_result = &(current_test_suite_->ad_hoc_test_result_);
+    test_result = &(test_suite->ad_hoc_test_result_);
   } else {
     xml_element = "testsuites";
     test_result = &ad_hoc_test_result_;
@@ -5785,6 +9264,9 @@ void UnitTestImpl::ConfigureXmlOutput() {
   } else if (output_format == "json") {
     listeners()->SetDefaultXmlGenerator(new JsonUnitTestResultPrinter(
         UnitTestOptions::GetAbsolutePathToOutputFile().c_str()));
+  } else if (output_format == "bin") {
+    listeners()->SetDefaultXmlGenerator(new BinaryUnitTestResultPrinter(
+        UnitTestOptions::GetAbsolutePathToOutputFile().c_str()));
   } else if (!output_format.empty()) {
     GTEST_LOG_(WARNING) << "WARNING: unrecognized output format \""
                         << output_format << "\" ignored.";
@@ -5803,140 +9285,1147 @@ void UnitTestImpl::ConfigureXmlOutput() {
 void UnitTestImpl::ConfigureStreamingOutput() {
   const std::string& target = GTEST_FLAG_GET(stream_result_to);
   if (!target.empty()) {
-    const size_t pos = target.find(':');
-    if (pos != std::string::npos) {
-      listeners()->Append(
-          new StreamingListener(target.substr(0, pos), target.substr(pos + 1)));
+    std::string address;
+    StreamingListener::Options options;
+    std::string error;
+    if (StreamingListener::ParseTarget(target, &address, &options, &error)) {
+      listeners()->Append(new StreamingListener(address, options));
     } else {
       GTEST_LOG_(WARNING) << "unrecognized streaming target \"" << target
-                          << "\" ignored.";
+                          << "\" ignored: " << error << ".";
+    }
+  }
+}
+#endif  // GTEST_CAN_STREAM_RESULTS_
+
+// Performs initialization dependent upon flag values obtained in
+// ParseGoogleTestFlagsOnly.  Is called from InitGoogleTest after the call to
+// ParseGoogleTestFlagsOnly.  In case a user neglects to call InitGoogleTest
+// this function is also called from RunAllTests.  Since this function can be
+// called more than once, it has to be idempotent.
+void UnitTestImpl::PostFlagParsingInit() {
+  // Ensures that this function does not execute more than once.
+  if (!post_flag_parse_init_performed_) {
+    post_flag_parse_init_performed_ = true;
+
+#if defined(GTEST_CUSTOM_TEST_EVENT_LISTENER_)
+    // Register to send notifications about key process state changes.
+    listeners()->Append(new GTEST_CUSTOM_TEST_EVENT_LISTENER_());
+#endif  // defined(GTEST_CUSTOM_TEST_EVENT_LISTENER_)
+
+#ifdef GTEST_HAS_DEATH_TEST
+    InitDeathTestSubprocessControlInfo();
+    SuppressTestEventsIfInSubprocess();
+#endif  // GTEST_HAS_DEATH_TEST
+
+    // Registers parameterized tests. This makes parameterized tests
+    // available to the UnitTest reflection API without running
+    // RUN_ALL_TESTS.
+    RegisterParameterizedTests();
+
+    // Configures listeners for XML output. This makes it possible for users
+    // to shut down the default XML output before invoking RUN_ALL_TESTS.
+    ConfigureXmlOutput();
+
+    if (GTEST_FLAG_GET(brief)) {
+      listeners()->SetDefaultResultPrinter(new BriefUnitTestResultPrinter);
+    }
+
+#if GTEST_CAN_STREAM_RESULTS_
+    // Configures listeners for streaming test results to the specified server.
+    // A death test child leaves the stream to its parent, which would
+    // otherwise see its connection or ring buffer replaced.
+#ifdef GTEST_HAS_DEATH_TEST
+    if (internal_run_death_test_flag_ == nullptr)
+#endif  // GTEST_HAS_DEATH_TEST
+      ConfigureStreamingOutput();
+#endif  // GTEST_CAN_STREAM_RESULTS_
+
+#ifdef GTEST_HAS_ABSL
+    if (GTEST_FLAG_GET(install_failure_signal_handler)) {
+      absl::FailureSignalHandlerOptions options;
+      absl::InstallFailureSignalHandler(options);
+    }
+#endif  // GTEST_HAS_ABSL
+  }
+}
+
+// Finds and returns a TestSuite with the given name.  If one doesn't
+// exist, creates one and returns it.  It's the CALLER'S
+// RESPONSIBILITY to ensure that this function is only called WHEN THE
+// TESTS ARE NOT SHUFFLED.
+//
+// Arguments:
+//
+//   test_suite_name: name of the test suite
+//   type_param:      the name of the test suite's type parameter, or NULL if
+//                    this is not a typed or a type-parameterized test suite.
+//   set_up_tc:       pointer to the function that sets up the test suite
+//   tear_down_tc:    pointer to the function that tears down the test suite
+TestSuite* UnitTestImpl::GetTestSuite(
+    const std::string& test_suite_name, const char* type_param,
+    internal::SetUpTestSuiteFunc set_up_tc,
+    internal::TearDownTestSuiteFunc tear_down_tc) {
+  // During initialization, all TestInfos for a given suite are added in
+  // sequence. To optimize this case, see if the most recently added suite is
+  // the one being requested now.
+  if (!test_suites_.empty() &&
+      (*test_suites_.rbegin())->name_ == test_suite_name) {
+    return *test_suites_.rbegin();
+  }
+
+  // Fall back to searching the collection.
+  auto item_it = test_suites_by_name_.find(test_suite_name);
+  if (item_it != test_suites_by_name_.end()) {
+    return item_it->second;
+  }
+
+  // Not found. Create a new instance.
+  auto* const new_test_suite =
+      new TestSuite(test_suite_name, type_param, set_up_tc, tear_down_tc);
+  test_suites_by_name_.emplace(test_suite_name, new_test_suite);
+
+  const UnitTestFilter death_test_suite_filter(kDeathTestSuiteFilter);
+  // Is this a death test suite?
+  if (death_test_suite_filter.MatchesName(test_suite_name)) {
+    // Yes.  Inserts the test suite after the last death test suite
+    // defined so far.  This only works when the test suites haven't
+    // been shuffled.  Otherwise we may end up running a death test
+    // after a non-death test.
+    ++last_death_test_suite_;
+    test_suites_.insert(test_suites_.begin() + last_death_test_suite_,
+                        new_test_suite);
+  } else {
+    // No.  Appends to the end of the list.
+    test_suites_.push_back(new_test_suite);
+  }
+
+  test_suite_indices_.push_back(static_cast<int>(test_suite_indices_.size()));
+  return new_test_suite;
+}
+
+// Helpers for setting up / tearing down the given environment.  They
+// are for use in the ForEach() function.
+static void SetUpEnvironment(Environment* env) { env->SetUp(); }
+static void TearDownEnvironment(Environment* env) { env->TearDown(); }
+
+// If the environment variable TEST_WARNINGS_OUTPUT_FILE was provided, appends
+// `str` to the file, creating the file if necessary.
+#if GTEST_HAS_FILE_SYSTEM
+static void AppendToTestWarningsOutputFile(const std::string& str) {
+  const char* const filename = posix::GetEnv(kTestWarningsOutputFile);
+  if (filename == nullptr) {
+    return;
+  }
+  auto* const file = posix::FOpen(filename, "a");
+  if (file == nullptr) {
+    return;
+  }
+  GTEST_CHECK_(fwrite(str.data(), 1, str.size(), file) == str.size());
+  GTEST_CHECK_(posix::FClose(file) == 0);
+}
+#endif  // GTEST_HAS_FILE_SYSTEM
+
+// Records the test events raised while a test suite runs on a parallel test
+// worker or in a worker process, so that they can be replayed to the real
+// listeners on the main thread once the suite has finished.
+class TestEventRecorder : public EmptyTestEventListener {
+ public:
+  void OnTestSuiteStart(const TestSuite& test_suite) override {
+    Record([&test_suite](TestEventListener* listener) {
+      GetUnitTestImpl()->set_current_test_suite(
+          const_cast<TestSuite*>(&test_suite));
+      listener->OnTestSuiteStart(test_suite);
+    });
+  }
+
+  //  Legacy API is deprecated but still available
+#ifndef GTEST_REMOVE_LEGACY_TEST_CASEAPI_
+  void OnTestCaseStart(const TestCase& test_case) override {
+    Record([&test_case](TestEventListener* listener) {
+      listener->OnTestCaseStart(test_case);
+    });
+  }
+#endif  //  GTEST_REMOVE_LEGACY_TEST_CASEAPI_
+
+  void OnTestStart(const TestInfo& test_info) override {
+    Record([&test_info](TestEventListener* listener) {
+      GetUnitTestImpl()->set_current_test_info(
+          const_cast<TestInfo*>(&test_info));
+      listener->OnTestStart(test_info);
+    });
+  }
+
+  void OnTestDisabled(const TestInfo& test_info) override {
+    Record([&test_info](TestEventListener* listener) {
+      listener->OnTestDisabled(test_info);
+    });
+  }
+
+  void OnTestPartResult(const TestPartResult& result) override {
+    Record([result](TestEventListener* listener) {
+      listener->OnTestPartResult(result);
+    });
+  }
+
+  void OnTestEnd(const TestInfo& test_info) override {
+    Record([&test_info](TestEventListener* listener) {
+      listener->OnTestEnd(test_info);
+      GetUnitTestImpl()->set_current_test_info(nullptr);
+    });
+  }
+
+  void OnTestSuiteEnd(const TestSuite& test_suite) override {
+    Record([&test_suite](TestEventListener* listener) {
+      listener->OnTestSuiteEnd(test_suite);
+    });
+  }
+
+  //  Legacy API is deprecated but still available
+#ifndef GTEST_REMOVE_LEGACY_TEST_CASEAPI_
+  void OnTestCaseEnd(const TestCase& test_case) override {
+    Record([&test_case](TestEventListener* listener) {
+      listener->OnTestCaseEnd(test_case);
+    });
+  }
+#endif  //  GTEST_REMOVE_LEGACY_TEST_CASEAPI_
+
+  // Sends the recorded events to listener in the order they were raised,
+  // making the recorded test the current one while its events are replayed.
+  // The const_casts above are safe since all test suites and tests are owned
+  // by the UnitTestImpl, which only hands them to listeners as const.
+  void Replay(TestEventListener* listener) {
+    for (const auto& event : events_) {
+      event(listener);
+    }
+    GetUnitTestImpl()->set_current_test_suite(nullptr);
+    events_.clear();
+  }
+
+ private:
+  void Record(std::function<void(TestEventListener*)> event) {
+    const TestEventLock lock;
+    events_.push_back(std::move(event));
+  }
+
+  std::vector<std::function<void(TestEventListener*)>> events_;
+};
+
+#ifdef GTEST_IS_THREADSAFE
+namespace {
+
+// Holds one queue of test suite indices per parallel test worker.  A worker
+// takes work from the front of its own queue and, once that is empty,
+// steals from the back of the other workers' queues.
+class WorkStealingQueues {
+ public:
+  explicit WorkStealingQueues(int num_workers) {
+    for (int i = 0; i < num_workers; i++) {
+      queues_.push_back(std::make_unique<Queue>());
+    }
+  }
+
+  // Appends item to the queue of the given worker.
+  void Push(int worker, int item) {
+    Queue& queue = *queues_[static_cast<size_t>(worker)];
+    MutexLock lock(queue.mutex);
+    queue.items.push_back(item);
+  }
+
+  // Takes the next item for the given worker.  Returns false when all the
+  // queues are empty.
+  bool Pop(int worker, int* item) {
+    const size_t num_queues = queues_.size();
+    for (size_t i = 0; i < num_queues; i++) {
+      Queue& queue = *queues_[(static_cast<size_t>(worker) + i) % num_queues];
+      MutexLock lock(queue.mutex);
+      if (queue.items.empty()) continue;
+      if (i == 0) {
+        *item = queue.items.front();
+        queue.items.pop_front();
+      } else {
+        *item = queue.items.back();
+        queue.items.pop_back();
+      }
+      return true;
+    }
+    return false;
+  }
+
+ private:
+  struct Queue {
+    Mutex mutex;
+    std::deque<int> items;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+};
+
+}  // namespace
+
+// Runs the test suites of the current iteration on num_workers threads.
+// Each test suite runs entirely on one worker, so the state shared through
+// SetUpTestSuite() is never touched by two threads at once.  Death test
+// suites, which come first, run on the main thread before any worker starts;
+// suites matching --gtest_parallel_exclude run on the main thread after the
+// workers are done.  The events raised on a worker are recorded and
+// replayed on the main thread, so listeners receive the events of the test
+// suites in the same order as in a serial run.
+void UnitTestImpl::RunTestSuitesInParallel(int num_workers) {
+  const UnitTestFilter death_test_filter(kDeathTestSuiteFilter);
+  const UnitTestFilter exclude_filter(GTEST_FLAG_GET(parallel_exclude));
+
+  const int num_test_suites = total_test_suite_count();
+  std::vector<std::unique_ptr<TestEventRecorder>> recorders(
+      static_cast<size_t>(num_test_suites));
+  std::vector<std::unique_ptr<Notification>> finished(
+      static_cast<size_t>(num_test_suites));
+  WorkStealingQueues queues(num_workers);
+  int next_worker = 0;
+  for (int i = 0; i < num_test_suites; i++) {
+    const TestSuite* const test_suite = GetTestSuite(i);
+    if (!test_suite->should_run() ||
+        death_test_filter.MatchesName(test_suite->name()) ||
+        exclude_filter.MatchesName(test_suite->name())) {
+      continue;
+    }
+    recorders[static_cast<size_t>(i)] = std::make_unique<TestEventRecorder>();
+    unreplayed_test_suites_.emplace_back(
+        test_suite, recorders[static_cast<size_t>(i)].get());
+    finished[static_cast<size_t>(i)] = std::make_unique<Notification>();
+    queues.Push(next_worker, i);
+    next_worker = (next_worker + 1) % num_workers;
+  }
+
+  // Set once a test suite fails under --gtest_fail_fast; the test suites
+  // started afterwards are skipped.
+  std::atomic<bool> stop(false);
+  const auto run_or_skip = [this, &stop](int i) {
+    TestSuite* const test_suite = GetMutableSuiteCase(i);
+    if (stop) {
+      test_suite->Skip();
+    } else {
+      test_suite->Run();
+    }
+    if (GTEST_FLAG_GET(fail_fast) && test_suite->Failed()) {
+      stop = true;
+    }
+  };
+
+  const auto worker_main = [&](int worker) {
+    ParallelWorkerState state;
+    set_parallel_worker_state(&state);
+    int i;
+    while (queues.Pop(worker, &i)) {
+      state.repeater = recorders[static_cast<size_t>(i)].get();
+      run_or_skip(i);
+      finished[static_cast<size_t>(i)]->Notify();
+    }
+    set_parallel_worker_state(nullptr);
+  };
+
+  std::vector<std::thread> workers;
+  TestEventListener* const repeater = listeners()->repeater();
+  for (int i = 0; i < num_test_suites; i++) {
+    TestEventRecorder* const recorder = recorders[static_cast<size_t>(i)].get();
+    if (recorder != nullptr) {
+      // Workers are started lazily so that the death tests at the front run
+      // while the process is still single-threaded.
+      if (workers.empty()) {
+        for (int worker = 0; worker < num_workers; worker++) {
+          workers.emplace_back(worker_main, worker);
+        }
+      }
+      finished[static_cast<size_t>(i)]->WaitForNotification();
+      const TestEventLock lock;
+      recorder->Replay(repeater);
+      unreplayed_test_suites_.pop_front();
+    } else {
+      // A test suite pinned to the main thread waits for the workers, which
+      // have then run every test suite they were given.
+      for (auto& worker : workers) {
+        if (worker.joinable()) worker.join();
+      }
+      run_or_skip(i);
+    }
+  }
+  for (auto& worker : workers) {
+    if (worker.joinable()) worker.join();
+  }
+}
+#endif  // GTEST_IS_THREADSAFE
+
+#if GTEST_CAN_RUN_TEST_JOBS_
+// The kinds of messages exchanged between the main process and the worker
+// processes of the fork-based test runner (see --gtest_jobs).
+enum class TestJobMessageType : int64_t {
+  // Main process to worker: runs a test suite.  Fields: the index of the
+  // test suite, the number of tests to leave out and their names.
+  kRunTestSuite,
+  // Worker to main process.  The fields mirror the arguments of the
+  // TestEventListener method of the same name.
+  kTestSuiteStart,  // No fields.
+  kTestStart,       // The name of the test.
+  kTestDisabled,    // The name of the test.
+  kTestPartResult,  // The type, file name, line number and message.
+  // The start timestamp, elapsed time, properties, benchmark result,
+  // whether the resource usage was measured, followed by it if so,
+  // whether the allocations were counted, followed by them if so, and
+  // whether the phases were timed, followed by their times if so.
+  kTestEnd,
+  // The start timestamp, elapsed time, properties, and whether the phases
+  // were timed, followed by the time of the set-up and tear-down if so.
+  kTestSuiteEnd,
+};
+
+// A message of the fork-based test runner: a sequence of integer and string
+// fields, sent over a pipe prefixed by its size.  Both ends of the pipe run
+// the same binary, so integers are sent in the native byte order.
+class TestJobMessage {
+ public:
+  TestJobMessage() = default;
+  explicit TestJobMessage(TestJobMessageType type) {
+    AddInt(static_cast<int64_t>(type));
+  }
+
+  void AddInt(int64_t value) {
+    payload_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+  void AddString(const std::string& value) {
+    AddInt(static_cast<int64_t>(value.size()));
+    payload_ += value;
+  }
+  void AddProperties(const TestResult& result) {
+    AddInt(result.test_property_count());
+    for (int i = 0; i < result.test_property_count(); i++) {
+      AddString(result.GetTestProperty(i).key());
+      AddString(result.GetTestProperty(i).value());
+    }
+  }
+
+  TestJobMessageType ReadType() {
+    return static_cast<TestJobMessageType>(ReadInt());
+  }
+  int64_t ReadInt() {
+    int64_t value;
+    GTEST_CHECK_(position_ + sizeof(value) <= payload_.size())
+        << "Truncated test job message.";
+    memcpy(&value, payload_.data() + position_, sizeof(value));
+    position_ += sizeof(value);
+    return value;
+  }
+  std::string ReadString() {
+    const size_t size = static_cast<size_t>(ReadInt());
+    GTEST_CHECK_(position_ + size <= payload_.size())
+        << "Truncated test job message.";
+    std::string value = payload_.substr(position_, size);
+    position_ += size;
+    return value;
+  }
+
+  // Writes the message to fd.  Returns false if the reader has gone away.
+  bool Send(int fd) const {
+    const int64_t size = static_cast<int64_t>(payload_.size());
+    std::string data(reinterpret_cast<const char*>(&size), sizeof(size));
+    data += payload_;
+    for (size_t written = 0; written < data.size();) {
+      const ssize_t n =
+          write(fd, data.data() + written, data.size() - written);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      written += static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  // Reads the next message from fd, blocking until it has arrived.  Returns
+  // false on end of file.
+  bool Receive(int fd) {
+    int64_t size;
+    if (!ReadFully(fd, &size, sizeof(size))) return false;
+    payload_.resize(static_cast<size_t>(size));
+    position_ = 0;
+    return ReadFully(fd, &payload_[0], payload_.size());
+  }
+
+  // Moves the first complete message out of buffer, which holds the bytes
+  // received so far.  Returns false if buffer holds no complete message.
+  bool Extract(std::string* buffer) {
+    int64_t size;
+    if (buffer->size() < sizeof(size)) return false;
+    memcpy(&size, buffer->data(), sizeof(size));
+    if (buffer->size() < sizeof(size) + static_cast<size_t>(size)) {
+      return false;
+    }
+    payload_ = buffer->substr(sizeof(size), static_cast<size_t>(size));
+    position_ = 0;
+    buffer->erase(0, sizeof(size) + static_cast<size_t>(size));
+    return true;
+  }
+
+ private:
+  static bool ReadFully(int fd, void* buffer, size_t size) {
+    char* const bytes = static_cast<char*>(buffer);
+    for (size_t read_so_far = 0; read_so_far < size;) {
+      const ssize_t n = read(fd, bytes + read_so_far, size - read_so_far);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      read_so_far += static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  std::string payload_;
+  size_t position_ = 0;
+};
+
+// Sends the test events raised in a worker process to the main process.
+class TestJobEventForwarder : public EmptyTestEventListener {
+ public:
+  explicit TestJobEventForwarder(int fd) : fd_(fd) {}
+
+  void OnTestSuiteStart(const TestSuite& /* test_suite */) override {
+    Send(TestJobMessage(TestJobMessageType::kTestSuiteStart));
+  }
+
+  void OnTestStart(const TestInfo& test_info) override {
+    TestJobMessage message(TestJobMessageType::kTestStart);
+    message.AddString(test_info.name());
+    Send(message);
+  }
+
+  void OnTestDisabled(const TestInfo& test_info) override {
+    TestJobMessage message(TestJobMessageType::kTestDisabled);
+    message.AddString(test_info.name());
+    Send(message);
+  }
+
+  void OnTestPartResult(const TestPartResult& result) override {
+    TestJobMessage message(TestJobMessageType::kTestPartResult);
+    message.AddInt(result.type());
+    message.AddString(result.file_name() == nullptr ? "" : result.file_name());
+    message.AddInt(result.line_number());
+    message.AddString(result.message());
+    Send(message);
+  }
+
+  void OnTestEnd(const TestInfo& test_info) override {
+    const TestResult& result = *test_info.result();
+    TestJobMessage message(TestJobMessageType::kTestEnd);
+    message.AddInt(result.start_timestamp());
+    message.AddInt(result.elapsed_time_nanos());
+    message.AddProperties(result);
+    const BenchmarkResult& benchmark = result.benchmark_result();
+    message.AddInt(benchmark.iterations());
+    message.AddInt(benchmark.samples());
+    message.AddInt(DoubleToBits(benchmark.mean_ns()));
+    message.AddInt(DoubleToBits(benchmark.median_ns()));
+    message.AddInt(DoubleToBits(benchmark.stddev_ns()));
+    message.AddInt(result.HasResourceUsage());
+    if (result.HasResourceUsage()) {
+      const ResourceUsage& usage = result.resource_usage();
+      message.AddInt(usage.user_cpu_time_us);
+      message.AddInt(usage.system_cpu_time_us);
+      message.AddInt(usage.max_rss_kb);
+      message.AddInt(usage.max_rss_growth_kb);
+      message.AddInt(usage.minor_page_faults);
+      message.AddInt(usage.major_page_faults);
+      message.AddInt(usage.voluntary_context_switches);
+      message.AddInt(usage.involuntary_context_switches);
+    }
+    message.AddInt(result.HasAllocationStats());
+    if (result.HasAllocationStats()) {
+      const AllocationStats& stats = result.allocation_stats();
+      message.AddInt(stats.count);
+      message.AddInt(stats.bytes);
+      message.AddInt(stats.peak_bytes);
     }
+    message.AddInt(result.HasPhaseTimes());
+    if (result.HasPhaseTimes()) {
+      const TestPhaseTimes& times = result.phase_times();
+      message.AddInt(times.constructor_nanos);
+      message.AddInt(times.set_up_nanos);
+      message.AddInt(times.body_nanos);
+      message.AddInt(times.tear_down_nanos);
+      message.AddInt(times.destructor_nanos);
+    }
+    Send(message);
+  }
+
+  void OnTestSuiteEnd(const TestSuite& test_suite) override {
+    TestJobMessage message(TestJobMessageType::kTestSuiteEnd);
+    message.AddInt(test_suite.start_timestamp());
+    message.AddInt(test_suite.elapsed_time_nanos());
+    message.AddProperties(test_suite.ad_hoc_test_result());
+    message.AddInt(test_suite.HasPhaseTimes());
+    if (test_suite.HasPhaseTimes()) {
+      message.AddInt(test_suite.set_up_test_suite_nanos());
+      message.AddInt(test_suite.tear_down_test_suite_nanos());
+    }
+    Send(message);
   }
-}
-#endif  // GTEST_CAN_STREAM_RESULTS_
 
-// Performs initialization dependent upon flag values obtained in
-// ParseGoogleTestFlagsOnly.  Is called from InitGoogleTest after the call to
-// ParseGoogleTestFlagsOnly.  In case a user neglects to call InitGoogleTest
-// this function is also called from RunAllTests.  Since this function can be
-// called more than once, it has to be idempotent.
-void UnitTestImpl::PostFlagParsingInit() {
-  // Ensures that this function does not execute more than once.
-  if (!post_flag_parse_init_performed_) {
-    post_flag_parse_init_performed_ = true;
+ private:
+  // The main process is gone if the message cannot be sent; there is nobody
+  // left to report to.
+  void Send(const TestJobMessage& message) {
+    if (!message.Send(fd_)) _exit(1);
+  }
 
-#if defined(GTEST_CUSTOM_TEST_EVENT_LISTENER_)
-    // Register to send notifications about key process state changes.
-    listeners()->Append(new GTEST_CUSTOM_TEST_EVENT_LISTENER_());
-#endif  // defined(GTEST_CUSTOM_TEST_EVENT_LISTENER_)
+  const int fd_;
+};
 
-#ifdef GTEST_HAS_DEATH_TEST
-    InitDeathTestSubprocessControlInfo();
-    SuppressTestEventsIfInSubprocess();
-#endif  // GTEST_HAS_DEATH_TEST
+// The main process's view of a worker process.
+struct TestJobWorker {
+  pid_t pid = -1;
+  // The pipes through which the worker receives the test suites to run and
+  // reports their events.
+  int command_fd = -1;
+  int event_fd = -1;
+  // The bytes received from the worker that do not form a complete message
+  // yet.
+  std::string received;
+  // The index of the test suite the worker runs, or -1 if it is idle, and the
+  // test it is in the middle of, if any.
+  int test_suite = -1;
+  TestInfo* test_info = nullptr;
+};
 
-    // Registers parameterized tests. This makes parameterized tests
-    // available to the UnitTest reflection API without running
-    // RUN_ALL_TESTS.
-    RegisterParameterizedTests();
+// The progress of a test suite run by the worker processes.
+struct TestJobSuite {
+  // Records the events of the test suite until it can be reported.
+  TestEventRecorder recorder;
+  // The tests that have been reported, which a worker resuming the test
+  // suite after a crash leaves out.
+  std::set<std::string> reported_tests;
+  bool dispatched = false;
+  bool started = false;
+  bool timed = false;
+  bool finished = false;
+};
 
-    // Configures listeners for XML output. This makes it possible for users
-    // to shut down the default XML output before invoking RUN_ALL_TESTS.
-    ConfigureXmlOutput();
+namespace {
 
-    if (GTEST_FLAG_GET(brief)) {
-      listeners()->SetDefaultResultPrinter(new BriefUnitTestResultPrinter);
+// Describes how a worker process whose wait(2) status is status ended.
+std::string DescribeTestJobExit(int status) {
+  Message msg;
+  if (WIFEXITED(status)) {
+    msg << "exited with code " << WEXITSTATUS(status);
+  } else if (WIFSIGNALED(status)) {
+    msg << "was killed by signal " << WTERMSIG(status);
+  } else {
+    msg << "ended with status " << status;
+  }
+  return msg.GetString();
+}
+
+}  // namespace
+
+// Runs the test suites of the current iteration in num_jobs worker processes
+// forked from this one once the environments are set up.  The main process
+// hands out one test suite at a time to each idle worker and merges the
+// events the workers send back into its own test results, so the listeners
+// (and thus the XML and JSON reports) see a single run with the test suites
+// in their usual order.  A worker that dies in the middle of a test suite
+// gets that test marked as failed and is replaced by a fresh worker, which
+// resumes the test suite after the tests already reported.
+void UnitTestImpl::RunTestSuitesInJobs(int num_jobs) {
+  const int num_test_suites = total_test_suite_count();
+  std::vector<std::unique_ptr<TestJobSuite>> suites(
+      static_cast<size_t>(num_test_suites));
+  std::deque<int> pending;
+  for (int i = 0; i < num_test_suites; i++) {
+    if (GetTestSuite(i)->should_run()) {
+      suites[static_cast<size_t>(i)] = std::make_unique<TestJobSuite>();
+      pending.push_back(i);
     }
+  }
 
-#if GTEST_CAN_STREAM_RESULTS_
-    // Configures listeners for streaming test results to the specified server.
-    ConfigureStreamingOutput();
-#endif  // GTEST_CAN_STREAM_RESULTS_
+  // Writing to a worker that has just died must not kill this process; the
+  // worker's death is noticed when its event pipe reaches end of file.
+  struct sigaction ignore_sigpipe;
+  memset(&ignore_sigpipe, 0, sizeof(ignore_sigpipe));
+  ignore_sigpipe.sa_handler = SIG_IGN;
+  struct sigaction old_sigpipe;
+  GTEST_CHECK_(sigaction(SIGPIPE, &ignore_sigpipe, &old_sigpipe) == 0);
+
+  std::vector<TestJobWorker> workers(static_cast<size_t>(num_jobs));
+  // Set once a test suite fails under --gtest_fail_fast; the test suites not
+  // handed out yet are skipped.
+  bool stop = false;
+  int next_to_report = 0;
+  TestEventListener* const repeater = listeners()->repeater();
+  for (;;) {
+    for (auto& worker : workers) {
+      if (stop || pending.empty() || worker.test_suite != -1) continue;
+      const int i = pending.front();
+      TestJobSuite& suite = *suites[static_cast<size_t>(i)];
+      TestJobMessage command(TestJobMessageType::kRunTestSuite);
+      command.AddInt(i);
+      command.AddInt(static_cast<int64_t>(suite.reported_tests.size()));
+      for (const auto& name : suite.reported_tests) command.AddString(name);
+      // A worker that died while idle has not started the test suite, which
+      // goes to a fresh worker instead of being reported as crashed.
+      if (worker.pid != -1 && !command.Send(worker.command_fd)) {
+        HandleTestJobWorkerExit(&worker, &pending, suites);
+      }
+      if (worker.pid == -1) {
+        StartTestJobWorker(&worker, workers, old_sigpipe);
+        // A fresh worker that cannot be sent the test suite has died before
+        // reading it, which is reported once its event pipe is closed.
+        command.Send(worker.command_fd);
+      }
+      pending.pop_front();
+      suite.dispatched = true;
+      worker.test_suite = i;
+    }
 
-#ifdef GTEST_HAS_ABSL
-    if (GTEST_FLAG_GET(install_failure_signal_handler)) {
-      absl::FailureSignalHandlerOptions options;
-      absl::InstallFailureSignalHandler(options);
+    // Reports the test suites that are done, in order.
+    for (; next_to_report < num_test_suites; next_to_report++) {
+      TestJobSuite* const suite =
+          suites[static_cast<size_t>(next_to_report)].get();
+      if (suite == nullptr) continue;
+      if (!suite->finished && stop &&
+          std::find(pending.begin(), pending.end(), next_to_report) !=
+              pending.end()) {
+        if (!suite->dispatched) {
+          GetMutableSuiteCase(next_to_report)->Skip();
+          continue;
+        }
+        FinishTestJobSuite(next_to_report, suite);
+      }
+      if (!suite->finished) break;
+      suite->recorder.Replay(repeater);
+    }
+    if (next_to_report == num_test_suites) break;
+
+    std::vector<pollfd> fds;
+    std::vector<TestJobWorker*> polled;
+    for (auto& worker : workers) {
+      if (worker.pid == -1) continue;
+      pollfd fd = {};
+      fd.fd = worker.event_fd;
+      fd.events = POLLIN;
+      fds.push_back(fd);
+      polled.push_back(&worker);
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      GTEST_CHECK_(errno == EINTR) << "poll() failed: " << strerror(errno);
+      continue;
+    }
+    for (size_t j = 0; j < fds.size(); j++) {
+      if (fds[j].revents == 0) continue;
+      TestJobWorker* const worker = polled[j];
+      char buffer[4096];
+      const ssize_t n = read(worker->event_fd, buffer, sizeof(buffer));
+      if (n < 0 && errno == EINTR) continue;
+      if (n > 0) {
+        worker->received.append(buffer, static_cast<size_t>(n));
+        TestJobMessage message;
+        while (message.Extract(&worker->received)) {
+          HandleTestJobMessage(worker, &message, suites);
+        }
+      } else {
+        HandleTestJobWorkerExit(worker, &pending, suites);
+      }
+      if (GTEST_FLAG_GET(fail_fast) && Failed()) stop = true;
     }
-#endif  // GTEST_HAS_ABSL
   }
-}
 
-// Finds and returns a TestSuite with the given name.  If one doesn't
-// exist, creates one and returns it.  It's the CALLER'S
-// RESPONSIBILITY to ensure that this function is only called WHEN THE
-// TESTS ARE NOT SHUFFLED.
-//
-// Arguments:
-//
-//   test_suite_name: name of the test suite
-//   type_param:      the name of the test suite's type parameter, or NULL if
-//                    this is not a typed or a type-parameterized test suite.
-//   set_up_tc:       pointer to the function that sets up the test suite
-//   tear_down_tc:    pointer to the function that tears down the test suite
-TestSuite* UnitTestImpl::GetTestSuite(
-    const std::string& test_suite_name, const char* type_param,
-    internal::SetUpTestSuiteFunc set_up_tc,
-    internal::TearDownTestSuiteFunc tear_down_tc) {
-  // During initialization, all TestInfos for a given suite are added in
-  // sequence. To optimize this case, see if the most recently added suite is
-  // the one being requested now.
-  if (!test_suites_.empty() &&
-      (*test_suites_.rbegin())->name_ == test_suite_name) {
-    return *test_suites_.rbegin();
+  // Closing the command pipes tells the idle workers to exit.
+  for (auto& worker : workers) {
+    if (worker.pid == -1) continue;
+    close(worker.command_fd);
+    close(worker.event_fd);
+    int status;
+    while (waitpid(worker.pid, &status, 0) == -1 && errno == EINTR) {
+    }
+  }
+  GTEST_CHECK_(sigaction(SIGPIPE, &old_sigpipe, nullptr) == 0);
+}
+
+// Forks a worker process of the fork-based test runner.  The child runs the
+// test suites it is sent and never returns.
+void UnitTestImpl::StartTestJobWorker(
+    TestJobWorker* worker, const std::vector<TestJobWorker>& workers,
+    const struct sigaction& child_sigpipe) {
+  int command_pipe[2];
+  int event_pipe[2];
+  GTEST_CHECK_(pipe(command_pipe) != -1);
+  GTEST_CHECK_(pipe(event_pipe) != -1);
+  // Output buffered so far must not be written again by the worker.
+  FlushConsoleOutput();
+  fflush(stderr);
+  FlushAsyncTestEvents();
+  const pid_t pid = fork();
+  GTEST_CHECK_(pid != -1) << "fork() failed: " << strerror(errno);
+  if (pid == 0) {
+    sigaction(SIGPIPE, &child_sigpipe, nullptr);
+    close(command_pipe[1]);
+    close(event_pipe[0]);
+    // The other workers must see end of file once the main process closes
+    // their pipes.
+    for (const auto& other : workers) {
+      if (other.pid == -1) continue;
+      close(other.command_fd);
+      close(other.event_fd);
+    }
+    RunTestJobWorker(command_pipe[0], event_pipe[1]);
+  }
+  close(command_pipe[0]);
+  close(event_pipe[1]);
+  // Keeps the main process's ends of the pipes from leaking into the
+  // processes of threadsafe-style death tests.
+  fcntl(command_pipe[1], F_SETFD, FD_CLOEXEC);
+  fcntl(event_pipe[0], F_SETFD, FD_CLOEXEC);
+  worker->pid = pid;
+  worker->command_fd = command_pipe[1];
+  worker->event_fd = event_pipe[0];
+  worker->received.clear();
+}
+
+// The main loop of a worker process: runs the test suites the main process
+// asks for, reporting their events through event_fd, until command_fd is
+// closed.
+void UnitTestImpl::RunTestJobWorker(int command_fd, int event_fd) {
+  fcntl(command_fd, F_SETFD, FD_CLOEXEC);
+  fcntl(event_fd, F_SETFD, FD_CLOEXEC);
+  // The listeners inherited from the main process only ever see the events
+  // it merges; the repeater they are attached to is abandoned, as this
+  // process never returns.
+  TestEventRepeater* const repeater = new TestEventRepeater;
+  repeater->Append(new TestJobEventForwarder(event_fd));
+  listeners_.repeater_->set_forwarding_enabled(false);
+  listeners_.repeater_ = repeater;
+  is_test_job_worker_ = true;
+#ifdef GTEST_IS_THREADSAFE
+  // The thread of the watchdog inherited from the main process, if any, does
+  // not exist in this process.
+  static_cast<void>(test_watchdog_.release());
+  test_watchdog_.reset(new TestWatchdog);
+#endif  // GTEST_IS_THREADSAFE
+
+  TestJobMessage command;
+  while (command.Receive(command_fd)) {
+    GTEST_CHECK_(command.ReadType() == TestJobMessageType::kRunTestSuite);
+    TestSuite* const test_suite =
+        GetMutableSuiteCase(static_cast<int>(command.ReadInt()));
+    std::set<std::string> reported_tests;
+    for (int64_t n = command.ReadInt(); n > 0; n--) {
+      reported_tests.insert(command.ReadString());
+    }
+    for (auto* test_info : test_suite->test_info_list_) {
+      if (reported_tests.count(test_info->name()) != 0) {
+        test_info->should_run_ = false;
+        test_info->is_disabled_ = false;
+      }
+    }
+    test_suite->Run();
+  }
+  FlushConsoleOutput();
+  fflush(stderr);
+  _exit(0);
+}
+
+// Merges an event sent by a worker into the results of the test suite it is
+// running and records it for the listeners.
+void UnitTestImpl::HandleTestJobMessage(
+    TestJobWorker* worker, TestJobMessage* message,
+    const std::vector<std::unique_ptr<TestJobSuite>>& suites) {
+  TestSuite* const test_suite = GetMutableSuiteCase(worker->test_suite);
+  TestJobSuite& suite = *suites[static_cast<size_t>(worker->test_suite)];
+  const auto find_test = [test_suite](const std::string& name) {
+    for (auto* test_info : test_suite->test_info_list_) {
+      if (name == test_info->name()) return test_info;
+    }
+    GTEST_LOG_(FATAL) << "Unknown test " << name << " in a test job message.";
+    return static_cast<TestInfo*>(nullptr);
+  };
+  const auto read_properties = [message](const char* xml_element,
+                                         TestResult* result) {
+    for (int64_t n = message->ReadInt(); n > 0; n--) {
+      const std::string key = message->ReadString();
+      result->RecordProperty(xml_element,
+                             TestProperty(key, message->ReadString()));
+    }
+  };
+
+  switch (message->ReadType()) {
+    case TestJobMessageType::kTestSuiteStart:
+      // A test suite resumed after a crash starts again.
+      if (suite.started) break;
+      suite.started = true;
+      suite.recorder.OnTestSuiteStart(*test_suite);
+#ifndef GTEST_REMOVE_LEGACY_TEST_CASEAPI_
+      suite.recorder.OnTestCaseStart(*test_suite);
+#endif  //  GTEST_REMOVE_LEGACY_TEST_CASEAPI_
+      break;
+    case TestJobMessageType::kTestStart:
+      worker->test_info = find_test(message->ReadString());
+      // Stands in for the start time sent at the end of the test, in case the
+      // worker does not get there.
+      worker->test_info->result_.set_start_timestamp(GetTimeInMillis());
+      suite.recorder.OnTestStart(*worker->test_info);
+      break;
+    case TestJobMessageType::kTestDisabled: {
+      TestInfo* const test_info = find_test(message->ReadString());
+      if (suite.reported_tests.insert(test_info->name()).second) {
+        suite.recorder.OnTestDisabled(*test_info);
+      }
+      break;
+    }
+    case TestJobMessageType::kTestPartResult: {
+      const auto type = static_cast<TestPartResult::Type>(message->ReadInt());
+      const std::string file_name = message->ReadString();
+      const int line_number = static_cast<int>(message->ReadInt());
+      const TestPartResult result(type, file_name, line_number,
+                                  message->ReadString());
+      (worker->test_info != nullptr ? worker->test_info->result_
+                                    : test_suite->ad_hoc_test_result_)
+          .AddTestPartResult(result);
+      suite.recorder.OnTestPartResult(result);
+      break;
+    }
+    case TestJobMessageType::kTestEnd: {
+      TestInfo* const test_info = worker->test_info;
+      GTEST_CHECK_(test_info != nullptr);
+      test_info->result_.set_start_timestamp(message->ReadInt());
+      test_info->result_.set_elapsed_time_nanos(message->ReadInt());
+      read_properties("testcase", &test_info->result_);
+      const int64_t iterations = message->ReadInt();
+      const int samples = static_cast<int>(message->ReadInt());
+      const double mean_ns = BitsToDouble(message->ReadInt());
+      const double median_ns = BitsToDouble(message->ReadInt());
+      const double stddev_ns = BitsToDouble(message->ReadInt());
+      test_info->result_.set_benchmark_result(
+          BenchmarkResult(iterations, samples, mean_ns, median_ns, stddev_ns));
+      if (message->ReadInt() != 0) {
+        ResourceUsage usage;
+        usage.user_cpu_time_us = message->ReadInt();
+        usage.system_cpu_time_us = message->ReadInt();
+        usage.max_rss_kb = message->ReadInt();
+        usage.max_rss_growth_kb = message->ReadInt();
+        usage.minor_page_faults = message->ReadInt();
+        usage.major_page_faults = message->ReadInt();
+        usage.voluntary_context_switches = message->ReadInt();
+        usage.involuntary_context_switches = message->ReadInt();
+        test_info->result_.set_resource_usage(usage);
+      }
+      if (message->ReadInt() != 0) {
+        AllocationStats stats;
+        stats.count = message->ReadInt();
+        stats.bytes = message->ReadInt();
+        stats.peak_bytes = message->ReadInt();
+        test_info->result_.set_allocation_stats(stats);
+      }
+      if (message->ReadInt() != 0) {
+        TestPhaseTimes& times = test_info->result_.phase_times_;
+        test_info->result_.has_phase_times_ = true;
+        times.constructor_nanos = message->ReadInt();
+        times.set_up_nanos = message->ReadInt();
+        times.body_nanos = message->ReadInt();
+        times.tear_down_nanos = message->ReadInt();
+        times.destructor_nanos = message->ReadInt();
+      }
+      suite.reported_tests.insert(test_info->name());
+      suite.recorder.OnTestEnd(*test_info);
+      worker->test_info = nullptr;
+      break;
+    }
+    case TestJobMessageType::kTestSuiteEnd: {
+      const TimeInMillis start_timestamp = message->ReadInt();
+      const TimeInNanos elapsed_time = message->ReadInt();
+      // A test suite resumed after a crash accumulates the time spent in
+      // each worker.
+      if (!suite.timed) {
+        test_suite->start_timestamp_ = start_timestamp;
+        test_suite->elapsed_time_nanos_ = 0;
+        test_suite->set_up_test_suite_nanos_ = 0;
+        test_suite->tear_down_test_suite_nanos_ = 0;
+        suite.timed = true;
+      }
+      test_suite->elapsed_time_nanos_ += elapsed_time;
+      read_properties("testsuite", &test_suite->ad_hoc_test_result_);
+      if (message->ReadInt() != 0) {
+        test_suite->has_phase_times_ = true;
+        test_suite->set_up_test_suite_nanos_ += message->ReadInt();
+        test_suite->tear_down_test_suite_nanos_ += message->ReadInt();
+      }
+      FinishTestJobSuite(worker->test_suite, &suite);
+      worker->test_suite = -1;
+      break;
+    }
+    default:
+      GTEST_LOG_(FATAL) << "Unexpected test job message.";
+  }
+}
+
+// Reaps a worker whose event pipe reached end of file.  If it was running a
+// test suite, the test it was in the middle of fails, and the rest of the
+// test suite goes back to the front of the queue.  A worker dying outside of
+// a test fails the test suite as a whole.
+void UnitTestImpl::HandleTestJobWorkerExit(
+    TestJobWorker* worker, std::deque<int>* pending,
+    const std::vector<std::unique_ptr<TestJobSuite>>& suites) {
+  close(worker->command_fd);
+  close(worker->event_fd);
+  int status = 0;
+  while (waitpid(worker->pid, &status, 0) == -1 && errno == EINTR) {
+  }
+  const std::string exit_summary = DescribeTestJobExit(status);
+  // A worker ended by a test timeout has reported the test as failed.
+  const bool timed_out =
+      WIFEXITED(status) && WEXITSTATUS(status) == kTestTimeoutExitCode;
+  const pid_t pid = worker->pid;
+  worker->pid = -1;
+  const int i = worker->test_suite;
+  worker->test_suite = -1;
+  if (i == -1) return;
+
+  TestSuite* const test_suite = GetMutableSuiteCase(i);
+  TestJobSuite& suite = *suites[static_cast<size_t>(i)];
+  if (!suite.started) {
+    suite.started = true;
+    suite.recorder.OnTestSuiteStart(*test_suite);
+#ifndef GTEST_REMOVE_LEGACY_TEST_CASEAPI_
+    suite.recorder.OnTestCaseStart(*test_suite);
+#endif  //  GTEST_REMOVE_LEGACY_TEST_CASEAPI_
+  }
+  TestInfo* const test_info = worker->test_info;
+  worker->test_info = nullptr;
+  if (test_info == nullptr && !timed_out) {
+    const std::string failure = (Message() << "The worker process (pid " << pid
+                                           << ") running this test suite "
+                                           << exit_summary << ".")
+                                    .GetString();
+    const TestPartResult result(TestPartResult::kFatalFailure,
+                                test_suite->test_info_list_.empty()
+                                    ? ""
+                                    : test_suite->test_info_list_[0]->file(),
+                                -1, failure);
+    test_suite->ad_hoc_test_result_.AddTestPartResult(result);
+    suite.recorder.OnTestPartResult(result);
+    FinishTestJobSuite(i, &suite);
+    return;
   }
 
-  // Fall back to searching the collection.
-  auto item_it = test_suites_by_name_.find(test_suite_name);
-  if (item_it != test_suites_by_name_.end()) {
-    return item_it->second;
+  if (test_info != nullptr) {
+    const std::string failure =
+        (Message() << "The worker process (pid " << pid
+                   << ") running this test " << exit_summary << ".")
+            .GetString();
+    const TestPartResult result(TestPartResult::kFatalFailure,
+                                test_info->file(), test_info->line(), failure);
+    test_info->result_.AddTestPartResult(result);
+    test_info->result_.set_elapsed_time(GetTimeInMillis() -
+                                        test_info->result_.start_timestamp());
+    suite.recorder.OnTestPartResult(result);
+    suite.reported_tests.insert(test_info->name());
+    suite.recorder.OnTestEnd(*test_info);
+  }
+  for (const auto* other : test_suite->test_info_list_) {
+    if (other->should_run() && suite.reported_tests.count(other->name()) == 0) {
+      pending->push_front(i);
+      return;
+    }
   }
+  FinishTestJobSuite(i, &suite);
+}
 
-  // Not found. Create a new instance.
-  auto* const new_test_suite =
-      new TestSuite(test_suite_name, type_param, set_up_tc, tear_down_tc);
-  test_suites_by_name_.emplace(test_suite_name, new_test_suite);
+// Records the end of a test suite run by the worker processes, which can now
+// be reported.
+void UnitTestImpl::FinishTestJobSuite(int i, TestJobSuite* suite) {
+  const TestSuite& test_suite = *GetTestSuite(i);
+  suite->recorder.OnTestSuiteEnd(test_suite);
+#ifndef GTEST_REMOVE_LEGACY_TEST_CASEAPI_
+  suite->recorder.OnTestCaseEnd(test_suite);
+#endif  //  GTEST_REMOVE_LEGACY_TEST_CASEAPI_
+  suite->finished = true;
+}
+#endif  // GTEST_CAN_RUN_TEST_JOBS_
 
-  const UnitTestFilter death_test_suite_filter(kDeathTestSuiteFilter);
-  // Is this a death test suite?
-  if (death_test_suite_filter.MatchesName(test_suite_name)) {
-    // Yes.  Inserts the test suite after the last death test suite
-    // defined so far.  This only works when the test suites haven't
-    // been shuffled.  Otherwise we may end up running a death test
-    // after a non-death test.
-    ++last_death_test_suite_;
-    test_suites_.insert(test_suites_.begin() + last_death_test_suite_,
-                        new_test_suite);
-  } else {
-    // No.  Appends to the end of the list.
-    test_suites_.push_back(new_test_suite);
+void UnitTestImpl::SetTestTimeout(TestInfo* test_info,
+                                  int timeout_in_seconds) {
+#ifdef GTEST_IS_THREADSAFE
+  if (test_watchdog_ != nullptr) {
+    test_watchdog_->Arm(test_info, timeout_in_seconds);
   }
-
-  test_suite_indices_.push_back(static_cast<int>(test_suite_indices_.size()));
-  return new_test_suite;
+#else
+  static_cast<void>(test_info);
+  static_cast<void>(timeout_in_seconds);
+#endif  // GTEST_IS_THREADSAFE
 }
 
-// Helpers for setting up / tearing down the given environment.  They
-// are for use in the ForEach() function.
-static void SetUpEnvironment(Environment* env) { env->SetUp(); }
-static void TearDownEnvironment(Environment* env) { env->TearDown(); }
+void UnitTestImpl::ClearTestTimeout(TestInfo* test_info) {
+#ifdef GTEST_IS_THREADSAFE
+  if (test_watchdog_ != nullptr) test_watchdog_->Disarm(test_info);
+#else
+  static_cast<void>(test_info);
+#endif  // GTEST_IS_THREADSAFE
+}
 
-// If the environment variable TEST_WARNINGS_OUTPUT_FILE was provided, appends
-// `str` to the file, creating the file if necessary.
-#if GTEST_HAS_FILE_SYSTEM
-static void AppendToTestWarningsOutputFile(const std::string& str) {
-  const char* const filename = posix::GetEnv(kTestWarningsOutputFile);
-  if (filename == nullptr) {
-    return;
+#ifdef GTEST_IS_THREADSAFE
+void UnitTestImpl::ReportTestTimeout(TestInfo* test_info,
+                                     int timeout_in_seconds) {
+  Message message;
+  message << "The test did not finish within "
+          << FormatCountableNoun(timeout_in_seconds, "second", "seconds")
+          << ".";
+  const std::string stack_traces = GetStackTracesOfAllThreads();
+  if (!stack_traces.empty()) {
+    message << "\nStack traces of all threads:\n" << stack_traces;
+  }
+  const TestPartResult result(TestPartResult::kFatalFailure, test_info->file(),
+                              test_info->line(), message.GetString().c_str());
+
+  // Stops the other threads from sending events or changing the results, as
+  // the lock is not released before the process ends.
+  const TestEventLock lock;
+  TestEventListener* const repeater = listeners()->repeater();
+
+  // The listeners first get the events recorded so far by the parallel test
+  // workers, up to the start of the test.
+  const auto unreplayed = std::find_if(
+      unreplayed_test_suites_.begin(), unreplayed_test_suites_.end(),
+      [test_info](const std::pair<const TestSuite*, TestEventRecorder*>& p) {
+        return p.first->name() == std::string(test_info->test_suite_name());
+      });
+  if (unreplayed != unreplayed_test_suites_.end()) {
+    for (auto it = unreplayed_test_suites_.begin(); it <= unreplayed; ++it) {
+      it->second->Replay(repeater);
+    }
   }
-  auto* const file = posix::FOpen(filename, "a");
-  if (file == nullptr) {
-    return;
+
+  test_info->result_.AddTestPartResult(result);
+  test_info->result_.set_elapsed_time(GetTimeInMillis() -
+                                      test_info->result_.start_timestamp());
+  repeater->OnTestPartResult(result);
+  repeater->OnTestEnd(*test_info);
+#if GTEST_CAN_RUN_TEST_JOBS_
+  // The main process runs the rest of the test suite in a new worker.
+  if (!is_test_job_worker_)
+#endif  // GTEST_CAN_RUN_TEST_JOBS_
+  {
+    // The test cannot be stopped, so the test program ends with the results
+    // of the tests run so far.  The tests that have not started are reported
+    // as not run.
+    for (TestSuite* test_suite : test_suites_) {
+      for (TestInfo* info : test_suite->test_info_list()) {
+        if (info->result_.start_timestamp() == 0 && !info->result_.Cached()) {
+          info->should_run_ = false;
+        }
+      }
+    }
+    elapsed_time_nanos_ = (GetTimeInMillis() - start_timestamp_) * 1000000;
+    repeater->OnTestIterationEnd(*parent_, iteration_);
+    repeater->OnTestProgramEnd(*parent_);
   }
-  GTEST_CHECK_(fwrite(str.data(), 1, str.size(), file) == str.size());
-  GTEST_CHECK_(posix::FClose(file) == 0);
+  listeners()->repeater_->FlushAsyncEvents();
+  FlushConsoleOutput();
+  fflush(stderr);
+  std::_Exit(kTestTimeoutExitCode);
 }
-#endif  // GTEST_HAS_FILE_SYSTEM
+#endif  // GTEST_IS_THREADSAFE
 
 // Runs all tests in this UnitTest object, prints the result, and
 // returns true if all tests are successful.  If any exception is
@@ -5961,7 +10450,7 @@ bool UnitTestImpl::RunAllTests() {
 
   // Handle the case where the program has no tests linked.
   // Sometimes this is a programmer mistake, but sometimes it is intended.
-  if (total_test_count() == 0) {
+  if (linked_test_count() == 0) {
     constexpr char kNoTestLinkedMessage[] =
         "This test program does NOT link in any test case.";
     constexpr char kNoTestLinkedFatal[] =
@@ -6001,13 +10490,41 @@ bool UnitTestImpl::RunAllTests() {
 #endif  // defined(GTEST_EXTRA_DEATH_TEST_CHILD_SETUP_)
 #endif  // GTEST_HAS_DEATH_TEST
 
+#if GTEST_CAN_RUN_TEST_JOBS_ && defined(GTEST_IS_THREADSAFE)
+  // The two flags run the test suites in different ways.
+  if (GTEST_FLAG_GET(jobs) > 1 && GTEST_FLAG_GET(parallel) > 1 &&
+      !in_subprocess_for_death_test) {
+    ColoredPrintf(GTestColor::kRed,
+                  "Invalid flags: --%sjobs cannot be combined with "
+                  "--%sparallel.\n",
+                  GTEST_FLAG_PREFIX_, GTEST_FLAG_PREFIX_);
+    fflush(stdout);
+    return false;
+  }
+#endif  // GTEST_CAN_RUN_TEST_JOBS_ && defined(GTEST_IS_THREADSAFE)
+
   const bool should_shard = ShouldShard(in_subprocess_for_death_test);
 
+  // Only the deferred tests that will be reported need TestInfo objects,
+  // except when listing the tests: the text list streams their names, and
+  // the XML and JSON lists include all the tests.
+  ReactionToDeferredTests deferred_tests = CREATE_REPORTABLE_TESTS;
+  if (GTEST_FLAG_GET(list_tests)) {
+    deferred_tests = CREATE_NO_TESTS;
+#if GTEST_HAS_FILE_SYSTEM
+    const std::string& output_format = UnitTestOptions::GetOutputFormat();
+    if (output_format == "xml" || output_format == "json") {
+      deferred_tests = CREATE_ALL_TESTS;
+    }
+#endif  // GTEST_HAS_FILE_SYSTEM
+  }
+
   // Compares the full test names with the filter to decide which
   // tests to run.
   const bool has_tests_to_run =
       FilterTests(should_shard ? HONOR_SHARDING_PROTOCOL
-                               : IGNORE_SHARDING_PROTOCOL) > 0;
+                               : IGNORE_SHARDING_PROTOCOL,
+                  deferred_tests) > 0;
 
   // Lists the tests and exits if the --gtest_list_tests flag was specified.
   if (GTEST_FLAG_GET(list_tests)) {
@@ -6016,6 +10533,35 @@ bool UnitTestImpl::RunAllTests() {
     return true;
   }
 
+#if GTEST_CAN_STREAM_RESULTS_
+  // Runs the requested tests instead if --gtest_serve was specified.  The
+  // server calls this function again for each request.
+  if (!GTEST_FLAG_GET(serve).empty() && !serving_test_requests_ &&
+      !in_subprocess_for_death_test) {
+    return ServeTestRequests();
+  }
+#endif  // GTEST_CAN_STREAM_RESULTS_
+
+#if GTEST_HAS_FILE_SYSTEM
+  // Death test subprocesses only run the death test.
+  if (!GTEST_FLAG_GET(cache_dir).empty() && !in_subprocess_for_death_test) {
+    LoadTestResultCache();
+  }
+#endif  // GTEST_HAS_FILE_SYSTEM
+
+#ifdef GTEST_IS_THREADSAFE
+  // The timeouts of death test subprocesses are handled by their parent.
+  if (!in_subprocess_for_death_test) test_watchdog_.reset(new TestWatchdog);
+#endif  // GTEST_IS_THREADSAFE
+
+  // Death test subprocesses may end with _Exit(), which loses buffered output,
+  // and do not forward events.
+  if (!in_subprocess_for_death_test) {
+    BufferConsoleOutput(GTEST_FLAG_GET(output_buffering));
+    listeners()->repeater_->SetAsyncDelivery(
+        GTEST_FLAG_GET(async_listeners));
+  }
+
   random_seed_ = GetRandomSeedFromFlag(GTEST_FLAG_GET(random_seed));
 
   // True if and only if at least one test has failed.
@@ -6044,11 +10590,20 @@ bool UnitTestImpl::RunAllTests() {
       gtest_repeat_forever;
 
   for (int i = 0; gtest_repeat_forever || i != repeat; i++) {
+    iteration_ = i;
+
     // We want to preserve failures generated by ad-hoc test
     // assertions executed before RUN_ALL_TESTS().
     ClearNonAdHocTestResult();
 
+#if GTEST_HAS_FILE_SYSTEM
+    MarkCachedTests();
+#endif  // GTEST_HAS_FILE_SYSTEM
+
     Timer timer;
+    has_phase_times_ = GTEST_FLAG_GET(print_phase_times);
+    environments_set_up_nanos_ = 0;
+    environments_tear_down_nanos_ = 0;
 
     // Shuffles test suites and tests if requested.
     if (has_tests_to_run && GTEST_FLAG_GET(shuffle)) {
@@ -6068,7 +10623,9 @@ bool UnitTestImpl::RunAllTests() {
       // recreated for each iteration, only do so on the first iteration.
       if (i == 0 || recreate_environments_when_repeating) {
         repeater->OnEnvironmentsSetUpStart(*parent_);
+        Timer set_up_timer;
         ForEach(environments_, SetUpEnvironment);
+        environments_set_up_nanos_ = set_up_timer.ElapsedNanos();
         repeater->OnEnvironmentsSetUpEnd(*parent_);
       }
 
@@ -6084,10 +10641,20 @@ bool UnitTestImpl::RunAllTests() {
               test_result.GetTestPartResult(j);
           if (test_part_result.type() == TestPartResult::kSkip) {
             const std::string& result = test_part_result.message();
-            printf("%s\n", result.c_str());
+            ConsolePrintf("%s\n", result.c_str());
           }
         }
-        fflush(stdout);
+        FlushConsoleOutput();
+#if GTEST_CAN_RUN_TEST_JOBS_
+      } else if (GTEST_FLAG_GET(jobs) > 1 && !in_subprocess_for_death_test &&
+                 !Test::HasFatalFailure()) {
+        RunTestSuitesInJobs(GTEST_FLAG_GET(jobs));
+#endif  // GTEST_CAN_RUN_TEST_JOBS_
+#ifdef GTEST_IS_THREADSAFE
+      } else if (GTEST_FLAG_GET(parallel) > 1 &&
+                 !in_subprocess_for_death_test && !Test::HasFatalFailure()) {
+        RunTestSuitesInParallel(GTEST_FLAG_GET(parallel));
+#endif  // GTEST_IS_THREADSAFE
       } else if (!Test::HasFatalFailure()) {
         for (int test_index = 0; test_index < total_test_suite_count();
              test_index++) {
@@ -6115,8 +10682,10 @@ bool UnitTestImpl::RunAllTests() {
       // last iteration.
       if (i == repeat - 1 || recreate_environments_when_repeating) {
         repeater->OnEnvironmentsTearDownStart(*parent_);
+        Timer tear_down_timer;
         std::for_each(environments_.rbegin(), environments_.rend(),
                       TearDownEnvironment);
+        environments_tear_down_nanos_ = tear_down_timer.ElapsedNanos();
         repeater->OnEnvironmentsTearDownEnd(*parent_);
       }
     } else if (GTEST_FLAG_GET(fail_if_no_test_selected)) {
@@ -6132,10 +10701,15 @@ bool UnitTestImpl::RunAllTests() {
           "specify \n"
           "--gtest_fail_if_no_test_selected=false.";
       ColoredPrintf(GTestColor::kRed, "%s\n", kNoTestsSelectedMessage);
+      FlushConsoleOutput();
       return false;
     }
 
-    elapsed_time_ = timer.Elapsed();
+    elapsed_time_nanos_ = timer.ElapsedNanos();
+
+#if GTEST_HAS_FILE_SYSTEM
+    RecordTestResultsInCache();
+#endif  // GTEST_HAS_FILE_SYSTEM
 
     // Tells the unit test event listener that the tests have just finished.
     repeater->OnTestIterationEnd(*parent_, i);
@@ -6159,9 +10733,24 @@ bool UnitTestImpl::RunAllTests() {
     }
   }
 
+#if GTEST_HAS_FILE_SYSTEM
+  if (test_result_cache_ != nullptr && !test_result_cache_->Save()) {
+    ColoredPrintf(GTestColor::kYellow,
+                  "WARNING: cannot write the test result cache \"%s\".\n",
+                  test_result_cache_->path().c_str());
+    FlushConsoleOutput();
+  }
+#endif  // GTEST_HAS_FILE_SYSTEM
+
+#ifdef GTEST_IS_THREADSAFE
+  test_watchdog_.reset();
+#endif  // GTEST_IS_THREADSAFE
+
   repeater->OnTestProgramEnd(*parent_);
-  // Destroy environments in normal code, not in static teardown.
-  bool delete_environment_on_teardown = true;
+  listeners()->repeater_->SetAsyncDelivery(false);
+  // Destroy environments in normal code, not in static teardown.  The server
+  // of --gtest_serve keeps them for the next request.
+  bool delete_environment_on_teardown = !serving_test_requests_;
   if (delete_environment_on_teardown) {
     ForEach(environments_, internal::Delete<Environment>);
     environments_.clear();
@@ -6187,10 +10776,106 @@ bool UnitTestImpl::RunAllTests() {
         " will start to enforce the valid usage. "
         "Please fix it ASAP, or IT WILL START TO FAIL.\n");  // NOLINT
   }
+  FlushConsoleOutput();
 
   return !failed;
 }
 
+#if GTEST_CAN_STREAM_RESULTS_
+namespace {
+
+// Sends the results streamed by a StreamingListener to the client of a
+// TestRequestServer.
+class TestRequestWriter : public StreamingListener::AbstractSocketWriter {
+ public:
+  explicit TestRequestWriter(TestRequestServer* server) : server_(server) {}
+
+  void Send(const std::string& message) override { server_->Send(message); }
+
+ private:
+  TestRequestServer* const server_;
+};
+
+#if GTEST_HAS_FILE_SYSTEM
+// Sends the XML or JSON report of each iteration to the client of a
+// TestRequestServer, URL-encoded on a single line.
+class TestReportSender : public EmptyTestEventListener {
+ public:
+  TestReportSender(TestRequestServer* server, const std::string& format)
+      : server_(server), format_(format) {}
+
+  void OnTestIterationEnd(const UnitTest& unit_test,
+                          int /* iteration */) override {
+    std::stringstream stream;
+    if (format_ == "xml") {
+      XmlUnitTestResultPrinter::PrintXmlUnitTest(&stream, unit_test);
+    } else {
+      JsonUnitTestResultPrinter::PrintJsonUnitTest(&stream, unit_test);
+    }
+    server_->Send("event=Report&format=" + format_ + "&content=" +
+                  StreamingListener::UrlEncode(
+                      StringStreamToString(&stream).c_str()) +
+                  "\n");
+  }
+
+ private:
+  TestRequestServer* const server_;
+  const std::string format_;
+};
+#endif  // GTEST_HAS_FILE_SYSTEM
+
+}  // namespace
+
+bool UnitTestImpl::ServeTestRequests() {
+  const std::string& address = GTEST_FLAG_GET(serve);
+  TestRequestServer server(address);
+  std::string error;
+  if (!server.Start(&error)) {
+    ColoredPrintf(GTestColor::kRed,
+                  "Cannot serve test requests on \"%s\": %s\n",
+                  address.c_str(), error.c_str());
+    fflush(stdout);
+    return false;
+  }
+  printf("Serving test requests on %s.\n", address.c_str());
+  fflush(stdout);
+
+  serving_test_requests_ = true;
+  std::string line;
+  while (server.NextRequest(&line) && line != "quit") {
+    TestRunRequest request;
+    if (!TestRequestServer::ParseRequest(line, &request, &error)) {
+      server.Send("event=RequestError&message=" +
+                  StreamingListener::UrlEncode(error.c_str()) + "\n");
+      continue;
+    }
+
+    GTestFlagSaver flag_saver;
+    GTEST_FLAG_SET(filter, request.filter);
+    GTEST_FLAG_SET(repeat, request.repeat);
+    TestEventListener* sender = nullptr;
+#if GTEST_HAS_FILE_SYSTEM
+    if (request.output != "stream") {
+      sender = new TestReportSender(&server, request.output);
+    }
+#endif  // GTEST_HAS_FILE_SYSTEM
+    if (sender == nullptr) {
+      sender = new StreamingListener(new TestRequestWriter(&server));
+    }
+    listeners()->Append(sender);
+    const bool passed = RunAllTests();
+    delete listeners()->Release(sender);
+    server.Send(std::string("event=RequestEnd&passed=") + (passed ? "1" : "0") +
+                "\n");
+  }
+  serving_test_requests_ = false;
+
+  ForEach(environments_, internal::Delete<Environment>);
+  environments_.clear();
+  return true;
+}
+#endif  // GTEST_CAN_STREAM_RESULTS_
+
 #if GTEST_HAS_FILE_SYSTEM
 // Reads the GTEST_SHARD_STATUS_FILE environment variable, and creates the file
 // if the variable is present. If a file already exists at this location, this
@@ -6284,22 +10969,405 @@ bool ShouldRunTestOnShard(int total_shards, int shard_index, int test_id) {
   return (test_id % total_shards) == shard_index;
 }
 
+namespace {
+
+// Incrementally computes a 64-bit hash of a sequence of bytes that does not
+// depend on the platform: FNV-1a, followed by the finalizer of SplitMix64 so
+// that all the bits of the hash depend on all the bytes.
+class StableHasher {
+ public:
+  void Update(const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      hash_ ^= static_cast<unsigned char>(data[i]);
+      hash_ *= 0x100000001b3u;
+    }
+  }
+  void Update(const std::string& str) {
+    // Includes the terminating NUL so that consecutive strings stay apart.
+    Update(str.c_str(), str.size() + 1);
+  }
+
+  uint64_t Finish() const {
+    uint64_t hash = hash_;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9u;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebu;
+    return hash ^ (hash >> 31);
+  }
+
+ private:
+  uint64_t hash_ = 0xcbf29ce484222325u;
+};
+
+}  // namespace
+
+// Returns a hash of the full name of a test ("TestSuite.Test") that does not
+// depend on the platform or on the other tests in the program.
+uint64_t HashTestName(const std::string& full_name) {
+  StableHasher hasher;
+  hasher.Update(full_name.data(), full_name.size());
+  return hasher.Finish();
+}
+
+// Returns the shard of the test with the given full name when the tests are
+// sharded by hash (see --gtest_shard_by), given the weight of each shard.  A
+// test only moves to another shard if the weights change.
+int GetShardOfTestByHash(const std::string& full_name,
+                         const std::vector<uint32_t>& shard_weights) {
+  uint64_t total_weight = 0;
+  for (const uint32_t weight : shard_weights) total_weight += weight;
+  uint64_t point = HashTestName(full_name) % total_weight;
+  int shard = 0;
+  while (point >= shard_weights[static_cast<size_t>(shard)]) {
+    point -= shard_weights[static_cast<size_t>(shard)];
+    ++shard;
+  }
+  return shard;
+}
+
+// Reads --gtest_shard_by.  Returns true if the tests are sharded by hash,
+// filling shard_weights with the weight of each of the total_shards shards.
+// Prints an error and exits if the flag is invalid or combined with
+// --gtest_shard_timing, as the shards could not agree on the tests each of
+// them runs.
+static bool ParseShardByFlagOrDie(int total_shards,
+                                  std::vector<uint32_t>* shard_weights) {
+  const std::string& shard_by = GTEST_FLAG_GET(shard_by);
+  if (shard_by == "index") return false;
+
+  std::string error;
+  const char* weights = shard_by.c_str();
+  if (!SkipPrefix("hash", &weights)) {
+    error = "must be \"index\" or \"hash\"";
+  } else if (*weights == '\0') {
+    shard_weights->assign(static_cast<size_t>(total_shards), 1);
+  } else if (*weights++ != ':') {
+    error = "must be \"index\" or \"hash\"";
+  } else {
+    std::vector<std::string> fields;
+    SplitString(weights, ',', &fields);
+    for (const auto& field : fields) {
+      int32_t weight;
+      if (!ParseInt32(Message() << "The shard weight", field.c_str(),
+                      &weight) ||
+          weight <= 0) {
+        error = "has an invalid shard weight";
+        break;
+      }
+      shard_weights->push_back(static_cast<uint32_t>(weight));
+    }
+    if (error.empty() &&
+        shard_weights->size() != static_cast<size_t>(total_shards)) {
+      error = (Message() << "has " << shard_weights->size()
+                         << " shard weights for " << total_shards << " shards")
+                  .GetString();
+    }
+  }
+  // The two flags assign the tests to the shards in different ways.
+  if (error.empty() && !GTEST_FLAG_GET(shard_timing).empty()) {
+    error = "cannot be combined with --" GTEST_FLAG_PREFIX_ "shard_timing";
+  }
+  if (!error.empty()) {
+    const Message msg = Message()
+                        << "Invalid sharding: --" GTEST_FLAG_PREFIX_ "shard_by="
+                        << shard_by << " " << error << ".\n";
+    ColoredPrintf(GTestColor::kRed, "%s", msg.GetString().c_str());
+    fflush(stdout);
+    exit(EXIT_FAILURE);
+  }
+  return true;
+}
+
+namespace {
+
+// A JSON value, as read by JsonParser.
+struct JsonValue {
+  enum Type { kNull, kBool, kNumber, kString, kArray, kObject };
+
+  // Returns the member of an object with the given key, or NULL.
+  const JsonValue* Find(const std::string& key) const {
+    for (const auto& member : members) {
+      if (member.first == key) return &member.second;
+    }
+    return nullptr;
+  }
+
+  Type type = kNull;
+  // The value of a string, or the text of a number or boolean.
+  std::string text;
+  std::vector<JsonValue> elements;
+  std::vector<std::pair<std::string, JsonValue>> members;
+};
+
+// A minimal JSON parser, sufficient for reading back the reports written by
+// JsonUnitTestResultPrinter.
+class JsonParser {
+ public:
+  explicit JsonParser(const std::string& json) : json_(json) {}
+
+  // Parses the whole document.  Returns false if it is not valid JSON.
+  bool Parse(JsonValue* value) {
+    return ParseValue(value, 0) && (SkipSpaces(), position_ == json_.size());
+  }
+
+ private:
+  // Deeper documents are rejected rather than overflowing the stack.
+  static constexpr int kMaxDepth = 64;
+
+  void SkipSpaces() {
+    while (position_ < json_.size() && IsSpace(json_[position_])) ++position_;
+  }
+
+  // Consumes c, after any white space, if it comes next.
+  bool Consume(char c) {
+    SkipSpaces();
+    if (position_ == json_.size() || json_[position_] != c) return false;
+    ++position_;
+    return true;
+  }
+
+  bool ParseValue(JsonValue* value, int depth) {
+    SkipSpaces();
+    if (position_ == json_.size() || depth > kMaxDepth) return false;
+    const char c = json_[position_];
+    if (c == '{') {
+      value->type = JsonValue::kObject;
+      ++position_;
+      if (Consume('}')) return true;
+      do {
+        std::pair<std::string, JsonValue> member;
+        SkipSpaces();
+        if (!ParseString(&member.first) || !Consume(':') ||
+            !ParseValue(&member.second, depth + 1)) {
+          return false;
+        }
+        value->members.push_back(std::move(member));
+      } while (Consume(','));
+      return Consume('}');
+    }
+    if (c == '[') {
+      value->type = JsonValue::kArray;
+      ++position_;
+      if (Consume(']')) return true;
+      do {
+        value->elements.emplace_back();
+        if (!ParseValue(&value->elements.back(), depth + 1)) return false;
+      } while (Consume(','));
+      return Consume(']');
+    }
+    if (c == '"') {
+      value->type = JsonValue::kString;
+      return ParseString(&value->text);
+    }
+    // A number or a literal.
+    const size_t start = position_;
+    while (position_ < json_.size() &&
+           (IsAlNum(json_[position_]) || json_[position_] == '-' ||
+            json_[position_] == '+' || json_[position_] == '.')) {
+      ++position_;
+    }
+    value->text = json_.substr(start, position_ - start);
+    if (value->text == "null") {
+      value->type = JsonValue::kNull;
+    } else if (value->text == "true" || value->text == "false") {
+      value->type = JsonValue::kBool;
+    } else {
+      value->type = JsonValue::kNumber;
+      return !value->text.empty() &&
+             (value->text[0] == '-' || IsDigit(value->text[0]));
+    }
+    return true;
+  }
+
+  bool ParseString(std::string* str) {
+    if (position_ == json_.size() || json_[position_] != '"') return false;
+    for (++position_; position_ < json_.size(); ++position_) {
+      const char c = json_[position_];
+      if (c == '"') {
+        ++position_;
+        return true;
+      }
+      if (c != '\\') {
+        *str += c;
+        continue;
+      }
+      if (++position_ == json_.size()) return false;
+      switch (json_[position_]) {
+        case 'b':
+          *str += '\b';
+          break;
+        case 'f':
+          *str += '\f';
+          break;
+        case 'n':
+          *str += '\n';
+          break;
+        case 'r':
+          *str += '\r';
+          break;
+        case 't':
+          *str += '\t';
+          break;
+        case 'u': {
+          if (json_.size() - position_ < 5) return false;
+          uint32_t code_point = 0;
+          for (int i = 0; i < 4; i++) {
+            const char digit = json_[++position_];
+            if (!IsXDigit(digit)) return false;
+            code_point = code_point * 16 +
+                         static_cast<uint32_t>(
+                             IsDigit(digit) ? digit - '0'
+                                            : ToLower(digit) - 'a' + 10);
+          }
+          *str += CodePointToUtf8(code_point);
+          break;
+        }
+        default:
+          *str += json_[position_];
+      }
+    }
+    return false;
+  }
+
+  const std::string& json_;
+  size_t position_ = 0;
+};
+
+}  // namespace
+
+// Reads the durations of the tests recorded in a report written by
+// --gtest_output=json into durations, keyed by the full name of each test
+// ("TestSuite.Test").  Returns false if json is not such a report.
+bool ParseTestDurationsFromJsonReport(
+    const std::string& json,
+    std::unordered_map<std::string, TimeInNanos>* durations) {
+  JsonValue report;
+  if (!JsonParser(json).Parse(&report)) return false;
+  const JsonValue* const test_suites = report.Find("testsuites");
+  if (test_suites == nullptr || test_suites->type != JsonValue::kArray) {
+    return false;
+  }
+  for (const auto& test_suite : test_suites->elements) {
+    const JsonValue* const suite_name = test_suite.Find("name");
+    const JsonValue* const tests = test_suite.Find("testsuite");
+    if (suite_name == nullptr || tests == nullptr) return false;
+    for (const auto& test : tests->elements) {
+      const JsonValue* const name = test.Find("name");
+      const JsonValue* const time = test.Find("time");
+      if (name == nullptr || time == nullptr) return false;
+      // Tests that did not run, e.g. those of other shards, are reported
+      // with a zero time, which says nothing about how long they take.
+      const JsonValue* const result = test.Find("result");
+      if (result == nullptr || result->type != JsonValue::kString ||
+          result->text != "COMPLETED") {
+        continue;
+      }
+      // The time is written in seconds with an "s" suffix, e.g. "1.5s".
+      char* end = nullptr;
+      const double seconds = strtod(time->text.c_str(), &end);
+      if (end == time->text.c_str() || seconds < 0) return false;
+      (*durations)[suite_name->text + "." + name->text] =
+          static_cast<TimeInNanos>(seconds * 1e9 + 0.5);
+    }
+  }
+  return true;
+}
+
+// Assigns tests with the given expected durations to total_shards shards
+// so that the shards take about as long: the tests are taken from the
+// longest to the shortest, each going to the shard with the least work so
+// far.  Ties are broken by the order of the tests and of the shards, so
+// every shard computes the same assignment from the same durations.  Returns
+// the shard of each test.
+std::vector<int> AssignTestsToShards(const std::vector<TimeInNanos>& durations,
+                                     int total_shards) {
+  std::vector<size_t> order(durations.size());
+  for (size_t i = 0; i < order.size(); i++) order[i] = i;
+  std::stable_sort(order.begin(), order.end(),
+                   [&durations](size_t a, size_t b) {
+                     return durations[a] > durations[b];
+                   });
+  std::vector<TimeInNanos> loads(static_cast<size_t>(total_shards), 0);
+  std::vector<int> shards(durations.size());
+  for (size_t i : order) {
+    const auto least_loaded = std::min_element(loads.begin(), loads.end());
+    *least_loaded += durations[i];
+    shards[i] = static_cast<int>(least_loaded - loads.begin());
+  }
+  return shards;
+}
+
+#if GTEST_HAS_FILE_SYSTEM
+// Reads the test durations from the report named by --gtest_shard_timing.
+// All the shards must read the same durations to agree on the tests each of
+// them runs, so an unusable report is a fatal error.
+static std::unordered_map<std::string, TimeInNanos> ReadShardTimingOrDie() {
+  const std::string& path = GTEST_FLAG_GET(shard_timing);
+  std::unordered_map<std::string, TimeInNanos> durations;
+  FILE* const file = posix::FOpen(path.c_str(), "r");
+  const bool ok = file != nullptr &&
+                  ParseTestDurationsFromJsonReport(ReadEntireFile(file),
+                                                   &durations);
+  if (file != nullptr) posix::FClose(file);
+  if (!ok) {
+    ColoredPrintf(GTestColor::kRed,
+                  "Invalid sharding: cannot read the test durations from "
+                  "\"%s\", which must be a JSON report written by --%soutput."
+                  "\n",
+                  path.c_str(), GTEST_FLAG_PREFIX_);
+    fflush(stdout);
+    exit(EXIT_FAILURE);
+  }
+  return durations;
+}
+#endif  // GTEST_HAS_FILE_SYSTEM
+
+namespace {
+
+// Whether a test runs, as decided by UnitTestImpl::FilterTests().
+struct TestFilterResult {
+  bool is_disabled;
+  bool matches_filter;
+  // Whether the test runs on some shard.
+  bool is_runnable;
+  bool is_in_another_shard;
+  // Whether the test runs on this shard.
+  bool is_selected;
+};
+
+}  // namespace
+
 // Compares the name of each test with the user-specified filter to
 // decide whether the test should be run, then records the result in
 // each TestSuite and TestInfo object.
 // If shard_tests == true, further filters tests based on sharding
 // variables in the environment - see
 // https://github.com/google/googletest/blob/main/docs/advanced.md
-// . Returns the number of tests that should run.
-int UnitTestImpl::FilterTests(ReactionToSharding shard_tests) {
+// . The TestInfo objects of the deferred tests are created as specified by
+// deferred_tests. Returns the number of tests that should run.
+int UnitTestImpl::FilterTests(ReactionToSharding shard_tests,
+                              ReactionToDeferredTests deferred_tests) {
   const int32_t total_shards = shard_tests == HONOR_SHARDING_PROTOCOL
                                    ? GTEST_FLAG_GET(total_shards)
                                    : -1;
   const int32_t shard_index =
       shard_tests == HONOR_SHARDING_PROTOCOL ? GTEST_FLAG_GET(shard_index) : -1;
 
+  // With --gtest_shard_by=hash, the shard of each test only depends on its
+  // name.  With --gtest_shard_timing, which cannot be combined with it, the
+  // tests are assigned to the shards once all the runnable tests are known.
+  std::vector<uint32_t> shard_weights;
+  const bool shard_by_hash =
+      shard_tests == HONOR_SHARDING_PROTOCOL &&
+      ParseShardByFlagOrDie(total_shards, &shard_weights);
+  const bool balance_shards = shard_tests == HONOR_SHARDING_PROTOCOL &&
+                              !shard_by_hash &&
+                              !GTEST_FLAG_GET(shard_timing).empty();
+  std::vector<TestInfo*> runnable_tests;
+
   const PositiveAndNegativeUnitTestFilter gtest_flag_filter(
       GTEST_FLAG_GET(filter));
+  PositiveAndNegativeUnitTestFilter::TestSuiteMatcher filter_matcher(
+      gtest_flag_filter);
   const UnitTestFilter disable_test_filter(kDisableTestFilter);
   // num_runnable_tests are the number of tests that will
   // run across all shards (i.e., match filter and are not disabled).
@@ -6310,60 +11378,524 @@ int UnitTestImpl::FilterTests(ReactionToSharding shard_tests) {
   for (auto* test_suite : test_suites_) {
     const std::string& test_suite_name = test_suite->name_;
     test_suite->set_should_run(false);
-
-    for (TestInfo* test_info : test_suite->test_info_list()) {
-      const std::string& test_name = test_info->name_;
+    const bool test_suite_is_disabled =
+        disable_test_filter.MatchesName(test_suite_name);
+    // False if the filter rules out all the tests of the test suite.
+    const bool test_suite_may_match =
+        filter_matcher.StartTestSuite(test_suite_name);
+
+    // Decides whether the test with the given name runs.
+    const auto filter_test = [&](const std::string& test_name) {
+      TestFilterResult result;
       // A test is disabled if test suite name or test name matches
       // kDisableTestFilter.
-      const bool is_disabled =
-          disable_test_filter.MatchesName(test_suite_name) ||
-          disable_test_filter.MatchesName(test_name);
-      test_info->is_disabled_ = is_disabled;
+      result.is_disabled = test_suite_is_disabled ||
+                           disable_test_filter.MatchesName(test_name);
+
+      result.matches_filter =
+          test_suite_may_match && filter_matcher.MatchesTest(test_name);
+
+      result.is_runnable =
+          (GTEST_FLAG_GET(also_run_disabled_tests) || !result.is_disabled) &&
+          result.matches_filter;
+
+      result.is_in_another_shard =
+          shard_tests != IGNORE_SHARDING_PROTOCOL && !balance_shards &&
+          (shard_by_hash
+               ? GetShardOfTestByHash(test_suite_name + "." + test_name,
+                                      shard_weights) != shard_index
+               : !ShouldRunTestOnShard(total_shards, shard_index,
+                                       num_runnable_tests));
+      result.is_selected = result.is_runnable && !result.is_in_another_shard;
+
+      num_runnable_tests += result.is_runnable;
+      num_selected_tests += result.is_selected;
+      return result;
+    };
+    // Records the decision in the TestInfo object of the test.
+    const auto record_result = [&](const TestFilterResult& result,
+                                   TestInfo* test_info) {
+      test_info->is_disabled_ = result.is_disabled;
+      test_info->matches_filter_ = result.matches_filter;
+      test_info->is_in_another_shard_ = result.is_in_another_shard;
+      test_info->should_run_ = result.is_selected;
+      test_suite->set_should_run(test_suite->should_run() ||
+                                 result.is_selected);
+      if (balance_shards && result.is_runnable) {
+        runnable_tests.push_back(test_info);
+      }
+    };
+
+    if (test_suite->deferred_tests_.empty()) {
+      for (TestInfo* test_info : test_suite->test_info_list()) {
+        record_result(filter_test(test_info->name_), test_info);
+      }
+      continue;
+    }
+
+    // Creates the TestInfo objects of the deferred tests that need one and
+    // rebuilds the test list in registration order.
+    std::vector<TestInfo*> test_infos;
+    test_suite->ForEachTest(
+        [&](TestInfo* test_info) {
+          record_result(filter_test(test_info->name_), test_info);
+          test_infos.push_back(test_info);
+        },
+        [&](TestSuite::DeferredTests& deferred) {
+          // The names of the tests are not needed when the filter rules out
+          // the whole test suite.
+          if (!test_suite_may_match && deferred_tests != CREATE_ALL_TESTS) {
+            for (const auto& entry : deferred.test_infos) {
+              record_result(filter_test(entry.second->name_), entry.second);
+              test_infos.push_back(entry.second);
+            }
+            return;
+          }
+          deferred.group->ForEachTestName([&](size_t index,
+                                              const std::string& test_name) {
+            const TestFilterResult result = filter_test(test_name);
+            const auto it = deferred.test_infos.find(index);
+            TestInfo* test_info =
+                it == deferred.test_infos.end() ? nullptr : it->second;
+            // With --gtest_shard_timing, the shards are only known once all
+            // the runnable tests are.
+            const bool is_reportable =
+                result.matches_filter &&
+                (balance_shards || !result.is_in_another_shard);
+            if (test_info == nullptr &&
+                (deferred_tests == CREATE_ALL_TESTS ||
+                 (deferred_tests == CREATE_REPORTABLE_TESTS &&
+                  is_reportable))) {
+              test_info = deferred.group->CreateTestInfo(index);
+              deferred.test_infos.emplace(index, test_info);
+            }
+            if (test_info != nullptr) {
+              record_result(result, test_info);
+              test_infos.push_back(test_info);
+            }
+            return true;
+          });
+        });
+    test_suite->test_info_list_ = std::move(test_infos);
+    test_suite->test_indices_.resize(test_suite->test_info_list_.size());
+    for (size_t i = 0; i < test_suite->test_indices_.size(); ++i) {
+      test_suite->test_indices_[i] = static_cast<int>(i);
+    }
+  }
+
+  if (balance_shards) {
+    num_selected_tests = BalanceShards(runnable_tests, total_shards,
+                                       shard_index);
+  }
+  return num_selected_tests;
+}
 
-      const bool matches_filter =
-          gtest_flag_filter.MatchesTest(test_suite_name, test_name);
-      test_info->matches_filter_ = matches_filter;
+// Moves the tests that --gtest_shard_timing assigns to other shards out of
+// this one.  Tests missing from the timing report, or that did not complete
+// in it, are expected to take as long as the average completed test in it.
+// Returns the number of tests left on this shard.
+int UnitTestImpl::BalanceShards(const std::vector<TestInfo*>& runnable_tests,
+                                int total_shards, int shard_index) {
+#if GTEST_HAS_FILE_SYSTEM
+  const std::unordered_map<std::string, TimeInNanos> known_durations =
+      ReadShardTimingOrDie();
+#else
+  const std::unordered_map<std::string, TimeInNanos> known_durations;
+#endif  // GTEST_HAS_FILE_SYSTEM
+  TimeInNanos total_duration = 0;
+  for (const auto& entry : known_durations) total_duration += entry.second;
+  const TimeInNanos default_duration =
+      known_durations.empty()
+          ? 1
+          : total_duration / static_cast<TimeInNanos>(known_durations.size());
+
+  std::vector<TimeInNanos> durations;
+  for (const TestInfo* test_info : runnable_tests) {
+    const auto it = known_durations.find(std::string(
+        test_info->test_suite_name()) + "." + test_info->name());
+    // Tests too fast to be timed still count, so that they are spread across
+    // the shards too.
+    durations.push_back(std::max<TimeInNanos>(
+        1, it == known_durations.end() ? default_duration : it->second));
+  }
+  const std::vector<int> shards = AssignTestsToShards(durations, total_shards);
+
+  int num_selected_tests = 0;
+  for (size_t i = 0; i < runnable_tests.size(); i++) {
+    TestInfo* const test_info = runnable_tests[i];
+    test_info->is_in_another_shard_ = shards[i] != shard_index;
+    test_info->should_run_ = !test_info->is_in_another_shard_;
+    num_selected_tests += test_info->should_run_;
+  }
+  for (auto* test_suite : test_suites_) {
+    test_suite->set_should_run(
+        std::any_of(test_suite->test_info_list().begin(),
+                    test_suite->test_info_list().end(),
+                    [](const TestInfo* test_info) {
+                      return test_info->should_run();
+                    }));
+  }
+  return num_selected_tests;
+}
 
-      const bool is_runnable =
-          (GTEST_FLAG_GET(also_run_disabled_tests) || !is_disabled) &&
-          matches_filter;
+#if GTEST_HAS_FILE_SYSTEM
+namespace {
 
-      const bool is_in_another_shard =
-          shard_tests != IGNORE_SHARDING_PROTOCOL &&
-          !ShouldRunTestOnShard(total_shards, shard_index, num_runnable_tests);
-      test_info->is_in_another_shard_ = is_in_another_shard;
-      const bool is_selected = is_runnable && !is_in_another_shard;
+// A result cache file starts with this magic string, followed by the number
+// of keys and by the keys themselves, in increasing order, all as native
+// 64-bit integers.
+constexpr char kTestResultCacheMagic[] = "GTCACHE1";
+constexpr size_t kTestResultCacheMagicSize = sizeof(kTestResultCacheMagic) - 1;
+constexpr size_t kTestResultCacheHeaderSize =
+    kTestResultCacheMagicSize + sizeof(uint64_t);
 
-      num_runnable_tests += is_runnable;
-      num_selected_tests += is_selected;
+#ifdef GTEST_OS_LINUX
+// The GNU build-ids of the objects loaded in the test program.
+struct LoadedBuildIds {
+  // The build-id of the test program itself, or empty if it has none.
+  std::string program;
+  // The names and build-ids of the shared libraries that have one.
+  std::string libraries;
+  bool seen_program = false;
+};
 
-      test_info->should_run_ = is_selected;
-      test_suite->set_should_run(test_suite->should_run() || is_selected);
+// Called by dl_iterate_phdr() on the loaded objects, the test program first.
+// Appends the GNU build-id of each object, if any, to the LoadedBuildIds
+// *data.
+int ReadGnuBuildId(struct dl_phdr_info* info, size_t /* size */, void* data) {
+  LoadedBuildIds* const ids = static_cast<LoadedBuildIds*>(data);
+  const bool is_program = !ids->seen_program;
+  ids->seen_program = true;
+  for (int i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr)& segment = info->dlpi_phdr[i];
+    if (segment.p_type != PT_NOTE) continue;
+    const char* note =
+        reinterpret_cast<const char*>(info->dlpi_addr + segment.p_vaddr);
+    const char* const end = note + segment.p_memsz;
+    while (end - note >= static_cast<ptrdiff_t>(sizeof(ElfW(Nhdr)))) {
+      ElfW(Nhdr) header;
+      memcpy(&header, note, sizeof(header));
+      const char* const name = note + sizeof(header);
+      const char* const desc = name + ((header.n_namesz + 3) & ~3u);
+      const char* const next = desc + ((header.n_descsz + 3) & ~3u);
+      if (next > end) break;
+      if (header.n_type == NT_GNU_BUILD_ID && header.n_namesz == 4 &&
+          memcmp(name, "GNU", 4) == 0) {
+        const std::string build_id(desc, header.n_descsz);
+        if (is_program) {
+          ids->program = build_id;
+        } else {
+          ids->libraries += ";";
+          ids->libraries += info->dlpi_name != nullptr ? info->dlpi_name : "";
+          ids->libraries += "=" + build_id;
+        }
+        return 0;
+      }
+      note = next;
+    }
+  }
+  return 0;
+}
+#endif  // GTEST_OS_LINUX
+
+// Returns a string that changes whenever the test program is rebuilt: its
+// build-id if the linker recorded one, or else a hash of the executable. On
+// Linux, the build-ids of the loaded shared libraries are part of it too, so
+// that rebuilding a library under test changes it as well.
+// Returns an empty string if the test program cannot be identified.
+std::string GetTestProgramBuildId() {
+#ifdef GTEST_OS_LINUX
+  LoadedBuildIds ids;
+  dl_iterate_phdr(ReadGnuBuildId, &ids);
+  if (!ids.program.empty()) return "build-id:" + ids.program + ids.libraries;
+  const FilePath executable("/proc/self/exe");
+#else
+  const std::vector<std::string> args = GetArgvs();
+  if (args.empty()) return "";
+  FilePath executable(args[0]);
+  if (!executable.IsAbsolutePath()) {
+    executable = FilePath::ConcatPaths(
+        FilePath(UnitTest::GetInstance()->original_working_dir()), executable);
+  }
+#endif  // GTEST_OS_LINUX
+  FILE* const file = posix::FOpen(executable.c_str(), "rb");
+  if (file == nullptr) return "";
+  StableHasher hasher;
+  char buffer[4096];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    hasher.Update(buffer, size);
+  }
+  posix::FClose(file);
+#ifdef GTEST_OS_LINUX
+  return "hash:" + StreamableToString(hasher.Finish()) + ids.libraries;
+#else
+  return "hash:" + StreamableToString(hasher.Finish());
+#endif  // GTEST_OS_LINUX
+}
+
+// Returns an identifier of the test program and of the flags that change
+// how its tests run, or an empty string if the program cannot be identified.
+std::string GetTestResultCacheProgramId() {
+  std::string id = GetTestProgramBuildId();
+  if (id.empty()) return id;
+  Message flags;
+  flags << ";catch_exceptions=" << GTEST_FLAG_GET(catch_exceptions)
+        << ";death_test_style=" << GTEST_FLAG_GET(death_test_style)
+        << ";death_test_use_fork=" << GTEST_FLAG_GET(death_test_use_fork)
+        << ";random_seed=" << GTEST_FLAG_GET(random_seed)
+        << ";shuffle=" << GTEST_FLAG_GET(shuffle)
+        << ";throw_on_failure=" << GTEST_FLAG_GET(throw_on_failure);
+  return id + flags.GetString();
+}
+
+// Returns the name of the cache file of the test program with the given
+// identifier.
+FilePath GetTestResultCacheFileName(const std::string& program_id) {
+  StableHasher hasher;
+  hasher.Update(program_id);
+  std::stringstream name;
+  name << GetCurrentExecutableName().string() << "-" << std::hex
+       << std::setw(16) << std::setfill('0') << hasher.Finish() << ".gtcache";
+  return FilePath(name.str());
+}
+
+}  // namespace
+
+TestResultCache::TestResultCache(const FilePath& directory,
+                                 const std::string& program_id)
+    : path_(FilePath::ConcatPaths(directory,
+                                  GetTestResultCacheFileName(program_id))),
+      keys_(nullptr),
+      key_count_(0)
+#ifdef GTEST_OS_LINUX
+      ,
+      mapping_(nullptr),
+      mapping_size_(0)
+#endif  // GTEST_OS_LINUX
+{
+  Load();
+}
+
+TestResultCache::~TestResultCache() { Unload(); }
+
+uint64_t TestResultCache::KeyOf(const TestInfo& test_info) {
+  StableHasher hasher;
+  hasher.Update(std::string(test_info.test_suite_name()));
+  hasher.Update(std::string(test_info.name()));
+  const char* const type_param = test_info.type_param();
+  hasher.Update(std::string(type_param != nullptr ? type_param : ""));
+  const char* const value_param = test_info.value_param();
+  hasher.Update(std::string(value_param != nullptr ? value_param : ""));
+  return hasher.Finish();
+}
+
+bool TestResultCache::Contains(uint64_t key) const {
+  return std::binary_search(keys_, keys_ + key_count_, key);
+}
+
+void TestResultCache::Record(uint64_t key, bool passed) {
+  if (passed) {
+    passed_.insert(key);
+    failed_.erase(key);
+  } else {
+    failed_.insert(key);
+    passed_.erase(key);
+  }
+}
+
+void TestResultCache::Load() {
+#ifdef GTEST_OS_LINUX
+  // Maps the file instead of reading it, so that only the pages holding the
+  // keys looked up are read.
+  const int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return;
+  struct stat file_status;
+  if (fstat(fd, &file_status) == 0 &&
+      static_cast<size_t>(file_status.st_size) >= kTestResultCacheHeaderSize) {
+    const size_t size = static_cast<size_t>(file_status.st_size);
+    void* const mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+      mapping_ = mapping;
+      mapping_size_ = size;
+    }
+  }
+  close(fd);
+  if (mapping_ == nullptr) return;
+  const char* const data = static_cast<const char*>(mapping_);
+  const size_t size = mapping_size_;
+#else
+  FILE* const file = posix::FOpen(path_.c_str(), "rb");
+  if (file == nullptr) return;
+  const std::string contents = ReadEntireFile(file);
+  posix::FClose(file);
+  const char* const data = contents.data();
+  const size_t size = contents.size();
+#endif  // GTEST_OS_LINUX
+
+  uint64_t key_count = 0;
+  if (size >= kTestResultCacheHeaderSize) {
+    memcpy(&key_count, data + kTestResultCacheMagicSize, sizeof(key_count));
+  }
+  if (size < kTestResultCacheHeaderSize ||
+      memcmp(data, kTestResultCacheMagic, kTestResultCacheMagicSize) != 0 ||
+      (size - kTestResultCacheHeaderSize) / sizeof(uint64_t) != key_count ||
+      (size - kTestResultCacheHeaderSize) % sizeof(uint64_t) != 0) {
+    // Not a cache file written by Save().
+    Unload();
+    return;
+  }
+  key_count_ = static_cast<size_t>(key_count);
+#ifdef GTEST_OS_LINUX
+  keys_ = reinterpret_cast<const uint64_t*>(data + kTestResultCacheHeaderSize);
+#else
+  key_storage_.resize(key_count_);
+  memcpy(key_storage_.data(), data + kTestResultCacheHeaderSize,
+         key_count_ * sizeof(uint64_t));
+  keys_ = key_storage_.data();
+#endif  // GTEST_OS_LINUX
+}
+
+void TestResultCache::Unload() {
+#ifdef GTEST_OS_LINUX
+  if (mapping_ != nullptr) munmap(mapping_, mapping_size_);
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+#endif  // GTEST_OS_LINUX
+  key_storage_.clear();
+  keys_ = nullptr;
+  key_count_ = 0;
+}
+
+bool TestResultCache::Save() {
+  // Other shards or runs of the test program may have saved the cache since
+  // it was loaded.
+  Unload();
+  Load();
+  std::vector<uint64_t> kept_keys;
+  std::copy_if(keys_, keys_ + key_count_, std::back_inserter(kept_keys),
+               [this](uint64_t key) { return failed_.count(key) == 0; });
+  std::vector<uint64_t> keys;
+  std::set_union(kept_keys.begin(), kept_keys.end(), passed_.begin(),
+                 passed_.end(), std::back_inserter(keys));
+  Unload();
+  key_storage_ = keys;
+  keys_ = key_storage_.data();
+  key_count_ = key_storage_.size();
+
+  const FilePath directory = path_.RemoveFileName();
+  if (!directory.IsEmpty() && !directory.CreateDirectoriesRecursively()) {
+    return false;
+  }
+
+  // Writes a new file and renames it over the old one, so that concurrent
+  // runs never read a partially written cache.
+  FilePath temp_path;
+  FILE* file = nullptr;
+  for (int attempt = 0; file == nullptr && attempt < 100; attempt++) {
+    temp_path = FilePath::GenerateUniqueFileName(
+        directory, path_.RemoveDirectoryName(), "tmp");
+    file = posix::FOpen(temp_path.c_str(), "wbx");
+  }
+  if (file == nullptr) return false;
+  const uint64_t key_count = keys.size();
+  bool ok =
+      fwrite(kTestResultCacheMagic, 1, kTestResultCacheMagicSize, file) ==
+          kTestResultCacheMagicSize &&
+      fwrite(&key_count, sizeof(key_count), 1, file) == 1 &&
+      fwrite(keys.data(), sizeof(uint64_t), keys.size(), file) == keys.size();
+  ok = posix::FClose(file) == 0 && ok;
+  if (ok && rename(temp_path.c_str(), path_.c_str()) != 0) {
+    // Windows does not replace existing files.
+    remove(path_.c_str());
+    ok = rename(temp_path.c_str(), path_.c_str()) == 0;
+  }
+  if (!ok) remove(temp_path.c_str());
+  return ok;
+}
+
+void UnitTestImpl::LoadTestResultCache() {
+  const std::string program_id = GetTestResultCacheProgramId();
+  if (program_id.empty()) {
+    ColoredPrintf(GTestColor::kYellow,
+                  "WARNING: cannot identify the test program; --%scache_dir "
+                  "is ignored.\n",
+                  GTEST_FLAG_PREFIX_);
+    fflush(stdout);
+    return;
+  }
+  FilePath directory(GTEST_FLAG_GET(cache_dir));
+  if (!directory.IsAbsolutePath()) {
+    directory = FilePath::ConcatPaths(original_working_dir_, directory);
+  }
+  test_result_cache_.reset(new TestResultCache(directory, program_id));
+}
+
+void UnitTestImpl::MarkCachedTests() {
+  if (test_result_cache_ == nullptr) return;
+  for (auto* test_suite : test_suites_) {
+    for (TestInfo* test_info : test_suite->test_info_list()) {
+      if (test_info->should_run() &&
+          test_result_cache_->Contains(TestResultCache::KeyOf(*test_info))) {
+        test_info->result_.set_cached(true);
+      }
     }
   }
-  return num_selected_tests;
 }
 
+void UnitTestImpl::RecordTestResultsInCache() {
+  if (test_result_cache_ == nullptr) return;
+  // A failure outside of the tests, e.g. in a global environment, may come
+  // from any of them.
+  const bool environment_failed = ad_hoc_test_result_.Failed();
+  for (auto* test_suite : test_suites_) {
+    const bool test_suite_failed =
+        environment_failed || test_suite->ad_hoc_test_result().Failed();
+    for (TestInfo* test_info : test_suite->test_info_list()) {
+      const TestResult& result = *test_info->result();
+      // Skipped tests may run next time.
+      if (!test_info->should_run() || result.Cached() || result.Skipped()) {
+        continue;
+      }
+      test_result_cache_->Record(TestResultCache::KeyOf(*test_info),
+                                 result.Passed() && !test_suite_failed);
+    }
+  }
+}
+#endif  // GTEST_HAS_FILE_SYSTEM
+
 // Returns true if a warning should be issued if no tests match the test filter
 // flag. We can't simply count the number of tests that ran because, for
 // instance, test sharding and death tests might mean no tests are expected to
 // run in this process, but will run in another process.
 bool UnitTestImpl::ShouldWarnIfNoTestsMatchFilter() const {
-  if (total_test_count() == 0) {
+  if (linked_test_count() == 0) {
     // No tests were linked in to program.
     // This case is handled by a different warning.
     return false;
   }
   const PositiveAndNegativeUnitTestFilter gtest_flag_filter(
       GTEST_FLAG_GET(filter));
+  PositiveAndNegativeUnitTestFilter::TestSuiteMatcher filter_matcher(
+      gtest_flag_filter);
+  bool any_test_matches = false;
   for (auto* test_suite : test_suites_) {
-    const std::string& test_suite_name = test_suite->name_;
-    for (TestInfo* test_info : test_suite->test_info_list()) {
-      const std::string& test_name = test_info->name_;
-      if (gtest_flag_filter.MatchesTest(test_suite_name, test_name)) {
-        return false;
-      }
-    }
+    if (!filter_matcher.StartTestSuite(test_suite->name_)) continue;
+    // The deferred tests in other shards have no TestInfo objects.
+    test_suite->ForEachTest(
+        [&](TestInfo* test_info) {
+          any_test_matches = any_test_matches ||
+                             filter_matcher.MatchesTest(test_info->name_);
+        },
+        [&](TestSuite::DeferredTests& deferred) {
+          deferred.group->ForEachTestName(
+              [&](size_t, const std::string& test_name) {
+                any_test_matches = any_test_matches ||
+                                   filter_matcher.MatchesTest(test_name);
+                return !any_test_matches;
+              });
+        });
+    if (any_test_matches) return false;
   }
   return true;
 }
@@ -6395,33 +11927,61 @@ void UnitTestImpl::ListTestsMatchingFilter() {
   // Print at most this many characters for each type/value parameter.
   const int kMaxParamLength = 250;
 
+  // The deferred tests without TestInfo objects are filtered again here, so
+  // that their names are streamed rather than kept.
+  const PositiveAndNegativeUnitTestFilter gtest_flag_filter(
+      GTEST_FLAG_GET(filter));
+  PositiveAndNegativeUnitTestFilter::TestSuiteMatcher filter_matcher(
+      gtest_flag_filter);
   for (auto* test_suite : test_suites_) {
     bool printed_test_suite_name = false;
-
-    for (size_t j = 0; j < test_suite->test_info_list().size(); j++) {
-      const TestInfo* const test_info = test_suite->test_info_list()[j];
-      if (test_info->matches_filter_) {
-        if (!printed_test_suite_name) {
-          printed_test_suite_name = true;
-          printf("%s.", test_suite->name());
-          if (test_suite->type_param() != nullptr) {
-            printf("  # %s = ", kTypeParamLabel);
-            // We print the type parameter on a single line to make
-            // the output easy to parse by a program.
-            PrintOnOneLine(test_suite->type_param(), kMaxParamLength);
-          }
-          printf("\n");
-        }
-        printf("  %s", test_info->name());
-        if (test_info->value_param() != nullptr) {
-          printf("  # %s = ", kValueParamLabel);
-          // We print the value parameter on a single line to make the
-          // output easy to parse by a program.
-          PrintOnOneLine(test_info->value_param(), kMaxParamLength);
+    const auto print_test = [&](const char* test_name,
+                                const char* value_param) {
+      if (!printed_test_suite_name) {
+        printed_test_suite_name = true;
+        printf("%s.", test_suite->name());
+        if (test_suite->type_param() != nullptr) {
+          printf("  # %s = ", kTypeParamLabel);
+          // We print the type parameter on a single line to make
+          // the output easy to parse by a program.
+          PrintOnOneLine(test_suite->type_param(), kMaxParamLength);
         }
         printf("\n");
       }
-    }
+      printf("  %s", test_name);
+      if (value_param != nullptr) {
+        printf("  # %s = ", kValueParamLabel);
+        // We print the value parameter on a single line to make the
+        // output easy to parse by a program.
+        PrintOnOneLine(value_param, kMaxParamLength);
+      }
+      printf("\n");
+    };
+    const bool test_suite_may_match =
+        filter_matcher.StartTestSuite(test_suite->name_);
+
+    test_suite->ForEachTest(
+        [&](TestInfo* test_info) {
+          if (test_info->matches_filter_) {
+            print_test(test_info->name(), test_info->value_param());
+          }
+        },
+        [&](TestSuite::DeferredTests& deferred) {
+          if (!test_suite_may_match) return;
+          deferred.group->ForEachTestName([&](size_t index,
+                                              const std::string& test_name) {
+            const auto it = deferred.test_infos.find(index);
+            if (it != deferred.test_infos.end()) {
+              if (it->second->matches_filter_) {
+                print_test(test_name.c_str(), it->second->value_param());
+              }
+            } else if (filter_matcher.MatchesTest(test_name)) {
+              print_test(test_name.c_str(),
+                         deferred.group->GetValueParam(index).c_str());
+            }
+            return true;
+          });
+        });
   }
   fflush(stdout);
 #if GTEST_HAS_FILE_SYSTEM
@@ -6429,7 +11989,8 @@ void UnitTestImpl::ListTestsMatchingFilter() {
   if (output_format == "xml" || output_format == "json") {
     FILE* fileout =
         OpenFileForWriting(UnitTestOptions::GetAbsolutePathToOutputFile());
-    std::stringstream stream;
+    FileStreamBuf buffer(fileout);
+    std::ostream stream(&buffer);
     if (output_format == "xml") {
       XmlUnitTestResultPrinter(
           UnitTestOptions::GetAbsolutePathToOutputFile().c_str())
@@ -6439,7 +12000,6 @@ void UnitTestImpl::ListTestsMatchingFilter() {
           UnitTestOptions::GetAbsolutePathToOutputFile().c_str())
           .PrintJsonTestList(&stream, test_suites_);
     }
-    fprintf(fileout, "%s", StringStreamToString(&stream).c_str());
     fclose(fileout);
   }
 #endif  // GTEST_HAS_FILE_SYSTEM
@@ -6475,11 +12035,13 @@ OsStackTraceGetterInterface* UnitTestImpl::os_stack_trace_getter() {
 
 // Returns the most specific TestResult currently running.
 TestResult* UnitTestImpl::current_test_result() {
-  if (current_test_info_ != nullptr) {
-    return &current_test_info_->result_;
+  TestInfo* const test_info = current_test_info();
+  if (test_info != nullptr) {
+    return &test_info->result_;
   }
-  if (current_test_suite_ != nullptr) {
-    return &current_test_suite_->ad_hoc_test_result_;
+  TestSuite* const test_suite = mutable_current_test_suite();
+  if (test_suite != nullptr) {
+    return &test_suite->ad_hoc_test_result_;
   }
   return &ad_hoc_test_result_;
 }
@@ -6722,6 +12284,15 @@ static const char kColorEncodedHelpMessage[] =
     "  @G--" GTEST_FLAG_PREFIX_
     "also_run_disabled_tests@D\n"
     "      Run all disabled tests too.\n"
+    "  @G--" GTEST_FLAG_PREFIX_
+    "shard_by=@Y(@Gindex@Y|@Ghash@Y[:@YWEIGHTS@Y])@D\n"
+    "      When sharding, assign the tests by their order (the default) or by\n"
+    "      a hash of their names, which keeps them on the same shard when\n"
+    "      other tests are added or removed.\n"
+    "  @G--" GTEST_FLAG_PREFIX_
+    "shard_timing=@YJSON_FILE@D\n"
+    "      When sharding, balance the shards by the test durations recorded\n"
+    "      in a previous JSON report.\n"
     "\n"
     "Test Execution:\n"
     "  @G--" GTEST_FLAG_PREFIX_
@@ -6742,8 +12313,47 @@ static const char kColorEncodedHelpMessage[] =
     "fail_fast@D\n"
     "      Stop running tests after the first failure.\n"
     "  @G--" GTEST_FLAG_PREFIX_
+    "benchmark_time_ms=@Y[MILLISECONDS]@D\n"
+    "      Time each benchmark test for about the given time; 0 runs their\n"
+    "      bodies once without timing them.\n"
+    "  @G--" GTEST_FLAG_PREFIX_
     "fail_if_no_test_linked@D\n"
     "      Fail if no test is linked into the test program.\n"
+#if GTEST_CAN_STREAM_RESULTS_
+    "  @G--" GTEST_FLAG_PREFIX_
+    "serve=@Y(@Gstdin@Y|@Gunix:@YSOCKET_PATH)@D\n"
+    "      Stay alive and run the tests requested on the standard input or on\n"
+    "      the given Unix domain socket, streaming the results back.\n"
+#endif  // GTEST_CAN_STREAM_RESULTS_
+#if GTEST_HAS_FILE_SYSTEM
+    "  @G--" GTEST_FLAG_PREFIX_
+    "cache_dir=@YDIRECTORY_PATH@D\n"
+    "      Record the tests that pass in the given directory and do not run\n"
+    "      them again in later runs of the same test binary.\n"
+#endif  // GTEST_HAS_FILE_SYSTEM
+#ifdef GTEST_IS_THREADSAFE
+    "  @G--" GTEST_FLAG_PREFIX_
+    "test_timeout=@Y[SECONDS]@D\n"
+    "      Fail a test that runs for longer than the given time, printing the\n"
+    "      stack traces of all the threads.\n"
+#endif  // GTEST_IS_THREADSAFE
+#if GTEST_CAN_RUN_TEST_JOBS_
+    "  @G--" GTEST_FLAG_PREFIX_
+    "jobs=@Y[NUMBER]@D\n"
+    "      Run test suites concurrently in the given number of processes.\n"
+#endif  // GTEST_CAN_RUN_TEST_JOBS_
+#ifdef GTEST_IS_THREADSAFE
+    "  @G--" GTEST_FLAG_PREFIX_
+    "parallel=@Y[NUMBER]@D\n"
+    "      Run test suites concurrently on the given number of threads.\n"
+    "  @G--" GTEST_FLAG_PREFIX_
+    "parallel_exclude=@YSUITE_PATTERNS@D\n"
+    "      Run the matching test suites on the main thread only.\n"
+    "  @G--" GTEST_FLAG_PREFIX_
+    "async_listeners@D\n"
+    "      Deliver the events to the async-safe listeners on a thread of\n"
+    "      their own.\n"
+#endif  // GTEST_IS_THREADSAFE
     "\n"
     "Test Output:\n"
     "  @G--" GTEST_FLAG_PREFIX_
@@ -6759,26 +12369,53 @@ static const char kColorEncodedHelpMessage[] =
     "print_utf8=0@D\n"
     "      Don't print UTF-8 characters as text.\n"
     "  @G--" GTEST_FLAG_PREFIX_
-    "output=@Y(@Gjson@Y|@Gxml@Y)[@G:@YDIRECTORY_PATH@G" GTEST_PATH_SEP_
+    "print_resources@D\n"
+    "      Measure the CPU time, memory, page faults and context switches of\n"
+    "      each test, and print the tests that use the most.\n"
+    "  @G--" GTEST_FLAG_PREFIX_
+    "print_phase_times@D\n"
+    "      Measure the time spent in each phase of the tests (constructing\n"
+    "      the fixture, SetUp(), the body, TearDown(), SetUpTestSuite()...),\n"
+    "      and print where the time went.\n"
+    "  @G--" GTEST_FLAG_PREFIX_
+    "output_buffering=@Y[BYTES]@D\n"
+    "      Buffer the text output instead of writing it after every event;\n"
+    "      failures are still written out right away.\n"
+    "  @G--" GTEST_FLAG_PREFIX_
+    "output=@Y(@Gjson@Y|@Gxml@Y|@Gbin@Y)[@G:@YDIRECTORY_PATH@G" GTEST_PATH_SEP_
     "@Y|@G:@YFILE_PATH]@D\n"
-    "      Generate a JSON or XML report in the given directory or with the "
-    "given\n"
-    "      file name. @YFILE_PATH@D defaults to @Gtest_detail.xml@D.\n"
+    "      Generate a JSON, XML or binary report in the given directory or "
+    "with\n"
+    "      the given file name. @YFILE_PATH@D defaults to "
+    "@Gtest_detail.xml@D.\n"
 #if GTEST_CAN_STREAM_RESULTS_
     "  @G--" GTEST_FLAG_PREFIX_
-    "stream_result_to=@YHOST@G:@YPORT@D\n"
-    "      Stream test results to the given server.\n"
+    "stream_result_to=@YHOST@G:@YPORT@D|@Gunix:@YPATH@D[@G?@YOPTIONS@D]\n"
+    "      Stream test results to the given server or Unix domain socket.\n"
+    "      @YOPTIONS@D are @Gframing=@Ytext@D|@Gcompact@D, "
+    "@Gbuffer=@YBYTES@D, and\n"
+    "      @Goverflow=@Yblock@D|@Gdrop@D, separated by @G&@D.\n"
+    "  @G--" GTEST_FLAG_PREFIX_
+    "stream_result_to=shm:@YPATH@D[@G?size=@YBYTES@D]\n"
+    "      Publish test results to a ring buffer mapped from the given file,\n"
+    "      e.g. under /dev/shm, that holds up to @YBYTES@D of events.\n"
 #endif  // GTEST_CAN_STREAM_RESULTS_
     "\n"
     "Assertion Behavior:\n"
 #if defined(GTEST_HAS_DEATH_TEST) && !defined(GTEST_OS_WINDOWS)
     "  @G--" GTEST_FLAG_PREFIX_
-    "death_test_style=@Y(@Gfast@Y|@Gthreadsafe@Y)@D\n"
+    "death_test_style=@Y(@Gfast@Y|@Gthreadsafe@Y|@Gzygote@Y)@D\n"
     "      Set the default death test style.\n"
     "  @G--" GTEST_FLAG_PREFIX_
     "death_test_use_fork@D\n"
     "      Use fork() instead of clone() to spawn death test child processes.\n"
 #endif  // GTEST_HAS_DEATH_TEST && !GTEST_OS_WINDOWS
+#ifdef GTEST_HAS_DEATH_TEST
+    "  @G--" GTEST_FLAG_PREFIX_
+    "death_test_output_limit=@YBYTES@D\n"
+    "      Keep only the first and last BYTES/2 bytes of the output of death\n"
+    "      test child processes. 0 means no limit.\n"
+#endif  // GTEST_HAS_DEATH_TEST
     "  @G--" GTEST_FLAG_PREFIX_
     "break_on_failure@D\n"
     "      Turn assertion failures into debugger break-points.\n"
@@ -6823,9 +12460,13 @@ static bool ParseGoogleTestFlag(const char* const arg) {
   } while (false)
 
   GTEST_INTERNAL_PARSE_FLAG(also_run_disabled_tests);
+  GTEST_INTERNAL_PARSE_FLAG(async_listeners);
+  GTEST_INTERNAL_PARSE_FLAG(benchmark_time_ms);
   GTEST_INTERNAL_PARSE_FLAG(break_on_failure);
+  GTEST_INTERNAL_PARSE_FLAG(cache_dir);
   GTEST_INTERNAL_PARSE_FLAG(catch_exceptions);
   GTEST_INTERNAL_PARSE_FLAG(color);
+  GTEST_INTERNAL_PARSE_FLAG(death_test_output_limit);
   GTEST_INTERNAL_PARSE_FLAG(death_test_style);
   GTEST_INTERNAL_PARSE_FLAG(death_test_use_fork);
   GTEST_INTERNAL_PARSE_FLAG(fail_fast);
@@ -6833,19 +12474,29 @@ static bool ParseGoogleTestFlag(const char* const arg) {
   GTEST_INTERNAL_PARSE_FLAG(fail_if_no_test_selected);
   GTEST_INTERNAL_PARSE_FLAG(filter);
   GTEST_INTERNAL_PARSE_FLAG(internal_run_death_test);
+  GTEST_INTERNAL_PARSE_FLAG(jobs);
   GTEST_INTERNAL_PARSE_FLAG(list_tests);
   GTEST_INTERNAL_PARSE_FLAG(output);
+  GTEST_INTERNAL_PARSE_FLAG(output_buffering);
+  GTEST_INTERNAL_PARSE_FLAG(parallel);
+  GTEST_INTERNAL_PARSE_FLAG(parallel_exclude);
   GTEST_INTERNAL_PARSE_FLAG(brief);
   GTEST_INTERNAL_PARSE_FLAG(print_time);
   GTEST_INTERNAL_PARSE_FLAG(print_utf8);
+  GTEST_INTERNAL_PARSE_FLAG(print_resources);
+  GTEST_INTERNAL_PARSE_FLAG(print_phase_times);
   GTEST_INTERNAL_PARSE_FLAG(random_seed);
   GTEST_INTERNAL_PARSE_FLAG(repeat);
+  GTEST_INTERNAL_PARSE_FLAG(serve);
+  GTEST_INTERNAL_PARSE_FLAG(shard_by);
   GTEST_INTERNAL_PARSE_FLAG(shard_index);
+  GTEST_INTERNAL_PARSE_FLAG(shard_timing);
   GTEST_INTERNAL_PARSE_FLAG(total_shards);
   GTEST_INTERNAL_PARSE_FLAG(recreate_environments_when_repeating);
   GTEST_INTERNAL_PARSE_FLAG(shuffle);
   GTEST_INTERNAL_PARSE_FLAG(stack_trace_depth);
   GTEST_INTERNAL_PARSE_FLAG(stream_result_to);
+  GTEST_INTERNAL_PARSE_FLAG(test_timeout);
   GTEST_INTERNAL_PARSE_FLAG(throw_on_failure);
   return false;
 }
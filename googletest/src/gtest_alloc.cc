@@ -0,0 +1,223 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Replaces the global operator new and operator delete with ones that count
+// the allocations of each thread, so that EXPECT_ALLOCATIONS_LE and
+// EXPECT_NO_ALLOCATIONS can check them and the result printers can report
+// the allocations of each test.  Link a test program with gtest_alloc to
+// use it.
+//
+// The counters belong to the thread, so updating them takes neither a lock
+// nor an atomic operation.  Memory deleted by another thread than the one
+// that allocated it counts as live in the thread that allocated it.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "gtest/gtest.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif  // _WIN32
+
+namespace {
+
+using ::testing::internal::AllocationCounters;
+
+// Zero-initialized without a dynamic initializer, so that it can be used
+// before the program starts and while the thread ends.
+thread_local AllocationCounters g_counters;
+
+AllocationCounters* GetCounters() { return &g_counters; }
+
+[[maybe_unused]] const bool g_counters_getter_installed =
+    (::testing::internal::SetAllocationCountersGetter(&GetCounters), true);
+
+// Every block starts with a header that holds its size, so that the
+// unsized operator delete can count the bytes it releases.  The header is
+// as large as the alignment of the block, which keeps the pointer returned
+// to the caller aligned.
+constexpr size_t kHeaderSize = alignof(std::max_align_t);
+static_assert(kHeaderSize >= sizeof(size_t),
+              "The header of a block must hold its size.");
+
+void* AllocateBlock(size_t size, size_t alignment) {
+  if (size > SIZE_MAX - alignment) return nullptr;
+  void* base = nullptr;
+  if (alignment == kHeaderSize) {
+    base = std::malloc(size + alignment);
+  } else {
+#ifdef _WIN32
+    base = _aligned_malloc(size + alignment, alignment);
+#else
+    if (posix_memalign(&base, alignment, size + alignment) != 0) {
+      base = nullptr;
+    }
+#endif  // _WIN32
+  }
+  if (base == nullptr) return nullptr;
+
+  AllocationCounters& counters = g_counters;
+  counters.count++;
+  counters.bytes += static_cast<int64_t>(size);
+  counters.live_bytes += static_cast<int64_t>(size);
+  if (counters.live_bytes > counters.peak_live_bytes) {
+    counters.peak_live_bytes = counters.live_bytes;
+  }
+
+  char* const block = static_cast<char*>(base) + alignment;
+  *reinterpret_cast<size_t*>(block - sizeof(size_t)) = size;
+  return block;
+}
+
+void DeleteBlock(void* block, size_t alignment) {
+  if (block == nullptr) return;
+  char* const base = static_cast<char*>(block) - alignment;
+  const size_t size =
+      *reinterpret_cast<size_t*>(static_cast<char*>(block) - sizeof(size_t));
+  g_counters.live_bytes -= static_cast<int64_t>(size);
+  if (alignment == kHeaderSize) {
+    std::free(base);
+  } else {
+#ifdef _WIN32
+    _aligned_free(base);
+#else
+    std::free(base);
+#endif  // _WIN32
+  }
+}
+
+// Allocates like the standard operator new does: calls the new-handler
+// until the allocation succeeds, and returns nullptr when there is none.
+void* Allocate(size_t size, size_t alignment) {
+  if (size == 0) size = 1;
+  if (alignment < kHeaderSize) alignment = kHeaderSize;
+  for (;;) {
+    void* const block = AllocateBlock(size, alignment);
+    if (block != nullptr) return block;
+    const std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) return nullptr;
+    handler();
+  }
+}
+
+void* AllocateOrThrow(size_t size, size_t alignment) {
+  void* const block = Allocate(size, alignment);
+  if (block == nullptr) {
+#if GTEST_HAS_EXCEPTIONS
+    throw std::bad_alloc();
+#else
+    std::abort();
+#endif  // GTEST_HAS_EXCEPTIONS
+  }
+  return block;
+}
+
+void* AllocateOrNull(size_t size, size_t alignment) noexcept {
+#if GTEST_HAS_EXCEPTIONS
+  try {
+    return Allocate(size, alignment);
+  } catch (const std::bad_alloc&) {
+    return nullptr;
+  }
+#else
+  return Allocate(size, alignment);
+#endif  // GTEST_HAS_EXCEPTIONS
+}
+
+void Delete(void* block, size_t alignment) noexcept {
+  DeleteBlock(block, alignment < kHeaderSize ? kHeaderSize : alignment);
+}
+
+}  // namespace
+
+void* operator new(size_t size) { return AllocateOrThrow(size, kHeaderSize); }
+void* operator new[](size_t size) { return AllocateOrThrow(size, kHeaderSize); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return AllocateOrNull(size, kHeaderSize);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return AllocateOrNull(size, kHeaderSize);
+}
+
+void operator delete(void* block) noexcept { Delete(block, kHeaderSize); }
+void operator delete[](void* block) noexcept { Delete(block, kHeaderSize); }
+void operator delete(void* block, const std::nothrow_t&) noexcept {
+  Delete(block, kHeaderSize);
+}
+void operator delete[](void* block, const std::nothrow_t&) noexcept {
+  Delete(block, kHeaderSize);
+}
+void operator delete(void* block, size_t) noexcept {
+  Delete(block, kHeaderSize);
+}
+void operator delete[](void* block, size_t) noexcept {
+  Delete(block, kHeaderSize);
+}
+
+#ifdef __cpp_aligned_new
+void* operator new(size_t size, std::align_val_t alignment) {
+  return AllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+  return AllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void* operator new(size_t size, std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept {
+  return AllocateOrNull(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept {
+  return AllocateOrNull(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* block, std::align_val_t alignment) noexcept {
+  Delete(block, static_cast<size_t>(alignment));
+}
+void operator delete[](void* block, std::align_val_t alignment) noexcept {
+  Delete(block, static_cast<size_t>(alignment));
+}
+void operator delete(void* block, std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept {
+  Delete(block, static_cast<size_t>(alignment));
+}
+void operator delete[](void* block, std::align_val_t alignment,
+                       const std::nothrow_t&) noexcept {
+  Delete(block, static_cast<size_t>(alignment));
+}
+void operator delete(void* block, size_t, std::align_val_t alignment) noexcept {
+  Delete(block, static_cast<size_t>(alignment));
+}
+void operator delete[](void* block, size_t,
+                       std::align_val_t alignment) noexcept {
+  Delete(block, static_cast<size_t>(alignment));
+}
+#endif  // __cpp_aligned_new
@@ -0,0 +1,68 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Converts a binary report written by --gtest_output=bin to the XML or JSON
+// report the test program would have written with --gtest_output=xml or
+// --gtest_output=json:
+//
+//   gtest_report_converter [--iteration=N] INPUT_FILE (xml|json):OUTPUT_FILE
+//
+// The report of a test program run with --gtest_repeat holds every
+// iteration; the last one is converted unless --iteration selects another,
+// counting from 0.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "src/gtest-internal-inl.h"
+
+int main(int argc, char** argv) {
+  int iteration = -1;
+  int arg = 1;
+  if (arg < argc && std::string(argv[arg]).rfind("--iteration=", 0) == 0) {
+    iteration = atoi(argv[arg] + 12);
+    arg++;
+  }
+  if (argc - arg != 2) {
+    fprintf(stderr,
+            "Usage: %s [--iteration=N] INPUT_FILE (xml|json):OUTPUT_FILE\n",
+            argv[0]);
+    return 2;
+  }
+
+  std::string error;
+  if (!testing::internal::ConvertBinaryReport(argv[arg], argv[arg + 1],
+                                              iteration, &error)) {
+    fprintf(stderr, "%s: %s\n", argv[arg], error.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3  # pylint: disable=g-interpreter-mismatch
+#
+# Copyright 2026, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+"""Tests Google Test's --gtest_cache_dir flag.
+
+This script invokes googletest-cache-test_ (a program written with Google Test)
+several times with the same result cache, and checks that the tests that
+passed are not run again.
+"""
+
+import os
+import shutil
+from xml.dom import minidom
+
+from googletest.test import gtest_test_utils
+
+COMMAND = gtest_test_utils.GetTestExecutablePath('googletest-cache-test_')
+
+
+class GTestCacheTest(gtest_test_utils.TestCase):
+  """Tests the --gtest_cache_dir flag."""
+
+  def setUp(self):
+    super().setUp()
+    self.cache_dir = os.path.join(
+        gtest_test_utils.GetTempDir(), 'googletest-cache-test'
+    )
+    shutil.rmtree(self.cache_dir, ignore_errors=True)
+
+  def tearDown(self):
+    shutil.rmtree(self.cache_dir, ignore_errors=True)
+    super().tearDown()
+
+  def Run(self, args=(), fail=False):
+    """Runs the test program with the cache and returns its output."""
+    env = os.environ.copy()
+    if fail:
+      env['GTEST_CACHE_TEST_FAIL'] = '1'
+    else:
+      env.pop('GTEST_CACHE_TEST_FAIL', None)
+    return gtest_test_utils.Subprocess(
+        [COMMAND, '--gtest_cache_dir=' + self.cache_dir] + list(args), env=env
+    ).output
+
+  def testDoesNotRunPassedTestsAgain(self):
+    output = self.Run()
+    self.assertIn('[ RUN      ] PassingTest.Passes', output)
+    self.assertIn('PassingTest::SetUpTestSuite()', output)
+
+    output = self.Run()
+    self.assertNotIn('[ RUN      ] PassingTest.Passes', output)
+    self.assertIn('[  CACHED  ] PassingTest.Passes', output)
+    self.assertIn('[  CACHED  ] PassingTest.AlsoPasses', output)
+    self.assertIn('[  CACHED  ] FlakyTest.FailsWhenAsked', output)
+    self.assertIn('[  CACHED  ] Values/ParamTest.IsPositive/1', output)
+    self.assertIn('[  CACHED  ] 5 tests passed in a previous run.', output)
+    self.assertNotIn('PassingTest::SetUpTestSuite()', output)
+
+  def testRunsFailedAndSkippedTestsAgain(self):
+    output = self.Run(fail=True)
+    self.assertIn('[  FAILED  ] FlakyTest.FailsWhenAsked', output)
+
+    output = self.Run()
+    self.assertIn('[       OK ] FlakyTest.FailsWhenAsked', output)
+    self.assertIn('[  CACHED  ] PassingTest.Passes', output)
+    self.assertIn('[  SKIPPED ] SkippedTest.Skips', output)
+
+    output = self.Run()
+    self.assertIn('[  CACHED  ] FlakyTest.FailsWhenAsked', output)
+    self.assertIn('[  SKIPPED ] SkippedTest.Skips', output)
+
+  def testCachesEachParameterSeparately(self):
+    self.Run(['--gtest_filter=*IsPositive/0'])
+    output = self.Run()
+    self.assertIn('[  CACHED  ] Values/ParamTest.IsPositive/0', output)
+    self.assertIn('[       OK ] Values/ParamTest.IsPositive/1', output)
+
+  def testFlagsAreKeptApart(self):
+    self.Run()
+    output = self.Run(['--gtest_catch_exceptions=0'])
+    self.assertNotIn('[  CACHED  ]', output)
+    self.assertIn('[       OK ] PassingTest.Passes', output)
+
+  def testMarksCachedTestsInXmlReport(self):
+    xml_path = os.path.join(
+        gtest_test_utils.GetTempDir(), 'googletest-cache-test.xml'
+    )
+    self.Run(fail=True)
+    self.Run(['--gtest_output=xml:' + xml_path], fail=True)
+    xml = minidom.parse(xml_path)
+    try:
+      results = {
+          '%s.%s'
+          % (testcase.getAttribute('classname'), testcase.getAttribute('name')):
+              testcase.getAttribute('result')
+          for testcase in xml.getElementsByTagName('testcase')
+      }
+      self.assertEqual('cached', results['PassingTest.Passes'])
+      self.assertEqual('completed', results['FlakyTest.FailsWhenAsked'])
+      self.assertEqual('skipped', results['SkippedTest.Skips'])
+    finally:
+      xml.unlink()
+      os.remove(xml_path)
+
+
+if __name__ == '__main__':
+  gtest_test_utils.Main()
@@ -0,0 +1,65 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Unit test for Google Test's --gtest_cache_dir flag.
+//
+// This program will be invoked from a Python test.
+// Don't run it directly.
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+class PassingTest : public testing::Test {
+ protected:
+  static void SetUpTestSuite() { printf("PassingTest::SetUpTestSuite()\n"); }
+};
+
+TEST_F(PassingTest, Passes) {}
+
+TEST_F(PassingTest, AlsoPasses) { EXPECT_EQ(2, 1 + 1); }
+
+// Fails when the GTEST_CACHE_TEST_FAIL environment variable is set.
+TEST(FlakyTest, FailsWhenAsked) {
+  EXPECT_EQ(nullptr, std::getenv("GTEST_CACHE_TEST_FAIL"))
+      << "Expected failure.";
+}
+
+TEST(SkippedTest, Skips) { GTEST_SKIP() << "Skipped tests are never cached."; }
+
+class ParamTest : public testing::TestWithParam<int> {};
+
+TEST_P(ParamTest, IsPositive) { EXPECT_GT(GetParam(), 0); }
+
+INSTANTIATE_TEST_SUITE_P(Values, ParamTest, testing::Values(1, 2));
+
+}  // namespace
@@ -475,6 +475,65 @@ TEST_F(TestForDeathTest, MixedStyles) {
   EXPECT_DEATH(_Exit(1), "");
 }
 
+// Repeats a representative sample of death tests in the "zygote" style.  The
+// child processes come from a zygote only if the style was selected on the
+// command line; otherwise these tests run in the "threadsafe" style.
+
+TEST_F(TestForDeathTest, StaticMemberFunctionZygoteStyle) {
+  GTEST_FLAG_SET(death_test_style, "zygote");
+  ASSERT_DEATH(StaticMemberFunction(), "death.*StaticMember");
+}
+
+TEST_F(TestForDeathTest, MemberFunctionZygoteStyle) {
+  GTEST_FLAG_SET(death_test_style, "zygote");
+  should_die_ = true;
+  EXPECT_DEATH(MemberFunction(), "inside.*MemberFunction");
+}
+
+TEST_F(TestForDeathTest, ZygoteDeathTestInLoop) {
+  GTEST_FLAG_SET(death_test_style, "zygote");
+
+  for (int i = 0; i < 3; ++i)
+    EXPECT_EXIT(_Exit(i), testing::ExitedWithCode(i), "") << ": i = " << i;
+}
+
+TEST_F(TestForDeathTest, ZygoteDeathTestInChangedDir) {
+  GTEST_FLAG_SET(death_test_style, "zygote");
+
+  ChangeToRootDir();
+  EXPECT_EXIT(_Exit(1), testing::ExitedWithCode(1), "");
+
+  ChangeToRootDir();
+  ASSERT_DEATH(_Exit(1), "");
+}
+
+#ifndef GTEST_OS_WINDOWS
+// Tests that the child process sees the environment of the parent process
+// at the time of the death test.
+TEST_F(TestForDeathTest, ZygoteDeathTestSeesCurrentEnvironment) {
+  GTEST_FLAG_SET(death_test_style, "zygote");
+  setenv("GTEST_ZYGOTE_TEST_VARIABLE", "set in the test", 1);
+  EXPECT_DEATH(
+      {
+        const char* const value = getenv("GTEST_ZYGOTE_TEST_VARIABLE");
+        fprintf(stderr, "value: %s", value == nullptr ? "(null)" : value);
+        fflush(stderr);
+        _Exit(1);
+      },
+      "value: set in the test");
+  unsetenv("GTEST_ZYGOTE_TEST_VARIABLE");
+}
+#endif  // GTEST_OS_WINDOWS
+
+TEST_F(TestForDeathTest, MixedStylesWithZygote) {
+  GTEST_FLAG_SET(death_test_style, "zygote");
+  EXPECT_DEATH(_Exit(1), "");
+  GTEST_FLAG_SET(death_test_style, "fast");
+  EXPECT_DEATH(_Exit(1), "");
+  GTEST_FLAG_SET(death_test_style, "zygote");
+  EXPECT_DEATH(_Exit(1), "");
+}
+
 #if GTEST_HAS_CLONE && GTEST_HAS_PTHREAD
 
 bool pthread_flag;
@@ -568,6 +627,39 @@ TEST_F(TestForDeathTest, ErrorMessageMismatch) {
       "died but not with expected error");
 }
 
+// Writes a line of 1000 characters to stderr the given number of times, with
+// "first" and "last" lines before and after them, then dies.
+void DieAfterWritingLines(int lines) {
+  const std::string line(999, 'x');
+  fputs("first\n", stderr);
+  for (int i = 0; i < lines; ++i) fprintf(stderr, "%s\n", line.c_str());
+  fputs("last\n", stderr);
+  fflush(stderr);
+  _Exit(1);
+}
+
+// Tests that output larger than a pipe can hold is read completely.
+TEST_F(TestForDeathTest, ReadsLargeOutput) {
+  GTEST_FLAG_SET(death_test_output_limit, 0);
+  EXPECT_DEATH(DieAfterWritingLines(1000), "x\nlast\n$");
+}
+
+// Tests that only the beginning and the end of the output are kept beyond
+// the limit.
+TEST_F(TestForDeathTest, KeepsBeginningAndEndOfOutput) {
+  GTEST_FLAG_SET(death_test_output_limit, 20);
+  EXPECT_DEATH(DieAfterWritingLines(1000),
+               "^first\nxxxx\n\\[\\.\\.\\. 999991 bytes omitted \\.\\.\\.\\]\n"
+               "xxxx\nlast\n$");
+}
+
+// Tests that a failure message says that output was omitted.
+TEST_F(TestForDeathTest, ReportsOmittedOutput) {
+  GTEST_FLAG_SET(death_test_output_limit, 20);
+  EXPECT_NONFATAL_FAILURE(EXPECT_DEATH(DieAfterWritingLines(10), "missing"),
+                          "9991 bytes of the output were omitted");
+}
+
 // On exit, *aborted will be true if and only if the EXPECT_DEATH()
 // statement aborted the function.
 void ExpectDeathTestHelper(bool* aborted) {
@@ -1353,6 +1445,18 @@ TEST(InDeathTestChildDeathTest, ReportsDeathTestCorrectlyInThreadSafeStyle) {
       "Inside");
 }
 
+TEST(InDeathTestChildDeathTest, ReportsDeathTestCorrectlyInZygoteStyle) {
+  GTEST_FLAG_SET(death_test_style, "zygote");
+  EXPECT_FALSE(InDeathTestChild());
+  EXPECT_DEATH(
+      {
+        fprintf(stderr, InDeathTestChild() ? "Inside" : "Outside");
+        fflush(stderr);
+        _Exit(1);
+      },
+      "Inside");
+}
+
 void DieWithMessage(const char* message) {
   fputs(message, stderr);
   fflush(stderr);  // Make sure the text is printed before the process exits.
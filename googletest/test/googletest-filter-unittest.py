@@ -40,6 +40,7 @@ Note that test sharding may also influence which tests are filtered. Therefore,
 we test that here also.
 """
 
+import json
 import os
 import re
 
@@ -125,6 +126,12 @@ DISABLED_BANNER_REGEX = re.compile(r'^\[\s*DISABLED\s*\] (.*)')
 # will run.
 LIST_TESTS_FLAG = '--gtest_list_tests'
 
+# The command line flag for selecting how tests are assigned to shards.
+SHARD_BY_FLAG = 'gtest_shard_by'
+
+# The command line flag for balancing the shards by recorded test durations.
+SHARD_TIMING_FLAG = 'gtest_shard_timing'
+
 # Indicates whether Google Test supports death tests.
 SUPPORTS_DEATH_TESTS = (
     'HasDeathTest'
@@ -712,6 +719,68 @@ class GTestFilterUnitTest(gtest_test_utils.TestCase):
       self.assertTrue(os.path.exists(shard_status_file))
       os.remove(shard_status_file)
 
+  def testShardByHashKeepsTestsOnTheirShard(self):
+    """Tests that --gtest_shard_by=hash ignores the other tests."""
+
+    args = ['--%s=hash' % SHARD_BY_FLAG]
+    self.RunAndVerifyWithSharding(None, 3, ACTIVE_TESTS, args=args)
+    self.RunAndVerifyWithSharding('*', 3, ACTIVE_TESTS, args=args)
+
+    def ShardOf(test, gtest_filter, weights=''):
+      shard_args = [
+          '--%s=hash%s' % (SHARD_BY_FLAG, weights),
+          '--%s=%s' % (FILTER_FLAG, gtest_filter),
+      ]
+      for i in range(3):
+        if test in RunWithSharding(3, i, shard_args)[0]:
+          return i
+      return None
+
+    for test in ['BarTest.TestOne', 'BazTest.TestA']:
+      self.assertEqual(ShardOf(test, '*'), ShardOf(test, test))
+      self.assertEqual(ShardOf(test, '*', ':1,1,1'), ShardOf(test, test))
+
+  def testShardByHashRejectsShardTiming(self):
+    """Tests that --gtest_shard_by=hash cannot be used with shard timing."""
+
+    args = [
+        '--%s=hash' % SHARD_BY_FLAG,
+        '--%s=shard_timing.json' % SHARD_TIMING_FLAG,
+    ]
+    tests_run, exit_code = RunWithSharding(2, 0, args)
+    self.assertEqual([], tests_run)
+    self.assertNotEqual(0, exit_code)
+
+  def testShardTimingBalancesShards(self):
+    """Tests that --gtest_shard_timing balances the shards by duration."""
+
+    timing_file = os.path.join(gtest_test_utils.GetTempDir(), 'shard_timing')
+    report = {
+        'testsuites': [{
+            'name': 'BarTest',
+            'testsuite': [
+                {'name': 'TestOne', 'result': 'COMPLETED', 'time': '100s'},
+                {'name': 'TestTwo', 'result': 'COMPLETED', 'time': '1s'},
+                {'name': 'TestThree', 'result': 'COMPLETED', 'time': '1s'},
+            ],
+        }],
+    }
+    with open(timing_file, 'w') as f:
+      json.dump(report, f)
+    try:
+      args = [
+          '--%s=Bar*' % FILTER_FLAG,
+          '--%s=%s' % (SHARD_TIMING_FLAG, timing_file),
+      ]
+      partition = [RunWithSharding(2, i, args)[0] for i in range(2)]
+    finally:
+      os.remove(timing_file)
+
+    self.AssertPartitionIsValid(
+        ['BarTest.TestOne', 'BarTest.TestTwo', 'BarTest.TestThree'], partition
+    )
+    self.assertIn(['BarTest.TestOne'], partition)
+
   def testDisabledBanner(self):
     """Tests that the disabled banner prints only tests that match filter."""
     make_filter = lambda s: ['--%s=%s' % (FILTER_FLAG, s)]
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3  # pylint: disable=g-interpreter-mismatch
+#
+# Copyright 2026, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+"""Tests Google Test's --gtest_jobs flag.
+
+This script invokes googletest-jobs-test_ (a program written with Google Test)
+serially and in several worker processes, and checks that the main process
+merges the results of the workers into a single run.
+"""
+
+import os
+import re
+from xml.dom import minidom
+
+from googletest.test import gtest_test_utils
+
+# The command line flag for running tests in worker processes.
+JOBS_FLAG = '--gtest_jobs=4'
+
+COMMAND = gtest_test_utils.GetTestExecutablePath('googletest-jobs-test_')
+
+RUN_LINE_RE = re.compile(r'^\[ RUN      \] (.*)$', re.MULTILINE)
+
+
+def Run(args):
+  """Runs the test program with the given arguments and returns its output."""
+  return gtest_test_utils.Subprocess([COMMAND] + args).output
+
+
+class GTestJobsTest(gtest_test_utils.TestCase):
+  """Tests the --gtest_jobs flag."""
+
+  def testReportsTestsInSerialOrder(self):
+    serial_order = RUN_LINE_RE.findall(Run([]))
+    jobs_order = RUN_LINE_RE.findall(Run([JOBS_FLAG]))
+    self.assertTrue(serial_order)
+    self.assertEqual(serial_order, jobs_order)
+
+  def testRunsTestsInWorkerProcesses(self):
+    output = Run([JOBS_FLAG])
+    self.assertIn('[       OK ] WorkerProcessTest.RunsInWorker', output)
+    self.assertIn('[       OK ] SharedResourceTest.Second', output)
+    if 'JobsDeathTest' in output:
+      self.assertIn('[       OK ] JobsDeathTest.Dies', output)
+
+  def testKeepsFailuresWithTheirTest(self):
+    output = Run([JOBS_FLAG])
+    self.assertRegex(
+        output,
+        r'\[ RUN      \] FailingTest\.Fails\n'
+        r'[^\[]*Expected failure in FailingTest\.Fails\.\n+'
+        r'\[  FAILED  \] FailingTest\.Fails',
+    )
+    self.assertIn('1 DISABLED TEST', output)
+
+  def testRecoversFromCrashedWorker(self):
+    output = Run([JOBS_FLAG])
+    self.assertRegex(
+        output,
+        r'\[ RUN      \] CrashTest\.Crashes\n'
+        r'[^\[]*The worker process \(pid \d+\) running this test was killed'
+        r' by signal \d+\.\n+'
+        r'\[  FAILED  \] CrashTest\.Crashes',
+    )
+    self.assertIn('[       OK ] CrashTest.RunsAfterCrash', output)
+    self.assertIn('2 FAILED TESTS', output)
+
+  def testRejectsParallelFlag(self):
+    p = gtest_test_utils.Subprocess([COMMAND, JOBS_FLAG, '--gtest_parallel=2'])
+    self.assertNotEqual(0, p.exit_code)
+    self.assertIn(
+        'Invalid flags: --gtest_jobs cannot be combined with --gtest_parallel.',
+        p.output,
+    )
+    self.assertNotIn('[ RUN      ]', p.output)
+
+  def testWritesSingleXmlReport(self):
+    xml_path = os.path.join(
+        gtest_test_utils.GetTempDir(), 'googletest-jobs-test.xml'
+    )
+    Run([JOBS_FLAG, '--gtest_output=xml:' + xml_path])
+    xml = minidom.parse(xml_path)
+    try:
+      testsuites = xml.documentElement
+      self.assertEqual('2', testsuites.getAttribute('failures'))
+      self.assertEqual('1', testsuites.getAttribute('disabled'))
+      testcases = {
+          '%s.%s'
+          % (testcase.getAttribute('classname'), testcase.getAttribute('name')):
+              testcase
+          for testcase in testsuites.getElementsByTagName('testcase')
+      }
+      self.assertIn('SharedResourceTest.First', testcases)
+      self.assertIn('CrashTest.RunsAfterCrash', testcases)
+      fails = testcases['FailingTest.Fails']
+      properties = fails.getElementsByTagName('property')
+      self.assertEqual(1, len(properties))
+      self.assertEqual('answer', properties[0].getAttribute('name'))
+      self.assertEqual('42', properties[0].getAttribute('value'))
+      self.assertEqual(1, len(fails.getElementsByTagName('failure')))
+    finally:
+      xml.unlink()
+      os.remove(xml_path)
+
+
+if __name__ == '__main__':
+  gtest_test_utils.Main()
@@ -0,0 +1,100 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Unit test for Google Test's --gtest_jobs flag.
+//
+// This program will be invoked from a Python test.
+// Don't run it directly.
+
+#include <unistd.h>
+
+#include <cstdlib>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+pid_t g_main_pid;
+
+TEST(WorkerProcessTest, RunsInWorker) {
+  if (GTEST_FLAG_GET(jobs) < 2) {
+    GTEST_SKIP() << "Only meaningful with --gtest_jobs.";
+  }
+  EXPECT_NE(g_main_pid, getpid());
+}
+
+class SharedResourceTest : public testing::Test {
+ protected:
+  static void SetUpTestSuite() { shared_value_ = new int(42); }
+
+  static void TearDownTestSuite() {
+    delete shared_value_;
+    shared_value_ = nullptr;
+  }
+
+  static int* shared_value_;
+};
+
+int* SharedResourceTest::shared_value_ = nullptr;
+
+TEST_F(SharedResourceTest, First) { EXPECT_EQ(42, *shared_value_); }
+
+TEST_F(SharedResourceTest, Second) { EXPECT_EQ(42, *shared_value_); }
+
+TEST(FailingTest, Fails) {
+  RecordProperty("answer", 42);
+  ADD_FAILURE() << "Expected failure in FailingTest.Fails.";
+}
+
+TEST(FailingTest, Passes) {}
+
+TEST(FailingTest, DISABLED_Disabled) {}
+
+// Kills the worker process running it, which must not stop the tests after
+// it from running.
+TEST(CrashTest, Crashes) {
+  if (GTEST_FLAG_GET(jobs) < 2) {
+    GTEST_SKIP() << "Only meaningful with --gtest_jobs.";
+  }
+  std::abort();
+}
+
+TEST(CrashTest, RunsAfterCrash) {}
+
+#ifdef GTEST_HAS_DEATH_TEST
+TEST(JobsDeathTest, Dies) { EXPECT_DEATH(std::abort(), ""); }
+#endif  // GTEST_HAS_DEATH_TEST
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  g_main_pid = getpid();
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3  # pylint: disable=g-interpreter-mismatch
+#
+# Copyright 2026, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+"""Tests Google Test's --gtest_parallel flag.
+
+This script invokes googletest-parallel-test_ (a program written with Google
+Test) serially and on several worker threads, and checks that the parallel
+runs report the same tests in the same order while actually overlapping.
+"""
+
+import re
+
+from googletest.test import gtest_test_utils
+
+# The command line flag for running tests in parallel.
+PARALLEL_FLAG = '--gtest_parallel'
+
+# The command line flag for pinning test suites to the main thread.
+PARALLEL_EXCLUDE_FLAG = '--gtest_parallel_exclude=MainThreadTest'
+
+COMMAND = gtest_test_utils.GetTestExecutablePath('googletest-parallel-test_')
+
+RUN_LINE_RE = re.compile(r'^\[ RUN      \] (.*)$', re.MULTILINE)
+
+
+def Run(args):
+  """Runs the test program with the given arguments and returns its output."""
+  return gtest_test_utils.Subprocess([COMMAND] + args).output
+
+
+def RunParallel(extra_args=None):
+  """Runs the test program on four worker threads and returns its output."""
+  return Run(
+      ['%s=4' % PARALLEL_FLAG, PARALLEL_EXCLUDE_FLAG] + (extra_args or [])
+  )
+
+
+class GTestParallelTest(gtest_test_utils.TestCase):
+  """Tests the --gtest_parallel flag."""
+
+  def testReportsTestsInSerialOrder(self):
+    serial_order = RUN_LINE_RE.findall(Run([PARALLEL_EXCLUDE_FLAG]))
+    parallel_order = RUN_LINE_RE.findall(RunParallel())
+    self.assertTrue(serial_order)
+    self.assertEqual(serial_order, parallel_order)
+
+  def testRunsTestSuitesConcurrently(self):
+    output = RunParallel()
+    self.assertIn('[       OK ] RendezvousATest.Meet', output)
+    self.assertIn('[       OK ] RendezvousBTest.Meet', output)
+
+  def testKeepsFailuresWithTheirTest(self):
+    output = RunParallel()
+    self.assertRegex(
+        output,
+        r'\[ RUN      \] FailingTest\.Fails\n'
+        r'[^\[]*Expected failure in FailingTest\.Fails\.\n+'
+        r'\[  FAILED  \] FailingTest\.Fails',
+    )
+    self.assertIn('1 FAILED TEST', output)
+
+  def testRunsExcludedAndDeathTestSuitesOnMainThread(self):
+    output = RunParallel()
+    self.assertIn('[       OK ] MainThreadTest.RunsOnMainThread', output)
+    if 'ParallelDeathTest' in output:
+      self.assertIn('[       OK ] ParallelDeathTest.RunsOnMainThread', output)
+
+  def testTracksCurrentTestPerThread(self):
+    output = RunParallel()
+    self.assertIn('[       OK ] CurrentTestInfoTest.IsPerThread', output)
+    self.assertIn('[       OK ] SharedResourceTest.Second', output)
+
+
+if __name__ == '__main__':
+  gtest_test_utils.Main()
@@ -0,0 +1,118 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Unit test for Google Test's --gtest_parallel flag.
+//
+// This program will be invoked from a Python test.
+// Don't run it directly.
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <thread>  // NOLINT
+
+#include "gtest/gtest.h"
+
+namespace {
+
+std::thread::id g_main_thread_id;
+
+// The number of test suites that have reached the rendezvous point.
+std::atomic<int> g_rendezvous_count(0);
+
+// Waits until two test suites have reached this function.  This can only
+// succeed if the two test suites run concurrently.
+void Rendezvous() {
+  if (GTEST_FLAG_GET(parallel) < 2) {
+    GTEST_SKIP() << "Only meaningful with --gtest_parallel.";
+  }
+  ++g_rendezvous_count;
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  while (g_rendezvous_count < 2 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(2, g_rendezvous_count)
+      << "The test suites did not run in parallel.";
+}
+
+TEST(RendezvousATest, Meet) { Rendezvous(); }
+
+TEST(RendezvousBTest, Meet) { Rendezvous(); }
+
+class SharedResourceTest : public testing::Test {
+ protected:
+  static void SetUpTestSuite() { shared_value_ = new int(42); }
+
+  static void TearDownTestSuite() {
+    delete shared_value_;
+    shared_value_ = nullptr;
+  }
+
+  static int* shared_value_;
+};
+
+int* SharedResourceTest::shared_value_ = nullptr;
+
+TEST_F(SharedResourceTest, First) { EXPECT_EQ(42, *shared_value_); }
+
+TEST_F(SharedResourceTest, Second) { EXPECT_EQ(42, *shared_value_); }
+
+TEST(FailingTest, Fails) {
+  ADD_FAILURE() << "Expected failure in FailingTest.Fails.";
+}
+
+TEST(FailingTest, Passes) {}
+
+TEST(MainThreadTest, RunsOnMainThread) {
+  EXPECT_EQ(g_main_thread_id, std::this_thread::get_id());
+}
+
+TEST(CurrentTestInfoTest, IsPerThread) {
+  const testing::TestInfo* const test_info =
+      testing::UnitTest::GetInstance()->current_test_info();
+  ASSERT_NE(nullptr, test_info);
+  EXPECT_STREQ("CurrentTestInfoTest", test_info->test_suite_name());
+  EXPECT_STREQ("IsPerThread", test_info->name());
+}
+
+#ifdef GTEST_HAS_DEATH_TEST
+TEST(ParallelDeathTest, RunsOnMainThread) {
+  EXPECT_EQ(g_main_thread_id, std::this_thread::get_id());
+  EXPECT_DEATH(std::abort(), "");
+}
+#endif  // GTEST_HAS_DEATH_TEST
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  g_main_thread_id = std::this_thread::get_id();
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -58,6 +58,17 @@ class GTestParamTestInvalidName1Test(gtest_test_utils.TestCase):
   def testExitCodeAndOutput(self):
     TestExitCodeAndOutput(COMMAND)
 
+  def testExitCodeAndOutputWhenFilteredOut(self):
+    TestExitCodeAndOutput([COMMAND, '--gtest_filter=NoSuchTest.*'])
+
+  def testExitCodeAndOutputWhenExcluded(self):
+    TestExitCodeAndOutput([COMMAND, '--gtest_filter=-*'])
+
+  def testExitCodeAndOutputWhenListingFilteredTests(self):
+    TestExitCodeAndOutput(
+        [COMMAND, '--gtest_list_tests', '--gtest_filter=NoSuchTest.*']
+    )
+
 
 if __name__ == '__main__':
   gtest_test_utils.Main()
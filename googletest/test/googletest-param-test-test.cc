@@ -41,6 +41,7 @@
 #include <iostream>
 #include <iterator>
 #include <list>
+#include <optional>
 #include <set>
 #include <sstream>
 #include <string>
@@ -357,6 +358,77 @@ TEST(ValuesInTest, ValuesInEmptyIteratorRange) {
   VerifyGeneratorIsEmpty(gen);
 }
 
+// Counts copies so that tests can verify ValuesIn() does not duplicate
+// parameters it was asked to move or view.
+class CopyCounter {
+ public:
+  explicit CopyCounter(int value) : value_(value) {}
+  CopyCounter(const CopyCounter& other) : value_(other.value_) { ++copies_; }
+  CopyCounter(CopyCounter&& other) = default;
+  CopyCounter& operator=(const CopyCounter&) = default;
+
+  int value() const { return value_; }
+  static int copies() { return copies_; }
+  static void ResetCopies() { copies_ = 0; }
+
+ private:
+  int value_;
+  static int copies_;
+};
+
+int CopyCounter::copies_ = 0;
+
+// Tests that ValuesIn() moves an rvalue container into the generator and
+// hands out its elements in place.
+TEST(ValuesInTest, ValuesInMovedVectorDoesNotCopy) {
+  std::vector<CopyCounter> values;
+  values.emplace_back(3);
+  values.emplace_back(5);
+  CopyCounter::ResetCopies();
+  const CopyCounter* data = values.data();
+  const ParamGenerator<CopyCounter> gen = ValuesIn(std::move(values));
+
+  ParamGenerator<CopyCounter>::iterator it = gen.begin();
+  EXPECT_EQ(data, &*it);
+  EXPECT_EQ(3, it->value());
+  ++it;
+  EXPECT_EQ(5, it->value());
+  ++it;
+  EXPECT_TRUE(it == gen.end());
+  EXPECT_EQ(0, CopyCounter::copies());
+}
+
+// Tests that ValuesIn() moves an rvalue container that is not random access
+// into a generator producing the expected sequence.
+TEST(ValuesInTest, ValuesInMovedList) {
+  const ParamGenerator<int> gen = ValuesIn(std::list<int>{3, 5, 8});
+
+  const int expected_values[] = {3, 5, 8};
+  VerifyGenerator(gen, expected_values);
+}
+
+// Tests that ValuesIn(std::cref()) views the range without copying it.
+TEST(ValuesInTest, ValuesInReferenceViewsRange) {
+  std::vector<int> values = {3, 5, 8};
+  const ParamGenerator<int> gen = ValuesIn(std::cref(values));
+  values[1] = 6;
+
+  EXPECT_EQ(values.data(), &*gen.begin());
+  const int expected_values[] = {3, 6, 8};
+  VerifyGenerator(gen, expected_values);
+}
+
+// Tests that ValuesIn(std::cref()) works with C-style arrays and with
+// containers that return proxies rather than references.
+TEST(ValuesInTest, ValuesInReferenceToArrayAndProxyContainer) {
+  static const int kArray[] = {3, 5, 8};
+  VerifyGenerator(ValuesIn(std::cref(kArray)), kArray);
+
+  const std::vector<bool> bools = {true, false};
+  const bool expected_bools[] = {true, false};
+  VerifyGenerator(ValuesIn(std::cref(bools)), expected_bools);
+}
+
 // Tests that the Values() generates the expected sequence.
 TEST(ValuesTest, ValuesWorks) {
   const ParamGenerator<int> gen = Values(3, 5, 8);
@@ -638,6 +710,64 @@ TEST(ConvertTest, WithConverterFunctionPointer) {
   VerifyGenerator(gen, expected_values);
 }
 
+// Tests that Combine() of random access generators supports random access
+// and that nested products and conversions preserve it.
+TEST(CombineTest, RandomAccess) {
+  const ParamGenerator<std::tuple<int, bool>> inner =
+      Combine(Range(0, 3), Bool());
+  const ParamGenerator<std::tuple<std::tuple<int, bool>, char>> gen =
+      Combine(inner, Values('a', 'b'));
+  ASSERT_TRUE(gen.impl()->IsRandomAccess());
+  ASSERT_EQ(12u, gen.impl()->Size());
+
+  std::optional<std::tuple<std::tuple<int, bool>, char>> storage;
+  EXPECT_TRUE(std::make_tuple(std::make_tuple(1, true), 'b') ==
+              *gen.impl()->At(7, &storage));
+
+  const ParamGenerator<ConstructFromT<std::tuple<int, bool>>> converted =
+      ConvertGenerator<std::tuple<int, bool>>(inner);
+  ASSERT_TRUE(converted.impl()->IsRandomAccess());
+  ConstructFromT<std::tuple<int, bool>> expected_values[] = {
+      {0, false}, {0, true}, {1, false}, {1, true}, {2, false}, {2, true}};
+  VerifyGenerator(converted, expected_values);
+}
+
+// Tests that Combine() falls back to walking generators that do not support
+// random access.
+TEST(CombineTest, NonRandomAccessComponent) {
+  const ParamGenerator<std::tuple<double, int>> gen =
+      Combine(Range(0.0, 1.0, 0.5), Values(3, 4));
+  EXPECT_FALSE(gen.impl()->IsRandomAccess());
+
+  std::tuple<double, int> expected_values[] = {
+      std::make_tuple(0.0, 3), std::make_tuple(0.0, 4),
+      std::make_tuple(0.5, 3), std::make_tuple(0.5, 4)};
+  VerifyGenerator(gen, expected_values);
+}
+
+// Tests that Combine() falls back to walking the generators when the size of
+// the product does not fit in size_t.
+TEST(CombineTest, ProductTooLargeToIndex) {
+  const ParamGenerator<int> gen16 = Range(0, 1 << 16);
+  const ParamGenerator<std::tuple<int, int, int, int, int>> gen =
+      Combine(gen16, gen16, gen16, gen16, gen16);
+  EXPECT_FALSE(gen.impl()->IsRandomAccess());
+
+  ParamGenerator<std::tuple<int, int, int, int, int>>::iterator it =
+      gen.begin();
+  EXPECT_TRUE(std::make_tuple(0, 0, 0, 0, 0) == *it);
+  ++it;
+  EXPECT_TRUE(std::make_tuple(0, 0, 0, 0, 1) == *it);
+}
+
+// Tests that Combine() with an empty random access component is empty.
+TEST(CombineTest, EmptyRandomAccessComponent) {
+  const ParamGenerator<std::tuple<int, int>> gen =
+      Combine(Range(0, 0), Values(3, 4));
+  EXPECT_EQ(0u, gen.impl()->Size());
+  VerifyGeneratorIsEmpty(gen);
+}
+
 TEST(ConvertTest, WithConverterFunctionReference) {
   int64_t (*func_ptr)(const std::string&) = [](const std::string& s) {
     size_t pos;
@@ -1191,6 +1321,52 @@ TEST_P(MyEnumTest, ChecksParamMoreThanZero) { EXPECT_GE(10, GetParam()); }
 INSTANTIATE_TEST_SUITE_P(MyEnumTests, MyEnumTest,
                          ::testing::Values(ENUM1, ENUM2, 0));
 
+// Tests that the TestInfo objects of the instances of a TEST_P are only
+// created by RUN_ALL_TESTS(), once it has selected the tests to run.
+class DeferredCreationTest : public TestWithParam<int> {};
+
+TEST_P(DeferredCreationTest, IsCreatedWhenSelected) {}
+INSTANTIATE_TEST_SUITE_P(Deferred, DeferredCreationTest, Range(0, 3));
+
+// The number of tests of Deferred/DeferredCreationTest with a TestInfo
+// object when RUN_ALL_TESTS() is called, or -1 if there is no such suite.
+int g_deferred_tests_created_before_run = -1;
+
+const ::testing::TestSuite* FindTestSuite(const char* name) {
+  const auto& unit_test = *::testing::UnitTest::GetInstance();
+  for (int i = 0; i < unit_test.total_test_suite_count(); ++i) {
+    if (std::string(unit_test.GetTestSuite(i)->name()) == name) {
+      return unit_test.GetTestSuite(i);
+    }
+  }
+  return nullptr;
+}
+
+TEST(DeferredCreationTest, CreatesTestInfosOfSelectedTests) {
+  EXPECT_EQ(0, g_deferred_tests_created_before_run);
+
+  const ::testing::TestSuite* test_suite =
+      FindTestSuite("Deferred/DeferredCreationTest");
+  ASSERT_TRUE(test_suite != nullptr);
+  for (int i = 0; i < test_suite->total_test_count(); ++i) {
+    EXPECT_TRUE(test_suite->GetTestInfo(i)->is_reportable());
+  }
+}
+
+// Tests that UnitTest counts the same tests as its test suites.
+TEST(DeferredCreationTest, CountsTestsConsistently) {
+  const auto& unit_test = *::testing::UnitTest::GetInstance();
+  int total_test_count = 0;
+  for (int i = 0; i < unit_test.total_test_suite_count(); ++i) {
+    const ::testing::TestSuite* test_suite = unit_test.GetTestSuite(i);
+    for (int j = 0; j < test_suite->total_test_count(); ++j) {
+      EXPECT_TRUE(test_suite->GetTestInfo(j) != nullptr);
+    }
+    total_test_count += test_suite->total_test_count();
+  }
+  EXPECT_EQ(total_test_count, unit_test.total_test_count());
+}
+
 namespace works_here {
 // Never used not instantiated, this should work.
 class NotUsedTest : public testing::TestWithParam<int> {};
@@ -1232,6 +1408,12 @@ int main(int argc, char** argv) {
 
   ::testing::InitGoogleTest(&argc, argv);
 
+  // Used in DeferredCreationTest test suite.
+  if (const ::testing::TestSuite* test_suite =
+          FindTestSuite("Deferred/DeferredCreationTest")) {
+    g_deferred_tests_created_before_run = test_suite->total_test_count();
+  }
+
   // Used in GeneratorEvaluationTest test suite. Tests that value updated
   // here will NOT be used for instantiating tests in
   // GeneratorEvaluationTest.
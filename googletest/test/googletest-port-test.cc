@@ -940,6 +940,37 @@ TEST(CaptureTest, CapturesStderr) {
   EXPECT_EQ(::std::string("jkl\0mno", 7), ::std::string(GetCapturedStderr()));
 }
 
+TEST(CaptureTest, ReturnsAtMostMaxSizeBytes) {
+  CaptureStdout(4);
+  fprintf(stdout, "abcdefgh");
+  EXPECT_EQ("abcd", GetCapturedStdout());
+
+  CaptureStderr(0);
+  fprintf(stderr, "abc");
+  EXPECT_EQ("", GetCapturedStderr());
+}
+
+TEST(CaptureTest, KeepsTheHeadOfOutputLargerThanMaxSize) {
+  std::string output;
+  for (int i = 0; output.size() < 3 * 4096 + 100; ++i) {
+    output += StreamableToString(i) + " ";
+  }
+  CaptureStdout(5000);
+  fwrite(output.data(), 1, output.size(), stdout);
+  fwrite(output.data(), 1, output.size(), stdout);
+  EXPECT_EQ(output.substr(0, 5000), GetCapturedStdout());
+  EXPECT_FALSE(ferror(stdout));
+}
+
+TEST(CaptureTest, CapturesLargeOutput) {
+  const std::string line(1023, 'x');
+  CaptureStdout();
+  for (int i = 0; i < 1024; ++i) fprintf(stdout, "%s\n", line.c_str());
+  const std::string output = GetCapturedStdout();
+  EXPECT_EQ(1024u * 1024u, output.size());
+  EXPECT_EQ(line + "\n", output.substr(output.size() - 1024));
+}
+
 // Tests that stdout and stderr capture don't interfere with each other.
 TEST(CaptureTest, CapturesStdoutAndStderr) {
   CaptureStdout();
@@ -0,0 +1,164 @@
+#!/usr/bin/env python3  # pylint: disable=g-interpreter-mismatch
+#
+# Copyright 2026, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""Tests Google Test's --gtest_serve flag.
+
+This script starts googletest-serve-test_ (a program written with Google Test)
+as a server, sends it requests to run tests, and checks the responses.
+"""
+
+import os
+import socket
+import subprocess
+import urllib.parse
+
+from googletest.test import gtest_test_utils
+
+COMMAND = gtest_test_utils.GetTestExecutablePath('googletest-serve-test_')
+
+# How long to wait for the server, in seconds.
+TIMEOUT = 60
+
+
+def ParseResponses(output):
+  """Returns the lines of the given responses as dicts of their fields."""
+  responses = []
+  for line in output.splitlines():
+    fields = {}
+    for field in line.split('&'):
+      name, _, value = field.partition('=')
+      fields[name] = urllib.parse.unquote(value)
+    responses.append(fields)
+  return responses
+
+
+def Values(responses, event, name):
+  """Returns the values of the given field of the given events."""
+  return [r[name] for r in responses if r.get('event') == event]
+
+
+class GTestServeTest(gtest_test_utils.TestCase):
+  """Tests the --gtest_serve flag."""
+
+  def testServesStandardInput(self):
+    requests = [
+        'filter=ServeTest.*',
+        'filter=FailingTest.*',
+        'filter=ServeTest.CountsRuns&output=xml',
+        'repeat=0',
+        'unknown=1',
+        'quit',
+        'filter=*',
+    ]
+    p = subprocess.run(
+        [COMMAND, '--gtest_serve=stdin'],
+        input='\n'.join(requests) + '\n',
+        capture_output=True,
+        text=True,
+        timeout=TIMEOUT,
+        check=False,
+    )
+    self.assertEqual(0, p.returncode, p.stderr)
+
+    responses = ParseResponses(p.stdout)
+    # The requests after "quit" are not served.
+    self.assertEqual(['1', '0', '1'], Values(responses, 'RequestEnd', 'passed'))
+    self.assertEqual(
+        ['CountsRuns', 'Prints', 'Fails'],
+        Values(responses, 'TestStart', 'name'),
+    )
+    errors = Values(responses, 'RequestError', 'message')
+    self.assertEqual(2, len(errors))
+    self.assertIn('repeat', errors[0])
+    self.assertIn('unknown', errors[1])
+
+    # The tests run in the same process.
+    reports = Values(responses, 'Report', 'content')
+    self.assertEqual(1, len(reports))
+    self.assertIn('<testcase name="CountsRuns"', reports[0])
+    self.assertIn('<property name="runs" value="2"/>', reports[0])
+
+    # What the tests print does not mix with the responses.
+    self.assertNotIn('Output of a served test.', p.stdout)
+    self.assertIn('Output of a served test.', p.stderr)
+    self.assertIn('[  FAILED  ] FailingTest.Fails', p.stderr)
+
+  def testServesUnixSocket(self):
+    path = os.path.join(gtest_test_utils.GetTempDir(), 'googletest-serve.sock')
+    server = subprocess.Popen(
+        [COMMAND, '--gtest_serve=unix:' + path],
+        stdout=subprocess.PIPE,
+        stderr=subprocess.STDOUT,
+        text=True,
+    )
+    try:
+      while 'Serving test requests' not in server.stdout.readline():
+        self.assertIsNone(server.poll())
+
+      def Request(line):
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as client:
+          client.settimeout(TIMEOUT)
+          client.connect(path)
+          client.sendall((line + '\n').encode())
+          client.shutdown(socket.SHUT_WR)
+          output = b''
+          while True:
+            chunk = client.recv(4096)
+            if not chunk:
+              return ParseResponses(output.decode())
+            output += chunk
+
+      for runs in ['1', '2']:
+        responses = Request(
+            'filter=ServeTest.CountsRuns%3AFailingTest.*&output=json'
+        )
+        self.assertEqual(['0'], Values(responses, 'RequestEnd', 'passed'))
+        reports = Values(responses, 'Report', 'content')
+        self.assertEqual(1, len(reports))
+        self.assertIn('"runs": "%s"' % runs, reports[0])
+        self.assertIn('"name": "Fails"', reports[0])
+        self.assertNotIn('"name": "Prints"', reports[0])
+
+      self.assertEqual([], Request('quit'))
+      self.assertEqual(0, server.wait(timeout=TIMEOUT))
+      self.assertFalse(os.path.exists(path))
+    finally:
+      if server.poll() is None:
+        server.kill()
+        server.wait()
+      server.stdout.close()
+
+
+if __name__ == '__main__':
+  if os.name != 'posix':
+    print('Serving test requests is not supported on this platform.')
+  else:
+    gtest_test_utils.Main()
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3  # pylint: disable=g-interpreter-mismatch
+#
+# Copyright 2026, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+"""Tests Google Test's --gtest_test_timeout flag.
+
+This script invokes googletest-timeout-test_ (a program written with Google
+Test) with tests that hang, and checks that they are reported as timed out.
+"""
+
+import os
+import sys
+from xml.dom import minidom
+
+from googletest.test import gtest_test_utils
+
+COMMAND = gtest_test_utils.GetTestExecutablePath('googletest-timeout-test_')
+
+# The exit code of a test program ended by a test timeout.
+TIMEOUT_EXIT_CODE = 124
+
+
+def Run(args):
+  """Runs the test program with the given arguments."""
+  return gtest_test_utils.Subprocess([COMMAND] + args)
+
+
+class GTestTimeoutTest(gtest_test_utils.TestCase):
+  """Tests the --gtest_test_timeout flag."""
+
+  def testReportsHangingTest(self):
+    xml_path = os.path.join(
+        gtest_test_utils.GetTempDir(), 'googletest-timeout-test.xml'
+    )
+    p = Run([
+        '--gtest_test_timeout=1',
+        '--gtest_filter=FastTest.*:HangingTest.*',
+        '--gtest_output=xml:' + xml_path,
+    ])
+    self.assertTrue(p.exited)
+    self.assertEqual(TIMEOUT_EXIT_CODE, p.exit_code)
+    self.assertIn('[       OK ] FastTest.Passes', p.output)
+    self.assertIn('The test did not finish within 1 second.', p.output)
+    self.assertIn('[  FAILED  ] HangingTest.Hangs', p.output)
+    self.assertNotIn('HangingTest.RunsAfterHang', p.output)
+    if sys.platform.startswith('linux'):
+      self.assertIn('Stack traces of all threads:', p.output)
+      # The main thread and the blocked thread of the test.
+      self.assertGreaterEqual(p.output.count('\nThread '), 2)
+
+    xml = minidom.parse(xml_path)
+    try:
+      testcases = {
+          testcase.getAttribute('name'): testcase
+          for testcase in xml.getElementsByTagName('testcase')
+      }
+      self.assertEqual(
+          0, len(testcases['Passes'].getElementsByTagName('failure'))
+      )
+      self.assertEqual(
+          1, len(testcases['Hangs'].getElementsByTagName('failure'))
+      )
+      self.assertEqual(
+          'notrun', testcases['RunsAfterHang'].getAttribute('status')
+      )
+    finally:
+      xml.unlink()
+      os.remove(xml_path)
+
+  def testReportsHangingTestOnParallelWorker(self):
+    xml_path = os.path.join(
+        gtest_test_utils.GetTempDir(), 'googletest-timeout-parallel-test.xml'
+    )
+    p = Run([
+        '--gtest_test_timeout=1',
+        '--gtest_parallel=2',
+        '--gtest_filter=FastTest.*:HangingTest.*',
+        '--gtest_output=xml:' + xml_path,
+    ])
+    self.assertTrue(p.exited)
+    self.assertEqual(TIMEOUT_EXIT_CODE, p.exit_code)
+    # The events recorded on the worker come before the timeout.
+    start = p.output.index('[ RUN      ] HangingTest.Hangs')
+    timeout = p.output.index('The test did not finish within 1 second.')
+    end = p.output.index('[  FAILED  ] HangingTest.Hangs')
+    self.assertLess(start, timeout)
+    self.assertLess(timeout, end)
+    self.assertIn('[       OK ] FastTest.Passes', p.output)
+
+    xml = minidom.parse(xml_path)
+    try:
+      testcases = {
+          testcase.getAttribute('name'): testcase
+          for testcase in xml.getElementsByTagName('testcase')
+      }
+      self.assertEqual(
+          1, len(testcases['Hangs'].getElementsByTagName('failure'))
+      )
+    finally:
+      xml.unlink()
+      os.remove(xml_path)
+
+  def testSetTestTimeoutOverridesFlag(self):
+    p = Run(['--gtest_filter=OverrideTest.SetsShortTimeout'])
+    self.assertEqual(TIMEOUT_EXIT_CODE, p.exit_code)
+    self.assertIn('[  FAILED  ] OverrideTest.SetsShortTimeout', p.output)
+
+    p = Run([
+        '--gtest_test_timeout=1',
+        '--gtest_filter=OverrideTest.DisablesTimeout',
+    ])
+    self.assertEqual(0, p.exit_code)
+    self.assertIn('[       OK ] OverrideTest.DisablesTimeout', p.output)
+
+  def testContinuesInNewWorkerProcess(self):
+    if os.name != 'posix':
+      return
+    p = Run([
+        '--gtest_test_timeout=1',
+        '--gtest_jobs=2',
+        '--gtest_filter=FastTest.*:HangingTest.*',
+    ])
+    self.assertEqual(1, p.exit_code)
+    self.assertIn('The test did not finish within 1 second.', p.output)
+    self.assertIn('[  FAILED  ] HangingTest.Hangs', p.output)
+    self.assertIn('[       OK ] HangingTest.RunsAfterHang', p.output)
+    self.assertIn('[  PASSED  ] 2 tests.', p.output)
+    self.assertNotIn('The worker process', p.output)
+
+
+if __name__ == '__main__':
+  gtest_test_utils.Main()
@@ -0,0 +1,74 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Unit test for Google Test's --gtest_test_timeout flag.
+//
+// This program will be invoked from a Python test.
+// Don't run it directly.
+
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <thread>              // NOLINT
+
+#include "gtest/gtest.h"
+
+namespace {
+
+void SleepForSeconds(int seconds) {
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+}
+
+TEST(FastTest, Passes) {}
+
+// Hangs, with a second thread blocked too.
+TEST(HangingTest, Hangs) {
+  std::mutex mutex;
+  std::condition_variable never_notified;
+  std::thread blocked([&] {
+    std::unique_lock<std::mutex> lock(mutex);
+    never_notified.wait(lock, [] { return false; });
+  });
+  blocked.detach();
+  SleepForSeconds(60);
+}
+
+TEST(HangingTest, RunsAfterHang) {}
+
+TEST(OverrideTest, SetsShortTimeout) {
+  testing::Test::SetTestTimeout(1);
+  SleepForSeconds(60);
+}
+
+TEST(OverrideTest, DisablesTimeout) {
+  testing::Test::SetTestTimeout(0);
+  SleepForSeconds(2);
+}
+
+}  // namespace
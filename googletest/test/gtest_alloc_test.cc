@@ -0,0 +1,181 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Tests the allocation assertions of a test program linked with
+// gtest_alloc.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest-spi.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+using ::testing::AllocationStats;
+using ::testing::DoNotOptimize;
+using ::testing::internal::AllocationScope;
+
+// Allocates and deletes an int, in a way the compiler cannot leave out.
+void NewInt() {
+  int* const p = new int(42);
+  DoNotOptimize(p);
+  delete p;
+}
+
+TEST(AllocationScopeTest, CountsAllocations) {
+  const AllocationScope scope;
+  ASSERT_TRUE(scope.counting());
+  std::vector<int> v(100);
+  DoNotOptimize(v.data());
+  NewInt();
+  const AllocationStats stats = scope.Stats();
+  EXPECT_EQ(2, stats.count);
+  EXPECT_GE(stats.bytes, static_cast<int64_t>(100 * sizeof(int)));
+}
+
+TEST(AllocationScopeTest, TracksThePeakOfTheScope) {
+  std::unique_ptr<char[]> outside(new char[1000]);
+  DoNotOptimize(outside.get());
+  const AllocationScope scope;
+  {
+    std::unique_ptr<char[]> a(new char[100]);
+    std::unique_ptr<char[]> b(new char[200]);
+    DoNotOptimize(a.get());
+    DoNotOptimize(b.get());
+  }
+  std::unique_ptr<char[]> c(new char[50]);
+  DoNotOptimize(c.get());
+  const AllocationStats stats = scope.Stats();
+  EXPECT_EQ(3, stats.count);
+  EXPECT_EQ(350, stats.bytes);
+  EXPECT_EQ(300, stats.peak_bytes);
+}
+
+TEST(AllocationScopeTest, NestedScopesKeepTheirOwnCounts) {
+  const AllocationScope outer;
+  NewInt();
+  {
+    const AllocationScope inner;
+    NewInt();
+    NewInt();
+    EXPECT_EQ(2, inner.Stats().count);
+  }
+  std::unique_ptr<char[]> big(new char[4096]);
+  DoNotOptimize(big.get());
+  big.reset();
+  // The inner scope, including its assertion, is part of the outer one.
+  EXPECT_LE(4, outer.Stats().count);
+  EXPECT_LE(4096, outer.Stats().peak_bytes);
+}
+
+TEST(AllocationAssertionTest, NoAllocationsPasses) {
+  int sum = 0;
+  EXPECT_NO_ALLOCATIONS(for (int i = 0; i < 10; ++i) sum += i);
+  ASSERT_NO_ALLOCATIONS(DoNotOptimize(sum));
+  EXPECT_EQ(45, sum);
+}
+
+TEST(AllocationAssertionTest, AllocationsLePasses) {
+  EXPECT_ALLOCATIONS_LE(1, NewInt());
+  ASSERT_ALLOCATIONS_LE(3, {
+    NewInt();
+    NewInt();
+  });
+}
+
+TEST(AllocationAssertionTest, NoAllocationsFails) {
+  EXPECT_NONFATAL_FAILURE(EXPECT_NO_ALLOCATIONS(NewInt()),
+                          "Expected: NewInt() allocates at most 0 times.\n"
+                          "  Actual: it allocates 1 times");
+  EXPECT_FATAL_FAILURE(ASSERT_NO_ALLOCATIONS(NewInt()),
+                       "allocates at most 0 times");
+}
+
+TEST(AllocationAssertionTest, AllocationsLeFails) {
+  EXPECT_NONFATAL_FAILURE(EXPECT_ALLOCATIONS_LE(1, {
+                            NewInt();
+                            NewInt();
+                          }),
+                          "it allocates 2 times");
+  EXPECT_FATAL_FAILURE(ASSERT_ALLOCATIONS_LE(2, {
+                         NewInt();
+                         NewInt();
+                         NewInt();
+                       }),
+                       "it allocates 3 times");
+}
+
+TEST(AllocationAssertionTest, CountsAlignedAllocations) {
+  struct alignas(64) Aligned {
+    char bytes[64];
+  };
+  EXPECT_NONFATAL_FAILURE(EXPECT_NO_ALLOCATIONS({
+                            Aligned* const p = new Aligned();
+                            DoNotOptimize(p);
+                            delete p;
+                          }),
+                          "it allocates 1 times, 64 bytes");
+}
+
+// Allocates a known amount, which the next test checks in the result.
+TEST(AllocationStatsTest, AllocatesABlock) {
+  std::unique_ptr<char[]> block(new char[12345]);
+  DoNotOptimize(block.get());
+}
+
+TEST(AllocationStatsTest, IsReportedForEachTest) {
+  const testing::TestResult& result = *testing::UnitTest::GetInstance()
+                                           ->current_test_suite()
+                                           ->GetTestInfo(0)
+                                           ->result();
+  ASSERT_TRUE(result.HasAllocationStats());
+  EXPECT_LE(1, result.allocation_stats().count);
+  EXPECT_LE(12345, result.allocation_stats().bytes);
+  EXPECT_LE(12345, result.allocation_stats().peak_bytes);
+}
+
+// Makes Google Test create the fixture and record a property, which the test
+// is not charged for.
+TEST(GoogleTestAllocationsTest, RecordsAProperty) {
+  RecordProperty("key", "value");
+  EXPECT_EQ(1, 1);
+}
+
+TEST(GoogleTestAllocationsTest, AreLeftOut) {
+  const testing::TestResult& result = *testing::UnitTest::GetInstance()
+                                           ->current_test_suite()
+                                           ->GetTestInfo(0)
+                                           ->result();
+  ASSERT_TRUE(result.HasAllocationStats());
+  EXPECT_EQ(0, result.allocation_stats().count);
+}
+
+}  // namespace
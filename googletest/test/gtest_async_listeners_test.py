@@ -0,0 +1,97 @@
+#!/usr/bin/env python3  # pylint: disable=g-interpreter-mismatch
+#
+# Copyright 2026, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+"""Tests the asynchronous delivery of the events to the listeners.
+
+This script invokes gtest_async_listeners_test_ (a program written with Google
+Test), which has a slow listener declaring itself async-safe, and checks that
+with --gtest_async_listeners the listener receives all the events in order on
+a thread of its own, including when the program is asked to end by a signal.
+"""
+
+from googletest.test import gtest_test_utils
+
+COMMAND = gtest_test_utils.GetTestExecutablePath('gtest_async_listeners_test_')
+
+
+def ListenerOutput(output):
+  """Returns the lines printed by the listener and RUN_ALL_TESTS()."""
+  return [
+      line
+      for line in output.splitlines()
+      if line.startswith('On') or line.startswith('RUN_ALL_TESTS')
+  ]
+
+
+def ExpectedOutput(thread):
+  return [
+      'OnTestStart Passes (%s thread)' % thread,
+      'OnTestEnd Passes passed (%s thread)' % thread,
+      'OnTestStart Fails (%s thread)' % thread,
+      'OnTestPartResult failure (%s thread)' % thread,
+      'OnTestEnd Fails failed (%s thread)' % thread,
+      'OnTestProgramEnd  (%s thread)' % thread,
+      'RUN_ALL_TESTS() returned',
+  ]
+
+
+class GTestAsyncListenersTest(gtest_test_utils.TestCase):
+  """Tests --gtest_async_listeners."""
+
+  def testEventsAreDeliveredOnTheMainThreadByDefault(self):
+    p = gtest_test_utils.Subprocess([COMMAND, '--gtest_filter=ListenerTest.*'])
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    self.assertEqual(ExpectedOutput('main'), ListenerOutput(p.output))
+
+  def testEventsAreDeliveredInOrderOnAnotherThread(self):
+    p = gtest_test_utils.Subprocess([
+        COMMAND,
+        '--gtest_filter=ListenerTest.*',
+        '--gtest_async_listeners',
+    ])
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    self.assertEqual(ExpectedOutput('other'), ListenerOutput(p.output))
+
+  def testEventsAreDeliveredWhenKilled(self):
+    p = gtest_test_utils.Subprocess([
+        COMMAND,
+        '--gtest_filter=ListenerTest.*:KilledTest.*',
+        '--gtest_async_listeners',
+    ])
+    self.assertTrue(p.terminated_by_signal, p.output)
+    self.assertEqual(
+        ExpectedOutput('other')[:5]
+        + ['OnTestStart Terminates (other thread)'],
+        ListenerOutput(p.output),
+    )
+
+
+if __name__ == '__main__':
+  gtest_test_utils.Main()
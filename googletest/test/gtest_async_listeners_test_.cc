@@ -0,0 +1,99 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Unit test for the asynchronous delivery of the events to the listeners
+// that declare themselves async-safe (--gtest_async_listeners).
+//
+// This program will be invoked from a Python test.
+// Don't run it directly.
+
+#include <chrono>  // NOLINT
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <thread>  // NOLINT
+
+#include "gtest/gtest.h"
+
+namespace {
+
+std::thread::id main_thread_id;
+
+// Prints the events it receives, and on which thread, slowly.
+class SlowAsyncSafeListener : public testing::EmptyTestEventListener {
+ public:
+  bool IsAsyncSafe() const override { return true; }
+
+  void OnTestStart(const testing::TestInfo& test_info) override {
+    Print("OnTestStart", test_info.name());
+  }
+
+  void OnTestPartResult(
+      const testing::TestPartResult& test_part_result) override {
+    Print("OnTestPartResult",
+          test_part_result.failed() ? "failure" : "success");
+  }
+
+  void OnTestEnd(const testing::TestInfo& test_info) override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    Print("OnTestEnd", std::string(test_info.name()) +
+                           (test_info.result()->Passed() ? " passed"
+                                                         : " failed"));
+  }
+
+  void OnTestProgramEnd(const testing::UnitTest& /* unit_test */) override {
+    Print("OnTestProgramEnd", "");
+  }
+
+ private:
+  static void Print(const char* event, const std::string& detail) {
+    printf("%s %s (%s thread)\n", event, detail.c_str(),
+           std::this_thread::get_id() == main_thread_id ? "main" : "other");
+    fflush(stdout);
+  }
+};
+
+TEST(ListenerTest, Passes) {}
+
+TEST(ListenerTest, Fails) { ADD_FAILURE() << "Expected failure"; }
+
+// Asks the test program to end with a signal while events are still queued.
+TEST(KilledTest, Terminates) { std::raise(SIGTERM); }
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  main_thread_id = std::this_thread::get_id();
+  testing::InitGoogleTest(&argc, argv);
+  testing::UnitTest::GetInstance()->listeners().Append(
+      new SlowAsyncSafeListener);
+  static_cast<void>(RUN_ALL_TESTS());
+  printf("RUN_ALL_TESTS() returned\n");
+  return 0;
+}
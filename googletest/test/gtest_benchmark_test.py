@@ -0,0 +1,154 @@
+#!/usr/bin/env python3  # pylint: disable=g-interpreter-mismatch
+#
+# Copyright 2026, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""Tests the benchmark tests of Google Test.
+
+This script invokes gtest_benchmark_test_ (a program written with Google Test)
+and checks that its benchmark tests print their timing and report it in the
+XML, JSON and binary reports.
+"""
+
+import json
+import os
+import re
+from xml.dom import minidom
+
+from googletest.test import gtest_test_utils
+
+COMMAND = gtest_test_utils.GetTestExecutablePath('gtest_benchmark_test_')
+
+# The benchmark tests that pass.
+PASSING_FILTER = '--gtest_filter=BenchmarkTest.*:FixtureBenchmarkTest.*'
+
+BENCHMARK_RE = re.compile(
+    r'\[ BENCHMARK\] mean [\d.e+]+ [nmu]?s, median [\d.e+]+ [nmu]?s, '
+    r'stddev [\d.e+]+ [nmu]?s \([\d.e+]+ iterations/s, '
+    r'\d+ samples of \d+\)\n'
+    r'\[       OK \] (\S+)'
+)
+
+BENCHMARK_KEYS = [
+    'iterations',
+    'samples',
+    'mean_ns',
+    'median_ns',
+    'stddev_ns',
+    'iterations_per_second',
+]
+
+
+def Run(*args):
+  """Runs the test program with the given flags."""
+  return gtest_test_utils.Subprocess(
+      [COMMAND, '--gtest_benchmark_time_ms=20'] + list(args)
+  )
+
+
+class GTestBenchmarkTest(gtest_test_utils.TestCase):
+  """Tests TEST_BENCHMARK and TEST_F_BENCHMARK."""
+
+  def setUp(self):
+    self.report_path = os.path.join(
+        gtest_test_utils.GetTempDir(), 'gtest_benchmark_test.out'
+    )
+
+  def tearDown(self):
+    if os.path.exists(self.report_path):
+      os.remove(self.report_path)
+
+  def _ReadReport(self):
+    with open(self.report_path) as f:
+      return f.read()
+
+  def _AssertBenchmarkResult(self, result):
+    self.assertGreaterEqual(int(result['samples']), 3)
+    self.assertGreater(int(result['iterations']), 0)
+    for key in ['mean_ns', 'median_ns', 'iterations_per_second']:
+      self.assertGreater(float(result[key]), 0, key)
+    self.assertGreaterEqual(float(result['stddev_ns']), 0)
+
+  def testPrintsTheTiming(self):
+    p = Run(PASSING_FILTER)
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    self.assertEqual(
+        ['BenchmarkTest.Sum', 'FixtureBenchmarkTest.Find'],
+        BENCHMARK_RE.findall(p.output),
+    )
+
+  def testStopsAtTheFirstFailure(self):
+    p = Run('--gtest_filter=FailingBenchmarkTest.*')
+    self.assertTrue(p.exited and p.exit_code == 1, p.output)
+    self.assertEqual(1, p.output.count('Running the body.'))
+    self.assertNotIn('[ BENCHMARK]', p.output)
+
+  def testRunsOnceWithoutTime(self):
+    p = Run(PASSING_FILTER, '--gtest_benchmark_time_ms=0')
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    self.assertNotIn('[ BENCHMARK]', p.output)
+
+  def testXmlReport(self):
+    p = Run('--gtest_output=xml:' + self.report_path)
+    self.assertTrue(p.exited, p.output)
+    document = minidom.parseString(self._ReadReport())
+    results = {}
+    for test_case in document.getElementsByTagName('testcase'):
+      for benchmark in test_case.getElementsByTagName('benchmark'):
+        results[test_case.getAttribute('name')] = {
+            key: benchmark.getAttribute(key) for key in BENCHMARK_KEYS
+        }
+    self.assertEqual(['Find', 'Sum'], sorted(results))
+    for result in results.values():
+      self._AssertBenchmarkResult(result)
+
+  def _AssertJsonReport(self, report):
+    results = {}
+    for test_suite in json.loads(report)['testsuites']:
+      for test in test_suite['testsuite']:
+        if 'benchmark' in test:
+          self.assertEqual(sorted(BENCHMARK_KEYS), sorted(test['benchmark']))
+          results[test['name']] = test['benchmark']
+    self.assertEqual(['Find', 'Sum'], sorted(results))
+    for result in results.values():
+      self._AssertBenchmarkResult(result)
+
+  def testJsonReport(self):
+    p = Run('--gtest_output=json:' + self.report_path)
+    self.assertTrue(p.exited, p.output)
+    self._AssertJsonReport(self._ReadReport())
+
+  def testJsonReportOfTestJobs(self):
+    p = Run('--gtest_jobs=2', '--gtest_output=json:' + self.report_path)
+    self.assertTrue(p.exited, p.output)
+    self._AssertJsonReport(self._ReadReport())
+
+
+if __name__ == '__main__':
+  gtest_test_utils.Main()
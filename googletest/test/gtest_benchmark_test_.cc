@@ -0,0 +1,67 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Unit test for the benchmark tests of Google Test (TEST_BENCHMARK).
+//
+// This program will be invoked from a Python test.
+// Don't run it directly.
+
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST_BENCHMARK(BenchmarkTest, Sum) {
+  int sum = 0;
+  for (int i = 0; i < 100; ++i) sum += i;
+  testing::DoNotOptimize(sum);
+}
+
+class FixtureBenchmarkTest : public testing::Test {
+ protected:
+  void SetUp() override { text_ = std::string(1000, 'a') + "b"; }
+
+  std::string text_;
+};
+
+TEST_F_BENCHMARK(FixtureBenchmarkTest, Find) {
+  testing::DoNotOptimize(text_.find('b'));
+}
+
+// A benchmark stops at its first failure.
+TEST_BENCHMARK(FailingBenchmarkTest, Fails) {
+  printf("Running the body.\n");
+  ADD_FAILURE() << "Expected failure.";
+}
+
+TEST(RegularTest, Passes) {}
+
+}  // namespace
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3  # pylint: disable=g-interpreter-mismatch
+#
+# Copyright 2026, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+"""Tests Google Test's binary report (--gtest_output=bin) and its converter.
+
+This script invokes gtest_xml_output_unittest_ (a program written with Google
+Test) to write binary reports, converts them to XML and JSON with
+gtest_report_converter, and checks that the results match the reports the
+program writes itself.
+"""
+
+import os
+import re
+from xml.dom import minidom
+
+from googletest.test import gtest_test_utils
+
+COMMAND = gtest_test_utils.GetTestExecutablePath('gtest_xml_output_unittest_')
+
+
+def GetConverterPath():
+  """Returns the path of gtest_report_converter."""
+  # CMake builds the converter next to the test programs, Bazel at the root of
+  # the workspace.
+  build_dir = gtest_test_utils.GetBuildDir()
+  for directory in [build_dir, os.path.join(build_dir, '..', '..')]:
+    path = os.path.join(directory, 'gtest_report_converter')
+    if os.path.exists(path) or os.path.exists(path + '.exe'):
+      return gtest_test_utils.GetTestExecutablePath(
+          'gtest_report_converter', directory
+      )
+  return gtest_test_utils.GetTestExecutablePath('gtest_report_converter')
+
+
+CONVERTER = GetConverterPath()
+
+
+def Normalize(report):
+  """Removes the parts of a report that change from run to run."""
+  report = re.sub(r'(time|timestamp)(="|": ")[^"]*"', r'\1\2*"', report)
+  return re.sub(r'pid \d+', 'pid *', report)
+
+
+class GTestBinaryOutputUnitTest(gtest_test_utils.TestCase):
+  """Tests --gtest_output=bin and gtest_report_converter."""
+
+  def setUp(self):
+    temp_dir = gtest_test_utils.GetTempDir()
+    self.report_path = os.path.join(temp_dir, 'gtest_binary_output.bin')
+    self.expected_path = os.path.join(temp_dir, 'gtest_binary_output.expected')
+    self.converted_path = os.path.join(temp_dir, 'gtest_binary_output.out')
+
+  def tearDown(self):
+    for path in [self.report_path, self.expected_path, self.converted_path]:
+      if os.path.exists(path):
+        os.remove(path)
+
+  def _Run(self, output, args):
+    p = gtest_test_utils.Subprocess([COMMAND, '--gtest_output=' + output] + args)
+    self.assertTrue(p.exited, p.output)
+
+  def _Convert(self, args):
+    return gtest_test_utils.Subprocess([CONVERTER] + args)
+
+  def _ReadFile(self, path):
+    with open(path) as f:
+      return f.read()
+
+  def _AssertConversionMatches(self, output_format, args, converter_args=()):
+    """Checks that a converted report matches the program's own report."""
+    self._Run('%s:%s' % (output_format, self.expected_path), args)
+    self._Run('bin:' + self.report_path, args)
+    p = self._Convert(
+        list(converter_args)
+        + [self.report_path, '%s:%s' % (output_format, self.converted_path)]
+    )
+    self.assertEqual(0, p.exit_code, p.output)
+    self.assertEqual(
+        Normalize(self._ReadFile(self.expected_path)),
+        Normalize(self._ReadFile(self.converted_path)),
+    )
+
+  def testConvertsToXml(self):
+    self._AssertConversionMatches('xml', [])
+
+  def testConvertsToJson(self):
+    self._AssertConversionMatches('json', [])
+
+  def testConvertsShuffledTestsAndDisabledTests(self):
+    self._AssertConversionMatches(
+        'xml',
+        [
+            '--gtest_shuffle',
+            '--gtest_random_seed=5',
+            '--gtest_also_run_disabled_tests',
+        ],
+    )
+
+  def testConvertsLastIterationByDefault(self):
+    self._AssertConversionMatches(
+        'json', ['--gtest_repeat=3', '--gtest_filter=Property*:Skipped*']
+    )
+
+  def testConvertsGivenIteration(self):
+    self._Run(
+        'bin:' + self.report_path,
+        ['--gtest_repeat=2', '--gtest_shuffle', '--gtest_random_seed=5'],
+    )
+    p = self._Convert(
+        ['--iteration=0', self.report_path, 'xml:' + self.converted_path]
+    )
+    self.assertEqual(0, p.exit_code, p.output)
+    self.assertIn('random_seed="5"', self._ReadFile(self.converted_path))
+
+    p = self._Convert([self.report_path, 'xml:' + self.converted_path])
+    self.assertEqual(0, p.exit_code, p.output)
+    self.assertIn('random_seed="6"', self._ReadFile(self.converted_path))
+
+    p = self._Convert(
+        ['--iteration=2', self.report_path, 'xml:' + self.converted_path]
+    )
+    self.assertEqual(1, p.exit_code)
+    self.assertIn('does not hold the requested iteration', p.output)
+
+  def testConvertsTruncatedReport(self):
+    self._Run('bin:' + self.report_path, [])
+    with open(self.report_path, 'rb') as f:
+      report = f.read()
+    with open(self.report_path, 'wb') as f:
+      f.write(report[: len(report) // 2])
+    p = self._Convert([self.report_path, 'xml:' + self.converted_path])
+    self.assertEqual(0, p.exit_code, p.output)
+    xml = minidom.parse(self.converted_path)
+    try:
+      self.assertNotEqual([], xml.getElementsByTagName('testcase'))
+    finally:
+      xml.unlink()
+
+  def testRejectsOtherFiles(self):
+    self._Run('xml:' + self.report_path, [])
+    p = self._Convert([self.report_path, 'xml:' + self.converted_path])
+    self.assertEqual(1, p.exit_code)
+    self.assertIn('Not a binary report', p.output)
+
+
+if __name__ == '__main__':
+  gtest_test_utils.Main()
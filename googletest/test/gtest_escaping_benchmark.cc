@@ -0,0 +1,255 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Compares the speed of the escaping routines of the XML and JSON reports
+// with the previous implementation, which escaped one character at a time,
+// on strings typical of failure messages:
+//
+//   gtest_escaping_benchmark [MEGABYTES]
+//
+// Each routine escapes MEGABYTES (default 64) of text of every kind, and the
+// results of both implementations are checked to be the same.
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "src/gtest-internal-inl.h"
+
+namespace {
+
+using testing::Message;
+using testing::internal::String;
+
+bool IsNormalizableWhitespace(unsigned char c) {
+  return c == '\t' || c == '\n' || c == '\r';
+}
+
+bool IsValidXmlCharacter(unsigned char c) {
+  return IsNormalizableWhitespace(c) || c >= 0x20;
+}
+
+// The previous implementations.
+
+std::string BaselineEscapeXml(const std::string& str, bool is_attribute) {
+  Message m;
+
+  for (size_t i = 0; i < str.size(); ++i) {
+    const char ch = str[i];
+    switch (ch) {
+      case '<':
+        m << "&lt;";
+        break;
+      case '>':
+        m << "&gt;";
+        break;
+      case '&':
+        m << "&amp;";
+        break;
+      case '\'':
+        if (is_attribute)
+          m << "&apos;";
+        else
+          m << '\'';
+        break;
+      case '"':
+        if (is_attribute)
+          m << "&quot;";
+        else
+          m << '"';
+        break;
+      default:
+        if (IsValidXmlCharacter(static_cast<unsigned char>(ch))) {
+          if (is_attribute &&
+              IsNormalizableWhitespace(static_cast<unsigned char>(ch)))
+            m << "&#x" << String::FormatByte(static_cast<unsigned char>(ch))
+              << ";";
+          else
+            m << ch;
+        }
+        break;
+    }
+  }
+
+  return m.GetString();
+}
+
+std::string BaselineRemoveInvalidXmlCharacters(const std::string& str) {
+  std::string output;
+  output.reserve(str.size());
+  for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+    if (IsValidXmlCharacter(static_cast<unsigned char>(*it)))
+      output.push_back(*it);
+
+  return output;
+}
+
+std::string BaselineEscapeJson(const std::string& str) {
+  Message m;
+
+  for (size_t i = 0; i < str.size(); ++i) {
+    const char ch = str[i];
+    switch (ch) {
+      case '\\':
+      case '"':
+      case '/':
+        m << '\\' << ch;
+        break;
+      case '\b':
+        m << "\\b";
+        break;
+      case '\t':
+        m << "\\t";
+        break;
+      case '\n':
+        m << "\\n";
+        break;
+      case '\f':
+        m << "\\f";
+        break;
+      case '\r':
+        m << "\\r";
+        break;
+      default:
+        // Compared as unsigned, so that non-ASCII bytes are copied as they
+        // are wherever char is signed too.
+        if (static_cast<unsigned char>(ch) < ' ') {
+          m << "\\u00" << String::FormatByte(static_cast<unsigned char>(ch));
+        } else {
+          m << ch;
+        }
+        break;
+    }
+  }
+
+  return m.GetString();
+}
+
+// Kinds of strings found in failure messages.
+struct Input {
+  const char* name;
+  std::string text;
+};
+
+std::vector<Input> MakeInputs() {
+  std::vector<Input> inputs;
+
+  // A large container printed by a failed EXPECT_EQ.
+  std::string container = "Expected equality of these values:\n  actual\n"
+                          "    Which is: { ";
+  for (int i = 0; i < 2000; i++) {
+    container += "(\"key" + std::to_string(i) + "\", " + std::to_string(i) +
+                 "), ";
+  }
+  container += "}\n";
+  inputs.push_back({"printed container", container});
+
+  // Lines of a captured log.
+  std::string log;
+  for (int i = 0; i < 500; i++) {
+    log += "I1017 12:00:00.000000  1234 server.cc:42] Handled request " +
+           std::to_string(i) + " from client in 12 ms\n";
+  }
+  inputs.push_back({"captured log", log});
+
+  // Text in a language written with non-ASCII characters.
+  std::string utf8;
+  for (int i = 0; i < 2000; i++) utf8 += "\xc3\xa9t\xc3\xa9 ";
+  inputs.push_back({"non-ASCII text", utf8});
+
+  // Markup, where most characters need escaping.
+  std::string markup;
+  for (int i = 0; i < 2000; i++) markup += "<a href=\"x/y\">&amp;</a>";
+  inputs.push_back({"markup", markup});
+  return inputs;
+}
+
+// Returns the throughput of escape on text in megabytes per second, storing
+// its last result in *result.
+template <typename Escape>
+double Measure(const std::string& text, size_t megabytes, Escape escape,
+               std::string* result) {
+  const size_t runs = megabytes * 1024 * 1024 / text.size() + 1;
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < runs; i++) *result = escape(text);
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return static_cast<double>(runs * text.size()) / (1024 * 1024) /
+         elapsed.count();
+}
+
+template <typename Escape, typename BaselineEscape>
+bool Compare(const char* routine, const Input& input, size_t megabytes,
+             Escape escape, BaselineEscape baseline_escape) {
+  std::string result;
+  std::string baseline_result;
+  const double speed = Measure(input.text, megabytes, escape, &result);
+  const double baseline_speed =
+      Measure(input.text, megabytes, baseline_escape, &baseline_result);
+  printf("%-28s %-18s %9.1f %9.1f %7.1fx\n", routine, input.name,
+         baseline_speed, speed, speed / baseline_speed);
+  if (result != baseline_result) {
+    printf("  The results differ!\n");
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const size_t megabytes =
+      argc > 1 ? static_cast<size_t>(atoi(argv[1])) : size_t{64};
+  printf("%-28s %-18s %9s %9s %8s\n", "Routine", "Input", "Old MB/s",
+         "New MB/s", "Speedup");
+  bool same = true;
+  for (const Input& input : MakeInputs()) {
+    same &= Compare(
+        "EscapeXml (attribute)", input, megabytes,
+        [](const std::string& s) {
+          return testing::internal::EscapeXml(s, true);
+        },
+        [](const std::string& s) { return BaselineEscapeXml(s, true); });
+    same &= Compare(
+        "EscapeXml (text)", input, megabytes,
+        [](const std::string& s) {
+          return testing::internal::EscapeXml(s, false);
+        },
+        [](const std::string& s) { return BaselineEscapeXml(s, false); });
+    same &= Compare("RemoveInvalidXmlCharacters", input, megabytes,
+                    testing::internal::RemoveInvalidXmlCharacters,
+                    BaselineRemoveInvalidXmlCharacters);
+    same &= Compare("EscapeJson", input, megabytes,
+                    testing::internal::EscapeJson, BaselineEscapeJson);
+  }
+  return same ? 0 : 1;
+}
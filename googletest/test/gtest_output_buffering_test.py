@@ -0,0 +1,93 @@
+#!/usr/bin/env python3  # pylint: disable=g-interpreter-mismatch
+#
+# Copyright 2026, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+"""Tests the buffered text output of Google Test.
+
+This script invokes gtest_output_buffering_test_ (a program written with Google
+Test) with --gtest_output_buffering, and checks that the text output is the
+same as without buffering, in the same order as the output of the tests, and
+written out when the program is killed by a signal.
+"""
+
+import re
+
+from googletest.test import gtest_test_utils
+
+COMMAND = gtest_test_utils.GetTestExecutablePath(
+    'gtest_output_buffering_test_'
+)
+
+
+def Run(*args):
+  """Runs the test program with the given flags and returns its output."""
+  p = gtest_test_utils.Subprocess([COMMAND] + list(args))
+  return p, re.sub(r'\d+ ms', '* ms', p.output)
+
+
+class GTestOutputBufferingTest(gtest_test_utils.TestCase):
+  """Tests --gtest_output_buffering."""
+
+  def testOutputIsUnchanged(self):
+    p, unbuffered = Run('--gtest_filter=PassingTest.*:FailingTest.*')
+    self.assertTrue(p.exited and p.exit_code == 1, p.output)
+    p, buffered = Run(
+        '--gtest_filter=PassingTest.*:FailingTest.*',
+        '--gtest_output_buffering=4096',
+    )
+    self.assertTrue(p.exited and p.exit_code == 1, p.output)
+    self.assertEqual(unbuffered, buffered)
+    self.assertIn(
+        '[ RUN      ] PassingTest.PrintsWithPrintf\nOutput of printf\n',
+        buffered,
+    )
+    self.assertIn(
+        '[ RUN      ] PassingTest.PrintsWithCout\nOutput of cout\n', buffered
+    )
+
+  def testOutputIsWrittenOutWhenKilled(self):
+    p, buffered = Run(
+        '--gtest_filter=PassingTest.*:CrashingTest.*',
+        '--gtest_output_buffering=4096',
+    )
+    self.assertTrue(p.terminated_by_signal, p.output)
+    self.assertIn('[       OK ] PassingTest.PrintsWithCout', buffered)
+    self.assertIn('[ RUN      ] CrashingTest.Aborts', buffered)
+
+  def testBufferedOutputIsWrittenOutWhenKilled(self):
+    p, buffered = Run(
+        '--gtest_filter=CrashingListenerTest.*',
+        '--gtest_output_buffering=4096',
+    )
+    self.assertTrue(p.terminated_by_signal, p.output)
+    self.assertIn('[       OK ] CrashingListenerTest.Passes', buffered)
+
+
+if __name__ == '__main__':
+  gtest_test_utils.Main()
@@ -0,0 +1,84 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Unit test for the buffered text output of Google Test
+// (--gtest_output_buffering).
+//
+// This program will be invoked from a Python test.
+// Don't run it directly.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(PassingTest, PrintsWithPrintf) { printf("Output of printf\n"); }
+
+TEST(PassingTest, PrintsWithCout) { std::cout << "Output of cout\n"; }
+
+TEST(FailingTest, Fails) { FAIL() << "Expected failure"; }
+
+// Ends the test program with a signal, like a crash would.
+TEST(CrashingTest, Aborts) { std::abort(); }
+
+// Passes, and then AbortingListener ends the test program while the text
+// printer still buffers the result.
+TEST(CrashingListenerTest, Passes) {}
+
+TEST(CrashingListenerTest, NeverRuns) {}
+
+// Ends the test program with a signal at the end of the first test of
+// CrashingListenerTest.
+class AbortingListener : public testing::EmptyTestEventListener {
+ public:
+  void OnTestEnd(const testing::TestInfo& test_info) override {
+    if (strcmp(test_info.test_suite_name(), "CrashingListenerTest") == 0) {
+      std::abort();
+    }
+  }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  // The end of a test is reported to the listeners in the reverse order, so
+  // AbortingListener goes before the text printer.
+  testing::TestEventListeners& listeners =
+      testing::UnitTest::GetInstance()->listeners();
+  testing::TestEventListener* const printer =
+      listeners.Release(listeners.default_result_printer());
+  listeners.Append(new AbortingListener);
+  listeners.Append(printer);
+  return RUN_ALL_TESTS();
+}
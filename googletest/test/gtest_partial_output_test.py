@@ -0,0 +1,174 @@
+#!/usr/bin/env python3  # pylint: disable=g-interpreter-mismatch
+#
+# Copyright 2026, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+"""Tests the partial XML and JSON reports of a test program that is killed.
+
+This script invokes gtest_partial_output_test_ (a program written with Google
+Test) with a test that ends the program abruptly, and checks that the XML or
+JSON report holds the tests that finished before it.
+"""
+
+import json
+import os
+import subprocess
+from xml.dom import minidom
+
+from googletest.test import gtest_test_utils
+
+COMMAND = gtest_test_utils.GetTestExecutablePath('gtest_partial_output_test_')
+
+# The tests that finish before the program ends, by test suite.
+FINISHED_TESTS = {
+    'PassingTest': ['First', 'Second'],
+    'FailingTest': ['Fails'],
+    'KilledTest': ['RunsBeforeExit'],
+}
+
+
+def Run(output_format, path):
+  """Runs the test program writing a report in the given format to path."""
+  p = gtest_test_utils.Subprocess(
+      [COMMAND, '--gtest_output=%s:%s' % (output_format, path)]
+  )
+  assert p.exited and p.exit_code == 1, p.output
+  assert '[ RUN      ] KilledTest.Exits' in p.output, p.output
+  assert 'KilledTest.NeverRuns' not in p.output, p.output
+
+
+class GTestPartialOutputTest(gtest_test_utils.TestCase):
+  """Tests the reports written while the tests run."""
+
+  def setUp(self):
+    self.path = os.path.join(
+        gtest_test_utils.GetTempDir(), 'gtest_partial_output_test'
+    )
+
+  def tearDown(self):
+    if os.path.exists(self.path):
+      os.remove(self.path)
+
+  def testXmlReportOfKilledProgram(self):
+    Run('xml', self.path)
+    xml = minidom.parse(self.path)
+    try:
+      testsuites = xml.documentElement
+      self.assertEqual('testsuites', testsuites.tagName)
+      self.assertEqual('AllTests', testsuites.getAttribute('name'))
+      tests = {}
+      for testsuite in testsuites.getElementsByTagName('testsuite'):
+        tests[testsuite.getAttribute('name')] = [
+            testcase.getAttribute('name')
+            for testcase in testsuite.getElementsByTagName('testcase')
+        ]
+      self.assertEqual(FINISHED_TESTS, tests)
+
+      testcases = {
+          testcase.getAttribute('name'): testcase
+          for testcase in xml.getElementsByTagName('testcase')
+      }
+      self.assertEqual(
+          'completed', testcases['RunsBeforeExit'].getAttribute('result')
+      )
+      failures = testcases['Fails'].getElementsByTagName('failure')
+      self.assertEqual(1, len(failures))
+      self.assertIn(
+          'Expected <failure> & "message"', failures[0].getAttribute('message')
+      )
+      properties = testcases['Second'].getElementsByTagName('property')
+      self.assertEqual('value', properties[0].getAttribute('value'))
+    finally:
+      xml.unlink()
+
+  def testJsonReportOfKilledProgram(self):
+    Run('json', self.path)
+    with open(self.path) as f:
+      report = json.load(f)
+    self.assertEqual('AllTests', report['name'])
+    tests = {
+        testsuite['name']: [test['name'] for test in testsuite['testsuite']]
+        for testsuite in report['testsuites']
+    }
+    self.assertEqual(FINISHED_TESTS, tests)
+
+    testcases = {
+        test['name']: test
+        for testsuite in report['testsuites']
+        for test in testsuite['testsuite']
+    }
+    self.assertEqual('COMPLETED', testcases['RunsBeforeExit']['result'])
+    self.assertEqual(1, len(testcases['Fails']['failures']))
+    self.assertIn(
+        'Expected <failure> & "message"',
+        testcases['Fails']['failures'][0]['failure'],
+    )
+    self.assertEqual('value', testcases['Second']['key'])
+
+  def testCompleteReportReplacesPartialReport(self):
+    p = gtest_test_utils.Subprocess([
+        COMMAND,
+        '--gtest_filter=PassingTest.*',
+        '--gtest_output=json:' + self.path,
+    ])
+    self.assertEqual(0, p.exit_code)
+    self.assertFalse(os.path.exists(self.path + '.tmp'))
+    with open(self.path) as f:
+      report = json.load(f)
+    self.assertEqual(2, report['tests'])
+    self.assertEqual(2, report['testsuites'][0]['tests'])
+
+  if os.name == 'posix':
+
+    def testWritesCompleteReportOnceToPipe(self):
+      for output_format in ['xml', 'json']:
+        read_fd, write_fd = os.pipe()
+        p = subprocess.Popen(
+            [
+                COMMAND,
+                '--gtest_filter=PassingTest.*',
+                '--gtest_output=%s:/dev/fd/%d' % (output_format, write_fd),
+            ],
+            stdout=subprocess.DEVNULL,
+            pass_fds=[write_fd],
+        )
+        os.close(write_fd)
+        with os.fdopen(read_fd) as f:
+          report = f.read()
+        self.assertEqual(0, p.wait())
+        self.assertFalse(os.path.exists('/dev/fd/%d.tmp' % write_fd))
+        if output_format == 'xml':
+          xml = minidom.parseString(report)
+          self.assertEqual('2', xml.documentElement.getAttribute('tests'))
+          xml.unlink()
+        else:
+          self.assertEqual(2, json.loads(report)['tests'])
+
+
+if __name__ == '__main__':
+  gtest_test_utils.Main()
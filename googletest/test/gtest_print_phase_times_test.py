@@ -0,0 +1,197 @@
+#!/usr/bin/env python3  # pylint: disable=g-interpreter-mismatch
+#
+# Copyright 2026, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""Tests the timing of the phases of each test.
+
+This script invokes gtest_print_phase_times_test_ (a program written with
+Google Test) with --gtest_print_phase_times, and checks the summary it prints
+and the phase times it reports in the XML and JSON reports.
+"""
+
+import json
+import os
+import re
+from xml.dom import minidom
+
+from googletest.test import gtest_test_utils
+
+COMMAND = gtest_test_utils.GetTestExecutablePath(
+    'gtest_print_phase_times_test_'
+)
+
+# The least time in seconds each phase of PhaseTest.Slow takes.
+TEST_PHASES = {
+    'constructor': 0.01,
+    'set_up': 0.02,
+    'body': 0.03,
+    'tear_down': 0.04,
+    'destructor': 0.05,
+}
+TEST_SUITE_PHASES = {
+    'set_up_test_suite': 0.01,
+    'tear_down_test_suite': 0.01,
+}
+UNIT_TEST_PHASES = {
+    'environments_set_up': 0.01,
+    'environments_tear_down': 0.01,
+}
+
+
+def Run(*args):
+  """Runs the test program with the given flags."""
+  p = gtest_test_utils.Subprocess([COMMAND] + list(args))
+  return p
+
+
+class GTestPrintPhaseTimesTest(gtest_test_utils.TestCase):
+  """Tests --gtest_print_phase_times."""
+
+  def setUp(self):
+    self.report_path = os.path.join(
+        gtest_test_utils.GetTempDir(), 'gtest_print_phase_times_test.out'
+    )
+
+  def tearDown(self):
+    if os.path.exists(self.report_path):
+      os.remove(self.report_path)
+
+  def _ReadReport(self):
+    with open(self.report_path) as f:
+      return f.read()
+
+  def _AssertPhases(self, expected, phases):
+    self.assertEqual(sorted(expected), sorted(phases))
+    for phase, least_time in expected.items():
+      self.assertGreaterEqual(phases[phase], least_time, phase)
+
+  def _AssertJsonReport(self, check_environments=True):
+    report = json.loads(self._ReadReport())
+
+    def Seconds(phases):
+      return {key: float(value.rstrip('s')) for key, value in phases.items()}
+
+    if check_environments:
+      self._AssertPhases(UNIT_TEST_PHASES, Seconds(report['phases']))
+    for test_suite in report['testsuites']:
+      if test_suite['name'] != 'PhaseTest':
+        continue
+      self._AssertPhases(TEST_SUITE_PHASES, Seconds(test_suite['phases']))
+      self._AssertPhases(
+          TEST_PHASES, Seconds(test_suite['testsuite'][0]['phases'])
+      )
+      return
+    self.fail('PhaseTest is missing from the report.')
+
+  def testPrintsTheTimeOfEachPhase(self):
+    p = Run('--gtest_print_phase_times')
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    self.assertIn('[  PHASES  ] The time spent in each phase:\n', p.output)
+    for phase in [
+        'environment set-up',
+        r'SetUpTestSuite\(\)',
+        'fixture constructors',
+        r'SetUp\(\)',
+        'test bodies',
+        r'TearDown\(\)',
+        'fixture destructors',
+        r'TearDownTestSuite\(\)',
+        'environment tear-down',
+    ]:
+      self.assertRegex(
+          p.output, r'\[  PHASES  \]   %s: [\d.]+ [num]?s\n' % phase
+      )
+    self.assertRegex(
+        p.output,
+        r'\[  PHASES  \] The tests whose fixtures took the most time:\n'
+        r'\[  PHASES  \]   PhaseTest\.Slow: [\d.]+ ms\n',
+    )
+
+  def testDoesNotReportByDefault(self):
+    p = Run('--gtest_output=json:' + self.report_path)
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    self.assertNotIn('[  PHASES  ]', p.output)
+    self.assertNotIn('"phases"', self._ReadReport())
+
+  def testJsonReport(self):
+    p = Run(
+        '--gtest_print_phase_times', '--gtest_output=json:' + self.report_path
+    )
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    self._AssertJsonReport()
+
+  def testJsonReportOfTestJobs(self):
+    p = Run(
+        '--gtest_print_phase_times',
+        '--gtest_jobs=2',
+        '--gtest_output=json:' + self.report_path,
+    )
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    self._AssertJsonReport()
+
+  def testXmlReport(self):
+    p = Run(
+        '--gtest_print_phase_times', '--gtest_output=xml:' + self.report_path
+    )
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    document = minidom.parseString(self._ReadReport())
+
+    def Seconds(element, keys):
+      return {key: float(element.getAttribute(key)) for key in keys}
+
+    (test_suites,) = document.getElementsByTagName('testsuites')
+    phases = [
+        node
+        for node in test_suites.childNodes
+        if node.nodeName == 'phases'
+    ]
+    self.assertEqual(1, len(phases))
+    self._AssertPhases(
+        UNIT_TEST_PHASES, Seconds(phases[0], UNIT_TEST_PHASES)
+    )
+    for test_suite in document.getElementsByTagName('testsuite'):
+      if test_suite.getAttribute('name') != 'PhaseTest':
+        continue
+      (test_case,) = test_suite.getElementsByTagName('testcase')
+      (test_phases,) = test_case.getElementsByTagName('phases')
+      self._AssertPhases(TEST_PHASES, Seconds(test_phases, TEST_PHASES))
+      suite_phases = [
+          node
+          for node in test_suite.childNodes
+          if node.nodeName == 'phases'
+      ]
+      self.assertEqual(1, len(suite_phases))
+      self._AssertPhases(
+          TEST_SUITE_PHASES, Seconds(suite_phases[0], TEST_SUITE_PHASES)
+      )
+
+
+if __name__ == '__main__':
+  gtest_test_utils.Main()
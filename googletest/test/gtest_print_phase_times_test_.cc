@@ -0,0 +1,79 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Unit test for the timing of the phases of each test
+// (--gtest_print_phase_times).
+//
+// This program will be invoked from a Python test.
+// Don't run it directly.
+
+#include <chrono>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Waits for the given number of milliseconds.
+void Wait(int ms) {
+  const auto end =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+class SlowEnvironment : public testing::Environment {
+ public:
+  void SetUp() override { Wait(10); }
+  void TearDown() override { Wait(10); }
+};
+
+// A fixture each phase of which takes a different time.
+class PhaseTest : public testing::Test {
+ protected:
+  PhaseTest() { Wait(10); }
+  ~PhaseTest() override { Wait(50); }
+
+  static void SetUpTestSuite() { Wait(10); }
+  static void TearDownTestSuite() { Wait(10); }
+
+  void SetUp() override { Wait(20); }
+  void TearDown() override { Wait(40); }
+};
+
+TEST_F(PhaseTest, Slow) { Wait(30); }
+
+TEST(FastTest, Passes) {}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::AddGlobalTestEnvironment(new SlowEnvironment);
+  return RUN_ALL_TESTS();
+}
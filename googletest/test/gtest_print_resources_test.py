@@ -0,0 +1,186 @@
+#!/usr/bin/env python3  # pylint: disable=g-interpreter-mismatch
+#
+# Copyright 2026, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""Tests the measurement of the resources used by each test.
+
+This script invokes gtest_print_resources_test_ (a program written with Google
+Test) with --gtest_print_resources, and checks the summary it prints and the
+resources it reports in the XML and JSON reports.
+"""
+
+import json
+import os
+import re
+from xml.dom import minidom
+
+from googletest.test import gtest_test_utils
+
+COMMAND = gtest_test_utils.GetTestExecutablePath('gtest_print_resources_test_')
+
+IS_LINUX = os.name == 'posix' and os.uname()[0] == 'Linux'
+
+RESOURCE_KEYS = [
+    'user_cpu_time_us',
+    'system_cpu_time_us',
+    'max_rss_kb',
+    'max_rss_growth_kb',
+    'minor_page_faults',
+    'major_page_faults',
+    'voluntary_context_switches',
+    'involuntary_context_switches',
+]
+
+
+def Run(*args):
+  """Runs the tests of ResourceTest with the given flags."""
+  p = gtest_test_utils.Subprocess(
+      [COMMAND, '--gtest_filter=ResourceTest.*'] + list(args)
+  )
+  return p
+
+
+class GTestPrintResourcesTest(gtest_test_utils.TestCase):
+  """Tests --gtest_print_resources."""
+
+  def setUp(self):
+    self.report_path = os.path.join(
+        gtest_test_utils.GetTempDir(), 'gtest_print_resources_test.out'
+    )
+
+  def tearDown(self):
+    if os.path.exists(self.report_path):
+      os.remove(self.report_path)
+
+  def _ReadReport(self):
+    with open(self.report_path) as f:
+      return f.read()
+
+  def _AssertResources(self, resources):
+    self.assertEqual(
+        ['AllocatesMemory', 'BurnsCpu', 'Passes'], sorted(resources)
+    )
+    burns_cpu = resources['BurnsCpu']
+    self.assertGreaterEqual(
+        burns_cpu['user_cpu_time_us'] + burns_cpu['system_cpu_time_us'], 50000
+    )
+    self.assertGreaterEqual(
+        resources['AllocatesMemory']['max_rss_growth_kb'], 32 * 1024
+    )
+    for usage in resources.values():
+      self.assertEqual(sorted(RESOURCE_KEYS), sorted(usage))
+      self.assertGreater(usage['max_rss_kb'], 0)
+
+  def _JsonResources(self):
+    resources = {}
+    for test_suite in json.loads(self._ReadReport())['testsuites']:
+      for test in test_suite['testsuite']:
+        if 'resources' in test:
+          resources[test['name']] = test['resources']
+    return resources
+
+  def testPrintsTheTestsThatUseTheMost(self):
+    p = Run('--gtest_print_resources')
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    self.assertIn(
+        '[ RESOURCES] The tests that used the most CPU time:\n', p.output
+    )
+    match = re.search(
+        r'\[ RESOURCES\]   ResourceTest\.BurnsCpu: ([\d.]+) ms '
+        r'\([\d.]+ ms user, [\d.]+ ms system\)\n',
+        p.output,
+    )
+    self.assertTrue(match, p.output)
+    self.assertGreaterEqual(float(match.group(1)), 50)
+    match = re.search(
+        r'\[ RESOURCES\] The tests that raised the peak memory the most:\n'
+        r'\[ RESOURCES\]   ResourceTest\.AllocatesMemory: \+(\d+) KB, '
+        r'to \d+ KB\n',
+        p.output,
+    )
+    self.assertTrue(match, p.output)
+    self.assertGreaterEqual(int(match.group(1)), 32 * 1024)
+
+  def testDoesNotMeasureByDefault(self):
+    p = Run('--gtest_output=json:' + self.report_path)
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    self.assertNotIn('[ RESOURCES]', p.output)
+    self.assertEqual({}, self._JsonResources())
+
+  def testJsonReport(self):
+    p = Run('--gtest_print_resources', '--gtest_output=json:' + self.report_path)
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    self._AssertResources(self._JsonResources())
+
+  def testJsonReportOfTestJobs(self):
+    p = Run(
+        '--gtest_print_resources',
+        '--gtest_jobs=2',
+        '--gtest_output=json:' + self.report_path,
+    )
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    self._AssertResources(self._JsonResources())
+
+  if IS_LINUX:
+
+    def testDoesNotChargeConcurrentTests(self):
+      p = Run(
+          '--gtest_print_resources',
+          '--gtest_parallel=2',
+          '--gtest_filter=ResourceTest.BurnsCpu:ConcurrentResourceTest.*',
+          '--gtest_output=json:' + self.report_path,
+      )
+      self.assertTrue(p.exited and p.exit_code == 0, p.output)
+      resources = self._JsonResources()
+      burns_cpu = resources['BurnsCpu']
+      self.assertGreaterEqual(
+          burns_cpu['user_cpu_time_us'] + burns_cpu['system_cpu_time_us'],
+          50000,
+      )
+      sleeps = resources['Sleeps']
+      self.assertLess(
+          sleeps['user_cpu_time_us'] + sleeps['system_cpu_time_us'], 50000
+      )
+
+  def testXmlReport(self):
+    p = Run('--gtest_print_resources', '--gtest_output=xml:' + self.report_path)
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    resources = {}
+    document = minidom.parseString(self._ReadReport())
+    for test_case in document.getElementsByTagName('testcase'):
+      for element in test_case.getElementsByTagName('resources'):
+        resources[test_case.getAttribute('name')] = {
+            key: int(element.getAttribute(key)) for key in RESOURCE_KEYS
+        }
+    self._AssertResources(resources)
+
+
+if __name__ == '__main__':
+  gtest_test_utils.Main()
@@ -0,0 +1,305 @@
+#!/usr/bin/env python3  # pylint: disable=g-interpreter-mismatch
+#
+# Copyright 2026, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+"""Tests streaming the test results to a Unix domain socket or a ring buffer.
+
+This script invokes gtest_stream_result_test_ (a program written with Google
+Test) with --gtest_stream_result_to=unix:PATH, collects what it sends to a
+socket listening at PATH, and checks the events in the text and compact
+framings, and that a receiver that does not keep up does not hold back the
+tests with overflow=drop.  It also reads the ring buffer the program writes
+to the file at PATH with --gtest_stream_result_to=shm:PATH.
+"""
+
+import mmap
+import os
+import socket
+import struct
+import tempfile
+import threading
+import time
+
+from googletest.test import gtest_test_utils
+
+COMMAND = gtest_test_utils.GetTestExecutablePath('gtest_stream_result_test_')
+
+EXPECTED_EVENTS = [
+    ('TestProgramStart', []),
+    ('TestIterationStart', [('iteration', '0')]),
+    ('TestCaseStart', [('name', 'StreamTest')]),
+    ('TestStart', [('name', 'Passes')]),
+    ('TestEnd', [('passed', '1')]),
+    ('TestStart', [('name', 'Fails')]),
+    (
+        'TestPartResult',
+        [('line', '48'), ('message', 'Failed\na=b&c%d\nline 2\n')],
+    ),
+    ('TestEnd', [('passed', '0')]),
+    ('TestCaseEnd', [('passed', '0')]),
+    ('TestIterationEnd', [('passed', '0')]),
+    ('TestProgramEnd', [('passed', '0')]),
+]
+
+
+def Decode(value):
+  """Decodes the %xx escapes of the text framing."""
+  parts = value.split('%')
+  return parts[0] + ''.join(chr(int(p[:2], 16)) + p[2:] for p in parts[1:])
+
+
+def ParseText(data):
+  """Returns the header and the (name, fields) events of the text framing."""
+  lines = data.decode('latin-1').split('\n')
+  assert lines[-1] == '', lines[-1]
+  events = []
+  for line in lines[1:-1]:
+    fields = [field.split('=', 1) for field in line.split('&')]
+    assert fields[0][0] == 'event', line
+    events.append(
+        (fields[0][1], [(key, Decode(value)) for key, value in fields[1:]])
+    )
+  return lines[0], events
+
+
+def ReadSize(data, pos):
+  """Reads an unsigned LEB128 varint at data[pos:]."""
+  size = 0
+  shift = 0
+  while True:
+    byte = data[pos]
+    pos += 1
+    size |= (byte & 0x7F) << shift
+    shift += 7
+    if byte < 0x80:
+      return size, pos
+
+
+def ReadString(data, pos):
+  size, pos = ReadSize(data, pos)
+  return data[pos : pos + size].decode('latin-1'), pos + size
+
+
+def ParseCompact(data):
+  """Returns the header and the (name, fields) events of the compact framing."""
+  header, data = data.split(b'\n', 1)
+  events = []
+  pos = 0
+  while pos < len(data):
+    size, pos = ReadSize(data, pos)
+    end = pos + size
+    name, pos = ReadString(data, pos)
+    fields = []
+    while pos < end:
+      key, pos = ReadString(data, pos)
+      value, pos = ReadString(data, pos)
+      fields.append((key, value))
+    assert pos == end
+    events.append((name, fields))
+  return header.decode('latin-1'), events
+
+
+def ReadRing(path):
+  """Returns the finished flag and the records of a ring buffer file."""
+  with open(path, 'rb') as f:
+    ring = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+  magic, version, header_size, capacity, oldest, end, finished, _ = (
+      struct.unpack_from('=8sIIQQQII', ring)
+  )
+  assert magic == b'gtestrng', magic
+  assert version == 1, version
+  records = []
+  position = oldest
+  while position < end:
+    offset = header_size + position % capacity
+    size, sequence = struct.unpack_from('=II', ring, offset)
+    if size == 0xFFFFFFFF:
+      position += capacity - position % capacity
+      continue
+    records.append((sequence, ring[offset + 8 : offset + 8 + size]))
+    position += (8 + size + 7) // 8 * 8
+  ring.close()
+  return finished, records
+
+
+def Comparable(events):
+  """Leaves out the fields that vary from run to run."""
+  return [
+      (name, [(k, v) for k, v in fields if k not in ('file', 'elapsed_time')])
+      for name, fields in events
+  ]
+
+
+class Receiver(object):
+  """Collects the bytes sent to a Unix domain socket."""
+
+  def __init__(self, path, delay_seconds=0):
+    self.data = b''
+    self._delay_seconds = delay_seconds
+    self._socket = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    self._socket.bind(path)
+    self._socket.listen(1)
+    self._thread = threading.Thread(target=self._Receive)
+    self._thread.start()
+
+  def _Receive(self):
+    connection, _ = self._socket.accept()
+    time.sleep(self._delay_seconds)
+    while True:
+      data = connection.recv(65536)
+      if not data:
+        break
+      self.data += data
+    connection.close()
+
+  def Join(self):
+    self._thread.join()
+    self._socket.close()
+
+
+class GTestStreamResultTest(gtest_test_utils.TestCase):
+  """Tests --gtest_stream_result_to=unix:PATH."""
+
+  def setUp(self):
+    self.dir = tempfile.mkdtemp()
+    self.path = os.path.join(self.dir, 'results')
+
+  def tearDown(self):
+    if os.path.exists(self.path):
+      os.remove(self.path)
+    os.rmdir(self.dir)
+
+  def Run(self, options, test_filter='StreamTest.*', delay_seconds=0):
+    receiver = Receiver(self.path, delay_seconds)
+    p = gtest_test_utils.Subprocess([
+        COMMAND,
+        '--gtest_filter=' + test_filter,
+        '--gtest_stream_result_to=unix:' + self.path + options,
+    ])
+    receiver.Join()
+    self.assertTrue(p.exited and p.exit_code == 1, p.output)
+    return receiver.data
+
+  def testStreamsTextEvents(self):
+    header, events = ParseText(self.Run(''))
+    self.assertEqual('gtest_streaming_protocol_version=1.0', header)
+    self.assertEqual(EXPECTED_EVENTS, Comparable(events))
+
+  def testStreamsBufferedTextEvents(self):
+    header, events = ParseText(self.Run('?buffer=65536'))
+    self.assertEqual('gtest_streaming_protocol_version=1.0', header)
+    self.assertEqual(EXPECTED_EVENTS, Comparable(events))
+
+  def testStreamsCompactEvents(self):
+    header, events = ParseCompact(
+        self.Run('?framing=compact&buffer=100&overflow=drop')
+    )
+    self.assertEqual(
+        'gtest_streaming_protocol_version=1.0&framing=compact', header
+    )
+    self.assertEqual(EXPECTED_EVENTS, Comparable(events))
+
+  def testPublishesEventsToARingBuffer(self):
+    p = gtest_test_utils.Subprocess([
+        COMMAND,
+        '--gtest_filter=StreamTest.*',
+        '--gtest_stream_result_to=shm:' + self.path,
+    ])
+    self.assertTrue(p.exited and p.exit_code == 1, p.output)
+    finished, records = ReadRing(self.path)
+    self.assertEqual(1, finished)
+    self.assertEqual(list(range(len(records))), [r[0] for r in records])
+    header, events = ParseCompact(b''.join(r[1] for r in records))
+    self.assertEqual(
+        'gtest_streaming_protocol_version=1.0&framing=compact', header
+    )
+    self.assertEqual(EXPECTED_EVENTS, Comparable(events))
+
+  def testKeepsTheRingBufferOfADeathTestParent(self):
+    p = gtest_test_utils.Subprocess([
+        COMMAND,
+        '--gtest_filter=RingDeathTest.*',
+        '--gtest_stream_result_to=shm:' + self.path,
+    ])
+    self.assertTrue(p.exited and p.exit_code == 0, p.output)
+    finished, records = ReadRing(self.path)
+    self.assertEqual(1, finished)
+    self.assertEqual(list(range(len(records))), [r[0] for r in records])
+    _, events = ParseCompact(b''.join(r[1] for r in records))
+    self.assertEqual(
+        [
+            ('TestProgramStart', []),
+            ('TestIterationStart', [('iteration', '0')]),
+            ('TestCaseStart', [('name', 'RingDeathTest')]),
+            ('TestStart', [('name', 'ThreadsafeStyle')]),
+            ('TestEnd', [('passed', '1')]),
+            ('TestCaseEnd', [('passed', '1')]),
+            ('TestIterationEnd', [('passed', '1')]),
+            ('TestProgramEnd', [('passed', '1')]),
+        ],
+        Comparable(events),
+    )
+
+  def testKeepsTheNewestEventsInARingBuffer(self):
+    p = gtest_test_utils.Subprocess([
+        COMMAND,
+        '--gtest_filter=StreamTest.*',
+        '--gtest_stream_result_to=shm:' + self.path + '?size=128',
+    ])
+    self.assertTrue(p.exited and p.exit_code == 1, p.output)
+    _, records = ReadRing(self.path)
+    sequences = [r[0] for r in records]
+    self.assertEqual(list(range(sequences[0], 12)), sequences)
+    _, events = ParseCompact(b'\n' + b''.join(r[1] for r in records))
+    self.assertEqual(EXPECTED_EVENTS[-len(events) :], Comparable(events))
+
+  def testDropsEventsTheReceiverCannotTake(self):
+    _, events = ParseCompact(
+        self.Run(
+            '?framing=compact&buffer=65536&overflow=drop',
+            test_filter='FloodTest.*',
+            delay_seconds=0.5,
+        )
+    )
+    names = [name for name, _ in events]
+    self.assertIn('EventsDropped', names)
+    dropped = sum(
+        int(dict(fields)['count'])
+        for name, fields in events
+        if name == 'EventsDropped'
+    )
+    # Every event is either received or counted as dropped.
+    self.assertEqual(
+        74, len(names) - names.count('EventsDropped') + dropped, names
+    )
+    self.assertLess(names.count('TestPartResult'), 64)
+    self.assertEqual('TestProgramEnd', names[-1])
+
+if __name__ == '__main__':
+  gtest_test_utils.Main()
@@ -0,0 +1,72 @@
+// Copyright 2026, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Unit test for streaming the test results to a Unix domain socket
+// (--gtest_stream_result_to=unix:PATH) or a ring buffer in a memory-mapped
+// file (--gtest_stream_result_to=shm:PATH).
+//
+// This program will be invoked from a Python test.
+// Don't run it directly.
+
+#include <chrono>  // NOLINT
+#include <cstdlib>
+#include <string>
+#include <thread>  // NOLINT
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(StreamTest, Passes) {}
+
+TEST(StreamTest, Fails) { ADD_FAILURE() << "a=b&c%d\nline 2"; }
+
+// Produces far more events than the receiver's socket buffer holds.
+TEST(FloodTest, FailsManyTimes) {
+  const std::string message(64 * 1024, 'x');
+  for (int i = 0; i < 64; ++i) {
+    ADD_FAILURE() << message;
+  }
+}
+
+// Gives the receiver the time to catch up, so that the events after this
+// test are sent.
+TEST(FloodTest, WaitsForTheReceiver) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+}
+
+#ifdef GTEST_HAS_DEATH_TEST
+// Runs a death test child that parses the same streaming flag.
+TEST(RingDeathTest, ThreadsafeStyle) {
+  GTEST_FLAG_SET(death_test_style, "threadsafe");
+  EXPECT_EXIT(std::exit(1), ::testing::ExitedWithCode(1), "");
+}
+#endif  // GTEST_HAS_DEATH_TEST
+
+}  // namespace
@@ -60,6 +60,7 @@ TEST(CommandLineFlagsTest, CanBeAccessedInCodeOnceGTestHIsIncluded) {
 #include <string.h>
 #include <time.h>
 
+#include <chrono>  // NOLINT
 #include <cstdint>
 #include <map>
 #include <memory>
@@ -68,6 +69,7 @@ TEST(CommandLineFlagsTest, CanBeAccessedInCodeOnceGTestHIsIncluded) {
 #include <stdexcept>
 #include <string>
 #include <type_traits>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -181,6 +183,245 @@ TEST_F(StreamingListenerTest, OnTestPartResult) {
       *output());
 }
 
+TEST_F(StreamingListenerTest, CompactFraming) {
+  FakeSocketWriter* const writer = new FakeSocketWriter;
+  StreamingListener streamer(writer, true);
+  EXPECT_EQ("gtest_streaming_protocol_version=1.0&framing=compact\n",
+            writer->output_);
+  writer->output_.clear();
+  streamer.OnTestStart(test_info_obj_);
+  EXPECT_EQ(std::string("\x13\x09TestStart\x04name\x03"
+                        "Bar"),
+            writer->output_);
+}
+
+TEST(StreamingListenerAppendEventTest, FramesCompactEventsWithSizes) {
+  std::string output;
+  StreamingListener::AppendEvent(
+      true, "TestPartResult", {{"line", "42"}, {"message", "a=\n"}}, &output);
+  EXPECT_EQ(std::string("\x23\x0eTestPartResult\x04line\x02"
+                        "42\x07message\x03"
+                        "a=\n"),
+            output);
+
+  // Sizes from 128 on take more than one byte.
+  output.clear();
+  StreamingListener::AppendEvent(true, "E", {{"k", std::string(200, 'v')}},
+                                 &output);
+  ASSERT_EQ(208u, output.size());
+  EXPECT_EQ(std::string("\xce\x01\x01"
+                        "E\x01k\xc8\x01"),
+            output.substr(0, 8));
+}
+
+TEST(StreamingListenerParseTargetTest, ParsesAddressesAndOptions) {
+  std::string address;
+  StreamingListener::Options options;
+  std::string error;
+  ASSERT_TRUE(StreamingListener::ParseTarget("localhost:555", &address,
+                                             &options, &error));
+  EXPECT_EQ("localhost:555", address);
+  EXPECT_FALSE(options.compact);
+  EXPECT_EQ(0u, options.buffer_size);
+  EXPECT_FALSE(options.drop_on_overflow);
+
+  ASSERT_TRUE(StreamingListener::ParseTarget(
+      "unix:/tmp/results?framing=compact&buffer=65536&overflow=drop",
+      &address, &options, &error));
+  EXPECT_EQ("unix:/tmp/results", address);
+  EXPECT_TRUE(options.compact);
+  EXPECT_EQ(65536u, options.buffer_size);
+  EXPECT_TRUE(options.drop_on_overflow);
+
+  ASSERT_TRUE(StreamingListener::ParseTarget("unix:@results", &address,
+                                             &options, &error));
+  EXPECT_EQ("unix:@results", address);
+  EXPECT_FALSE(options.compact);
+
+  // A host named "unix".
+  ASSERT_TRUE(StreamingListener::ParseTarget("unix:555?buffer=64", &address,
+                                             &options, &error));
+  EXPECT_EQ("unix:555", address);
+  EXPECT_EQ(64u, options.buffer_size);
+
+  ASSERT_TRUE(StreamingListener::ParseTarget(
+      "::1:555?framing=text&overflow=block", &address, &options, &error));
+  EXPECT_EQ("::1:555", address);
+  EXPECT_FALSE(options.compact);
+  EXPECT_FALSE(options.drop_on_overflow);
+
+  ASSERT_TRUE(StreamingListener::ParseTarget("shm:/dev/shm/results", &address,
+                                             &options, &error));
+  EXPECT_EQ("shm:/dev/shm/results", address);
+  EXPECT_TRUE(options.compact);
+  EXPECT_EQ(size_t{1} << 20, options.ring_size);
+
+  ASSERT_TRUE(StreamingListener::ParseTarget("shm:/dev/shm/results?size=4096",
+                                             &address, &options, &error));
+  EXPECT_EQ(4096u, options.ring_size);
+}
+
+TEST(StreamingListenerParseTargetTest, RejectsInvalidTargets) {
+  std::string address;
+  StreamingListener::Options options;
+  std::string error;
+  EXPECT_FALSE(
+      StreamingListener::ParseTarget("localhost", &address, &options, &error));
+  EXPECT_EQ("expected HOST:PORT, unix:PATH or shm:PATH", error);
+  EXPECT_FALSE(StreamingListener::ParseTarget("localhost:", &address,
+                                              &options, &error));
+  EXPECT_FALSE(
+      StreamingListener::ParseTarget("unix:", &address, &options, &error));
+  EXPECT_EQ("missing path after \"unix:\"", error);
+  EXPECT_FALSE(
+      StreamingListener::ParseTarget("shm:", &address, &options, &error));
+  EXPECT_EQ("missing path after \"shm:\"", error);
+  EXPECT_FALSE(StreamingListener::ParseTarget("shm:/dev/shm/r?size=0",
+                                              &address, &options, &error));
+  EXPECT_EQ("invalid option \"size=0\" for shm:PATH", error);
+  EXPECT_FALSE(StreamingListener::ParseTarget("shm:/dev/shm/r?buffer=64",
+                                              &address, &options, &error));
+  EXPECT_FALSE(StreamingListener::ParseTarget("unix:/tmp/s?size=64",
+                                              &address, &options, &error));
+  EXPECT_FALSE(StreamingListener::ParseTarget("unix:/tmp/s?buffer", &address,
+                                              &options, &error));
+  EXPECT_EQ("missing '=' in option \"buffer\"", error);
+  EXPECT_FALSE(StreamingListener::ParseTarget("unix:/tmp/s?buffer=-1",
+                                              &address, &options, &error));
+  EXPECT_EQ("invalid option \"buffer=-1\"", error);
+  EXPECT_FALSE(StreamingListener::ParseTarget("unix:/tmp/s?framing=json",
+                                              &address, &options, &error));
+  EXPECT_FALSE(StreamingListener::ParseTarget("unix:/tmp/s?colour=red",
+                                              &address, &options, &error));
+  EXPECT_EQ("invalid option \"colour=red\"", error);
+}
+
+class RingBufferWriterTest : public Test {
+ protected:
+  // A record read back from the ring: its sequence number and contents.
+  using Record = std::pair<uint32_t, std::string>;
+
+  RingBufferWriterTest() : path_(TempDir() + "gtest_ring_buffer_test") {}
+
+  ~RingBufferWriterTest() override { remove(path_.c_str()); }
+
+  // Reads the header field of type T at offset.
+  template <typename T>
+  static T Read(const std::string& bytes, size_t offset) {
+    T value;
+    memcpy(&value, bytes.data() + offset, sizeof(value));
+    return value;
+  }
+
+  // Reads the records from the oldest one on, as a reader following the
+  // ring from another process would.
+  std::vector<Record> ReadRecords(bool* finished) {
+    FILE* const file = posix::FOpen(path_.c_str(), "rb");
+    std::string bytes;
+    char buffer[256];
+    for (size_t n; (n = fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+      bytes.append(buffer, n);
+    }
+    posix::FClose(file);
+
+    EXPECT_EQ("gtestrng", bytes.substr(0, 8));
+    EXPECT_EQ(1u, (Read<uint32_t>(bytes, 8)));
+    const uint32_t header_size = Read<uint32_t>(bytes, 12);
+    const uint64_t capacity = Read<uint64_t>(bytes, 16);
+    EXPECT_EQ(header_size + capacity, bytes.size());
+    *finished = Read<uint32_t>(bytes, 40) != 0;
+
+    std::vector<Record> records;
+    const char* const data = bytes.data() + header_size;
+    for (uint64_t position = Read<uint64_t>(bytes, 24),
+                  end = Read<uint64_t>(bytes, 32);
+         position < end;) {
+      const uint64_t offset = position % capacity;
+      const uint32_t size = Read<uint32_t>(bytes, header_size + offset);
+      if (size == 0xffffffff) {
+        position += capacity - offset;
+        continue;
+      }
+      records.emplace_back(Read<uint32_t>(bytes, header_size + offset + 4),
+                           std::string(data + offset + 8, size));
+      position += (8 + size + 7) / 8 * 8;
+    }
+    return records;
+  }
+
+  const std::string path_;
+};
+
+TEST_F(RingBufferWriterTest, KeepsTheNewestRecords) {
+  StreamingListener::RingBufferWriter writer(path_, 64);
+  bool finished = true;
+  EXPECT_EQ(std::vector<Record>(), ReadRecords(&finished));
+  EXPECT_FALSE(finished);
+
+  writer.Send("first");
+  writer.Send("second");
+  EXPECT_EQ((std::vector<Record>{{0, "first"}, {1, "second"}}),
+            ReadRecords(&finished));
+
+  // Each of these takes up 16 bytes, so the ring holds the last 4.
+  for (int i = 2; i < 7; ++i) {
+    writer.Send("record" + StreamableToString(i));
+  }
+  EXPECT_EQ((std::vector<Record>{{3, "record3"},
+                                 {4, "record4"},
+                                 {5, "record5"},
+                                 {6, "record6"}}),
+            ReadRecords(&finished));
+
+  // This one takes up 24 bytes and does not fit in the 16 bytes left before
+  // the end of the ring, which are marked unused.  It goes to the start of
+  // the ring, and so replaces record3 to record5.
+  writer.Send("a longer record");
+  EXPECT_EQ((std::vector<Record>{{6, "record6"}, {7, "a longer record"}}),
+            ReadRecords(&finished));
+
+  writer.CloseConnection();
+  ReadRecords(&finished);
+  EXPECT_TRUE(finished);
+}
+
+TEST_F(RingBufferWriterTest, SkipsRecordsLargerThanTheRing) {
+  StreamingListener::RingBufferWriter writer(path_, 64);
+  writer.Send("a");
+  writer.Send(std::string(64, 'b'));
+  writer.Send(std::string(56, 'c'));
+  bool finished;
+  EXPECT_EQ((std::vector<Record>{{2, std::string(56, 'c')}}),
+            ReadRecords(&finished));
+}
+
+TEST(TestRequestServerTest, ParsesRequests) {
+  TestRunRequest request;
+  std::string error;
+  ASSERT_TRUE(TestRequestServer::ParseRequest("", &request, &error));
+  EXPECT_EQ("*", request.filter);
+  EXPECT_EQ(1, request.repeat);
+  EXPECT_EQ("stream", request.output);
+
+  ASSERT_TRUE(TestRequestServer::ParseRequest(
+      "filter=Foo.*%3ABar.*-Bar.Baz&repeat=3", &request, &error));
+  EXPECT_EQ("Foo.*:Bar.*-Bar.Baz", request.filter);
+  EXPECT_EQ(3, request.repeat);
+  EXPECT_EQ("stream", request.output);
+}
+
+TEST(TestRequestServerTest, RejectsMalformedRequests) {
+  TestRunRequest request;
+  std::string error;
+  EXPECT_FALSE(TestRequestServer::ParseRequest("filter", &request, &error));
+  EXPECT_FALSE(TestRequestServer::ParseRequest("repeat=0", &request, &error));
+  EXPECT_FALSE(TestRequestServer::ParseRequest("repeat=2x", &request, &error));
+  EXPECT_FALSE(
+      TestRequestServer::ParseRequest("output=html", &request, &error));
+  EXPECT_FALSE(TestRequestServer::ParseRequest("colour=no", &request, &error));
+  EXPECT_EQ("unknown field \"colour\"", error);
+}
+
 #endif  // GTEST_CAN_STREAM_RESULTS_
 
 // Provides access to otherwise private parts of the TestEventListeners class
@@ -245,29 +486,37 @@ using testing::TestPartResultArray;
 using testing::TestProperty;
 using testing::TestResult;
 using testing::TimeInMillis;
+using testing::TimeInNanos;
 using testing::UnitTest;
 using testing::internal::AlwaysFalse;
 using testing::internal::AlwaysTrue;
 using testing::internal::AppendUserMessage;
 using testing::internal::ArrayAwareFind;
 using testing::internal::ArrayEq;
+using testing::internal::AssignTestsToShards;
 using testing::internal::CodePointToUtf8;
 using testing::internal::CopyArray;
 using testing::internal::CountIf;
 using testing::internal::EqFailure;
+using testing::internal::EscapeJson;
+using testing::internal::EscapeXml;
+using testing::internal::FindByteToEscape;
 using testing::internal::FloatingPoint;
 using testing::internal::ForEach;
 using testing::internal::FormatEpochTimeInMillisAsIso8601;
 using testing::internal::FormatTimeInMillisAsSeconds;
+using testing::internal::FormatTimeInNanosAsSeconds;
 using testing::internal::GetElementOr;
 using testing::internal::GetNextRandomSeed;
 using testing::internal::GetRandomSeedFromFlag;
 using testing::internal::GetTestTypeId;
 using testing::internal::GetTimeInMillis;
 using testing::internal::GetTypeId;
+using testing::internal::GetShardOfTestByHash;
 using testing::internal::GetUnitTestImpl;
 using testing::internal::GTestFlagSaver;
 using testing::internal::HasDebugStringAndShortDebugString;
+using testing::internal::HashTestName;
 using testing::internal::Int32FromEnvOrDie;
 using testing::internal::IsContainer;
 using testing::internal::IsContainerTest;
@@ -276,8 +525,10 @@ using testing::internal::kMaxRandomSeed;
 using testing::internal::kTestTypeIdInGoogleTest;
 using testing::internal::NativeArray;
 using testing::internal::ParseFlag;
+using testing::internal::ParseTestDurationsFromJsonReport;
 using testing::internal::RelationToSourceCopy;
 using testing::internal::RelationToSourceReference;
+using testing::internal::RemoveInvalidXmlCharacters;
 using testing::internal::ShouldRunTestOnShard;
 using testing::internal::ShouldShard;
 using testing::internal::ShouldUseColor;
@@ -288,6 +539,9 @@ using testing::internal::StreamableToString;
 using testing::internal::String;
 using testing::internal::TestEventListenersAccessor;
 using testing::internal::TestResultAccessor;
+#if GTEST_HAS_FILE_SYSTEM
+using testing::internal::TestResultCache;
+#endif  // GTEST_HAS_FILE_SYSTEM
 using testing::internal::WideStringToUtf8;
 using testing::internal::edit_distance::CalculateOptimalEdits;
 using testing::internal::edit_distance::CreateUnifiedDiff;
@@ -438,6 +692,29 @@ TEST(FormatTimeInMillisAsSecondsTest, FormatsNegativeNumber) {
   EXPECT_EQ("-1234567.89", FormatTimeInMillisAsSeconds(-1234567890));
 }
 
+// Tests FormatTimeInNanosAsSeconds().
+
+TEST(FormatTimeInNanosAsSecondsTest, FormatsZero) {
+  EXPECT_EQ("0.", FormatTimeInNanosAsSeconds(0));
+}
+
+TEST(FormatTimeInNanosAsSecondsTest, FormatsPositiveNumber) {
+  EXPECT_EQ("0.000000001", FormatTimeInNanosAsSeconds(1));
+  EXPECT_EQ("0.00000025", FormatTimeInNanosAsSeconds(250));
+  EXPECT_EQ("0.000012", FormatTimeInNanosAsSeconds(12000));
+  EXPECT_EQ("0.003", FormatTimeInNanosAsSeconds(3000000));
+  EXPECT_EQ("1.2", FormatTimeInNanosAsSeconds(1200000000));
+  EXPECT_EQ("3.", FormatTimeInNanosAsSeconds(3000000000));
+  EXPECT_EQ("123.456789012", FormatTimeInNanosAsSeconds(123456789012));
+}
+
+TEST(FormatTimeInNanosAsSecondsTest, FormatsNegativeNumber) {
+  EXPECT_EQ("-0.000000001", FormatTimeInNanosAsSeconds(-1));
+  EXPECT_EQ("-0.000012", FormatTimeInNanosAsSeconds(-12000));
+  EXPECT_EQ("-3.", FormatTimeInNanosAsSeconds(-3000000000));
+  EXPECT_EQ("-123.456789012", FormatTimeInNanosAsSeconds(-123456789012));
+}
+
 // TODO: b/287046337 - In emscripten, local time zone modification is not
 // supported.
 #if !defined(__EMSCRIPTEN__)
@@ -534,6 +811,80 @@ TEST_F(FormatEpochTimeInMillisAsIso8601Test, PrintsEpochStart) {
 
 #endif  // __EMSCRIPTEN__
 
+// Tests FindByteToEscape() with the byte to find at every position of
+// strings long enough to be scanned several bytes at a time.
+TEST(FindByteToEscapeTest, FindsByteAtAnyPosition) {
+  const char kFound[] = {'<', '\n', '\0', '\x1f'};
+  for (size_t size = 0; size <= 40; size++) {
+    std::string str(size, 'a');
+    const char* const begin = str.data();
+    const char* const end = begin + size;
+    EXPECT_EQ(end, FindByteToEscape(begin, end, "<>"));
+    for (size_t i = 0; i < size; i++) {
+      for (char c : kFound) {
+        str[i] = c;
+        EXPECT_EQ(begin + i, FindByteToEscape(begin, end, "<>"))
+            << "size " << size << ", byte " << static_cast<int>(c) << " at "
+            << i;
+      }
+      str[i] = 'a';
+    }
+  }
+}
+
+TEST(FindByteToEscapeTest, SkipsNonAsciiBytes) {
+  const std::string str = std::string(20, '\xc3') + "<";
+  const char* const begin = str.data();
+  const char* const end = begin + str.size();
+  EXPECT_EQ(begin + 20, FindByteToEscape(begin, end, "<"));
+  EXPECT_EQ(end, FindByteToEscape(begin, end, ""));
+}
+
+TEST(EscapeXmlTest, EscapesAttributeValues) {
+  EXPECT_EQ("", EscapeXml("", true));
+  EXPECT_EQ("a &lt;b&gt; &amp; &apos;c&apos; &quot;d&quot;&#x0A;e",
+            EscapeXml("a <b> & 'c' \"d\"\ne", true));
+  EXPECT_EQ("invalid:  valid: &#x09;\xc3\xa9",
+            EscapeXml("invalid: \x01\x1f valid: \t\xc3\xa9", true));
+}
+
+TEST(EscapeXmlTest, EscapesText) {
+  EXPECT_EQ("a &lt;b&gt; &amp; 'c' \"d\"\ne",
+            EscapeXml("a <b> & 'c' \"d\"\ne", false));
+}
+
+TEST(EscapeXmlTest, EscapesLongStrings) {
+  const std::string chunk = "0123456789 abcdefghijklmnopqrstuvwxyz <&>\n";
+  const std::string escaped =
+      "0123456789 abcdefghijklmnopqrstuvwxyz &lt;&amp;&gt;&#x0A;";
+  std::string str;
+  std::string expected;
+  for (int i = 0; i < 10; i++) {
+    str += chunk;
+    expected += escaped;
+  }
+  EXPECT_EQ(expected, EscapeXml(str, true));
+}
+
+TEST(RemoveInvalidXmlCharactersTest, RemovesControlCharacters) {
+  const std::string str("a\tb\nc\r\0\x01"
+                        "d]]>\xc3\xa9",
+                        14);
+  EXPECT_EQ("a\tb\nc\rd]]>\xc3\xa9", RemoveInvalidXmlCharacters(str));
+}
+
+TEST(EscapeJsonTest, EscapesSpecialCharacters) {
+  EXPECT_EQ("", EscapeJson(""));
+  EXPECT_EQ("a\\\\b\\\"c\\/d", EscapeJson("a\\b\"c/d"));
+  EXPECT_EQ("\\b\\t\\n\\f\\r\\u0001\\u001F",
+            EscapeJson("\b\t\n\f\r\x01\x1f"));
+  EXPECT_EQ("caf\xc3\xa9", EscapeJson("caf\xc3\xa9"));
+  EXPECT_EQ(std::string(40, '\xc3') + "\\n",
+            EscapeJson(std::string(40, '\xc3') + "\n"));
+  EXPECT_EQ(std::string(40, 'x') + "\\n" + std::string(40, 'y'),
+            EscapeJson(std::string(40, 'x') + "\n" + std::string(40, 'y')));
+}
+
 #ifdef __BORLANDC__
 // Silences warnings: "Condition is always true", "Unreachable code"
 #pragma option push -w-ccc -w-rch
@@ -1995,6 +2346,140 @@ TEST(ShouldRunTestOnShardTest, IsPartitionWhenThereAreFiveShards) {
   }
 }
 
+// Tests that AssignTestsToShards() gives the shards about the same amount of
+// work, longest test first.
+TEST(AssignTestsToShardsTest, BalancesTheDurations) {
+  const std::vector<TimeInNanos> durations = {10, 70, 20, 30, 40, 10, 10};
+  const std::vector<int> shards = AssignTestsToShards(durations, 3);
+  ASSERT_EQ(durations.size(), shards.size());
+
+  std::vector<TimeInNanos> loads(3, 0);
+  for (size_t i = 0; i < durations.size(); i++) {
+    ASSERT_GE(shards[i], 0);
+    ASSERT_LT(shards[i], 3);
+    loads[static_cast<size_t>(shards[i])] += durations[i];
+  }
+  EXPECT_EQ(70, loads[0]);
+  EXPECT_EQ(60, loads[1]);
+  EXPECT_EQ(60, loads[2]);
+}
+
+// Tests that AssignTestsToShards() breaks ties by the order of the tests.
+TEST(AssignTestsToShardsTest, IsDeterministic) {
+  const std::vector<TimeInNanos> durations(7, 1);
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 0, 1, 2, 0}),
+            AssignTestsToShards(durations, 3));
+}
+
+// Tests that HashTestName() only depends on the name of the test, so that
+// tests keep their shard under --gtest_shard_by=hash.
+TEST(HashTestNameTest, IsStable) {
+  EXPECT_EQ(0xece760fa364dcc1au, HashTestName("FooTest.Bar"));
+  EXPECT_NE(HashTestName("FooTest.Bar"), HashTestName("FooTest.Baz"));
+}
+
+// Tests that GetShardOfTestByHash() gives each shard a share of the tests
+// proportional to its weight.
+TEST(GetShardOfTestByHashTest, HonorsTheWeights) {
+  EXPECT_EQ(1, GetShardOfTestByHash("FooTest.Bar", {1, 1, 1}));
+
+  std::vector<int> tests_per_shard(2, 0);
+  for (int i = 0; i < 1000; i++) {
+    const int shard =
+        GetShardOfTestByHash("T.Test" + std::to_string(i), {3, 1});
+    ASSERT_GE(shard, 0);
+    ASSERT_LT(shard, 2);
+    tests_per_shard[static_cast<size_t>(shard)]++;
+  }
+  EXPECT_EQ(737, tests_per_shard[0]);
+  EXPECT_EQ(263, tests_per_shard[1]);
+}
+
+TEST(ParseTestDurationsFromJsonReportTest, ReadsTheTestTimes) {
+  std::unordered_map<std::string, TimeInNanos> durations;
+  ASSERT_TRUE(ParseTestDurationsFromJsonReport(
+      R"({"tests": 3, "testsuites": [{"name": "FooTest", "testsuite": [)"
+      R"({"name": "Bar", "result": "COMPLETED", "time": "1.5s",)"
+      R"( "properties": {"a": [1, true]}},)"
+      R"({"name": "Baz\u0041", "result": "COMPLETED", "time": "0.002s"},)"
+      R"({"name": "Qux", "result": "COMPLETED", "time": "0.00000025s"}]}]})",
+      &durations));
+  EXPECT_EQ(3u, durations.size());
+  EXPECT_EQ(1500000000, durations["FooTest.Bar"]);
+  EXPECT_EQ(2000000, durations["FooTest.BazA"]);
+  EXPECT_EQ(250, durations["FooTest.Qux"]);
+}
+
+TEST(ParseTestDurationsFromJsonReportTest, SkipsTheTestsThatDidNotComplete) {
+  std::unordered_map<std::string, TimeInNanos> durations;
+  ASSERT_TRUE(ParseTestDurationsFromJsonReport(
+      R"({"testsuites": [{"name": "FooTest", "testsuite": [)"
+      R"({"name": "Bar", "result": "COMPLETED", "time": "1s"},)"
+      R"({"name": "Baz", "result": "SUPPRESSED", "time": "0s"},)"
+      R"({"name": "Qux", "result": "SKIPPED", "time": "0s"},)"
+      R"({"name": "Quux", "time": "0s"}]}]})",
+      &durations));
+  EXPECT_EQ(1u, durations.size());
+  EXPECT_EQ(1000000000, durations["FooTest.Bar"]);
+}
+
+TEST(ParseTestDurationsFromJsonReportTest, RejectsOtherDocuments) {
+  std::unordered_map<std::string, TimeInNanos> durations;
+  EXPECT_FALSE(ParseTestDurationsFromJsonReport("", &durations));
+  EXPECT_FALSE(ParseTestDurationsFromJsonReport("<testsuites/>", &durations));
+  EXPECT_FALSE(ParseTestDurationsFromJsonReport(R"({"testsuites": [)",
+                                                &durations));
+  EXPECT_FALSE(ParseTestDurationsFromJsonReport(
+      R"({"testsuites": [{"name": "FooTest", "testsuite": [{"name": "B"}]}]})",
+      &durations));
+}
+
+#if GTEST_HAS_FILE_SYSTEM
+TEST(TestResultCacheTest, KeepsTheTestsThatPassed) {
+  const testing::internal::FilePath directory(testing::TempDir());
+  const std::string program_id = "TestResultCacheTest";
+  {
+    TestResultCache cache(directory, program_id);
+    remove(cache.path().c_str());
+    cache.Record(1, true);
+    cache.Record(2, true);
+    cache.Record(3, false);
+    ASSERT_TRUE(cache.Save());
+  }
+  {
+    TestResultCache cache(directory, program_id);
+    EXPECT_TRUE(cache.Contains(1));
+    EXPECT_TRUE(cache.Contains(2));
+    EXPECT_FALSE(cache.Contains(3));
+    EXPECT_FALSE(TestResultCache(directory, "OtherProgram").Contains(1));
+    cache.Record(2, false);
+    ASSERT_TRUE(cache.Save());
+  }
+  TestResultCache cache(directory, program_id);
+  EXPECT_TRUE(cache.Contains(1));
+  EXPECT_FALSE(cache.Contains(2));
+  remove(cache.path().c_str());
+}
+
+TEST(TestResultCacheTest, IgnoresMalformedFiles) {
+  const testing::internal::FilePath directory(testing::TempDir());
+  const std::string program_id = "TestResultCacheTest.IgnoresMalformedFiles";
+  const testing::internal::FilePath path =
+      TestResultCache(directory, program_id).path();
+  FILE* const file = testing::internal::posix::FOpen(path.c_str(), "wb");
+  ASSERT_TRUE(file != nullptr);
+  fputs("GTCACHE1 is not enough", file);
+  testing::internal::posix::FClose(file);
+
+  TestResultCache cache(directory, program_id);
+  EXPECT_FALSE(cache.Contains(0));
+  cache.Record(1, true);
+  ASSERT_TRUE(cache.Save());
+  EXPECT_TRUE(TestResultCache(directory, program_id).Contains(1));
+  remove(path.c_str());
+}
+#endif  // GTEST_HAS_FILE_SYSTEM
+
 // For the same reason we are not explicitly testing everything in the
 // Test class, there are no separate tests for the following classes
 // (except for some trivial cases):
@@ -7870,3 +8355,245 @@ TEST(PatternGlobbingTest, MatchesFilterEdgeCases) {
   EXPECT_FALSE(testing::internal::UnitTestOptions::MatchesFilter("a", ""));
   EXPECT_TRUE(testing::internal::UnitTestOptions::MatchesFilter("", ""));
 }
+
+TEST(PatternGlobbingTest, MatchesFilterWithSharedPrefixes) {
+  const char* const filter = "Foo.Bar:Foo.Baz:Foo.B?x:Foo.**Qux:Fo";
+  EXPECT_TRUE(testing::internal::UnitTestOptions::MatchesFilter("Foo.Bar",
+                                                                filter));
+  EXPECT_TRUE(testing::internal::UnitTestOptions::MatchesFilter("Foo.Baz",
+                                                                filter));
+  EXPECT_TRUE(testing::internal::UnitTestOptions::MatchesFilter("Foo.Bax",
+                                                                filter));
+  EXPECT_TRUE(testing::internal::UnitTestOptions::MatchesFilter("Foo.Qux",
+                                                                filter));
+  EXPECT_TRUE(testing::internal::UnitTestOptions::MatchesFilter("Foo.QuxQux",
+                                                                filter));
+  EXPECT_TRUE(testing::internal::UnitTestOptions::MatchesFilter("Fo", filter));
+  EXPECT_FALSE(testing::internal::UnitTestOptions::MatchesFilter("Foo.Ba",
+                                                                 filter));
+  EXPECT_FALSE(testing::internal::UnitTestOptions::MatchesFilter("Foo.Barr",
+                                                                 filter));
+  EXPECT_FALSE(testing::internal::UnitTestOptions::MatchesFilter("Foo.Quxx",
+                                                                 filter));
+  EXPECT_FALSE(testing::internal::UnitTestOptions::MatchesFilter("Foo",
+                                                                 filter));
+}
+
+// The suite name and the test name are matched in two steps, which must give
+// the same results as matching "suite.test".
+TEST(PatternGlobbingTest, FilterMatchesTestAcrossTheDot) {
+  testing::internal::GTestFlagSaver flag_saver;
+  GTEST_FLAG_SET(filter,
+                 "Foo*Bar.*:A?B:Exact.Name:Ne*-*.Skipped*:Foo.Bar.Y:Neg.*");
+  EXPECT_TRUE(
+      testing::internal::UnitTestOptions::FilterMatchesTest("FooX", "Bar.Y"));
+  EXPECT_TRUE(
+      testing::internal::UnitTestOptions::FilterMatchesTest("FooBar", "Z"));
+  EXPECT_TRUE(testing::internal::UnitTestOptions::FilterMatchesTest("A", "B"));
+  EXPECT_TRUE(
+      testing::internal::UnitTestOptions::FilterMatchesTest("Exact", "Name"));
+  EXPECT_FALSE(
+      testing::internal::UnitTestOptions::FilterMatchesTest("Foo", "Bar.Y"));
+  EXPECT_FALSE(
+      testing::internal::UnitTestOptions::FilterMatchesTest("Exact", "Nam"));
+  EXPECT_FALSE(
+      testing::internal::UnitTestOptions::FilterMatchesTest("A", "BB"));
+  EXPECT_FALSE(testing::internal::UnitTestOptions::FilterMatchesTest(
+      "FooBar", "Skipped"));
+  EXPECT_TRUE(
+      testing::internal::UnitTestOptions::FilterMatchesTest("Nex", "Y"));
+  EXPECT_FALSE(
+      testing::internal::UnitTestOptions::FilterMatchesTest("Neg", "Y"));
+}
+
+// Tests that BenchmarkRunner calibrates the number of iterations before it
+// takes samples, and records their statistics in the current test's result.
+TEST(BenchmarkRunnerTest, CalibratesThenSamples) {
+  testing::internal::GTestFlagSaver flag_saver;
+  GTEST_FLAG_SET(benchmark_time_ms, 10);
+  testing::internal::BenchmarkRunner runner;
+
+  // A sample should take a tenth of the 10 ms.  The iterations grow by at
+  // most a factor of 100 at a time until a batch takes that long.
+  EXPECT_EQ(1, runner.NextIterations());
+  runner.Record(1, 1000);
+  EXPECT_EQ(100, runner.NextIterations());
+  runner.Record(100, 500000);
+  EXPECT_EQ(240, runner.NextIterations());
+  runner.Record(240, 1200000);
+
+  const int64_t kSampleNanos[] = {600000, 1200000, 600000, 600000,
+                                  600000, 600000,  1800000, 600000,
+                                  600000, 600000};
+  for (int64_t nanos : kSampleNanos) {
+    ASSERT_EQ(240, runner.NextIterations());
+    runner.Record(240, nanos);
+  }
+  EXPECT_EQ(0, runner.NextIterations());
+
+  const TestResult& result =
+      *UnitTest::GetInstance()->current_test_info()->result();
+  ASSERT_TRUE(result.HasBenchmarkResult());
+  const testing::BenchmarkResult& benchmark = result.benchmark_result();
+  EXPECT_EQ(240, benchmark.iterations());
+  EXPECT_EQ(10, benchmark.samples());
+  EXPECT_DOUBLE_EQ(3250, benchmark.mean_ns());
+  EXPECT_DOUBLE_EQ(2500, benchmark.median_ns());
+  EXPECT_NEAR(1687, benchmark.stddev_ns(), 1);
+  EXPECT_NEAR(307692, benchmark.iterations_per_second(), 1);
+}
+
+// Tests that BenchmarkRunner stops growing the batches of a body that takes
+// no time, as when the optimizer has removed it.
+TEST(BenchmarkRunnerTest, CapsTheIterations) {
+  testing::internal::GTestFlagSaver flag_saver;
+  GTEST_FLAG_SET(benchmark_time_ms, 10);
+  testing::internal::BenchmarkRunner runner;
+
+  const int64_t kBatches[] = {1, 100, 10000, 1000000, 100000000, 1000000000};
+  for (int64_t iterations : kBatches) {
+    ASSERT_EQ(iterations, runner.NextIterations());
+    runner.Record(iterations, 0);
+  }
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(1000000000, runner.NextIterations());
+    runner.Record(1000000000, 1);
+  }
+  EXPECT_EQ(0, runner.NextIterations());
+  EXPECT_EQ(1000000000, UnitTest::GetInstance()
+                            ->current_test_info()
+                            ->result()
+                            ->benchmark_result()
+                            .iterations());
+}
+
+// Tests that BenchmarkRunner takes fewer samples when they use up the time
+// it is given.
+TEST(BenchmarkRunnerTest, StopsWhenOutOfTime) {
+  testing::internal::GTestFlagSaver flag_saver;
+  GTEST_FLAG_SET(benchmark_time_ms, 10);
+  testing::internal::BenchmarkRunner runner;
+
+  EXPECT_EQ(1, runner.NextIterations());
+  runner.Record(1, 5000000);
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_EQ(1, runner.NextIterations());
+    runner.Record(1, 4000000);
+  }
+  EXPECT_EQ(0, runner.NextIterations());
+  EXPECT_EQ(3, UnitTest::GetInstance()
+                   ->current_test_info()
+                   ->result()
+                   ->benchmark_result()
+                   .samples());
+}
+
+// Tests that a benchmark given no time runs its body once, untimed.
+TEST(BenchmarkRunnerTest, RunsOnceWithoutTime) {
+  testing::internal::GTestFlagSaver flag_saver;
+  GTEST_FLAG_SET(benchmark_time_ms, 0);
+  int runs = 0;
+  testing::internal::RunBenchmark([&runs] { ++runs; });
+  EXPECT_EQ(1, runs);
+  EXPECT_FALSE(UnitTest::GetInstance()
+                   ->current_test_info()
+                   ->result()
+                   ->HasBenchmarkResult());
+}
+
+// A benchmark test that checks its timing once it has run.
+class BenchmarkFixtureTest : public Test {
+ protected:
+  BenchmarkFixtureTest() { GTEST_FLAG_SET(benchmark_time_ms, 5); }
+
+  void TearDown() override {
+    const TestResult& result =
+        *UnitTest::GetInstance()->current_test_info()->result();
+    ASSERT_TRUE(result.HasBenchmarkResult());
+    EXPECT_GE(result.benchmark_result().samples(), 3);
+    EXPECT_GT(result.benchmark_result().iterations(), 0);
+    EXPECT_GE(result.benchmark_result().mean_ns(), 0);
+  }
+
+  testing::internal::GTestFlagSaver flag_saver_;
+  std::string text_ = "benchmark";
+};
+
+TEST_F_BENCHMARK(BenchmarkFixtureTest, UsesTheFixture) {
+  testing::DoNotOptimize(text_.find('m'));
+}
+
+// Tests that ResourceMeter only measures with --gtest_print_resources.
+TEST(ResourceMeterTest, MeasuresOnlyWhenAsked) {
+  testing::internal::GTestFlagSaver flag_saver;
+  testing::ResourceUsage usage;
+  GTEST_FLAG_SET(print_resources, false);
+  EXPECT_FALSE(testing::internal::ResourceMeter().Measure(&usage));
+
+  GTEST_FLAG_SET(print_resources, true);
+  const testing::internal::ResourceMeter meter;
+  const clock_t start = clock();
+  while (clock() - start < CLOCKS_PER_SEC / 50) {
+  }
+#if GTEST_CAN_MEASURE_RESOURCES_
+  ASSERT_TRUE(meter.Measure(&usage));
+  EXPECT_GE(usage.user_cpu_time_us + usage.system_cpu_time_us, 10000);
+  EXPECT_GT(usage.max_rss_kb, 0);
+  EXPECT_GE(usage.max_rss_growth_kb, 0);
+#else
+  EXPECT_FALSE(meter.Measure(&usage));
+#endif  // GTEST_CAN_MEASURE_RESOURCES_
+}
+
+// Tests that the allocation assertions fail when the test program is not
+// linked with gtest_alloc.
+TEST(AllocationAssertionTest, FailsWhenAllocationsAreNotCounted) {
+  EXPECT_FALSE(testing::internal::AllocationScope().counting());
+  EXPECT_FALSE(testing::UnitTest::GetInstance()
+                   ->current_test_info()
+                   ->result()
+                   ->HasAllocationStats());
+  EXPECT_NONFATAL_FAILURE(EXPECT_NO_ALLOCATIONS(testing::DoNotOptimize(1)),
+                          "link the test program with gtest_alloc");
+  EXPECT_FATAL_FAILURE(ASSERT_ALLOCATIONS_LE(1, testing::DoNotOptimize(1)),
+                       "allocates at most 1 times");
+}
+
+// Tests that the elapsed time of a test is kept in nanoseconds, and that the
+// elapsed time in milliseconds is truncated from it.
+TEST(ElapsedTimeTest, RunsInLessThanAMillisecond) {}
+
+TEST(ElapsedTimeTest, IsKeptInNanoseconds) {
+  const testing::TestResult& result = *testing::UnitTest::GetInstance()
+                                           ->current_test_suite()
+                                           ->GetTestInfo(0)
+                                           ->result();
+  EXPECT_GT(result.elapsed_time_nanos(), 0);
+  EXPECT_EQ(result.elapsed_time_nanos() / 1000000, result.elapsed_time());
+}
+
+// Tests that the phases of a test are timed, and that they are only reported
+// with --gtest_print_phase_times.
+TEST(PhaseTimesTest, SpendsTwoMillisecondsInTheBody) {
+  const auto start = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() - start <
+         std::chrono::milliseconds(2)) {
+  }
+}
+
+TEST(PhaseTimesTest, TimesEachPhase) {
+  const testing::TestResult& result = *testing::UnitTest::GetInstance()
+                                           ->current_test_suite()
+                                           ->GetTestInfo(0)
+                                           ->result();
+  EXPECT_EQ(GTEST_FLAG_GET(print_phase_times), result.HasPhaseTimes());
+  const testing::TestPhaseTimes& times = result.phase_times();
+  EXPECT_GE(times.body_nanos, 2000000);
+  EXPECT_GE(times.constructor_nanos, 0);
+  EXPECT_GE(times.set_up_nanos, 0);
+  EXPECT_GE(times.tear_down_nanos, 0);
+  EXPECT_GE(times.destructor_nanos, 0);
+  EXPECT_LE(times.constructor_nanos + times.set_up_nanos + times.body_nanos +
+                times.tear_down_nanos + times.destructor_nanos,
+            result.elapsed_time_nanos());
+}